@@ -65,6 +65,235 @@ void* dlmalloc_sbrk(ptrdiff_t increment)
     return ptr;
 }
 
+/*
+**==============================================================================
+**
+** Per-thread caches
+**
+**     Every dlmalloc call takes the global lock. To keep small allocations
+**     off that lock, each enclave thread keeps the small chunks it frees in
+**     free lists, one per chunk size, and reuses them for allocations of the
+**     same chunk size. A cache is refilled with several chunks at a time
+**     (with a single dlindependent_comalloc call) and trimmed several chunks
+**     at a time (with a single dlbulk_free call), and never holds more than
+**     OE_DLMALLOC_THREAD_CACHE_SIZE bytes. Cached chunks stay allocated from
+**     the point of view of dlmalloc, so oe_allocator_mallinfo() subtracts
+**     them.
+**
+**     A cache lives in the thread-local data, which is only valid between
+**     oe_allocator_thread_init() and oe_allocator_thread_cleanup(), that is,
+**     for the duration of an ecall. The cleanup returns all the cached chunks.
+**
+**==============================================================================
+*/
+
+#ifndef OE_DLMALLOC_THREAD_CACHE_SIZE
+#if defined(__x86_64__)
+#define OE_DLMALLOC_THREAD_CACHE_SIZE (64 * 1024)
+#else
+#define OE_DLMALLOC_THREAD_CACHE_SIZE 0
+#endif
+#endif
+
+#if OE_DLMALLOC_THREAD_CACHE_SIZE > 0
+
+/* Chunk sizes from MIN_CHUNK_SIZE (32 bytes) to 512 bytes are cached */
+#define CACHE_MAX_CHUNK_SIZE 512
+#define CACHE_NUM_CLASSES \
+    ((CACHE_MAX_CHUNK_SIZE - MIN_CHUNK_SIZE) / MALLOC_ALIGNMENT + 1)
+#define CACHE_MAX_CHUNKS_PER_CLASS 64
+#define CACHE_REFILL_COUNT 8
+
+typedef struct _thread_cache
+{
+    /* Free lists, linked through the first word of the chunks */
+    void* chunks[CACHE_NUM_CLASSES];
+    uint32_t counts[CACHE_NUM_CLASSES];
+    size_t bytes;
+    bool enabled;
+
+    /* Links of the list of caches, for oe_allocator_mallinfo() */
+    struct _thread_cache* prev;
+    struct _thread_cache* next;
+} thread_cache_t;
+
+static __thread thread_cache_t _thread_cache;
+static thread_cache_t* _thread_caches;
+static int _thread_caches_lock = 0;
+
+OE_INLINE size_t _get_cache_class(size_t chunk_size)
+{
+    return (chunk_size - MIN_CHUNK_SIZE) / MALLOC_ALIGNMENT;
+}
+
+OE_INLINE size_t _get_class_chunk_size(size_t index)
+{
+    return MIN_CHUNK_SIZE + index * MALLOC_ALIGNMENT;
+}
+
+/* Return up to count chunks of the given class to dlmalloc */
+static void _trim_cache_class(thread_cache_t* cache, size_t index, size_t count)
+{
+    void* chunks[CACHE_MAX_CHUNKS_PER_CLASS];
+    size_t n = 0;
+
+    while (n < count && cache->chunks[index])
+    {
+        void* chunk = cache->chunks[index];
+        cache->chunks[index] = *(void**)chunk;
+        chunks[n++] = chunk;
+    }
+
+    cache->counts[index] -= (uint32_t)n;
+    cache->bytes -= n * _get_class_chunk_size(index);
+
+    if (n)
+        dlbulk_free(chunks, n);
+}
+
+static void* _cache_malloc(thread_cache_t* cache, size_t size)
+{
+    size_t chunk_size = request2size(size);
+    size_t index = 0;
+    size_t count = CACHE_REFILL_COUNT;
+    size_t sizes[CACHE_REFILL_COUNT];
+    void* chunks[CACHE_REFILL_COUNT];
+    void* ptr = NULL;
+
+    if (size >= MAX_REQUEST || chunk_size > CACHE_MAX_CHUNK_SIZE)
+        return dlmalloc(size);
+
+    index = _get_cache_class(chunk_size);
+
+    if ((ptr = cache->chunks[index]))
+    {
+        cache->chunks[index] = *(void**)ptr;
+        cache->counts[index]--;
+        cache->bytes -= chunk_size;
+        return ptr;
+    }
+
+    /* Refill the class with a single call, within the size of the cache */
+    while (count > 1 && cache->bytes + (count - 1) * chunk_size >
+                            OE_DLMALLOC_THREAD_CACHE_SIZE)
+        count--;
+
+    if (count == 1)
+        return dlmalloc(size);
+
+    for (size_t i = 0; i < count; i++)
+        sizes[i] = size;
+
+    if (!dlindependent_comalloc(count, sizes, chunks))
+        return dlmalloc(size);
+
+    /* The last chunk may hold the remainder of the block that dlmalloc
+     * carved the chunks from, so it goes to the caller */
+    for (size_t i = 0; i < count - 1; i++)
+    {
+        *(void**)chunks[i] = cache->chunks[index];
+        cache->chunks[index] = chunks[i];
+    }
+
+    cache->counts[index] += (uint32_t)(count - 1);
+    cache->bytes += (count - 1) * chunk_size;
+
+    return chunks[count - 1];
+}
+
+static void _cache_free(thread_cache_t* cache, void* ptr)
+{
+    size_t chunk_size = chunksize(mem2chunk(ptr));
+    size_t index = 0;
+
+    if (chunk_size > CACHE_MAX_CHUNK_SIZE || chunk_size < MIN_CHUNK_SIZE)
+    {
+        dlfree(ptr);
+        return;
+    }
+
+    index = _get_cache_class(chunk_size);
+
+    /* Catch the simplest double free */
+    if (cache->chunks[index] == ptr)
+        oe_abort();
+
+    /* Make room by returning half of the class */
+    if (cache->counts[index] == CACHE_MAX_CHUNKS_PER_CLASS ||
+        cache->bytes + chunk_size > OE_DLMALLOC_THREAD_CACHE_SIZE)
+    {
+        _trim_cache_class(cache, index, (cache->counts[index] + 1) / 2);
+
+        if (cache->bytes + chunk_size > OE_DLMALLOC_THREAD_CACHE_SIZE)
+        {
+            dlfree(ptr);
+            return;
+        }
+    }
+
+    *(void**)ptr = cache->chunks[index];
+    cache->chunks[index] = ptr;
+    cache->counts[index]++;
+    cache->bytes += chunk_size;
+}
+
+static void _thread_cache_init(void)
+{
+    thread_cache_t* cache = &_thread_cache;
+
+    if (cache->enabled)
+        return;
+
+    ACQUIRE_LOCK(&_thread_caches_lock);
+    cache->prev = NULL;
+    cache->next = _thread_caches;
+    if (_thread_caches)
+        _thread_caches->prev = cache;
+    _thread_caches = cache;
+    RELEASE_LOCK(&_thread_caches_lock);
+
+    cache->enabled = true;
+}
+
+static void _thread_cache_cleanup(void)
+{
+    thread_cache_t* cache = &_thread_cache;
+
+    if (!cache->enabled)
+        return;
+
+    cache->enabled = false;
+
+    for (size_t i = 0; i < CACHE_NUM_CLASSES; i++)
+        _trim_cache_class(cache, i, cache->counts[i]);
+
+    ACQUIRE_LOCK(&_thread_caches_lock);
+    if (cache->prev)
+        cache->prev->next = cache->next;
+    else
+        _thread_caches = cache->next;
+    if (cache->next)
+        cache->next->prev = cache->prev;
+    RELEASE_LOCK(&_thread_caches_lock);
+
+    cache->prev = NULL;
+    cache->next = NULL;
+}
+
+static size_t _get_cached_bytes(void)
+{
+    size_t bytes = 0;
+
+    ACQUIRE_LOCK(&_thread_caches_lock);
+    for (thread_cache_t* cache = _thread_caches; cache; cache = cache->next)
+        bytes += cache->bytes;
+    RELEASE_LOCK(&_thread_caches_lock);
+
+    return bytes;
+}
+
+#endif /* OE_DLMALLOC_THREAD_CACHE_SIZE > 0 */
+
 void oe_allocator_init(void* heap_start_address, void* heap_end_address)
 {
     _heap_start = heap_start_address;
@@ -78,24 +307,52 @@ void oe_allocator_cleanup(void)
 
 void oe_allocator_thread_init(void)
 {
+#if OE_DLMALLOC_THREAD_CACHE_SIZE > 0
+    _thread_cache_init();
+#endif
 }
 
 void oe_allocator_thread_cleanup(void)
 {
+#if OE_DLMALLOC_THREAD_CACHE_SIZE > 0
+    _thread_cache_cleanup();
+#endif
 }
 
 void* oe_allocator_malloc(size_t size)
 {
+#if OE_DLMALLOC_THREAD_CACHE_SIZE > 0
+    if (_thread_cache.enabled)
+        return _cache_malloc(&_thread_cache, size);
+#endif
     return dlmalloc(size);
 }
 
 void oe_allocator_free(void* ptr)
 {
+#if OE_DLMALLOC_THREAD_CACHE_SIZE > 0
+    if (ptr && _thread_cache.enabled)
+    {
+        _cache_free(&_thread_cache, ptr);
+        return;
+    }
+#endif
     dlfree(ptr);
 }
 
 void* oe_allocator_calloc(size_t nmemb, size_t size)
 {
+#if OE_DLMALLOC_THREAD_CACHE_SIZE > 0
+    size_t total = 0;
+
+    if (_thread_cache.enabled && !__builtin_mul_overflow(nmemb, size, &total))
+    {
+        void* ptr = _cache_malloc(&_thread_cache, total);
+        if (ptr)
+            memset(ptr, 0, total);
+        return ptr;
+    }
+#endif
     return dlcalloc(nmemb, size);
 }
 
@@ -126,6 +383,10 @@ oe_result_t oe_allocator_mallinfo(oe_mallinfo_t* info)
     struct mallinfo minfo = dlmallinfo();
     // uordblks:  current total allocated space (normal or mmapped)
     info->current_allocated_heap_size = minfo.uordblks;
+#if OE_DLMALLOC_THREAD_CACHE_SIZE > 0
+    // Chunks held by the thread caches are free from the caller's view.
+    info->current_allocated_heap_size -= _get_cached_bytes();
+#endif
 
     // usmblks:   the maximum total allocated space. This will be greater
     //            than current total if trimming has occurred.
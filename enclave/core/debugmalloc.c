@@ -40,7 +40,8 @@ int32_t oe_debug_malloc_session_number = 0;
 **         (3) Assuming blocks are zero filled (fills new blocks with 0xAA).
 **         (3) Use of free memory (fills freed blocks with 0xDD).
 **
-**     This allocator keeps in-use blocks on a linked list. Each block has the
+**     This allocator keeps in-use blocks on linked lists, which are sharded by
+**     block address so that threads rarely contend for them. Each block has the
 **     following layout.
 **
 **         [padding] [header] [user-data] [footer]
@@ -207,12 +208,40 @@ typedef struct _list
     header_t* tail;
 } list_t;
 
-static list_t _list = {NULL, NULL};
-static oe_spinlock_t _spin = OE_SPINLOCK_INITIALIZER;
+/* In-use blocks are spread over shards by the address of their header, so
+ * that threads allocating and freeing at the same time rarely wait for the
+ * same lock. Each shard is on a cache line of its own. */
+#define SHARD_BITS 6
+#define NUM_SHARDS (1 << SHARD_BITS)
 
-static void _list_insert(list_t* list, header_t* header)
+typedef struct _shard
 {
-    oe_spin_lock(&_spin);
+    list_t list;
+    oe_spinlock_t lock;
+    uint8_t padding[64 - sizeof(list_t) - sizeof(oe_spinlock_t)];
+} shard_t;
+
+OE_STATIC_ASSERT(sizeof(shard_t) == 64);
+
+static OE_ALIGNED(64) shard_t _shards[NUM_SHARDS];
+
+/* Serializes the start and stop of tracking sessions */
+static oe_spinlock_t _tracking_spin = OE_SPINLOCK_INITIALIZER;
+
+OE_INLINE shard_t* _get_shard(const header_t* header)
+{
+    /* Headers are 16-byte aligned: multiply by the golden ratio to mix the
+     * remaining bits into the top ones */
+    uint64_t x = ((uint64_t)header >> 4) * 0x9e3779b97f4a7c15;
+    return &_shards[x >> (64 - SHARD_BITS)];
+}
+
+static void _list_insert(header_t* header)
+{
+    shard_t* shard = _get_shard(header);
+    list_t* list = &shard->list;
+
+    oe_spin_lock(&shard->lock);
     {
         if (list->head)
         {
@@ -229,12 +258,15 @@ static void _list_insert(list_t* list, header_t* header)
             list->tail = header;
         }
     }
-    oe_spin_unlock(&_spin);
+    oe_spin_unlock(&shard->lock);
 }
 
-static void _list_remove(list_t* list, header_t* header)
+static void _list_remove(header_t* header)
 {
-    oe_spin_lock(&_spin);
+    shard_t* shard = _get_shard(header);
+    list_t* list = &shard->list;
+
+    oe_spin_lock(&shard->lock);
     {
         if (header->next)
             header->next->prev = header->prev;
@@ -247,7 +279,22 @@ static void _list_remove(list_t* list, header_t* header)
         else if (header == list->tail)
             list->tail = header->prev;
     }
-    oe_spin_unlock(&_spin);
+    oe_spin_unlock(&shard->lock);
+}
+
+/* Lock all the shards to walk the in-use blocks. The shards are always
+ * locked in the same order, and the allocating functions never hold more
+ * than one, so this cannot deadlock with them. */
+static void _lock_shards(void)
+{
+    for (size_t i = 0; i < NUM_SHARDS; i++)
+        oe_spin_lock(&_shards[i].lock);
+}
+
+static void _unlock_shards(void)
+{
+    for (size_t i = NUM_SHARDS; i > 0; i--)
+        oe_spin_unlock(&_shards[i - 1].lock);
 }
 
 OE_INLINE bool _check_multiply_overflow(size_t x, size_t y)
@@ -285,14 +332,13 @@ done:
 static void _dump(bool need_lock)
 {
     bool secure_unserialize_enabled = false;
-    list_t* list = &_list;
 
     if (need_lock)
-        oe_spin_lock(&_spin);
+        _lock_shards();
 
     /* Temporarily disable the oe_edger8r_secure_unserialize (if set)
      * to avoid using malloc in the OCALL marshalling code
-     * that cause deadlock on _spin when debug malloc is enabled. */
+     * that cause deadlock on the shards when debug malloc is enabled. */
     if (oe_edger8r_secure_unserialize)
     {
         secure_unserialize_enabled = true;
@@ -304,17 +350,23 @@ static void _dump(bool need_lock)
         size_t bytes = 0;
 
         /* Count bytes allocated and blocks still in use */
-        for (header_t* p = list->head; p; p = p->next)
+        for (size_t i = 0; i < NUM_SHARDS; i++)
         {
-            blocks++;
-            bytes += p->size;
+            for (header_t* p = _shards[i].list.head; p; p = p->next)
+            {
+                blocks++;
+                bytes += p->size;
+            }
         }
 
         oe_host_printf(
             "=== %s(): %zu bytes in %zu blocks\n", __FUNCTION__, bytes, blocks);
 
-        for (header_t* p = list->head; p; p = p->next)
-            _malloc_dump(p->size, p->addrs, (int)p->num_addrs);
+        for (size_t i = 0; i < NUM_SHARDS; i++)
+        {
+            for (header_t* p = _shards[i].list.head; p; p = p->next)
+                _malloc_dump(p->size, p->addrs, (int)p->num_addrs);
+        }
 
         oe_host_printf("\n");
     }
@@ -324,7 +376,7 @@ static void _dump(bool need_lock)
         oe_edger8r_secure_unserialize = true;
 
     if (need_lock)
-        oe_spin_unlock(&_spin);
+        _unlock_shards();
 }
 
 /*
@@ -352,7 +404,7 @@ void* oe_debug_malloc(size_t size)
     header_t* header = (header_t*)block;
     INIT_BLOCK(header, 0, size);
     _check_block(header);
-    _list_insert(&_list, header);
+    _list_insert(header);
 
     return header->data;
 }
@@ -363,7 +415,7 @@ void oe_debug_free(void* ptr)
     {
         header_t* header = _get_header(ptr);
         _check_block(header);
-        _list_remove(&_list, header);
+        _list_remove(header);
 
         /* Fill the whole block with 0xDD (Deallocated) bytes */
         void* block = _get_block_address(ptr);
@@ -441,7 +493,7 @@ int oe_debug_posix_memalign(void** memptr, size_t alignment, size_t size)
 
     INIT_BLOCK(header, alignment, size);
     _check_block(header);
-    _list_insert(&_list, header);
+    _list_insert(header);
     *memptr = header->data;
 
     return 0;
@@ -462,7 +514,7 @@ void* oe_debug_aligned_alloc(size_t alignment, size_t size)
     header = (header_t*)((uint8_t*)block + padding_size);
     INIT_BLOCK(header, alignment, size);
     _check_block(header);
-    _list_insert(&_list, header);
+    _list_insert(header);
 
     return header->data;
 }
@@ -481,23 +533,28 @@ void oe_debug_malloc_dump(void)
 
 size_t oe_debug_malloc_check(void)
 {
-    list_t* list = &_list;
     size_t count = 0;
 
-    oe_spin_lock(&_spin);
+    _lock_shards();
     {
-        for (header_t* p = list->head; p; p = p->next)
-            count++;
+        for (size_t i = 0; i < NUM_SHARDS; i++)
+        {
+            for (header_t* p = _shards[i].list.head; p; p = p->next)
+                count++;
+        }
 
         if (count)
         {
             _dump(false);
 
-            for (header_t* p = list->head; p; p = p->next)
-                _check_block(p);
+            for (size_t i = 0; i < NUM_SHARDS; i++)
+            {
+                for (header_t* p = _shards[i].list.head; p; p = p->next)
+                    _check_block(p);
+            }
         }
     }
-    oe_spin_unlock(&_spin);
+    _unlock_shards();
 
     return count;
 }
@@ -525,6 +582,8 @@ void* oe_malloc(size_t size)
         p = oe_allocator_malloc(size);
     }
 
+    oe_heap_profile_malloc(p, size);
+
     if (!p && size)
     {
         oe_errno = OE_ENOMEM;
@@ -537,6 +596,8 @@ void* oe_malloc(size_t size)
 
 void oe_free(void* ptr)
 {
+    oe_heap_profile_free(ptr);
+
     if (oe_use_debug_malloc)
     {
         oe_debug_free(ptr);
@@ -563,6 +624,8 @@ void* oe_calloc(size_t nmemb, size_t size)
         p = oe_allocator_calloc(nmemb, size);
     }
 
+    oe_heap_profile_malloc(p, nmemb * size);
+
 done:
     if (!p && nmemb && size)
     {
@@ -577,6 +640,11 @@ done:
 void* oe_realloc(void* ptr, size_t size)
 {
     void* p = NULL;
+
+    /* Forget the old block first, as another thread may get its address as
+     * soon as it is freed */
+    oe_heap_profile_free(ptr);
+
     if (oe_use_debug_malloc)
     {
         p = oe_debug_realloc(ptr, size);
@@ -586,6 +654,8 @@ void* oe_realloc(void* ptr, size_t size)
         p = oe_allocator_realloc(ptr, size);
     }
 
+    oe_heap_profile_malloc(p, size);
+
     if (!p && size)
     {
         oe_errno = OE_ENOMEM;
@@ -629,6 +699,9 @@ int oe_posix_memalign(void** memptr, size_t alignment, size_t size)
     else
         rc = oe_allocator_posix_memalign(memptr, alignment, size);
 
+    if (rc == 0)
+        oe_heap_profile_malloc(*memptr, size);
+
     if (rc != 0 && size)
     {
         if (_failure_callback)
@@ -657,6 +730,8 @@ void* oe_aligned_alloc(size_t alignment, size_t size)
             ptr = oe_allocator_aligned_alloc(alignment, size);
         }
 
+        oe_heap_profile_malloc(ptr, size);
+
         if (!ptr && size)
         {
             if (_failure_callback)
@@ -690,14 +765,14 @@ oe_result_t oe_debug_malloc_tracking_start(void)
 {
     oe_result_t result = OE_UNEXPECTED;
 
-    oe_spin_lock(&_spin);
+    oe_spin_lock(&_tracking_spin);
     if (!oe_use_debug_malloc_tracking)
     {
         oe_use_debug_malloc_tracking = true;
         ++oe_debug_malloc_session_number;
         result = OE_OK;
     }
-    oe_spin_unlock(&_spin);
+    oe_spin_unlock(&_tracking_spin);
 
     return result;
 }
@@ -706,13 +781,13 @@ oe_result_t oe_debug_malloc_tracking_stop(void)
 {
     oe_result_t result = OE_UNEXPECTED;
 
-    oe_spin_lock(&_spin);
+    oe_spin_lock(&_tracking_spin);
     if (oe_use_debug_malloc_tracking)
     {
         oe_use_debug_malloc_tracking = false;
         result = OE_OK;
     }
-    oe_spin_unlock(&_spin);
+    oe_spin_unlock(&_tracking_spin);
 
     return result;
 }
@@ -744,12 +819,14 @@ static oe_result_t _copy_frames(
                 *size *= 2;
             }
 
-            *str = oe_realloc(*str, *size);
-            if (*str == NULL)
+            /* The shards are locked, so bypass debug malloc */
+            char* new_str = oe_allocator_realloc(*str, *size);
+            if (new_str == NULL)
             {
                 result = OE_ENOMEM;
                 goto done;
             }
+            *str = new_str;
         }
 
         oe_snprintf(
@@ -773,38 +850,44 @@ oe_result_t oe_debug_malloc_tracking_report(
     char** report)
 {
     bool secure_unserialize_enabled = false;
+    bool locked = false;
     oe_result_t result = OE_OK;
     uint64_t count = 0;
 
     size_t index = 0;
     size_t length = 4096;
-    char* report_string = oe_malloc(length);
-    if (!report_string)
+    char* report_string = NULL;
+
+    /* The report is built with all the shards locked, in a buffer that
+     * bypasses debug malloc, and copied to a tracked block at the end */
+    char* buffer = oe_allocator_malloc(length);
+    if (!buffer)
     {
         result = OE_ENOMEM;
         goto done;
     }
-    report_string[0] = '\0';
+    buffer[0] = '\0';
 
-    list_t* list = &_list;
-    oe_spin_lock(&_spin);
+    _lock_shards();
+    locked = true;
 
     /* Temporarily disable the oe_edger8r_secure_unserialize (if set)
      * to avoid using malloc in the OCALL marshalling code
-     * that cause deadlock on _spin when debug malloc is enabled. */
+     * that cause deadlock on the shards when debug malloc is enabled. */
     if (oe_edger8r_secure_unserialize)
     {
         secure_unserialize_enabled = true;
         oe_edger8r_secure_unserialize = false;
     }
 
+    for (size_t i = 0; i < NUM_SHARDS; i++)
     {
-        for (header_t* p = list->head; p; p = p->next)
+        for (header_t* p = _shards[i].list.head; p; p = p->next)
         {
             if (p->session_number)
             {
                 count++;
-                result = _copy_frames(p, &report_string, &length, &index);
+                result = _copy_frames(p, &buffer, &length, &index);
                 if (result != OE_OK)
                 {
                     goto done;
@@ -815,22 +898,33 @@ oe_result_t oe_debug_malloc_tracking_report(
 
     /* Re-enable the oe_edger8r_secure_unserialize if needed */
     if (secure_unserialize_enabled)
+    {
         oe_edger8r_secure_unserialize = true;
+        secure_unserialize_enabled = false;
+    }
 
-    oe_spin_unlock(&_spin);
+    _unlock_shards();
+    locked = false;
 
     length = index + 1;
-    report_string = oe_realloc(report_string, length);
-    if (!report_string)
+    if (!(report_string = oe_malloc(length)))
     {
         result = OE_ENOMEM;
         goto done;
     }
+    oe_memcpy_s(report_string, length, buffer, length);
 
     *out_object_count = count;
     *report = report_string;
 
 done:
-    oe_spin_unlock(&_spin);
+    if (secure_unserialize_enabled)
+        oe_edger8r_secure_unserialize = true;
+
+    if (locked)
+        _unlock_shards();
+
+    oe_allocator_free(buffer);
+
     return result;
 }
@@ -0,0 +1,503 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/advanced/allocator.h>
+#include <openenclave/advanced/heapprofile.h>
+#include <openenclave/corelibc/stdio.h>
+#include <openenclave/corelibc/string.h>
+#include <openenclave/enclave.h>
+#include <openenclave/internal/backtrace.h>
+#include <openenclave/internal/malloc.h>
+#include <openenclave/internal/raise.h>
+#include <openenclave/internal/thread.h>
+#include <openenclave/internal/types.h>
+
+/*
+**==============================================================================
+**
+** Sampling heap profiler
+**
+**     Each thread counts down the bytes it allocates, and samples the
+**     allocation that brings the count below zero. The count then restarts
+**     from a random distance, drawn from an exponential distribution whose
+**     mean is the sampling interval (as in tcmalloc), which lets pprof
+**     estimate the unsampled totals.
+**
+**     A sample records a backtrace. Samples with the same backtrace share a
+**     call site in a bounded hash table, which keeps the sampled bytes in use
+**     and the sampled bytes allocated so far. Live samples are kept in a
+**     second table, keyed by address, so that frees can be attributed. Every
+**     free checks a small table of counters first, indexed by a hash of the
+**     address, and only takes the lock if the counter is not zero.
+**
+**     The tables are allocated from the allocator directly, bypassing the
+**     profiler and debug malloc, on the first oe_heap_profile_start() call.
+**
+**==============================================================================
+*/
+
+#define MAX_DEPTH 24
+#define MAX_SITES 1024
+#define SITE_BUCKETS (2 * MAX_SITES)
+#define MAX_SAMPLES 4096
+#define SAMPLE_BUCKETS (2 * MAX_SAMPLES)
+#define FILTER_SIZE 65536
+
+#define MAX_SAMPLE_INTERVAL ((size_t)1 << 30)
+
+typedef struct _site
+{
+    uint64_t hash;
+    uint64_t depth;
+    void* addrs[MAX_DEPTH];
+    uint64_t live_count;
+    uint64_t live_bytes;
+    uint64_t alloc_count;
+    uint64_t alloc_bytes;
+} site_t;
+
+typedef struct _sample
+{
+    void* ptr;
+    uint64_t size;
+    uint32_t site;
+    uint32_t padding;
+} sample_t;
+
+typedef struct _profile
+{
+    site_t sites[MAX_SITES];
+    size_t num_sites;
+
+    /* Site index plus one, or zero for an empty bucket */
+    uint16_t site_buckets[SITE_BUCKETS];
+
+    /* Open addressing with linear probing, with a null ptr for empty */
+    sample_t samples[SAMPLE_BUCKETS];
+    size_t num_samples;
+
+    /* Number of samples that did not fit */
+    uint64_t num_dropped;
+
+    /* Number of live samples per hash of their address */
+    uint8_t filter[FILTER_SIZE];
+} profile_t;
+
+bool oe_heap_profile_enabled;
+
+static profile_t* _profile;
+static size_t _sample_interval;
+static oe_spinlock_t _lock = OE_SPINLOCK_INITIALIZER;
+
+static uint64_t _seed;
+
+/* Thread-local data is cleared when each ecall returns. The countdown then
+ * restarts from a new random distance, which the exponential distribution
+ * allows without skewing the samples. */
+static __thread bool _sampler_initialized;
+static __thread int64_t _bytes_until_sample;
+static __thread uint64_t _random_state;
+
+static uint64_t _hash_pointer(const void* ptr)
+{
+    return ((uint64_t)ptr >> 4) * 0x9e3779b97f4a7c15;
+}
+
+/* The high bits of the hash are the well-mixed ones */
+static size_t _get_bucket(const void* ptr, size_t num_buckets)
+{
+    return (size_t)((_hash_pointer(ptr) >> 32) % num_buckets);
+}
+
+static uint64_t _hash_stack(void* const* addrs, size_t depth)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for (size_t i = 0; i < depth; i++)
+        hash = (hash ^ (uint64_t)addrs[i]) * 0x100000001b3;
+
+    return hash;
+}
+
+static uint64_t _next_random(void)
+{
+    /* xorshift64* */
+    uint64_t x = _random_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    _random_state = x;
+    return x * 0x2545f4914f6cdd1d;
+}
+
+/* Return log2(x) in 16.16 fixed point, for x >= 1 */
+static uint64_t _log2_fixed(uint64_t x)
+{
+    uint64_t integer = 63 - (uint64_t)__builtin_clzll(x);
+    uint64_t fraction = 0;
+    uint64_t m = 0;
+
+    /* Mantissa in [1, 2) as 1.31 fixed point */
+    m = integer >= 31 ? x >> (integer - 31) : x << (31 - integer);
+
+    for (int i = 0; i < 16; i++)
+    {
+        m = (m * m) >> 31;
+        fraction <<= 1;
+
+        if (m >= ((uint64_t)1 << 32))
+        {
+            m >>= 1;
+            fraction |= 1;
+        }
+    }
+
+    return (integer << 16) | fraction;
+}
+
+/* Draw the number of bytes until the next sample: -ln(u) * interval, for u
+ * uniform in (0, 1], computed as (26 - log2(q)) * ln(2) * interval with q
+ * uniform in [1, 2^26] */
+static int64_t _next_sample_distance(void)
+{
+    uint64_t q = (_next_random() >> 38) + 1;
+    uint64_t distance = ((uint64_t)26 << 16) - _log2_fixed(q);
+
+    /* ln(2) is 45426 in 16.16 fixed point */
+    distance = ((distance * _sample_interval) >> 16) * 45426 >> 16;
+
+    return (int64_t)distance + 1;
+}
+
+static bool _should_sample(size_t size)
+{
+    if (!_sampler_initialized)
+    {
+        _random_state = _hash_pointer(&_random_state) ^
+                        __atomic_add_fetch(
+                            &_seed, 0x9e3779b97f4a7c15, __ATOMIC_RELAXED);
+        if (!_random_state)
+            _random_state = 1;
+
+        _bytes_until_sample = _next_sample_distance();
+        _sampler_initialized = true;
+    }
+
+    _bytes_until_sample -= (int64_t)size;
+
+    if (_bytes_until_sample > 0)
+        return false;
+
+    _bytes_until_sample = _next_sample_distance();
+    return true;
+}
+
+/* Find or add the site of the given backtrace (called with the lock held) */
+static site_t* _get_site(void* const* addrs, size_t depth, uint32_t* index)
+{
+    uint64_t hash = _hash_stack(addrs, depth);
+    size_t bucket = hash % SITE_BUCKETS;
+
+    while (_profile->site_buckets[bucket])
+    {
+        site_t* site = &_profile->sites[_profile->site_buckets[bucket] - 1];
+
+        if (site->hash == hash && site->depth == depth &&
+            memcmp(site->addrs, addrs, depth * sizeof(void*)) == 0)
+        {
+            *index = _profile->site_buckets[bucket] - 1U;
+            return site;
+        }
+
+        bucket = (bucket + 1) % SITE_BUCKETS;
+    }
+
+    if (_profile->num_sites == MAX_SITES)
+        return NULL;
+
+    *index = (uint32_t)_profile->num_sites++;
+    _profile->site_buckets[bucket] = (uint16_t)(*index + 1);
+
+    {
+        site_t* site = &_profile->sites[*index];
+
+        site->hash = hash;
+        site->depth = depth;
+        memcpy(site->addrs, addrs, depth * sizeof(void*));
+        return site;
+    }
+}
+
+void oe_heap_profile_record_malloc(void* ptr, size_t size)
+{
+    void* addrs[MAX_DEPTH];
+    int depth = 0;
+    uint8_t* filter = NULL;
+    site_t* site = NULL;
+    uint32_t index = 0;
+    size_t bucket = 0;
+
+    if (!_should_sample(size))
+        return;
+
+    /* The first frame is the allocation function that called this one */
+    depth = oe_backtrace(addrs, MAX_DEPTH);
+    if (depth < 0)
+        depth = 0;
+
+    oe_spin_lock(&_lock);
+
+    if (!oe_heap_profile_enabled)
+        goto done;
+
+    filter = &_profile->filter[_get_bucket(ptr, FILTER_SIZE)];
+
+    if (_profile->num_samples == MAX_SAMPLES || *filter == OE_UINT8_MAX ||
+        !(site = _get_site(addrs, (size_t)depth, &index)))
+    {
+        _profile->num_dropped++;
+        goto done;
+    }
+
+    bucket = _get_bucket(ptr, SAMPLE_BUCKETS);
+    while (_profile->samples[bucket].ptr)
+        bucket = (bucket + 1) % SAMPLE_BUCKETS;
+
+    _profile->samples[bucket].ptr = ptr;
+    _profile->samples[bucket].size = size;
+    _profile->samples[bucket].site = index;
+    _profile->num_samples++;
+
+    site->live_count++;
+    site->live_bytes += size;
+    site->alloc_count++;
+    site->alloc_bytes += size;
+
+    __atomic_add_fetch(filter, 1, __ATOMIC_RELEASE);
+
+done:
+    oe_spin_unlock(&_lock);
+}
+
+void oe_heap_profile_record_free(void* ptr)
+{
+    uint8_t* filter = NULL;
+    size_t bucket = 0;
+
+    /* Most frees are of blocks that were not sampled */
+    filter = &_profile->filter[_get_bucket(ptr, FILTER_SIZE)];
+    if (__atomic_load_n(filter, __ATOMIC_ACQUIRE) == 0)
+        return;
+
+    oe_spin_lock(&_lock);
+
+    bucket = _get_bucket(ptr, SAMPLE_BUCKETS);
+
+    while (_profile->samples[bucket].ptr &&
+           _profile->samples[bucket].ptr != ptr)
+        bucket = (bucket + 1) % SAMPLE_BUCKETS;
+
+    if (_profile->samples[bucket].ptr)
+    {
+        sample_t* sample = &_profile->samples[bucket];
+        site_t* site = &_profile->sites[sample->site];
+        size_t hole = bucket;
+
+        site->live_count--;
+        site->live_bytes -= sample->size;
+        _profile->num_samples--;
+        __atomic_sub_fetch(filter, 1, __ATOMIC_RELEASE);
+
+        /* Remove the sample, and move up the samples that probed past it */
+        for (;;)
+        {
+            size_t home = 0;
+
+            _profile->samples[hole].ptr = NULL;
+
+            do
+            {
+                bucket = (bucket + 1) % SAMPLE_BUCKETS;
+
+                if (!_profile->samples[bucket].ptr)
+                    goto done;
+
+                home = _get_bucket(
+                    _profile->samples[bucket].ptr, SAMPLE_BUCKETS);
+            } while (hole <= bucket ? (hole < home && home <= bucket)
+                                    : (hole < home || home <= bucket));
+
+            _profile->samples[hole] = _profile->samples[bucket];
+            hole = bucket;
+        }
+    }
+
+done:
+    oe_spin_unlock(&_lock);
+}
+
+oe_result_t oe_heap_profile_start(size_t sample_interval)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    profile_t* profile = NULL;
+
+    if (sample_interval > MAX_SAMPLE_INTERVAL)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    if (!sample_interval)
+        sample_interval = OE_HEAP_PROFILE_DEFAULT_SAMPLE_INTERVAL;
+
+    /* Allocate the tables outside of the lock, once */
+    if (!__atomic_load_n(&_profile, __ATOMIC_ACQUIRE))
+    {
+        if (!(profile = oe_allocator_malloc(sizeof(profile_t))))
+            OE_RAISE(OE_OUT_OF_MEMORY);
+    }
+
+    oe_spin_lock(&_lock);
+
+    if (oe_heap_profile_enabled)
+    {
+        oe_spin_unlock(&_lock);
+        OE_RAISE_NO_TRACE(OE_UNEXPECTED);
+    }
+
+    if (!_profile)
+    {
+        __atomic_store_n(&_profile, profile, __ATOMIC_RELEASE);
+        profile = NULL;
+    }
+
+    memset(_profile, 0, sizeof(profile_t));
+    _sample_interval = sample_interval;
+    __atomic_store_n(&oe_heap_profile_enabled, true, __ATOMIC_RELEASE);
+
+    oe_spin_unlock(&_lock);
+
+    result = OE_OK;
+
+done:
+    if (profile)
+        oe_allocator_free(profile);
+
+    return result;
+}
+
+oe_result_t oe_heap_profile_stop(void)
+{
+    oe_result_t result = OE_UNEXPECTED;
+
+    oe_spin_lock(&_lock);
+
+    if (oe_heap_profile_enabled)
+    {
+        __atomic_store_n(&oe_heap_profile_enabled, false, __ATOMIC_RELEASE);
+        result = OE_OK;
+    }
+
+    oe_spin_unlock(&_lock);
+
+    return result;
+}
+
+/* Longest line of a site: four counts and the addresses */
+#define MAX_LINE_SIZE (4 * 21 + 16 + MAX_DEPTH * 19)
+
+/* Format the profile (called with the lock held) */
+static size_t _format_profile(char* buffer, size_t size, size_t num_sites)
+{
+    uint64_t live_count = 0;
+    uint64_t live_bytes = 0;
+    uint64_t alloc_count = 0;
+    uint64_t alloc_bytes = 0;
+    size_t n = 0;
+
+    for (size_t i = 0; i < num_sites; i++)
+    {
+        live_count += _profile->sites[i].live_count;
+        live_bytes += _profile->sites[i].live_bytes;
+        alloc_count += _profile->sites[i].alloc_count;
+        alloc_bytes += _profile->sites[i].alloc_bytes;
+    }
+
+    n += (size_t)oe_snprintf(
+        buffer + n,
+        size - n,
+        "heap profile: %llu: %llu [%llu: %llu] @ heap_v2/%llu\n",
+        OE_LLU(live_count),
+        OE_LLU(live_bytes),
+        OE_LLU(alloc_count),
+        OE_LLU(alloc_bytes),
+        OE_LLU(_sample_interval));
+
+    for (size_t i = 0; i < num_sites; i++)
+    {
+        const site_t* site = &_profile->sites[i];
+
+        n += (size_t)oe_snprintf(
+            buffer + n,
+            size - n,
+            "%llu: %llu [%llu: %llu] @",
+            OE_LLU(site->live_count),
+            OE_LLU(site->live_bytes),
+            OE_LLU(site->alloc_count),
+            OE_LLU(site->alloc_bytes));
+
+        for (size_t j = 0; j < site->depth; j++)
+            n += (size_t)oe_snprintf(
+                buffer + n,
+                size - n,
+                " 0x%llx",
+                (unsigned long long)(uint64_t)site->addrs[j]);
+
+        n += (size_t)oe_snprintf(buffer + n, size - n, "\n");
+    }
+
+    return n;
+}
+
+oe_result_t oe_heap_profile_dump(const char* path)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    char* buffer = NULL;
+    size_t size = 0;
+    size_t num_sites = 0;
+    size_t length = 0;
+    bool enabled = false;
+
+    if (!path)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    oe_spin_lock(&_lock);
+    enabled = oe_heap_profile_enabled;
+    if (enabled)
+        num_sites = _profile->num_sites;
+    oe_spin_unlock(&_lock);
+
+    if (!enabled)
+        OE_RAISE_NO_TRACE(OE_UNEXPECTED);
+
+    /* Format into a buffer that bypasses the profiler, so that the profile
+     * does not change while it is written. Sites added in the meantime are
+     * left out. */
+    size = (num_sites + 1) * MAX_LINE_SIZE;
+    if (!(buffer = oe_allocator_malloc(size)))
+        OE_RAISE(OE_OUT_OF_MEMORY);
+
+    oe_spin_lock(&_lock);
+    if (num_sites > _profile->num_sites)
+        num_sites = _profile->num_sites;
+    length = _format_profile(buffer, size, num_sites);
+    oe_spin_unlock(&_lock);
+
+    /* The OCALL allocates, so the lock must not be held */
+    OE_CHECK(oe_heap_profile_write(path, buffer, length));
+
+    result = OE_OK;
+
+done:
+    if (buffer)
+        oe_allocator_free(buffer);
+
+    return result;
+}
@@ -23,6 +23,8 @@ void* oe_malloc(size_t size)
 {
     void* p = oe_allocator_malloc(size);
 
+    oe_heap_profile_malloc(p, size);
+
     if (!p && size)
     {
         oe_errno = OE_ENOMEM;
@@ -35,6 +37,7 @@ void* oe_malloc(size_t size)
 
 void oe_free(void* ptr)
 {
+    oe_heap_profile_free(ptr);
     oe_allocator_free(ptr);
 }
 
@@ -42,6 +45,8 @@ void* oe_calloc(size_t nmemb, size_t size)
 {
     void* p = oe_allocator_calloc(nmemb, size);
 
+    oe_heap_profile_malloc(p, nmemb * size);
+
     if (!p && nmemb && size)
     {
         oe_errno = OE_ENOMEM;
@@ -54,7 +59,13 @@ void* oe_calloc(size_t nmemb, size_t size)
 
 void* oe_realloc(void* ptr, size_t size)
 {
-    void* p = oe_allocator_realloc(ptr, size);
+    void* p = NULL;
+
+    /* Forget the old block first, as another thread may get its address as
+     * soon as it is freed */
+    oe_heap_profile_free(ptr);
+    p = oe_allocator_realloc(ptr, size);
+    oe_heap_profile_malloc(p, size);
 
     if (!p && size)
     {
@@ -97,6 +108,9 @@ int oe_posix_memalign(void** memptr, size_t alignment, size_t size)
 
     int rc = oe_allocator_posix_memalign(memptr, alignment, size);
 
+    if (rc == 0)
+        oe_heap_profile_malloc(*memptr, size);
+
     if (rc != 0 && size)
     {
         if (_failure_callback)
@@ -117,6 +131,7 @@ void* oe_aligned_alloc(size_t alignment, size_t size)
     else
     {
         ptr = oe_allocator_aligned_alloc(alignment, size);
+        oe_heap_profile_malloc(ptr, size);
         if (!ptr && size)
         {
             if (_failure_callback)
@@ -2,6 +2,7 @@
 // Licensed under the MIT License.
 
 #include <openenclave/enclave.h>
+#include <openenclave/internal/malloc.h>
 
 int oe_backtrace(void** buffer, int size)
 {
@@ -24,3 +25,15 @@ void oe_backtrace_symbols_free(char** ptr)
 {
     OE_UNUSED(ptr);
 }
+
+oe_result_t oe_heap_profile_write(
+    const char* path,
+    const void* profile,
+    size_t size)
+{
+    OE_UNUSED(path);
+    OE_UNUSED(profile);
+    OE_UNUSED(size);
+
+    return OE_UNSUPPORTED;
+}
@@ -9,6 +9,7 @@
 #include <openenclave/internal/raise.h>
 #include <openenclave/internal/safecrt.h>
 #include <openenclave/internal/thread.h>
+#include <openenclave/internal/threadpool.h>
 
 /*
 **==============================================================================
@@ -141,6 +142,43 @@ oe_result_t oe_mutex_destroy(oe_mutex_t* mutex)
     return OE_OK;
 }
 
+oe_result_t oe_configure_spinning(uint32_t max_spins)
+{
+    OE_UNUSED(max_spins);
+
+    /* Threads are not supported */
+    return OE_UNSUPPORTED;
+}
+
+oe_result_t oe_thread_pool_run(void (*function)(void*), void* arg)
+{
+    OE_UNUSED(function);
+    OE_UNUSED(arg);
+
+    /* Threads are not supported */
+    return OE_UNSUPPORTED;
+}
+
+oe_result_t oe_thread_pool_parallel_for(
+    size_t count,
+    void (*function)(size_t index, void* arg),
+    void* arg)
+{
+    if (!function)
+        return OE_INVALID_PARAMETER;
+
+    /* Without threads, the calling thread makes all the calls */
+    for (size_t i = 0; i < count; i++)
+        function(i, arg);
+
+    return OE_OK;
+}
+
+size_t oe_thread_pool_get_num_threads(void)
+{
+    return 0;
+}
+
 /*
 **==============================================================================
 **
@@ -0,0 +1,29 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/enclave.h>
+#include <openenclave/internal/raise.h>
+#include <openenclave/internal/time.h>
+
+oe_result_t oe_get_clock_time(int clock_id, uint64_t* nanoseconds)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    uint64_t msec;
+
+    if (!nanoseconds)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    /* Only the realtime clock of the host is available */
+    if (clock_id != CLOCK_REALTIME && clock_id != CLOCK_REALTIME_COARSE)
+        OE_RAISE_NO_TRACE(OE_UNSUPPORTED);
+
+    if ((msec = oe_get_time()) == (uint64_t)-1)
+        OE_RAISE(OE_FAILURE);
+
+    *nanoseconds = msec * 1000000;
+
+    result = OE_OK;
+
+done:
+    return result;
+}
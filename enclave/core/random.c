@@ -6,8 +6,7 @@
 
 oe_result_t oe_random(void* data, size_t size)
 {
-    /* For now just call oe_random_internal.  In the future, this should
-     * return a cryptographically random set of bytes.
-     */
+    /* On SGX, the bytes come from a per-thread ChaCha20 DRBG seeded from the
+     * CPU (see sgx/random_internal.c). */
     return oe_random_internal(data, size);
 }
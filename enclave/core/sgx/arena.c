@@ -12,17 +12,26 @@
 #include <openenclave/internal/thread.h>
 #include <openenclave/internal/utils.h>
 
-// Default shared memory arena capacity is 1 mb
+// Default limit on the capacity of a chunk is 1 mb. Chunks start smaller and
+// double in size up to this limit (larger requests get a chunk of their own).
 static size_t _capacity = 1024 * 1024;
 
 static const size_t _max_capacity = 1 << 30;
 
+// Capacity of the first chunk when there is no history to go by
+static const size_t _initial_capacity = 64 * 1024;
+
+// Arenas that hold host memory, so that the enclave destructor can return
+// the memory of every thread to the host
+static oe_shared_memory_arena_t* _registered_arenas;
+static oe_spinlock_t _registered_arenas_lock = OE_SPINLOCK_INITIALIZER;
+
 void* oe_allocate_arena(size_t capacity);
 void oe_deallocate_arena(void* buffer);
 
 static oe_shared_memory_arena_t* _get_arena()
 {
-    /* Note: arenas are zero-initialized by td_init() */
+    /* Note: arenas are zero-initialized with the thread data */
     return &oe_sgx_get_td()->arena;
 }
 
@@ -36,74 +45,154 @@ bool oe_configure_arena_capacity(size_t cap)
     return true;
 }
 
-void* oe_arena_malloc(size_t size)
+static void _register_arena(oe_shared_memory_arena_t* arena)
 {
-    oe_result_t result = OE_UNEXPECTED;
-    size_t total_size = 0;
-    const size_t align = OE_EDGER8R_BUFFER_ALIGNMENT;
-    oe_shared_memory_arena_t* arena = _get_arena();
+    if (arena->registered)
+        return;
+
+    oe_spin_lock(&_registered_arenas_lock);
+    arena->next_registered = _registered_arenas;
+    _registered_arenas = arena;
+    arena->registered = 1;
+    oe_spin_unlock(&_registered_arenas_lock);
+}
 
-    // Create the arena if it hasn't been created.
-    if (arena->buffer == NULL)
+static void _release_chunks(oe_shared_memory_arena_t* arena)
+{
+    for (uint64_t i = 0; i < arena->num_chunks; i++)
     {
-        arena->capacity = __atomic_load_n(&_capacity, __ATOMIC_SEQ_CST);
-        if (size > arena->capacity)
-        {
-            arena->capacity = oe_round_up_to_multiple(size, OE_PAGE_SIZE);
-        }
+        oe_deallocate_arena(arena->chunks[i].buffer);
+        arena->statistics.num_chunk_releases++;
+    }
 
-        void* buffer = oe_allocate_arena(arena->capacity);
-        if (buffer == NULL)
-        {
-            arena->capacity = 0;
-            return NULL;
-        }
-        arena->buffer = (uint8_t*)buffer;
-        arena->used = 0;
+    memset(arena->chunks, 0, sizeof(arena->chunks));
+    arena->num_chunks = 0;
+    arena->in_use = 0;
+    arena->statistics.capacity = 0;
+}
+
+static size_t _get_new_chunk_capacity(
+    oe_shared_memory_arena_t* arena,
+    size_t size)
+{
+    size_t limit = __atomic_load_n(&_capacity, __ATOMIC_SEQ_CST);
+    size_t capacity = 0;
+
+    if (arena->num_chunks == 0)
+    {
+        capacity = arena->preferred_capacity ? arena->preferred_capacity
+                                             : _initial_capacity;
+    }
+    else
+    {
+        capacity = arena->chunks[arena->num_chunks - 1].capacity * 2;
     }
 
-    // Round up to the nearest alignment size.
-    total_size = oe_round_up_to_multiple(size, align);
+    if (capacity > limit)
+        capacity = limit;
 
-    // check for overflow
-    if (total_size < size)
-        return NULL;
+    if (capacity < size)
+        capacity = size;
 
-    // check for capacity
-    size_t used_after;
-    OE_CHECK(oe_safe_add_sizet(arena->used, total_size, &used_after));
+    return oe_round_up_to_multiple(capacity, OE_PAGE_SIZE);
+}
+
+/* Get the chunk to serve a request of the given size, adding a chunk to the
+ * chain if needed. Reservations must be made from the newest chunk so that
+ * they are released in the reverse order; allocations can be made from any
+ * chunk. */
+static oe_shared_memory_arena_chunk_t* _get_chunk(
+    oe_shared_memory_arena_t* arena,
+    size_t size,
+    bool reserve)
+{
+    oe_shared_memory_arena_chunk_t* chunk = NULL;
+    uint64_t i = arena->num_chunks;
 
-    // Ok if the incoming malloc puts us below the capacity.
-    if (used_after <= arena->capacity)
+    while (i > 0)
     {
-        uint8_t* addr = arena->buffer + arena->used;
-        arena->used = used_after;
-        return addr;
+        chunk = &arena->chunks[--i];
+
+        if (size <= chunk->capacity - chunk->used - chunk->reserved)
+            return chunk;
+
+        if (reserve)
+            break;
     }
-    else
+
+    /* A chunk that holds no objects can be replaced by a larger one */
+    if (arena->num_chunks > 0)
     {
-        // If the arena does not contain any objects, then
-        // it is safe to resize the arena.
-        if (arena->used == 0)
-        {
-            void* buffer = arena->buffer;
-            arena->buffer = NULL;
-            oe_deallocate_arena(buffer);
-            arena->capacity = 0;
-            return oe_arena_malloc(size);
-        }
-        else
+        chunk = &arena->chunks[arena->num_chunks - 1];
+
+        if (chunk->used == 0 && chunk->reserved == 0)
         {
-            // Currently there are no scenarios where multiple objects are
-            // allocated in the arena. Hence, control will not reach here.
-            // In case, in future, the area is used for allocating multiple
-            // objects, the control can reach here. In such a case, the current
-            // behavior is preserved and the switchless call will fail.
-            // This can be handled in the future.
+            oe_deallocate_arena(chunk->buffer);
+            arena->statistics.num_chunk_releases++;
+            arena->statistics.capacity -= chunk->capacity;
+            memset(chunk, 0, sizeof(*chunk));
+            arena->num_chunks--;
         }
     }
 
-done:
+    if (arena->num_chunks == OE_SHARED_MEMORY_ARENA_MAX_CHUNKS)
+        return NULL;
+
+    chunk = &arena->chunks[arena->num_chunks];
+    chunk->capacity = _get_new_chunk_capacity(arena, size);
+    chunk->buffer = (uint8_t*)oe_allocate_arena(chunk->capacity);
+
+    if (chunk->buffer == NULL)
+    {
+        chunk->capacity = 0;
+        return NULL;
+    }
+
+    chunk->used = 0;
+    chunk->reserved = 0;
+    arena->num_chunks++;
+    arena->statistics.num_chunk_allocations++;
+    arena->statistics.capacity += chunk->capacity;
+
+    _register_arena(arena);
+
+    return chunk;
+}
+
+static void _update_high_watermark(oe_shared_memory_arena_t* arena)
+{
+    if (arena->in_use > arena->statistics.high_watermark)
+        arena->statistics.high_watermark = arena->in_use;
+
+    if (arena->in_use > arena->statistics.max_high_watermark)
+        arena->statistics.max_high_watermark = arena->in_use;
+}
+
+void* oe_arena_malloc(size_t size)
+{
+    size_t total_size = 0;
+    const size_t align = OE_EDGER8R_BUFFER_ALIGNMENT;
+    oe_shared_memory_arena_t* arena = _get_arena();
+    oe_shared_memory_arena_chunk_t* chunk = NULL;
+    uint8_t* addr = NULL;
+
+    // Round up to the nearest alignment size, and check for overflow.
+    total_size = oe_round_up_to_multiple(size, align);
+    if (total_size < size)
+        goto failed;
+
+    if (!(chunk = _get_chunk(arena, total_size, false)))
+        goto failed;
+
+    addr = chunk->buffer + chunk->used;
+    chunk->used += total_size;
+    arena->in_use += total_size;
+    _update_high_watermark(arena);
+
+    return addr;
+
+failed:
+    arena->statistics.num_failures++;
     return NULL;
 }
 
@@ -121,10 +210,106 @@ void* oe_arena_calloc(size_t num, size_t size)
     return ptr;
 }
 
+void* oe_arena_reserve(size_t size)
+{
+    size_t total_size = 0;
+    oe_shared_memory_arena_t* arena = _get_arena();
+    oe_shared_memory_arena_chunk_t* chunk = NULL;
+
+    // Round up to the nearest alignment size, and check for overflow.
+    total_size = oe_round_up_to_multiple(size, OE_EDGER8R_BUFFER_ALIGNMENT);
+    if (total_size < size)
+        goto failed;
+
+    if (!(chunk = _get_chunk(arena, total_size, true)))
+        goto failed;
+
+    chunk->reserved += total_size;
+    arena->in_use += total_size;
+    _update_high_watermark(arena);
+
+    return chunk->buffer + chunk->capacity - chunk->reserved;
+
+failed:
+    arena->statistics.num_failures++;
+    return NULL;
+}
+
+void oe_arena_unreserve(size_t size)
+{
+    oe_shared_memory_arena_t* arena = _get_arena();
+    size_t total_size =
+        oe_round_up_to_multiple(size, OE_EDGER8R_BUFFER_ALIGNMENT);
+
+    // The most recent reservation is in the newest chunk that has any.
+    for (uint64_t i = arena->num_chunks; i > 0; i--)
+    {
+        oe_shared_memory_arena_chunk_t* chunk = &arena->chunks[i - 1];
+
+        if (chunk->reserved)
+        {
+            if (total_size <= chunk->reserved)
+            {
+                chunk->reserved -= total_size;
+                arena->in_use -= total_size;
+            }
+            break;
+        }
+    }
+}
+
 void oe_arena_free_all()
 {
     oe_shared_memory_arena_t* arena = _get_arena();
-    arena->used = 0;
+
+    for (uint64_t i = 0; i < arena->num_chunks; i++)
+    {
+        arena->in_use -= arena->chunks[i].used;
+        arena->chunks[i].used = 0;
+    }
+}
+
+// Called when the outermost ECALL of the current thread returns, once all
+// the asynchronous calls are complete. The arena keeps at most one chunk,
+// sized after the high watermark of the ECALL, for the next ECALL.
+void oe_trim_arena()
+{
+    oe_shared_memory_arena_t* arena = _get_arena();
+    uint64_t high_watermark = arena->statistics.high_watermark;
+    uint64_t capacity = 0;
+
+    arena->statistics.high_watermark = 0;
+
+    for (uint64_t i = 0; i < arena->num_chunks; i++)
+    {
+        arena->chunks[i].used = 0;
+        arena->chunks[i].reserved = 0;
+    }
+    arena->in_use = 0;
+
+    if (arena->num_chunks == 0)
+        return;
+
+    // An idle thread holds no host memory.
+    if (high_watermark == 0)
+    {
+        arena->preferred_capacity = 0;
+        _release_chunks(arena);
+        return;
+    }
+
+    capacity = oe_round_up_to_multiple(high_watermark, OE_PAGE_SIZE);
+    if (capacity < _initial_capacity)
+        capacity = _initial_capacity;
+
+    // Keep a single chunk unless it is more than four times too large.
+    if (arena->num_chunks == 1 && arena->chunks[0].capacity >= capacity &&
+        arena->chunks[0].capacity / 4 <= capacity)
+        return;
+
+    // Otherwise, coalesce or shrink: the next chunk fits the high watermark.
+    arena->preferred_capacity = capacity;
+    _release_chunks(arena);
 }
 
 // Free the arena in the current thread.
@@ -132,7 +317,28 @@ void oe_teardown_arena()
 {
     oe_shared_memory_arena_t* arena = _get_arena();
 
-    if (arena->buffer != NULL)
-        oe_deallocate_arena(arena->buffer);
-    memset(arena, 0, sizeof(oe_shared_memory_arena_t));
+    _release_chunks(arena);
+    arena->preferred_capacity = 0;
+    arena->statistics.high_watermark = 0;
+}
+
+// Free the arenas of all the threads (called by the enclave destructor, when
+// no other thread is running in the enclave).
+void oe_teardown_all_arenas()
+{
+    oe_spin_lock(&_registered_arenas_lock);
+
+    for (oe_shared_memory_arena_t* arena = _registered_arenas; arena;)
+    {
+        oe_shared_memory_arena_t* next = arena->next_registered;
+
+        _release_chunks(arena);
+        arena->preferred_capacity = 0;
+        arena->next_registered = NULL;
+        arena->registered = 0;
+        arena = next;
+    }
+
+    _registered_arenas = NULL;
+    oe_spin_unlock(&_registered_arenas_lock);
 }
@@ -6,14 +6,31 @@
 
 #include <openenclave/bits/types.h>
 
+/* Set the maximum capacity of a chunk of the arena. The arena of a thread is
+ * a chain of chunks of host memory, allocated on demand. */
 bool oe_configure_arena_capacity(size_t cap);
 
 void* oe_arena_malloc(size_t size);
 
 void* oe_arena_calloc(size_t num, size_t size);
 
+/* Reserve memory at the top of the arena. Unlike the memory returned by
+ * oe_arena_malloc(), reserved memory is not freed by oe_arena_free_all().
+ * Reservations must be released in the reverse order. */
+void* oe_arena_reserve(size_t size);
+
+void oe_arena_unreserve(size_t size);
+
 void oe_arena_free_all();
 
+/* Release the memory of the arena at the end of the outermost ECALL of the
+ * thread, keeping a single chunk sized after the high watermark of the ECALL
+ * if the thread used the arena. */
+void oe_trim_arena();
+
 void oe_teardown_arena();
 
+/* Release the arenas of all threads (called by the enclave destructor) */
+void oe_teardown_all_arenas();
+
 #endif /* _OE_ARENA_H */
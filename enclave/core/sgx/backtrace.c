@@ -32,6 +32,13 @@ oe_result_t _oe_sgx_backtrace_symbols_ocall(
     size_t symbols_buffer_size,
     size_t* symbols_buffer_size_out);
 
+oe_result_t _oe_sgx_write_heap_profile_ocall(
+    oe_result_t* _retval,
+    oe_enclave_t* oe_enclave,
+    const char* path,
+    const void* profile,
+    size_t size);
+
 /**
  * Make the following OCALLs weak to support the system EDL opt-in.
  * When the user does not opt into (import) the EDL, the linker will pick
@@ -81,6 +88,27 @@ oe_result_t _oe_sgx_log_backtrace_ocall(
 }
 OE_WEAK_ALIAS(_oe_sgx_log_backtrace_ocall, oe_sgx_log_backtrace_ocall);
 
+oe_result_t _oe_sgx_write_heap_profile_ocall(
+    oe_result_t* _retval,
+    oe_enclave_t* oe_enclave,
+    const char* path,
+    const void* profile,
+    size_t size)
+{
+    OE_UNUSED(oe_enclave);
+    OE_UNUSED(path);
+    OE_UNUSED(profile);
+    OE_UNUSED(size);
+
+    if (_retval)
+        *_retval = OE_UNSUPPORTED;
+
+    return OE_UNSUPPORTED;
+}
+OE_WEAK_ALIAS(
+    _oe_sgx_write_heap_profile_ocall,
+    oe_sgx_write_heap_profile_ocall);
+
 /* Return null if address is outside of the enclave; else return ptr. */
 const void* _check_address(const void* ptr)
 {
@@ -264,3 +292,32 @@ void oe_backtrace_symbols_free(char** ptr)
     /* Backtrace must use the allocator directly to bypass debug-malloc. */
     oe_allocator_free(ptr);
 }
+
+oe_result_t oe_heap_profile_write(
+    const char* path,
+    const void* profile,
+    size_t size)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_result_t retval = OE_UNEXPECTED;
+
+    result = oe_sgx_write_heap_profile_ocall(
+        &retval, oe_get_enclave(), path, profile, size);
+
+    if (result == OE_UNSUPPORTED)
+    {
+        OE_TRACE_WARNING(
+            "Heap profiles cannot be written. To enable, please add \n\n"
+            "from \"openenclave/edl/sgx/debug.edl\" import *;\n\n"
+            "in the edl file.\n");
+        goto done;
+    }
+
+    OE_CHECK(result);
+    OE_CHECK(retval);
+
+    result = OE_OK;
+
+done:
+    return result;
+}
@@ -19,10 +19,12 @@
 #include <openenclave/internal/malloc.h>
 #include <openenclave/internal/print.h>
 #include <openenclave/internal/raise.h>
+#include <openenclave/internal/random.h>
 #include <openenclave/internal/safecrt.h>
 #include <openenclave/internal/safemath.h>
 #include <openenclave/internal/sgx/ecall_context.h>
 #include <openenclave/internal/sgx/td.h>
+#include <openenclave/internal/sgx/writebarrier.h>
 #include <openenclave/internal/thread.h>
 #include <openenclave/internal/trace.h>
 #include <openenclave/internal/types.h>
@@ -36,6 +38,7 @@
 #include "core_t.h"
 #include "cpuid.h"
 #include "handle_ecall.h"
+#include "hostpool.h"
 #include "init.h"
 #include "openenclave/bits/result.h"
 #include "openenclave/internal/backtrace.h"
@@ -187,6 +190,10 @@ static oe_result_t _handle_init_enclave(uint64_t arg_in)
             /* Initialize the CPUID table before calling global constructors. */
             OE_CHECK(oe_initialize_cpuid());
 
+            /* Select the bulk paths of the hardened host memory writes.
+             * Depends on the CPUID table. */
+            oe_initialize_write_barrier();
+
             /* Initialize the xstate settings
              * Depends on TD and sgx_create_report, so can't happen earlier */
             OE_CHECK(oe_set_is_xsave_supported());
@@ -213,6 +220,121 @@ done:
     return result;
 }
 
+/*
+**==============================================================================
+**
+** Per-thread ecall marshaling buffers
+**
+**     Each enclave thread keeps a grow-only buffer that holds the marshaled
+**     inputs and outputs of oe_handle_call_enclave_function(), avoiding a
+**     heap round-trip on every ecall. Requests larger than the configured
+**     limit, and ecalls nested within an ocall, use the heap instead.
+**
+**     Cached buffers are allocated zero-filled and td->ecall_buffer_dirty
+**     records how much of the buffer may since have been written, so that
+**     only that part of the output region needs to be cleared.
+**
+**==============================================================================
+*/
+
+/* Default limit on the size of a cached buffer is 64 kb */
+static size_t _ecall_buffer_limit = 64 * 1024;
+
+static const size_t _max_ecall_buffer_limit = 1 << 30;
+
+/* Threads that own a cached buffer (released by _enclave_destructor) */
+static oe_sgx_td_t* _ecall_buffer_owners;
+static oe_spinlock_t _ecall_buffer_lock = OE_SPINLOCK_INITIALIZER;
+
+oe_result_t oe_configure_ecall_buffer_cache(size_t max_size)
+{
+    if (max_size > _max_ecall_buffer_limit)
+        return OE_INVALID_PARAMETER;
+
+    __atomic_store_n(&_ecall_buffer_limit, max_size, __ATOMIC_SEQ_CST);
+    return OE_OK;
+}
+
+static uint8_t* _acquire_ecall_buffer(oe_sgx_td_t* td, size_t size)
+{
+    if (td->ecall_buffer_in_use ||
+        size > __atomic_load_n(&_ecall_buffer_limit, __ATOMIC_SEQ_CST))
+        return (uint8_t*)oe_malloc(size);
+
+    if (size > td->ecall_buffer_size)
+    {
+        size_t capacity = oe_round_up_to_multiple(size, OE_PAGE_SIZE);
+        uint8_t* buffer = (uint8_t*)oe_calloc(1, capacity);
+
+        if (!buffer)
+            return NULL;
+
+        oe_spin_lock(&_ecall_buffer_lock);
+        if (td->ecall_buffer)
+        {
+            oe_free(td->ecall_buffer);
+        }
+        else
+        {
+            td->ecall_buffer_next = _ecall_buffer_owners;
+            _ecall_buffer_owners = td;
+        }
+        td->ecall_buffer = buffer;
+        td->ecall_buffer_size = capacity;
+        td->ecall_buffer_dirty = 0;
+        oe_spin_unlock(&_ecall_buffer_lock);
+    }
+
+    td->ecall_buffer_in_use = 1;
+    return td->ecall_buffer;
+}
+
+static void _release_ecall_buffer(oe_sgx_td_t* td, uint8_t* buffer, size_t size)
+{
+    if (buffer && buffer == td->ecall_buffer)
+    {
+        if (size > td->ecall_buffer_dirty)
+            td->ecall_buffer_dirty = size;
+        td->ecall_buffer_in_use = 0;
+    }
+    else
+    {
+        oe_free(buffer);
+    }
+}
+
+/* Release the cached buffers so that they are not reported as leaks */
+static void _free_ecall_buffers(void)
+{
+    oe_sgx_td_t* owners = NULL;
+
+    oe_spin_lock(&_ecall_buffer_lock);
+
+    for (oe_sgx_td_t* td = _ecall_buffer_owners; td;)
+    {
+        oe_sgx_td_t* next = td->ecall_buffer_next;
+
+        if (td->ecall_buffer_in_use)
+        {
+            td->ecall_buffer_next = owners;
+            owners = td;
+        }
+        else
+        {
+            oe_free(td->ecall_buffer);
+            td->ecall_buffer = NULL;
+            td->ecall_buffer_size = 0;
+            td->ecall_buffer_dirty = 0;
+            td->ecall_buffer_next = NULL;
+        }
+
+        td = next;
+    }
+
+    _ecall_buffer_owners = owners;
+    oe_spin_unlock(&_ecall_buffer_lock);
+}
+
 /**
  * This is the preferred way to call enclave functions.
  */
@@ -226,8 +348,10 @@ oe_result_t oe_handle_call_enclave_function(uint64_t arg_in)
     uint8_t* input_buffer = NULL;
     uint8_t* output_buffer = NULL;
     size_t buffer_size = 0;
+    size_t output_clear_size = 0;
     size_t output_bytes_written = 0;
     ecall_table_t ecall_table;
+    oe_sgx_td_t* td = oe_sgx_get_td();
 
     // Ensure that args lies outside the enclave and is 8-byte aligned
     // (against the xAPIC vulnerability).
@@ -284,8 +408,8 @@ oe_result_t oe_handle_call_enclave_function(uint64_t arg_in)
     if (func == NULL)
         OE_RAISE(OE_NOT_FOUND);
 
-    // Allocate buffers in enclave memory
-    buffer = input_buffer = oe_malloc(buffer_size);
+    // Get buffers in enclave memory
+    buffer = input_buffer = _acquire_ecall_buffer(td, buffer_size);
     if (buffer == NULL)
         OE_RAISE(OE_OUT_OF_MEMORY);
 
@@ -294,9 +418,21 @@ oe_result_t oe_handle_call_enclave_function(uint64_t arg_in)
 
     // Clear out output buffer.
     // This ensures reproducible behavior if say the function is reading from
-    // output buffer.
+    // output buffer, and that no stale data from an earlier ecall is copied
+    // back to the host. A cached buffer is already zero beyond its dirty
+    // mark, so only the part of the output region below the mark is cleared.
     output_buffer = buffer + args.input_buffer_size;
-    memset(output_buffer, 0, args.output_buffer_size);
+    output_clear_size = args.output_buffer_size;
+    if (buffer == td->ecall_buffer)
+    {
+        if (td->ecall_buffer_dirty <= args.input_buffer_size)
+            output_clear_size = 0;
+        else if (
+            td->ecall_buffer_dirty - args.input_buffer_size <
+            output_clear_size)
+            output_clear_size = td->ecall_buffer_dirty - args.input_buffer_size;
+    }
+    memset(output_buffer, 0, output_clear_size);
 
     // Call the function.
     func(
@@ -390,11 +526,62 @@ done:
     }
 
     if (buffer)
-        oe_free(buffer);
+        _release_ecall_buffer(td, buffer, buffer_size);
 
     return result;
 }
 
+/**
+ * Call a batch of enclave functions submitted with a single ECALL by
+ * oe_call_enclave_function_batch(). The functions are called in order and
+ * the failure of one call does not prevent the following ones.
+ */
+oe_result_t oe_handle_call_enclave_function_batch(uint64_t arg_in)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_call_enclave_function_batch_args_t args = {0};
+    uint64_t calls_size = 0;
+
+    // Ensure that args lies outside the enclave and is 8-byte aligned
+    // (against the xAPIC vulnerability).
+    if (!oe_is_outside_enclave(
+            (void*)arg_in, sizeof(oe_call_enclave_function_batch_args_t)) ||
+        (arg_in % 8) != 0)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    // Copy args to enclave memory to avoid TOCTOU issues.
+    oe_memcpy_aligned(
+        &args, (void*)arg_in, sizeof(oe_call_enclave_function_batch_args_t));
+
+    if (args.num_calls == 0)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    OE_CHECK(oe_safe_mul_u64(
+        args.num_calls, sizeof(oe_call_enclave_function_args_t), &calls_size));
+
+    // The per-call results are written back to the array, so it must lie
+    // outside the enclave and be 8-byte aligned as well.
+    if (!oe_is_outside_enclave(args.calls, calls_size) ||
+        ((uint64_t)args.calls % 8) != 0)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    for (uint64_t i = 0; i < args.num_calls; i++)
+    {
+        oe_call_enclave_function_args_t* call = &args.calls[i];
+        oe_result_t call_result =
+            oe_handle_call_enclave_function((uint64_t)call);
+
+        // Successful calls have already reported their result.
+        if (call_result != OE_OK)
+            OE_WRITE_VALUE_WITH_BARRIER(&call->result, call_result);
+    }
+
+    result = OE_OK;
+
+done:
+    return result;
+}
+
 /*
 **==============================================================================
 **
@@ -469,6 +656,18 @@ static oe_result_t _enclave_destructor(void)
         /* Cleanup verifiers */
         oe_verifier_shutdown();
 
+        /* Release the cached ecall marshaling buffers */
+        _free_ecall_buffers();
+
+        /* Return the host memory pool to the host */
+        oe_host_pool_cleanup();
+
+        /* Return the shared memory arenas of all threads to the host */
+        oe_teardown_all_arenas();
+
+        /* Wipe the random number generators of all threads */
+        oe_random_teardown();
+
         /* If memory still allocated, print a trace and return an error */
         OE_CHECK(oe_check_memory_leaks());
 
@@ -485,6 +684,9 @@ done:
     return result;
 }
 
+/* Defined below with the asynchronous switchless calls */
+static void _drain_async_calls(oe_sgx_td_t* td);
+
 /*
 **==============================================================================
 **
@@ -565,6 +767,36 @@ static void _handle_ecall(
             arg_out = oe_handle_call_enclave_function(arg_in);
             break;
         }
+        case OE_ECALL_CALL_ENCLAVE_FUNCTION_BATCH:
+        {
+            arg_out = oe_handle_call_enclave_function_batch(arg_in);
+            break;
+        }
+        case OE_ECALL_GET_STACK_USAGE:
+        {
+            arg_out = oe_handle_get_stack_usage(arg_in);
+            break;
+        }
+        case OE_ECALL_INIT_WAKE_RING:
+        {
+            arg_out = oe_handle_init_wake_ring(arg_in);
+            break;
+        }
+        case OE_ECALL_INIT_THREAD_POOL:
+        {
+            arg_out = oe_handle_init_thread_pool(arg_in);
+            break;
+        }
+        case OE_ECALL_THREAD_POOL_WORKER:
+        {
+            arg_out = oe_handle_thread_pool_worker(arg_in);
+            break;
+        }
+        case OE_ECALL_STOP_THREAD_POOL:
+        {
+            arg_out = oe_handle_stop_thread_pool(arg_in);
+            break;
+        }
         case OE_ECALL_CALL_AT_EXIT_FUNCTIONS:
         {
             _call_at_exit_functions();
@@ -601,10 +833,11 @@ static void _handle_ecall(
 
 done:
 
-    /* Free shared memory arena before we clear TLS */
+    /* Trim shared memory arena before we clear TLS */
     if (td->depth == 1)
     {
-        oe_teardown_arena();
+        _drain_async_calls(td);
+        oe_trim_arena();
     }
 
     /* Remove ECALL context from front of oe_sgx_td_t.ecalls list */
@@ -856,105 +1089,62 @@ done:
 /*
 **==============================================================================
 **
-** oe_call_host_function_by_table_id()
+** _is_host_function_call_complete()
 **
 **==============================================================================
 */
 
-oe_result_t oe_call_host_function_internal(
-    uint64_t function_id,
-    const void* input_buffer,
-    size_t input_buffer_size,
-    void* output_buffer,
-    size_t output_buffer_size,
-    size_t* output_bytes_written,
-    bool switchless)
+static bool _is_host_function_call_complete(
+    oe_call_host_function_args_t* args_host_ptr)
 {
-    oe_result_t result = OE_UNEXPECTED;
-    oe_call_host_function_args_t args, *args_host_ptr = NULL;
-    oe_call_function_return_args_t return_args, *return_args_host_ptr = NULL;
-    uint64_t host_result = 0;
-
-    /* Ensure input buffer is outside the enclave memory and its size is valid
-     */
-    if (!oe_is_outside_enclave(input_buffer, input_buffer_size) ||
-        input_buffer_size < sizeof(oe_call_function_return_args_t))
-        OE_RAISE(OE_INVALID_PARAMETER);
+    OE_ATOMIC_MEMORY_BARRIER_ACQUIRE();
 
-    /* Ensure output buffer is outside the enclave memory and its size is
-     * valid. Also, check its address is 8-byte aligned (against the xAPIC
-     * vulnerability) */
-    if (!oe_is_outside_enclave(output_buffer, output_buffer_size) ||
-        output_buffer_size < sizeof(oe_call_function_return_args_t) ||
-        ((uint64_t)output_buffer % 8) != 0)
-        OE_RAISE(OE_INVALID_PARAMETER);
+    /* The member result is alignend given that args_host_ptr is
+     * aligned and its size is 8-byte (for xAPIC vulnerability
+     * mitigation). */
+    return __atomic_load_n(&args_host_ptr->result, __ATOMIC_SEQ_CST) !=
+           OE_UINT64_MAX;
+}
 
-    /*
-     * oe_post_switchless_ocall (below) can make a regular ocall to wake up the
-     * host worker thread, and will end up using the ecall context's args.
-     * Therefore, for switchless calls, allocate args in the arena so that it is
-     * is not overwritten by oe_post_switchless_ocall.
-     */
-    args_host_ptr =
-        (oe_call_host_function_args_t*)(switchless ? oe_arena_malloc(sizeof(*args_host_ptr)) : oe_ecall_context_get_ocall_args());
+/*
+**==============================================================================
+**
+** _wait_for_host_function_call()
+**
+** Wait until args.result is set by the host worker.
+**
+**==============================================================================
+*/
 
-    /* Ensure the args_host_ptr is valid and 8-byte aligned (for xAPIC
-     * vulnerability mitigation) */
-    if (!oe_is_outside_enclave(
-            (const void*)args_host_ptr, sizeof(oe_call_host_function_args_t)) ||
-        ((uint64_t)args_host_ptr % 8) != 0)
+static void _wait_for_host_function_call(
+    oe_call_host_function_args_t* args_host_ptr)
+{
+    while (!_is_host_function_call_complete(args_host_ptr))
     {
-        /* Fail if the enclave is crashing. */
-        OE_CHECK(__oe_enclave_status);
-        OE_RAISE(OE_UNEXPECTED);
+        /* Yield to CPU */
+        asm volatile("pause");
     }
+}
 
-    /* Prepare a local copy of args */
-    args.function_id = function_id;
-    args.input_buffer = input_buffer;
-    args.input_buffer_size = input_buffer_size;
-    args.output_buffer = output_buffer;
-    args.output_buffer_size = output_buffer_size;
-    args.result = OE_UNEXPECTED;
-
-    /* Copy the local copy of args to host memory */
-    OE_CHECK(oe_memcpy_s_with_barrier(
-        args_host_ptr, sizeof(*args_host_ptr), &args, sizeof(args)));
-
-    /* Call the host function with this address */
-    if (switchless && oe_is_switchless_initialized())
-    {
-        oe_result_t post_result = oe_post_switchless_ocall(args_host_ptr);
-
-        // Fall back to regular OCALL if host worker threads are unavailable
-        if (post_result == OE_CONTEXT_SWITCHLESS_OCALL_MISSED)
-            OE_CHECK(oe_ocall(
-                OE_OCALL_CALL_HOST_FUNCTION, (uint64_t)args_host_ptr, NULL));
-        else
-        {
-            OE_CHECK(post_result);
-            // Wait until args.result is set by the host worker.
-            while (true)
-            {
-                OE_ATOMIC_MEMORY_BARRIER_ACQUIRE();
-
-                /* The member result is alignend given that args_host_ptr is
-                 * aligned and its size is 8-byte (for xAPIC vulnerability
-                 * mitigation). */
-                if (__atomic_load_n(&args_host_ptr->result, __ATOMIC_SEQ_CST) !=
-                    OE_UINT64_MAX)
-                    break;
+/*
+**==============================================================================
+**
+** _finish_host_function_call()
+**
+** Check the result of a completed host function call, and copy deep-copied
+** outputs into enclave memory.
+**
+**==============================================================================
+*/
 
-                /* Yield to CPU */
-                asm volatile("pause");
-            }
-        }
-    }
-    else
-    {
-        OE_CHECK(oe_ocall(
-            OE_OCALL_CALL_HOST_FUNCTION, (uint64_t)args_host_ptr, NULL));
-    }
+static oe_result_t _finish_host_function_call(
+    oe_call_host_function_args_t* args_host_ptr,
+    void* output_buffer,
+    size_t* output_bytes_written)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_call_function_return_args_t return_args, *return_args_host_ptr = NULL;
+    uint64_t host_result = 0;
 
     /* Copy the result from the host memory
      * The member result is aligned given that args_host_ptr is aligned
@@ -1066,6 +1256,320 @@ done:
     return result;
 }
 
+/*
+**==============================================================================
+**
+** oe_call_host_function_by_table_id()
+**
+**==============================================================================
+*/
+
+oe_result_t oe_call_host_function_internal(
+    uint64_t function_id,
+    const void* input_buffer,
+    size_t input_buffer_size,
+    void* output_buffer,
+    size_t output_buffer_size,
+    size_t* output_bytes_written,
+    bool switchless)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_call_host_function_args_t args, *args_host_ptr = NULL;
+
+    /* Ensure input buffer is outside the enclave memory and its size is valid
+     */
+    if (!oe_is_outside_enclave(input_buffer, input_buffer_size) ||
+        input_buffer_size < sizeof(oe_call_function_return_args_t))
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    /* Ensure output buffer is outside the enclave memory and its size is
+     * valid. Also, check its address is 8-byte aligned (against the xAPIC
+     * vulnerability) */
+    if (!oe_is_outside_enclave(output_buffer, output_buffer_size) ||
+        output_buffer_size < sizeof(oe_call_function_return_args_t) ||
+        ((uint64_t)output_buffer % 8) != 0)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    /*
+     * oe_post_switchless_ocall (below) can make a regular ocall to wake up the
+     * host worker thread, and will end up using the ecall context's args.
+     * Therefore, for switchless calls, allocate args in the arena so that it is
+     * is not overwritten by oe_post_switchless_ocall.
+     */
+    args_host_ptr =
+        (oe_call_host_function_args_t*)(switchless ? oe_arena_malloc(sizeof(*args_host_ptr)) : oe_ecall_context_get_ocall_args());
+
+    /* Ensure the args_host_ptr is valid and 8-byte aligned (for xAPIC
+     * vulnerability mitigation) */
+    if (!oe_is_outside_enclave(
+            (const void*)args_host_ptr, sizeof(oe_call_host_function_args_t)) ||
+        ((uint64_t)args_host_ptr % 8) != 0)
+    {
+        /* Fail if the enclave is crashing. */
+        OE_CHECK(__oe_enclave_status);
+        OE_RAISE(OE_UNEXPECTED);
+    }
+
+    /* Prepare a local copy of args */
+    args.function_id = function_id;
+    args.input_buffer = input_buffer;
+    args.input_buffer_size = input_buffer_size;
+    args.output_buffer = output_buffer;
+    args.output_buffer_size = output_buffer_size;
+    args.result = OE_UNEXPECTED;
+
+    /* Copy the local copy of args to host memory */
+    OE_CHECK(oe_memcpy_s_with_barrier(
+        args_host_ptr, sizeof(*args_host_ptr), &args, sizeof(args)));
+
+    /* Call the host function with this address */
+    if (switchless && oe_is_switchless_initialized())
+    {
+        oe_result_t post_result = oe_post_switchless_ocall(args_host_ptr);
+
+        // Fall back to regular OCALL if host worker threads are unavailable
+        if (post_result == OE_CONTEXT_SWITCHLESS_OCALL_MISSED)
+            OE_CHECK(oe_ocall(
+                OE_OCALL_CALL_HOST_FUNCTION, (uint64_t)args_host_ptr, NULL));
+        else
+        {
+            OE_CHECK(post_result);
+            // Wait until args.result is set by the host worker.
+            _wait_for_host_function_call(args_host_ptr);
+        }
+    }
+    else
+    {
+        OE_CHECK(oe_ocall(
+            OE_OCALL_CALL_HOST_FUNCTION, (uint64_t)args_host_ptr, NULL));
+    }
+
+    result = _finish_host_function_call(
+        args_host_ptr, output_buffer, output_bytes_written);
+
+done:
+    return result;
+}
+
+/*
+**==============================================================================
+**
+** Asynchronous switchless host function calls
+**
+** The completion buffer of an asynchronous call (the call arguments, followed
+** by the input and output buffers) is reserved at the top of the arena of the
+** calling thread, where oe_arena_free_all() leaves it alone. The handles live
+** in enclave memory, on a per-thread list ordered from the newest call to the
+** oldest. Reservations are released in the same order: a call is reclaimed
+** once it is complete, it is detached (fire-and-forget, or waited on), and all
+** newer calls have been reclaimed.
+**
+**==============================================================================
+*/
+
+struct _oe_switchless_call
+{
+    /* The next older outstanding call of the thread */
+    struct _oe_switchless_call* next;
+
+    /* The completion buffer, and the output buffer within it */
+    oe_call_host_function_args_t* args_host_ptr;
+    void* output_buffer;
+    size_t output_buffer_size;
+
+    /* The size of the reservation in the arena */
+    size_t size;
+
+    /* Whether the handle is no longer owned by the caller */
+    bool detached;
+};
+
+static void _reclaim_async_calls(oe_shared_memory_arena_t* arena)
+{
+    oe_switchless_call_t* call = NULL;
+
+    while ((call = arena->async_calls) != NULL && call->detached &&
+           _is_host_function_call_complete(call->args_host_ptr))
+    {
+        arena->async_calls = call->next;
+        oe_arena_unreserve(call->size);
+        oe_free(call);
+    }
+}
+
+/* Wait for all the outstanding calls of the thread before its arena is
+ * trimmed at the end of the ECALL. */
+static void _drain_async_calls(oe_sgx_td_t* td)
+{
+    oe_switchless_call_t* call = NULL;
+
+    while ((call = td->arena.async_calls) != NULL)
+    {
+        _wait_for_host_function_call(call->args_host_ptr);
+        td->arena.async_calls = call->next;
+        oe_free(call);
+    }
+}
+
+oe_result_t oe_switchless_call_host_function_async(
+    size_t function_id,
+    const void* input_buffer,
+    size_t input_buffer_size,
+    size_t output_buffer_size,
+    oe_switchless_call_t** call)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_shared_memory_arena_t* arena = &oe_sgx_get_td()->arena;
+    oe_switchless_call_t* new_call = NULL;
+    oe_call_host_function_args_t args, *args_host_ptr = NULL;
+    uint8_t* buffer = NULL;
+    size_t size = 0;
+
+    if (call)
+        *call = NULL;
+
+    /* The host requires the buffer sizes to be pointer aligned, and the
+     * output buffer to have room for the return arguments. */
+    if ((!input_buffer && input_buffer_size) ||
+        input_buffer_size % OE_EDGER8R_BUFFER_ALIGNMENT ||
+        output_buffer_size % OE_EDGER8R_BUFFER_ALIGNMENT ||
+        output_buffer_size < sizeof(oe_call_function_return_args_t))
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    OE_CHECK(oe_safe_add_sizet(sizeof(args), input_buffer_size, &size));
+    OE_CHECK(oe_safe_add_sizet(size, output_buffer_size, &size));
+
+    _reclaim_async_calls(arena);
+
+    if (!(new_call = oe_calloc(1, sizeof(*new_call))))
+        OE_RAISE(OE_OUT_OF_MEMORY);
+
+    if (!(buffer = oe_arena_reserve(size)))
+        OE_RAISE(OE_OUT_OF_MEMORY);
+
+    args_host_ptr = (oe_call_host_function_args_t*)buffer;
+
+    new_call->args_host_ptr = args_host_ptr;
+    new_call->output_buffer = buffer + sizeof(args) + input_buffer_size;
+    new_call->output_buffer_size = output_buffer_size;
+    new_call->size = size;
+    new_call->detached = (call == NULL);
+
+    /* Copy the inputs next to the args */
+    if (input_buffer_size)
+        OE_CHECK(oe_memcpy_s_with_barrier(
+            buffer + sizeof(args),
+            input_buffer_size,
+            input_buffer,
+            input_buffer_size));
+
+    /* Prepare a local copy of args */
+    args.function_id = function_id;
+    args.input_buffer = buffer + sizeof(args);
+    args.input_buffer_size = input_buffer_size;
+    args.output_buffer = new_call->output_buffer;
+    args.output_buffer_size = output_buffer_size;
+    args.output_bytes_written = 0;
+    args.result = OE_UNEXPECTED;
+
+    /* Copy the local copy of args to host memory */
+    OE_CHECK(oe_memcpy_s_with_barrier(
+        args_host_ptr, sizeof(*args_host_ptr), &args, sizeof(args)));
+
+    new_call->next = arena->async_calls;
+    arena->async_calls = new_call;
+
+    /* Post the call, or make it right away if no host worker is available */
+    result = oe_is_switchless_initialized()
+                 ? oe_post_switchless_ocall(args_host_ptr)
+                 : OE_CONTEXT_SWITCHLESS_OCALL_MISSED;
+
+    if (result == OE_CONTEXT_SWITCHLESS_OCALL_MISSED)
+        result = oe_ocall(
+            OE_OCALL_CALL_HOST_FUNCTION, (uint64_t)args_host_ptr, NULL);
+
+    if (result != OE_OK)
+    {
+        /* The call never reached the host. Undo the reservation. */
+        arena->async_calls = new_call->next;
+        OE_RAISE(result);
+    }
+
+    if (call)
+        *call = new_call;
+
+    new_call = NULL;
+    buffer = NULL;
+    result = OE_OK;
+
+done:
+    if (buffer)
+        oe_arena_unreserve(size);
+
+    oe_free(new_call);
+
+    return result;
+}
+
+bool oe_switchless_call_is_complete(const oe_switchless_call_t* call)
+{
+    return call && !call->detached &&
+           _is_host_function_call_complete(call->args_host_ptr);
+}
+
+oe_result_t oe_switchless_call_wait(
+    oe_switchless_call_t* call,
+    void* output_buffer,
+    size_t output_buffer_size,
+    size_t* output_bytes_written)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    size_t bytes_written = 0;
+
+    if (output_bytes_written)
+        *output_bytes_written = 0;
+
+    if (!call || call->detached ||
+        (output_buffer &&
+         !oe_is_within_enclave(output_buffer, output_buffer_size)))
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    _wait_for_host_function_call(call->args_host_ptr);
+
+    /* The call can be reclaimed from now on, whatever the outcome. */
+    call->detached = true;
+
+    OE_CHECK(_finish_host_function_call(
+        call->args_host_ptr, call->output_buffer, &bytes_written));
+
+    if (bytes_written > call->output_buffer_size)
+        OE_RAISE(OE_UNEXPECTED);
+
+    if (output_buffer)
+    {
+        if (bytes_written > output_buffer_size)
+            OE_RAISE(OE_BUFFER_TOO_SMALL);
+
+        /* Copy the outputs into enclave memory. The output buffer in the
+         * arena is 8-byte aligned, and so is the number of bytes written by
+         * oeedger8r-generated code. */
+        OE_CHECK(oe_memcpy_s(
+            output_buffer,
+            output_buffer_size,
+            call->output_buffer,
+            bytes_written));
+    }
+
+    if (output_bytes_written)
+        *output_bytes_written = bytes_written;
+
+    result = OE_OK;
+
+done:
+    _reclaim_async_calls(&oe_sgx_get_td()->arena);
+    return result;
+}
+
 /*
 **==============================================================================
 **
@@ -1093,6 +1597,166 @@ oe_result_t oe_call_host_function(
         false /* non-switchless */);
 }
 
+/*
+**==============================================================================
+**
+** oe_call_host_function_batch()
+**
+** The batch is laid out in a single buffer outside the enclave: the batch
+** args, the args of each call, then the input and output buffers of each
+** call in turn.
+**
+**==============================================================================
+*/
+
+oe_result_t oe_call_host_function_batch(
+    oe_host_function_call_t* calls,
+    size_t num_calls,
+    uint32_t flags)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_call_host_function_batch_args_t batch_args, *batch_host_ptr = NULL;
+    oe_call_host_function_args_t args, *args_host_ptr = NULL;
+    uint8_t* buffer = NULL;
+    uint8_t* data = NULL;
+    size_t size = 0;
+    uint64_t num_calls_completed = 0;
+
+    if (!calls || num_calls == 0 ||
+        (flags & ~(uint32_t)OE_HOST_FUNCTION_BATCH_STOP_ON_FAILURE))
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    OE_CHECK(oe_safe_mul_sizet(num_calls, sizeof(*calls), &size));
+    if (!oe_is_within_enclave(calls, size))
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    OE_CHECK(oe_safe_mul_sizet(num_calls, sizeof(args), &size));
+    OE_CHECK(oe_safe_add_sizet(size, sizeof(batch_args), &size));
+
+    for (size_t i = 0; i < num_calls; i++)
+    {
+        oe_host_function_call_t* call = &calls[i];
+
+        call->output_bytes_written = 0;
+        call->result = OE_UNEXPECTED;
+
+        /* The host requires the buffer sizes to be pointer aligned, and the
+         * output buffer to have room for the return arguments. */
+        if (!call->input_buffer ||
+            call->input_buffer_size < sizeof(oe_call_function_return_args_t) ||
+            call->input_buffer_size % OE_EDGER8R_BUFFER_ALIGNMENT ||
+            call->output_buffer_size % OE_EDGER8R_BUFFER_ALIGNMENT ||
+            call->output_buffer_size < sizeof(oe_call_function_return_args_t))
+            OE_RAISE(OE_INVALID_PARAMETER);
+
+        if (!oe_is_within_enclave(
+                call->output_buffer, call->output_buffer_size))
+            OE_RAISE(OE_INVALID_PARAMETER);
+
+        OE_CHECK(oe_safe_add_sizet(size, call->input_buffer_size, &size));
+        OE_CHECK(oe_safe_add_sizet(size, call->output_buffer_size, &size));
+    }
+
+    if (!(buffer = (uint8_t*)oe_allocate_ocall_buffer(size)))
+        OE_RAISE(OE_OUT_OF_MEMORY);
+
+    /* Ensure the buffer is valid and 8-byte aligned (for xAPIC
+     * vulnerability mitigation) */
+    if (!oe_is_outside_enclave(buffer, size) || ((uint64_t)buffer % 8) != 0)
+        OE_RAISE(OE_UNEXPECTED);
+
+    batch_host_ptr = (oe_call_host_function_batch_args_t*)buffer;
+    args_host_ptr = (oe_call_host_function_args_t*)(batch_host_ptr + 1);
+    data = (uint8_t*)(args_host_ptr + num_calls);
+
+    for (size_t i = 0; i < num_calls; i++)
+    {
+        oe_host_function_call_t* call = &calls[i];
+
+        /* Copy the inputs to host memory */
+        OE_CHECK(oe_memcpy_s_with_barrier(
+            data,
+            call->input_buffer_size,
+            call->input_buffer,
+            call->input_buffer_size));
+
+        /* Prepare a local copy of args */
+        args.function_id = call->function_id;
+        args.input_buffer = data;
+        args.input_buffer_size = call->input_buffer_size;
+        args.output_buffer = data + call->input_buffer_size;
+        args.output_buffer_size = call->output_buffer_size;
+        args.output_bytes_written = 0;
+        args.result = OE_UNEXPECTED;
+
+        /* Copy the local copy of args to host memory */
+        OE_CHECK(oe_memcpy_s_with_barrier(
+            &args_host_ptr[i], sizeof(args), &args, sizeof(args)));
+
+        data += call->input_buffer_size + call->output_buffer_size;
+    }
+
+    batch_args.calls = args_host_ptr;
+    batch_args.num_calls = num_calls;
+    batch_args.flags = flags;
+    batch_args.num_calls_completed = 0;
+
+    OE_CHECK(oe_memcpy_s_with_barrier(
+        batch_host_ptr, sizeof(batch_args), &batch_args, sizeof(batch_args)));
+
+    OE_CHECK(oe_ocall(
+        OE_OCALL_CALL_HOST_FUNCTION_BATCH, (uint64_t)batch_host_ptr, NULL));
+
+    /* The member num_calls_completed is aligned given that batch_host_ptr is
+     * aligned (for xAPIC vulnerability mitigation) */
+    num_calls_completed = batch_host_ptr->num_calls_completed;
+    if (num_calls_completed > num_calls)
+        OE_RAISE(OE_UNEXPECTED);
+
+    data = (uint8_t*)(args_host_ptr + num_calls);
+
+    for (size_t i = 0; i < num_calls_completed; i++)
+    {
+        oe_host_function_call_t* call = &calls[i];
+        uint8_t* output_buffer = data + call->input_buffer_size;
+        size_t bytes_written = 0;
+
+        data += call->input_buffer_size + call->output_buffer_size;
+
+        call->result = _finish_host_function_call(
+            &args_host_ptr[i], output_buffer, &bytes_written);
+
+        if (call->result != OE_OK)
+            continue;
+
+        if (bytes_written > call->output_buffer_size)
+        {
+            call->result = OE_UNEXPECTED;
+            continue;
+        }
+
+        /* Copy the outputs into enclave memory. The output buffer is 8-byte
+         * aligned, and so is the number of bytes written by
+         * oeedger8r-generated code. */
+        call->result = oe_memcpy_s(
+            call->output_buffer,
+            call->output_buffer_size,
+            output_buffer,
+            bytes_written);
+
+        if (call->result == OE_OK)
+            call->output_bytes_written = bytes_written;
+    }
+
+    result = OE_OK;
+
+done:
+    if (buffer)
+        oe_free_ocall_buffer(buffer);
+
+    return result;
+}
+
 /*
 **==============================================================================
 **
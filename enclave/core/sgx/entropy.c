@@ -7,6 +7,7 @@
 #include <openenclave/internal/raise.h>
 #include <openenclave/internal/rdrand.h>
 #include <openenclave/internal/rdseed.h>
+#include <openenclave/internal/thread.h>
 #include "cpuid.h"
 
 typedef uint64_t (*_entropy_function_t)(void);
@@ -45,6 +46,16 @@ static oe_entropy_kind_t _get_entropy_kind()
     return result;
 }
 
+/* The entropy kind needs two emulated CPUID instructions, so it is only
+ * determined once */
+static oe_once_t _entropy_kind_once = OE_ONCE_INIT;
+static oe_entropy_kind_t _entropy_kind;
+
+static void _initialize_entropy_kind(void)
+{
+    _entropy_kind = _get_entropy_kind();
+}
+
 oe_result_t oe_get_entropy(void* output, size_t len, oe_entropy_kind_t* kind)
 {
     oe_result_t result = OE_UNEXPECTED;
@@ -61,7 +72,8 @@ oe_result_t oe_get_entropy(void* output, size_t len, oe_entropy_kind_t* kind)
     if (!output || !kind)
         OE_RAISE(OE_INVALID_PARAMETER);
 
-    *kind = _get_entropy_kind();
+    oe_once(&_entropy_kind_once, _initialize_entropy_kind);
+    *kind = _entropy_kind;
     if (*kind == OE_ENTROPY_KIND_RDSEED)
         get_entropy = oe_rdseed;
     else if (*kind == OE_ENTROPY_KIND_RDRAND)
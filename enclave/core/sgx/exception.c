@@ -12,6 +12,7 @@
 #include "cpuid.h"
 #include "init.h"
 #include "platform_t.h"
+#include "rdtsc.h"
 #include "td.h"
 
 #define MAX_EXCEPTION_HANDLER_COUNT 64
@@ -23,6 +24,7 @@
 
 #define WRFSBASE64_OPCODE_1 0xAE0F48F3
 #define WRFSBASE64_OPCODE_2 0xAE0F49F3 // with REX.B bit set
+#define RDTSC_OPCODE 0x310F
 #define WRFSBASE64_MODRM_MASK 0xD0
 
 // The spin lock to synchronize the exception handler access.
@@ -267,6 +269,21 @@ static int _emulate_cpuid(sgx_ssa_gpr_t* ssa_gpr)
     return 0;
 }
 
+/* RDTSC is illegal in SGX1 enclaves. Only the RDTSC of oe_rdtsc() is
+ * emulated, as a TSC of 0, which tells the callers to use an OCALL instead.
+ * Any other RDTSC is left to the exception handlers of the enclave. */
+static int _emulate_rdtsc(sgx_ssa_gpr_t* ssa_gpr)
+{
+    if (ssa_gpr->rip != (uint64_t)oe_rdtsc)
+        return -1;
+
+    ssa_gpr->rax = 0;
+    ssa_gpr->rdx = 0;
+    ssa_gpr->rip += 2;
+
+    return 0;
+}
+
 /*
 **==============================================================================
 **
@@ -292,6 +309,12 @@ int _emulate_illegal_instruction(sgx_ssa_gpr_t* ssa_gpr)
         return _emulate_wrfsbase64(ssa_gpr);
     }
 
+    // emulate the RDTSC of oe_rdtsc()
+    if (*((uint16_t*)ssa_gpr->rip) == RDTSC_OPCODE)
+    {
+        return _emulate_rdtsc(ssa_gpr);
+    }
+
     return -1;
 }
 
@@ -9,4 +9,16 @@
 
 oe_result_t oe_handle_call_enclave_function(uint64_t arg);
 
+oe_result_t oe_handle_call_enclave_function_batch(uint64_t arg);
+
+oe_result_t oe_handle_get_stack_usage(uint64_t arg);
+
+oe_result_t oe_handle_init_wake_ring(uint64_t arg);
+
+oe_result_t oe_handle_init_thread_pool(uint64_t arg);
+
+oe_result_t oe_handle_thread_pool_worker(uint64_t arg);
+
+oe_result_t oe_handle_stop_thread_pool(uint64_t arg);
+
 #endif // _HANDLE_ECALL_H
@@ -7,6 +7,7 @@
 #include <openenclave/internal/safemath.h>
 #include <openenclave/internal/sgx/ecall_context.h>
 #include <openenclave/internal/sgx/td.h>
+#include "hostpool.h"
 #include "td.h"
 
 /**
@@ -108,8 +109,9 @@ void* oe_allocate_ocall_buffer(size_t size)
         return buffer;
     }
 
-    // Perform host allocation by making an ocall.
-    return oe_host_malloc(size);
+    // Allocate from the host memory pool, which only makes an ocall when it
+    // has to grow.
+    return oe_host_pool_malloc(size);
 }
 
 // Function used by oeedger8r for freeing ocall buffers.
@@ -130,7 +132,7 @@ void oe_free_ocall_buffer(void* buffer)
     // execution.
     oe_lfence();
 
-    oe_host_free(buffer);
+    oe_host_pool_free(buffer);
 }
 
 void* oe_allocate_arena(size_t capacity)
@@ -0,0 +1,337 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include "hostpool.h"
+#include <openenclave/corelibc/stdlib.h>
+#include <openenclave/corelibc/string.h>
+#include <openenclave/enclave.h>
+#include <openenclave/internal/thread.h>
+
+/*
+**==============================================================================
+**
+** Host memory pool
+**
+**     Serves host memory to the enclave without an OCALL per allocation.
+**     The pool obtains regions of host memory with oe_host_malloc(), divides
+**     each region into slabs, and each slab into blocks of one size class.
+**     All the bookkeeping lives in enclave memory, so the host can read and
+**     write the blocks but cannot influence which blocks the pool hands out
+**     or accepts back.
+**
+**     Regions are aligned on REGION_SIZE, so the region of a block is found
+**     by hashing its aligned address, without walking the regions.
+**
+**==============================================================================
+*/
+
+/* Blocks range from 64 bytes to 64 KB in power-of-two size classes */
+#define MIN_BLOCK_SHIFT 6
+#define MAX_BLOCK_SHIFT 16
+#define NUM_CLASSES (MAX_BLOCK_SHIFT - MIN_BLOCK_SHIFT + 1)
+
+#define SLAB_SIZE (256 * 1024)
+#define SLABS_PER_REGION 8
+#define REGION_SIZE (SLABS_PER_REGION * SLAB_SIZE)
+
+#define MAX_BLOCKS_PER_SLAB (SLAB_SIZE >> MIN_BLOCK_SHIFT)
+#define BITMAP_WORDS (MAX_BLOCKS_PER_SLAB / 64)
+
+#define UNASSIGNED_CLASS ((uint32_t)-1)
+
+#define NUM_BUCKETS 64
+
+typedef struct _slab
+{
+    /* Links of the partial list of the class, or of the free slab list */
+    struct _slab* prev;
+    struct _slab* next;
+
+    uint8_t* base;
+    uint32_t class_index;
+    uint32_t num_blocks;
+    uint32_t num_free;
+    uint32_t padding;
+
+    /* A bit is set for each allocated block */
+    uint64_t used[BITMAP_WORDS];
+} slab_t;
+
+typedef struct _region
+{
+    /* Next region of the same bucket */
+    struct _region* next;
+
+    /* What oe_host_malloc() returned, and the aligned region within it */
+    void* allocation;
+    uint8_t* base;
+
+    slab_t slabs[SLABS_PER_REGION];
+} region_t;
+
+static region_t* _buckets[NUM_BUCKETS];
+static slab_t* _free_slabs;
+static slab_t* _partial_slabs[NUM_CLASSES];
+static oe_spinlock_t _lock = OE_SPINLOCK_INITIALIZER;
+
+/* Serializes the growth of the pool, whose OCALL is made without _lock */
+static oe_mutex_t _grow_lock = OE_MUTEX_INITIALIZER;
+
+static size_t _get_bucket(const uint8_t* base)
+{
+    return ((uintptr_t)base / REGION_SIZE) % NUM_BUCKETS;
+}
+
+/* Find the region that contains the given address (called with the lock
+ * held) */
+static region_t* _find_region(const void* ptr)
+{
+    const uint8_t* base =
+        (const uint8_t*)((uintptr_t)ptr & ~((uintptr_t)REGION_SIZE - 1));
+    region_t* region = _buckets[_get_bucket(base)];
+
+    while (region && region->base != base)
+        region = region->next;
+
+    return region;
+}
+
+static uint32_t _get_class_index(size_t size)
+{
+    uint32_t shift = MIN_BLOCK_SHIFT;
+
+    while (((size_t)1 << shift) < size)
+        shift++;
+
+    return shift - MIN_BLOCK_SHIFT;
+}
+
+static void _push_slab(slab_t** list, slab_t* slab)
+{
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list)
+        (*list)->prev = slab;
+    *list = slab;
+}
+
+static void _remove_slab(slab_t** list, slab_t* slab)
+{
+    if (slab->prev)
+        slab->prev->next = slab->next;
+    else
+        *list = slab->next;
+
+    if (slab->next)
+        slab->next->prev = slab->prev;
+
+    slab->prev = NULL;
+    slab->next = NULL;
+}
+
+/* Assign a free slab to the given class (called with the lock held) */
+static slab_t* _assign_slab(uint32_t class_index)
+{
+    slab_t* slab = _free_slabs;
+
+    if (!slab)
+        return NULL;
+
+    _remove_slab(&_free_slabs, slab);
+
+    slab->class_index = class_index;
+    slab->num_blocks = SLAB_SIZE >> (class_index + MIN_BLOCK_SHIFT);
+    slab->num_free = slab->num_blocks;
+    memset(slab->used, 0, sizeof(slab->used));
+
+    _push_slab(&_partial_slabs[class_index], slab);
+    return slab;
+}
+
+/* Get a new region from the host, with a single OCALL, unless a slab of the
+ * given class became available while waiting for another thread to grow the
+ * pool. Returns false if the pool cannot grow. */
+static bool _grow(uint32_t class_index)
+{
+    region_t* region = NULL;
+    uint8_t* allocation = NULL;
+    bool available = false;
+    bool grown = false;
+
+    oe_mutex_lock(&_grow_lock);
+
+    oe_spin_lock(&_lock);
+    available = _free_slabs || _partial_slabs[class_index];
+    oe_spin_unlock(&_lock);
+
+    if (available)
+    {
+        grown = true;
+        goto done;
+    }
+
+    if (!(region = (region_t*)oe_calloc(1, sizeof(region_t))))
+        goto done;
+
+    /* oe_host_malloc() ensures that the region lies outside the enclave. The
+     * host cannot align it, so twice the size is reserved, and the pages
+     * outside the aligned region are never touched. */
+    if (!(allocation = (uint8_t*)oe_host_malloc(2 * REGION_SIZE)))
+    {
+        oe_free(region);
+        goto done;
+    }
+
+    region->allocation = allocation;
+    region->base = (uint8_t*)(((uintptr_t)allocation + REGION_SIZE - 1) &
+                              ~((uintptr_t)REGION_SIZE - 1));
+
+    oe_spin_lock(&_lock);
+
+    for (size_t i = 0; i < SLABS_PER_REGION; i++)
+    {
+        slab_t* slab = &region->slabs[i];
+
+        slab->base = region->base + i * SLAB_SIZE;
+        slab->class_index = UNASSIGNED_CLASS;
+        _push_slab(&_free_slabs, slab);
+    }
+
+    region->next = _buckets[_get_bucket(region->base)];
+    _buckets[_get_bucket(region->base)] = region;
+
+    oe_spin_unlock(&_lock);
+
+    grown = true;
+
+done:
+    oe_mutex_unlock(&_grow_lock);
+    return grown;
+}
+
+void* oe_host_pool_malloc(size_t size)
+{
+    uint32_t class_index = 0;
+    void* ptr = NULL;
+
+    if (size == 0 || size > ((size_t)1 << MAX_BLOCK_SHIFT))
+        return oe_host_malloc(size);
+
+    class_index = _get_class_index(size);
+
+    for (;;)
+    {
+        oe_spin_lock(&_lock);
+
+        slab_t* slab = _partial_slabs[class_index];
+        if (!slab)
+            slab = _assign_slab(class_index);
+
+        if (slab)
+        {
+            uint32_t shift = class_index + MIN_BLOCK_SHIFT;
+
+            for (uint32_t i = 0; i < BITMAP_WORDS; i++)
+            {
+                if (slab->used[i] != OE_UINT64_MAX)
+                {
+                    uint32_t bit = (uint32_t)__builtin_ctzll(~slab->used[i]);
+                    uint32_t block = i * 64 + bit;
+
+                    slab->used[i] |= (uint64_t)1 << bit;
+                    ptr = slab->base + ((size_t)block << shift);
+                    break;
+                }
+            }
+
+            if (--slab->num_free == 0)
+                _remove_slab(&_partial_slabs[class_index], slab);
+        }
+
+        oe_spin_unlock(&_lock);
+
+        if (slab)
+            return ptr;
+
+        /* Pool exhausted. Fall back to the host heap if it cannot grow. */
+        if (!_grow(class_index))
+            return oe_host_malloc(size);
+    }
+}
+
+void oe_host_pool_free(void* ptr)
+{
+    uint8_t* p = (uint8_t*)ptr;
+    region_t* region = NULL;
+
+    if (!ptr)
+        return;
+
+    oe_spin_lock(&_lock);
+
+    if (!(region = _find_region(p)))
+    {
+        /* Memory from the oe_host_malloc() fallback */
+        oe_spin_unlock(&_lock);
+        oe_host_free(ptr);
+        return;
+    }
+
+    {
+        slab_t* slab = &region->slabs[(size_t)(p - region->base) / SLAB_SIZE];
+        size_t offset = (size_t)(p - slab->base);
+        uint32_t shift = 0;
+        uint32_t block = 0;
+        uint64_t mask = 0;
+
+        /* Reject pointers that were not handed out by the pool */
+        if (slab->class_index == UNASSIGNED_CLASS)
+            oe_abort();
+
+        shift = slab->class_index + MIN_BLOCK_SHIFT;
+        block = (uint32_t)(offset >> shift);
+        mask = (uint64_t)1 << (block % 64);
+
+        if ((offset & (((size_t)1 << shift) - 1)) != 0 ||
+            !(slab->used[block / 64] & mask))
+            oe_abort();
+
+        slab->used[block / 64] &= ~mask;
+
+        if (++slab->num_free == 1)
+            _push_slab(&_partial_slabs[slab->class_index], slab);
+
+        /* Return empty slabs to the free list, for use by any class */
+        if (slab->num_free == slab->num_blocks)
+        {
+            _remove_slab(&_partial_slabs[slab->class_index], slab);
+            slab->class_index = UNASSIGNED_CLASS;
+            _push_slab(&_free_slabs, slab);
+        }
+    }
+
+    oe_spin_unlock(&_lock);
+}
+
+void oe_host_pool_cleanup(void)
+{
+    region_t* buckets[NUM_BUCKETS];
+
+    oe_spin_lock(&_lock);
+    memcpy(buckets, _buckets, sizeof(buckets));
+    memset(_buckets, 0, sizeof(_buckets));
+    _free_slabs = NULL;
+    memset(_partial_slabs, 0, sizeof(_partial_slabs));
+    oe_spin_unlock(&_lock);
+
+    for (size_t i = 0; i < NUM_BUCKETS; i++)
+    {
+        while (buckets[i])
+        {
+            region_t* next = buckets[i]->next;
+            oe_host_free(buckets[i]->allocation);
+            oe_free(buckets[i]);
+            buckets[i] = next;
+        }
+    }
+}
@@ -0,0 +1,20 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#ifndef _OE_HOSTPOOL_H
+#define _OE_HOSTPOOL_H
+
+#include <openenclave/bits/types.h>
+
+/* Allocate host memory, from the pool if the size fits a size class, and
+ * with oe_host_malloc() otherwise. The memory must only be released with
+ * oe_host_pool_free(), and never by the host. */
+void* oe_host_pool_malloc(size_t size);
+
+/* Release memory returned by oe_host_pool_malloc() */
+void oe_host_pool_free(void* ptr);
+
+/* Return the pool regions to the host (called by the enclave destructor) */
+void oe_host_pool_cleanup(void);
+
+#endif /* _OE_HOSTPOOL_H */
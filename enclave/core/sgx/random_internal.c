@@ -3,23 +3,225 @@
 
 #include <openenclave/corelibc/string.h>
 #include <openenclave/enclave.h>
-#include <openenclave/internal/rdrand.h>
+#include <openenclave/internal/entropy.h>
+#include <openenclave/internal/raise.h>
+#include <openenclave/internal/random.h>
+#include <openenclave/internal/sgx/td.h>
+#include <openenclave/internal/thread.h>
+#include <openenclave/internal/utils.h>
 
-// The RDRAND generates 8-byte random value.
-#define RDRAND_BYTES 8
+/*
+**==============================================================================
+**
+** Per-thread ChaCha20 DRBG.
+**
+**     Each thread generates random bytes from its own ChaCha20 keystream,
+**     so that only seeding touches the hardware entropy source. The first
+**     bytes of every refill become the next key and the bytes handed out
+**     are erased from the buffer, so a later compromise of the state does
+**     not reveal earlier output. The key is reseeded from oe_get_entropy()
+**     (RDSEED where available) every RESEED_INTERVAL bytes.
+**
+**     The state lives in the oe_sgx_td_t of the thread, so no lock is taken,
+**     no two threads ever share a keystream, and the state survives the end
+**     of the ECALLs, unlike thread-local storage. It is thus seeded once per
+**     TCS rather than once per ECALL. The enclave destructor wipes it.
+**
+**==============================================================================
+*/
+
+#define CHACHA20_KEY_SIZE 32
+#define CHACHA20_BLOCK_SIZE 64
+
+/* Number of ChaCha20 blocks generated by each refill of the buffer */
+#define DRBG_BUFFER_SIZE OE_RANDOM_STATE_BUFFER_SIZE
+#define DRBG_BLOCKS (DRBG_BUFFER_SIZE / CHACHA20_BLOCK_SIZE)
+
+/* Number of bytes generated between reseeds from the entropy source */
+#define RESEED_INTERVAL (1024 * 1024)
+
+typedef oe_random_state_t drbg_t;
+
+OE_STATIC_ASSERT(sizeof(((drbg_t*)0)->key) == CHACHA20_KEY_SIZE);
+
+/* The seeded states, which the enclave destructor wipes */
+static drbg_t* _seeded;
+static oe_spinlock_t _seeded_lock = OE_SPINLOCK_INITIALIZER;
+
+#define ROTL32(X, N) (((X) << (N)) | ((X) >> (32 - (N))))
+
+#define QUARTER_ROUND(A, B, C, D) \
+    do                            \
+    {                             \
+        A += B;                   \
+        D = ROTL32(D ^ A, 16);    \
+        C += D;                   \
+        B = ROTL32(B ^ C, 12);    \
+        A += B;                   \
+        D = ROTL32(D ^ A, 8);     \
+        C += D;                   \
+        B = ROTL32(B ^ C, 7);     \
+    } while (0)
+
+static void _chacha20_block(
+    const uint32_t key[8],
+    uint32_t counter,
+    uint8_t output[CHACHA20_BLOCK_SIZE])
+{
+    /* "expand 32-byte k", followed by the key, the counter and a zero nonce
+     * (the key never encrypts more than one buffer) */
+    const uint32_t input[16] = {0x61707865,
+                                0x3320646e,
+                                0x79622d32,
+                                0x6b206574,
+                                key[0],
+                                key[1],
+                                key[2],
+                                key[3],
+                                key[4],
+                                key[5],
+                                key[6],
+                                key[7],
+                                counter,
+                                0,
+                                0,
+                                0};
+    uint32_t x[16];
+
+    memcpy(x, input, sizeof(x));
+
+    for (size_t i = 0; i < 10; i++)
+    {
+        QUARTER_ROUND(x[0], x[4], x[8], x[12]);
+        QUARTER_ROUND(x[1], x[5], x[9], x[13]);
+        QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+        QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+        QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+        QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+        QUARTER_ROUND(x[2], x[7], x[8], x[13]);
+        QUARTER_ROUND(x[3], x[4], x[9], x[14]);
+    }
+
+    /* x86 is little-endian, as ChaCha20 serializes the words */
+    for (size_t i = 0; i < 16; i++)
+        x[i] += input[i];
+
+    memcpy(output, x, CHACHA20_BLOCK_SIZE);
+    oe_secure_zero_fill(x, sizeof(x));
+}
+
+static oe_result_t _reseed(drbg_t* drbg)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    uint32_t seed[CHACHA20_KEY_SIZE / sizeof(uint32_t)];
+    oe_entropy_kind_t kind;
+
+    OE_CHECK(oe_get_entropy(seed, sizeof(seed), &kind));
+
+    /* Mix the seed into the current key rather than replacing it, so that
+     * a weak seed cannot make the state weaker */
+    for (size_t i = 0; i < OE_COUNTOF(seed); i++)
+        drbg->key[i] ^= seed[i];
+
+    drbg->generated = 0;
+    drbg->num_reseeds++;
+
+    if (!drbg->seeded)
+    {
+        oe_spin_lock(&_seeded_lock);
+        drbg->next_seeded = _seeded;
+        _seeded = drbg;
+        drbg->seeded = 1;
+        oe_spin_unlock(&_seeded_lock);
+    }
+
+    result = OE_OK;
+
+done:
+    oe_secure_zero_fill(seed, sizeof(seed));
+    return result;
+}
+
+static oe_result_t _refill(drbg_t* drbg)
+{
+    oe_result_t result = OE_UNEXPECTED;
+
+    if (!drbg->seeded || drbg->generated >= RESEED_INTERVAL)
+        OE_CHECK(_reseed(drbg));
+
+    for (uint32_t i = 0; i < DRBG_BLOCKS; i++)
+        _chacha20_block(drbg->key, i, drbg->buffer + i * CHACHA20_BLOCK_SIZE);
+
+    /* Replace the key with the start of the keystream and erase it */
+    memcpy(drbg->key, drbg->buffer, CHACHA20_KEY_SIZE);
+    oe_secure_zero_fill(drbg->buffer, CHACHA20_KEY_SIZE);
+    drbg->offset = CHACHA20_KEY_SIZE;
+    drbg->generated += DRBG_BUFFER_SIZE;
+
+    result = OE_OK;
+
+done:
+    return result;
+}
 
 oe_result_t oe_random_internal(void* data, size_t size)
 {
-    for (size_t i = 0; i < size; i += RDRAND_BYTES)
+    oe_result_t result = OE_UNEXPECTED;
+    oe_sgx_td_t* td = oe_sgx_get_td();
+    drbg_t* drbg = NULL;
+    uint8_t* p = (uint8_t*)data;
+
+    if (!data && size)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    if (!td)
+        OE_RAISE(OE_UNEXPECTED);
+
+    drbg = &td->random_state;
+
+    while (size > 0)
+    {
+        size_t n;
+
+        if (drbg->offset == DRBG_BUFFER_SIZE || !drbg->seeded)
+            OE_CHECK(_refill(drbg));
+
+        n = DRBG_BUFFER_SIZE - drbg->offset;
+        if (n > size)
+            n = size;
+
+        memcpy(p, drbg->buffer + drbg->offset, n);
+        oe_secure_zero_fill(drbg->buffer + drbg->offset, n);
+        drbg->offset += n;
+        p += n;
+        size -= n;
+    }
+
+    result = OE_OK;
+
+done:
+    return result;
+}
+
+uint64_t oe_random_get_num_reseeds(void)
+{
+    oe_sgx_td_t* td = oe_sgx_get_td();
+
+    return td ? td->random_state.num_reseeds : 0;
+}
+
+void oe_random_teardown(void)
+{
+    oe_spin_lock(&_seeded_lock);
+
+    for (drbg_t* drbg = _seeded; drbg;)
     {
-        size_t request_size = size - i;
-        if (request_size > RDRAND_BYTES)
-        {
-            request_size = RDRAND_BYTES;
-        }
-        uint64_t random_bytes = oe_rdrand();
-        memcpy((void*)((uint8_t*)data + i), (void*)&random_bytes, request_size);
+        drbg_t* next = drbg->next_seeded;
+
+        oe_secure_zero_fill(drbg, sizeof(*drbg));
+        drbg = next;
     }
 
-    return OE_OK;
+    _seeded = NULL;
+    oe_spin_unlock(&_seeded_lock);
 }
@@ -0,0 +1,12 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#ifndef _OE_RDTSC_ENCLAVE_H
+#define _OE_RDTSC_ENCLAVE_H
+
+#include <openenclave/bits/types.h>
+
+/* Return the TSC, or 0 if RDTSC is illegal in the enclave (SGX1) */
+uint64_t oe_rdtsc(void);
+
+#endif /* _OE_RDTSC_ENCLAVE_H */
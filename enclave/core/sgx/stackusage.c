@@ -0,0 +1,120 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/bits/eeid.h>
+#include <openenclave/bits/sgx/writebarrier.h>
+#include <openenclave/enclave.h>
+#include <openenclave/internal/calls.h>
+#include <openenclave/internal/constants_x64.h>
+#include <openenclave/internal/globals.h>
+#include <openenclave/internal/raise.h>
+#include "../tracee.h"
+#include "handle_ecall.h"
+
+/* The pattern that the host loader writes to every stack page (see
+ * _add_stack_pages() in host/sgx/create.c) */
+#define STACK_FILL_PATTERN 0xccccccccccccccccULL
+
+extern volatile const oe_sgx_enclave_properties_t oe_enclave_properties_sgx;
+extern uint64_t _td_from_tcs_offset;
+
+#ifdef OE_WITH_EXPERIMENTAL_EEID
+extern oe_eeid_t* oe_eeid;
+#endif
+
+static const volatile oe_enclave_size_settings_t* _get_size_settings(void)
+{
+#ifdef OE_WITH_EXPERIMENTAL_EEID
+    if (oe_eeid)
+        return &oe_eeid->size_settings;
+#endif
+    return &oe_enclave_properties_sgx.header.size_settings;
+}
+
+/* Return the number of bytes below the top of the stack that no longer hold
+ * the fill pattern. The stack grows down, so the lowest overwritten word
+ * marks the deepest point the thread ever reached. */
+static uint64_t _get_stack_usage(const uint64_t* low, const uint64_t* high)
+{
+    const uint64_t* p = low;
+
+    while (p < high && *p == STACK_FILL_PATTERN)
+        p++;
+
+    return (uint64_t)((const uint8_t*)high - (const uint8_t*)p);
+}
+
+/*
+**==============================================================================
+**
+** oe_handle_get_stack_usage()
+**
+**     Scan the stack of each thread for the fill pattern. The layout of a
+**     thread, starting right after the heap, is: guard page, stack, guard
+**     page, control pages, TLS pages, and thread data page, where the offset
+**     from the TCS (the first control page) to the thread data is
+**     _td_from_tcs_offset.
+**
+**==============================================================================
+*/
+
+oe_result_t oe_handle_get_stack_usage(uint64_t arg_in)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_get_stack_usage_args_t args = {0};
+    const volatile oe_enclave_size_settings_t* size_settings;
+    uint64_t num_threads;
+    uint64_t stack_size;
+    uint64_t stride;
+    const uint8_t* stack;
+
+    // The stack depth of the threads is only disclosed by debug enclaves.
+    if (!oe_is_enclave_debug_allowed())
+        OE_RAISE(OE_UNSUPPORTED);
+
+    // Ensure that args lies outside the enclave and is 8-byte aligned
+    // (against the xAPIC vulnerability).
+    if (!oe_is_outside_enclave(
+            (void*)arg_in, sizeof(oe_get_stack_usage_args_t)) ||
+        (arg_in % 8) != 0)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    // Copy args to enclave memory to avoid TOCTOU issues.
+    oe_memcpy_aligned(&args, (void*)arg_in, sizeof(oe_get_stack_usage_args_t));
+
+    size_settings = _get_size_settings();
+    num_threads = size_settings->num_tcs;
+    stack_size = size_settings->num_stack_pages * OE_PAGE_SIZE;
+    // Two guard pages surround each stack.
+    stride = stack_size + (2 + OE_SGX_TCS_THREAD_DATA_PAGES) * OE_PAGE_SIZE +
+             _td_from_tcs_offset;
+
+    OE_WRITE_VALUE_WITH_BARRIER(
+        &((oe_get_stack_usage_args_t*)arg_in)->num_threads, num_threads);
+    OE_WRITE_VALUE_WITH_BARRIER(
+        &((oe_get_stack_usage_args_t*)arg_in)->stack_size, stack_size);
+
+    if (args.num_threads < num_threads)
+        OE_RAISE_NO_TRACE(OE_BUFFER_TOO_SMALL);
+
+    if (!oe_is_outside_enclave(
+            args.stack_usage, num_threads * sizeof(uint64_t)) ||
+        ((uint64_t)args.stack_usage % 8) != 0)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    // Skip the guard page below the first stack.
+    stack = (const uint8_t*)__oe_get_heap_end() + OE_PAGE_SIZE;
+
+    for (uint64_t i = 0; i < num_threads; i++, stack += stride)
+    {
+        uint64_t usage = _get_stack_usage(
+            (const uint64_t*)stack, (const uint64_t*)(stack + stack_size));
+
+        OE_WRITE_VALUE_WITH_BARRIER(&args.stack_usage[i], usage);
+    }
+
+    result = OE_OK;
+
+done:
+    return result;
+}
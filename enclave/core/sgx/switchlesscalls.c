@@ -21,6 +21,21 @@ static size_t _host_worker_count = 0;
 // variables.
 static volatile oe_host_worker_context_t* _host_worker_contexts = NULL;
 
+// The submission ring shared by all host workers. Initialized by host through
+// ECALL. The capacity is stashed in enclave memory so that a misbehaving host
+// cannot steer enclave writes outside the ring.
+static oe_switchless_ring_t* _ocall_ring = NULL;
+static volatile oe_switchless_ring_slot_t* _ocall_ring_slots = NULL;
+static uint64_t _ocall_ring_mask = 0;
+
+// Flag to denote if the ocall ring has been initialized or is being
+// initialized. Defined as int64_t for oe_atomic_compare_and_swap().
+static int64_t _ocall_ring_init_started = 0;
+
+// Counters in host memory that the host reads. Initialized by host through
+// ECALL.
+static oe_switchless_statistics_t* _statistics = NULL;
+
 // Flag to denote if switchless calls have already been initialized.
 static bool _is_switchless_initialized = false;
 
@@ -147,6 +162,10 @@ oe_result_t oe_sgx_init_context_switchless_ecall(
 
         if ((uint64_t)&_host_worker_contexts[i].event % 8)
             OE_RAISE(OE_INVALID_PARAMETER);
+
+        /* Refuse contexts laid out by a host with a different ABI. */
+        if (_host_worker_contexts[i].version != OE_SWITCHLESS_CONTEXT_VERSION)
+            OE_RAISE(OE_INVALID_PARAMETER);
     }
 
     __atomic_store_n(&_is_switchless_initialized, true, __ATOMIC_SEQ_CST);
@@ -162,28 +181,252 @@ done:
 /*
 **==============================================================================
 **
-** oe_post_switchless_ocall()
+** oe_sgx_init_switchless_ocall_ring_ecall()
 **
-**  Post the function call (wrapped in args) to a free host worker thread
-**  by writing to its context.
+** Initialize the submission ring that switchless ocalls are queued in when
+** every host worker is busy. This function can be called only once, after
+** oe_sgx_init_context_switchless_ecall.
 **
 **==============================================================================
 */
-oe_result_t oe_post_switchless_ocall(oe_call_host_function_args_t* args)
+oe_result_t oe_sgx_init_switchless_ocall_ring_ecall(
+    void* ring,
+    uint64_t capacity)
 {
     oe_result_t result = OE_UNEXPECTED;
+    oe_switchless_ring_t* ocall_ring = (oe_switchless_ring_t*)ring;
 
-    OE_ATOMIC_MEMORY_BARRIER_RELEASE();
+    if (!oe_is_switchless_initialized())
+        OE_RAISE(OE_UNEXPECTED);
 
-    // Set the result to indicate that the call hasn't been processed
-    OE_WRITE_VALUE_WITH_BARRIER(&args->result, OE_UINT64_MAX);
+    if (!oe_atomic_compare_and_swap(
+            &_ocall_ring_init_started, (int64_t) false, (int64_t) true))
+    {
+        OE_RAISE(OE_ALREADY_INITIALIZED);
+    }
+
+    /* The capacity must be a power of two so that positions can be masked */
+    if (capacity == 0 || capacity > OE_SWITCHLESS_OCALL_RING_MAX_DEPTH ||
+        (capacity & (capacity - 1)) != 0)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    /* Ensure the ring is outside of enclave and its alignment guarantees that
+     * every index and slot word is 8-byte aligned against the xAPIC
+     * vulnerability */
+    if (!oe_is_outside_enclave(
+            ocall_ring, oe_switchless_ring_size(capacity)) ||
+        ((uint64_t)ocall_ring % OE_SWITCHLESS_RING_ALIGNMENT) != 0)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    /* lfence after checks. */
+    oe_lfence();
+
+    _ocall_ring_slots = oe_switchless_ring_slots(ocall_ring);
+    _ocall_ring_mask = capacity - 1;
+
+    // Publish the ring only after the slots and mask are in place.
+    __atomic_store_n(&_ocall_ring, ocall_ring, __ATOMIC_SEQ_CST);
+
+    result = OE_OK;
+
+done:
+    return result;
+}
+
+/*
+**==============================================================================
+**
+** oe_sgx_init_switchless_statistics_ecall()
+**
+** Initialize the counters that the enclave updates for the host. This
+** function can be called only once, after oe_sgx_init_context_switchless_ecall.
+**
+**==============================================================================
+*/
+oe_result_t oe_sgx_init_switchless_statistics_ecall(void* statistics)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_switchless_statistics_t* expected = NULL;
+
+    if (!oe_is_switchless_initialized())
+        OE_RAISE(OE_UNEXPECTED);
+
+    /* Ensure the counters are outside of enclave and 8-byte aligned against
+     * the xAPIC vulnerability */
+    if (!oe_is_outside_enclave(
+            statistics, sizeof(oe_switchless_statistics_t)) ||
+        ((uint64_t)statistics % 8) != 0)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    /* lfence after checks. */
+    oe_lfence();
+
+    if (!__atomic_compare_exchange_n(
+            &_statistics,
+            &expected,
+            (oe_switchless_statistics_t*)statistics,
+            false,
+            __ATOMIC_ACQ_REL,
+            __ATOMIC_ACQUIRE))
+        OE_RAISE(OE_ALREADY_INITIALIZED);
+
+    result = OE_OK;
+
+done:
+    return result;
+}
+
+/*
+**==============================================================================
+**
+** _wake_host_worker()
+**
+**  Wake the given host worker if it has gone to sleep. Return true if a wake
+**  notification was delivered or is already pending.
+**
+**==============================================================================
+*/
+static bool _wake_host_worker(size_t index)
+{
+    // If event is 0, it means that it has gone to sleep. Wake it by
+    // making an ocall (oe_sgx_wake_switchless_worker_ocall).
+    // Note: it is important to use an atomic cas operation to set
+    // the value to 1 before making the ocall. Setting the value to
+    // 1 prevents the host worker from simultaneously going to
+    // sleep. If instead, just a compare operation is used to
+    // determine if the host thread is sleeping or not, the host
+    // thread could go to sleep after the enclave has determined
+    // that the host is not sleeping, causing a deadlock.
+    //
+    // If event is 1, that indicates a pending wake notification.
+    int64_t oldval = 0;
+    int64_t newval = 1;
+    // Weak operation could sporadically fail.
+    // We need a strong operation.
+    bool weak = false;
+
+    if (__atomic_compare_exchange_n(
+            &_host_worker_contexts[index].event,
+            &oldval,
+            newval,
+            weak,
+            __ATOMIC_ACQ_REL,
+            __ATOMIC_ACQUIRE))
+    {
+        // The pevious value of the event was 0 which means that the
+        // worker was previously sleeping.
+        // Wake it via an ocall.
+        oe_sgx_wake_switchless_worker_ocall(
+            (oe_host_worker_context_t*)&_host_worker_contexts[index]);
+        return true;
+    }
+
+    return oldval == 1;
+}
 
+/*
+**==============================================================================
+**
+** _post_switchless_ocall_to_ring()
+**
+**  Queue the function call (wrapped in args) in the submission ring so that
+**  the next available host worker picks it up.
+**
+**==============================================================================
+*/
+static oe_result_t _post_switchless_ocall_to_ring(
+    oe_call_host_function_args_t* args)
+{
+    oe_switchless_ring_t* ring =
+        __atomic_load_n(&_ocall_ring, __ATOMIC_ACQUIRE);
+
+    if (!ring)
+        return OE_CONTEXT_SWITCHLESS_OCALL_MISSED;
+
+    uint64_t pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_ACQUIRE);
+
+    // The ring lives in host memory. Bound the number of attempts so that a
+    // host that keeps moving the indices cannot stall the enclave thread.
+    for (uint64_t tries = 0; tries <= _ocall_ring_mask; tries++)
+    {
+        volatile oe_switchless_ring_slot_t* slot =
+            &_ocall_ring_slots[pos & _ocall_ring_mask];
+        uint64_t sequence =
+            __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(sequence - pos);
+
+        if (diff == 0)
+        {
+            // The slot is free. Try to claim the position. On failure, pos is
+            // updated with the current enqueue position.
+            if (__atomic_compare_exchange_n(
+                    &ring->enqueue_pos,
+                    &pos,
+                    pos + 1,
+                    false,
+                    __ATOMIC_ACQ_REL,
+                    __ATOMIC_ACQUIRE))
+            {
+                // Publish the call. Both words are 8-byte aligned.
+                OE_WRITE_VALUE_WITH_BARRIER(&slot->call_arg, (void*)args);
+                OE_WRITE_VALUE_WITH_BARRIER(&slot->sequence, pos + 1);
+
+                // Parked workers announce themselves before re-checking the
+                // ring, so at least one of the two sides sees the other.
+                // Wake a worker that is asleep: the event of a running worker
+                // is 0 as well.
+                if (__atomic_load_n(
+                        &ring->num_sleeping_workers, __ATOMIC_SEQ_CST))
+                {
+                    for (size_t i = 0; i < _host_worker_count; i++)
+                    {
+                        if (__atomic_load_n(
+                                &_host_worker_contexts[i].is_sleeping,
+                                __ATOMIC_SEQ_CST) &&
+                            _wake_host_worker(i))
+                            break;
+                    }
+                }
+
+                return OE_OK;
+            }
+        }
+        else if (diff < 0)
+        {
+            // The ring is full.
+            break;
+        }
+        else
+        {
+            // Another enclave thread claimed this position.
+            pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    return OE_CONTEXT_SWITCHLESS_OCALL_MISSED;
+}
+
+/*
+**==============================================================================
+**
+** _post_switchless_ocall_to_worker()
+**
+**  Post the function call (wrapped in args) to a host worker whose slot holds
+**  the expected value (NULL for a free worker). Return false if no such worker
+**  was found.
+**
+**==============================================================================
+*/
+static bool _post_switchless_ocall_to_worker(
+    void* expected,
+    oe_call_host_function_args_t* args)
+{
     // Cycle through the worker contexts until we find a free worker.
     size_t tries = _host_worker_count;
     while (tries--)
     {
         // Check if the worker's slot is free.
-        if (_host_worker_contexts[tries].call_arg == NULL)
+        if (_host_worker_contexts[tries].call_arg == expected)
         {
             // Try to atomically grab the slot by placing args in the slot.
             // If the atomic operation was successful, then the worker thread
@@ -194,51 +437,57 @@ oe_result_t oe_post_switchless_ocall(oe_call_host_function_args_t* args)
 
             if (oe_atomic_compare_and_swap_ptr(
                     (void* volatile*)&_host_worker_contexts[tries].call_arg,
-                    NULL,
+                    expected,
                     args))
             {
                 // The worker thread has been marked to execute this switchless
                 // call. Determine if it needs to be woken up or not.
-                //
-                // If event is 0, it means that it has gone to sleep. Wake it by
-                // making an ocall (oe_sgx_wake_switchless_worker_ocall).
-                // Note: it is important to use an atomic cas operation to set
-                // the value to 1 before making the ocall. Setting the value to
-                // 1 prevents the host worker from simultaneously going to
-                // sleep. If instead, just a compare operation is used to
-                // determine if the host thread is sleeping or not, the host
-                // thread could go to sleep after the enclave has determined
-                // that the host is not sleeping, causing a deadlock.
-                //
-                // If event is 1, that indicates a pending wake notification.
-                int64_t oldval = 0;
-                int64_t newval = 1;
-                // Weak operation could sporadically fail.
-                // We need a strong operation.
-                bool weak = false;
-
-                if (__atomic_compare_exchange_n(
-                        &_host_worker_contexts[tries].event,
-                        &oldval,
-                        newval,
-                        weak,
-                        __ATOMIC_ACQ_REL,
-                        __ATOMIC_ACQUIRE))
-                {
-                    // The pevious value of the event was 0 which means that the
-                    // worker was previously sleeping.
-                    // Wake it via an ocall.
-                    oe_sgx_wake_switchless_worker_ocall(
-                        (oe_host_worker_context_t*)&_host_worker_contexts
-                            [tries]);
-                }
+                _wake_host_worker(tries);
 
-                return OE_OK;
+                return true;
             }
         }
     }
 
-    result = OE_CONTEXT_SWITCHLESS_OCALL_MISSED;
+    return false;
+}
+
+/*
+**==============================================================================
+**
+** oe_post_switchless_ocall()
+**
+**  Post the function call (wrapped in args) to a free host worker thread
+**  by writing to its context. If every worker is busy, queue the call in the
+**  submission ring (if enabled).
+**
+**==============================================================================
+*/
+oe_result_t oe_post_switchless_ocall(oe_call_host_function_args_t* args)
+{
+    OE_ATOMIC_MEMORY_BARRIER_RELEASE();
+
+    // Set the result to indicate that the call hasn't been processed
+    OE_WRITE_VALUE_WITH_BARRIER(&args->result, OE_UINT64_MAX);
+
+    // Post to a free worker. If every active worker is busy, revive a
+    // retired one before queuing the call.
+    if (_post_switchless_ocall_to_worker(NULL, args) ||
+        _post_switchless_ocall_to_worker(OE_SWITCHLESS_WORKER_RETIRED, args))
+        return OE_OK;
+
+    oe_result_t result = _post_switchless_ocall_to_ring(args);
+
+    // The caller falls back to a regular ocall. Count it for the host.
+    if (result == OE_CONTEXT_SWITCHLESS_OCALL_MISSED)
+    {
+        oe_switchless_statistics_t* statistics =
+            __atomic_load_n(&_statistics, __ATOMIC_ACQUIRE);
+
+        if (statistics)
+            __atomic_fetch_add(
+                &statistics->num_ocall_fallbacks, 1, __ATOMIC_RELAXED);
+    }
 
     return result;
 }
@@ -272,18 +521,28 @@ oe_result_t oe_switchless_call_host_function(
 void oe_sgx_switchless_enclave_worker_thread_ecall(
     oe_enclave_worker_context_t* context)
 {
-    // Ensure that the context lies in host memory.
-    if (!oe_is_outside_enclave(context, sizeof(*context)))
+    // Ensure that the context lies in host memory and has the expected layout.
+    if (!oe_is_outside_enclave(context, sizeof(*context)) ||
+        context->version != OE_SWITCHLESS_CONTEXT_VERSION)
         return;
 
     // Prevent speculative execution.
     oe_lfence();
 
-    const uint64_t spin_count_threshold = context->spin_count_threshold;
+    uint64_t spin_count_threshold = context->spin_count_threshold;
     while (!context->is_stopping)
     {
-        volatile oe_call_enclave_function_args_t* local_call_arg = NULL;
-        if ((local_call_arg = context->call_arg) != NULL)
+        volatile oe_call_enclave_function_args_t* local_call_arg =
+            context->call_arg;
+
+        if (local_call_arg == OE_SWITCHLESS_WORKER_RETIRED)
+        {
+            // The host has retired this worker. Sleep until a call revives
+            // it.
+            oe_sgx_sleep_switchless_worker_ocall(context);
+            spin_count_threshold = context->spin_count_threshold;
+        }
+        else if (local_call_arg != NULL)
         {
             // Handle the switchless call, but do not clear the slot yet. Since
             // the slot is not empty, any new incoming switchless call request
@@ -320,8 +579,12 @@ void oe_sgx_switchless_enclave_worker_thread_ecall(
 
                 OE_WRITE_VALUE_WITH_BARRIER(&context->spin_count, (uint64_t)0);
 
-                // Make an ocall to sleep until messages arrive.
+                // Make an ocall to sleep until messages arrive. Under an
+                // adaptive spin policy, the host adjusts the threshold in the
+                // meantime. The threshold only bounds the spinning, so it
+                // need not be trusted.
                 oe_sgx_sleep_switchless_worker_ocall(context);
+                spin_count_threshold = context->spin_count_threshold;
             }
 
             // In Release builds, the following pause has been observed to be
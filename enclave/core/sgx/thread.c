@@ -11,6 +11,7 @@
 #include <openenclave/internal/thread.h>
 #include "platform_t.h"
 #include "td.h"
+#include "wakering.h"
 
 /*
 **==============================================================================
@@ -34,6 +35,10 @@ static int _thread_wake(oe_sgx_td_t* self)
 {
     const void* tcs = td_to_tcs((oe_sgx_td_t*)self);
 
+    /* Leave the enclave only if the host wake ring cannot take the request */
+    if (oe_post_wake(tcs))
+        return 0;
+
     if (oe_ocall(OE_OCALL_THREAD_WAKE, (uint64_t)tcs, NULL) != OE_OK)
         return -1;
 
@@ -70,6 +75,141 @@ done:
     return ret;
 }
 
+/*
+**==============================================================================
+**
+** Adaptive spinning:
+**
+**     A thread that is queued on a mutex or condition variable spins for a
+**     while before it asks the host to park it, since the wait for a short
+**     critical section is far shorter than the two enclave exits of parking
+**     and waking it. The waker changes the wait state of the waiter, and
+**     only makes the wake OCALL if the waiter has already parked.
+**
+**     Each mutex and condition variable keeps an estimate of the number of
+**     polls that its waiters needed before being woken, which shrinks while
+**     spinning does not pay off. A waiter spins for at most twice that
+**     estimate (plus a minimum), with exponential backoff between polls,
+**     and never for more than the limit set with oe_configure_spinning().
+**
+**==============================================================================
+*/
+
+/* The values of oe_sgx_td_t.wait_state */
+#define WAIT_STATE_RUNNING 0
+#define WAIT_STATE_SPINNING 1
+#define WAIT_STATE_PARKED 2
+
+/* Polls of the wait state that a waiter makes whatever its estimate */
+#define MIN_SPINS 10
+
+/* Default and largest limit of the polls made before parking */
+#define DEFAULT_MAX_SPINS 100
+#define MAX_MAX_SPINS 100000
+
+/* Largest number of PAUSE instructions between two polls */
+#define MAX_BACKOFF 16
+
+static uint32_t _max_spins = DEFAULT_MAX_SPINS;
+
+oe_result_t oe_configure_spinning(uint32_t max_spins)
+{
+    if (max_spins > MAX_MAX_SPINS)
+        return OE_INVALID_PARAMETER;
+
+    __atomic_store_n(&_max_spins, max_spins, __ATOMIC_RELAXED);
+    return OE_OK;
+}
+
+/* Caller holds the spinlock of the queue that self was added to */
+static void _prepare_wait(oe_sgx_td_t* self)
+{
+    __atomic_store_n(&self->wait_state, WAIT_STATE_SPINNING, __ATOMIC_RELAXED);
+}
+
+/* Return true if the waiter is asleep in the host and must be woken */
+static bool _set_running(oe_sgx_td_t* waiter)
+{
+    return __atomic_exchange_n(
+               &waiter->wait_state, WAIT_STATE_RUNNING, __ATOMIC_ACQ_REL) ==
+           WAIT_STATE_PARKED;
+}
+
+/* Park self, unless it was woken since _prepare_wait() */
+static bool _park(oe_sgx_td_t* self)
+{
+    uint32_t expected = WAIT_STATE_SPINNING;
+
+    return __atomic_compare_exchange_n(
+        &self->wait_state,
+        &expected,
+        WAIT_STATE_PARKED,
+        false,
+        __ATOMIC_ACQ_REL,
+        __ATOMIC_ACQUIRE);
+}
+
+/* Wait until self is woken, spinning first if spins is not null. spins is
+ * the estimate of the primitive that self waits on. */
+static void _wait(oe_sgx_td_t* self, uint32_t* spins)
+{
+    if (spins)
+    {
+        uint32_t estimate = __atomic_load_n(spins, __ATOMIC_RELAXED);
+        uint32_t max_spins = __atomic_load_n(&_max_spins, __ATOMIC_RELAXED);
+        uint32_t budget = 2 * estimate + MIN_SPINS;
+        uint32_t backoff = 1;
+
+        if (budget > max_spins)
+            budget = max_spins;
+
+        for (uint32_t i = 0; i < budget; i++)
+        {
+            if (__atomic_load_n(&self->wait_state, __ATOMIC_ACQUIRE) !=
+                WAIT_STATE_SPINNING)
+            {
+                /* Move the estimate an eighth of the way towards i */
+                int32_t delta = ((int32_t)i - (int32_t)estimate) / 8;
+
+                estimate = (uint32_t)((int32_t)estimate + delta);
+                __atomic_store_n(spins, estimate, __ATOMIC_RELAXED);
+                return;
+            }
+
+            for (uint32_t j = 0; j < backoff; j++)
+                asm volatile("pause" ::: "memory");
+
+            if (backoff < MAX_BACKOFF)
+                backoff *= 2;
+        }
+
+        /* Spinning did not pay off */
+        __atomic_store_n(spins, estimate - estimate / 8, __ATOMIC_RELAXED);
+    }
+
+    if (_park(self))
+        _thread_wait(self);
+}
+
+/* Wake the waiter, if it is not already running */
+static void _wake(oe_sgx_td_t* waiter)
+{
+    if (_set_running(waiter))
+        _thread_wake(waiter);
+}
+
+/* Wake the waiter and wait until self is woken, in a single OCALL when both
+ * threads have to go through the host */
+static void _wake_wait(oe_sgx_td_t* waiter, oe_sgx_td_t* self, uint32_t* spins)
+{
+    if (!_set_running(waiter))
+        _wait(self, spins);
+    else if (_park(self))
+        _thread_wake_wait(waiter, self);
+    else
+        _thread_wake(waiter);
+}
+
 /*
 **==============================================================================
 **
@@ -168,7 +308,10 @@ typedef struct _oe_mutex_impl
     oe_sgx_td_t* owner;
 
     /* The type of mutex (supported types: normal and recursive) */
-    uint64_t type;
+    uint32_t type;
+
+    /* Estimate of the polls that a waiter makes before it is woken */
+    uint32_t spins;
 
     /* Queue of waiting threads (front holds the mutex) */
     Queue queue;
@@ -185,6 +328,7 @@ OE_STATIC_ASSERT(OE_OFFSETOF(oe_mutex_impl_t, lock) == 0);
 OE_STATIC_ASSERT(OE_OFFSETOF(oe_mutex_impl_t, refs) == 4);
 OE_STATIC_ASSERT(OE_OFFSETOF(oe_mutex_impl_t, owner) == 8);
 OE_STATIC_ASSERT(OE_OFFSETOF(oe_mutex_impl_t, type) == 16);
+OE_STATIC_ASSERT(OE_OFFSETOF(oe_mutex_impl_t, spins) == 20);
 OE_STATIC_ASSERT(OE_OFFSETOF(oe_mutex_impl_t, queue) == 24);
 
 static oe_result_t _validate_mutexattr_type(uint32_t type)
@@ -327,6 +471,8 @@ oe_result_t oe_mutex_lock(oe_mutex_t* mutex)
     /* Loop until SELF obtains mutex */
     for (;;)
     {
+        bool spin;
+
         oe_spin_lock(&m->lock);
         {
             /* Attempt to acquire lock */
@@ -352,11 +498,16 @@ oe_result_t oe_mutex_lock(oe_mutex_t* mutex)
                 /* Insert thread at back of waiters queue */
                 _queue_push_back(&m->queue, self);
             }
+
+            /* Only the front of the queue is handed the mutex, so only that
+             * thread spins */
+            spin = (m->queue.front == self);
+            _prepare_wait(self);
         }
         oe_spin_unlock(&m->lock);
 
-        /* Ask host to wait for an event on this thread */
-        _thread_wait(self);
+        /* Wait for the owner to hand over the mutex */
+        _wait(self, spin ? &m->spins : NULL);
     }
 
     /* Unreachable! */
@@ -425,8 +576,8 @@ oe_result_t oe_mutex_unlock(oe_mutex_t* m)
 
     if (waiter)
     {
-        /* Ask host to wake up this thread */
-        _thread_wake(waiter);
+        /* Ask host to wake up this thread, unless it is still spinning */
+        _wake(waiter);
     }
 
     return OE_OK;
@@ -468,6 +619,9 @@ typedef struct _oe_cond_impl
     /* Spinlock for synchronizing access to thread queue and mutex parameter */
     oe_spinlock_t lock;
 
+    /* Estimate of the polls that a waiter makes before it is signaled */
+    uint32_t spins;
+
     /* Queue of threads waiting on this condition variable */
     struct
     {
@@ -539,16 +693,17 @@ oe_result_t oe_cond_wait(oe_cond_t* condition, oe_mutex_t* mutex)
 
         for (;;)
         {
+            _prepare_wait(self);
             oe_spin_unlock(&cond->lock);
             {
                 if (waiter)
                 {
-                    _thread_wake_wait(waiter, self);
+                    _wake_wait(waiter, self, &cond->spins);
                     waiter = NULL;
                 }
                 else
                 {
-                    _thread_wait(self);
+                    _wait(self, &cond->spins);
                 }
             }
             oe_spin_lock(&cond->lock);
@@ -579,7 +734,7 @@ oe_result_t oe_cond_signal(oe_cond_t* condition)
     if (!waiter)
         return OE_OK;
 
-    _thread_wake(waiter);
+    _wake(waiter);
     return OE_OK;
 }
 
@@ -607,7 +762,7 @@ oe_result_t oe_cond_broadcast(oe_cond_t* condition)
         // primitive that could modify the next field.
         // Therefore fetch the next thread before waking up p.
         p_next = p->next;
-        _thread_wake(p);
+        _wake(p);
     }
 
     return OE_OK;
@@ -0,0 +1,440 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/bits/sgx/writebarrier.h>
+#include <openenclave/corelibc/stdlib.h>
+#include <openenclave/corelibc/string.h>
+#include <openenclave/enclave.h>
+#include <openenclave/internal/calls.h>
+#include <openenclave/internal/raise.h>
+#include <openenclave/internal/thread.h>
+#include <openenclave/internal/threadpool.h>
+#include "handle_ecall.h"
+#include "thread.h"
+
+/*
+**==============================================================================
+**
+** The thread pool.
+**
+**     The host announces the number of threads of the pool with
+**     OE_ECALL_INIT_THREAD_POOL, and then each of its threads enters with
+**     OE_ECALL_THREAD_POOL_WORKER on a TCS of its own (see
+**     host/sgx/threadpool.c). A worker runs the queued functions, joins the
+**     parallel loops that still have work, and otherwise waits on _cond
+**     until OE_ECALL_STOP_THREAD_POOL.
+**
+**     The threads that have not entered yet count as free, so that a
+**     function can be queued as soon as the enclave is created. A function
+**     is only queued if a free thread will run it: functions may block, and
+**     one waiting behind another could deadlock.
+**
+**==============================================================================
+*/
+
+#define CACHE_LINE_SIZE 64
+
+typedef struct _job
+{
+    struct _job* next;
+    void (*function)(void*);
+    void* arg;
+} job_t;
+
+/* The indices [begin, end) left to a thread of a parallel loop */
+typedef struct _range
+{
+    oe_spinlock_t lock;
+    size_t begin;
+    size_t end;
+} range_t;
+
+/* Pad the ranges to a cache line, as each is mostly used by one thread */
+typedef struct _padded_range
+{
+    range_t range;
+    uint8_t padding[CACHE_LINE_SIZE - sizeof(range_t)];
+} padded_range_t;
+
+typedef struct _loop
+{
+    struct _loop* next;
+    void (*function)(size_t index, void* arg);
+    void* arg;
+
+    /* Number of indices taken from a range at once */
+    size_t grain;
+
+    /* One range for the calling thread and one for each thread of the pool
+     * that joins the loop */
+    padded_range_t* ranges;
+    size_t num_ranges;
+
+    /* Number of ranges handed out and number of threads of the pool in the
+     * loop (under _lock) */
+    size_t num_joined;
+    size_t num_participants;
+
+    /* Set once a thread found no index left */
+    bool exhausted;
+} loop_t;
+
+static oe_mutex_t _lock = OE_MUTEX_INITIALIZER;
+
+/* Workers wait for functions and loops on _cond, and the callers of
+ * oe_thread_pool_parallel_for() wait for the workers to leave on _done */
+static oe_cond_t _cond = OE_COND_INITIALIZER;
+static oe_cond_t _done = OE_COND_INITIALIZER;
+
+static size_t _num_threads;
+static size_t _num_entered;
+static size_t _num_free;
+static size_t _num_queued;
+static job_t* _head;
+static job_t* _tail;
+static loop_t* _loops;
+static bool _stopping;
+
+/* Take up to grain indices from the range */
+static bool _take(range_t* range, size_t grain, size_t* begin, size_t* end)
+{
+    bool taken = false;
+
+    oe_spin_lock(&range->lock);
+
+    if (range->begin < range->end)
+    {
+        *begin = range->begin;
+        *end = range->end - range->begin > grain ? range->begin + grain
+                                                 : range->end;
+        range->begin = *end;
+        taken = true;
+    }
+
+    oe_spin_unlock(&range->lock);
+
+    return taken;
+}
+
+/* Move half of the indices left to another thread to the given range */
+static bool _steal(loop_t* loop, size_t index)
+{
+    for (size_t i = 1; i < loop->num_ranges; i++)
+    {
+        range_t* victim = &loop->ranges[(index + i) % loop->num_ranges].range;
+        range_t* range = &loop->ranges[index].range;
+        size_t begin;
+        size_t end;
+
+        oe_spin_lock(&victim->lock);
+        end = victim->end;
+        begin = end - (end - victim->begin + 1) / 2;
+        victim->end = begin;
+        oe_spin_unlock(&victim->lock);
+
+        if (begin < end)
+        {
+            oe_spin_lock(&range->lock);
+            range->begin = begin;
+            range->end = end;
+            oe_spin_unlock(&range->lock);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Call the function of the loop until no index is left, using the given
+ * range. A worker also leaves when a function is queued, which then runs
+ * sooner, and the indices left in its range are stolen by others. */
+static void _participate(loop_t* loop, size_t index)
+{
+    range_t* range = &loop->ranges[index].range;
+    size_t begin;
+    size_t end;
+
+    for (;;)
+    {
+        if (!_take(range, loop->grain, &begin, &end))
+        {
+            if (!_steal(loop, index))
+            {
+                __atomic_store_n(&loop->exhausted, true, __ATOMIC_RELAXED);
+                break;
+            }
+
+            continue;
+        }
+
+        for (size_t i = begin; i < end; i++)
+            loop->function(i, loop->arg);
+
+        if (index != 0 && __atomic_load_n(&_num_queued, __ATOMIC_RELAXED))
+            break;
+    }
+}
+
+/* Find a loop that a worker can join (under _lock) */
+static loop_t* _find_loop(void)
+{
+    for (loop_t* loop = _loops; loop; loop = loop->next)
+    {
+        if (loop->num_joined < loop->num_ranges &&
+            !__atomic_load_n(&loop->exhausted, __ATOMIC_RELAXED))
+            return loop;
+    }
+
+    return NULL;
+}
+
+static void _run_worker(void)
+{
+    oe_mutex_lock(&_lock);
+
+    for (;;)
+    {
+        loop_t* loop;
+
+        if (_head)
+        {
+            job_t* job = _head;
+
+            if (!(_head = job->next))
+                _tail = NULL;
+
+            __atomic_store_n(&_num_queued, _num_queued - 1, __ATOMIC_RELAXED);
+            _num_free--;
+            oe_mutex_unlock(&_lock);
+
+            job->function(job->arg);
+            oe_free(job);
+
+            // The next function starts without thread-specific data, as a
+            // new thread would. The TLS variables are not reset.
+            oe_thread_destruct_specific();
+
+            oe_mutex_lock(&_lock);
+            _num_free++;
+        }
+        else if ((loop = _find_loop()))
+        {
+            size_t index = loop->num_joined++;
+
+            loop->num_participants++;
+            oe_mutex_unlock(&_lock);
+
+            _participate(loop, index);
+
+            oe_mutex_lock(&_lock);
+            if (--loop->num_participants == 0)
+                oe_cond_broadcast(&_done);
+        }
+        else if (_stopping)
+        {
+            break;
+        }
+        else
+        {
+            oe_cond_wait(&_cond, &_lock);
+        }
+    }
+
+    oe_mutex_unlock(&_lock);
+}
+
+oe_result_t oe_handle_init_thread_pool(uint64_t arg_in)
+{
+    oe_result_t result = OE_UNEXPECTED;
+
+    oe_mutex_lock(&_lock);
+
+    if (_num_threads)
+        OE_RAISE(OE_ALREADY_INITIALIZED);
+
+    if (arg_in == 0 || arg_in > OE_SGX_MAX_TCS)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    _num_threads = (size_t)arg_in;
+    _num_free = _num_threads;
+
+    result = OE_OK;
+
+done:
+    oe_mutex_unlock(&_lock);
+    return result;
+}
+
+oe_result_t oe_handle_thread_pool_worker(uint64_t arg_in)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    bool entered = false;
+
+    // Ensure that args lies outside the enclave and is 8-byte aligned
+    // (against the xAPIC vulnerability).
+    if (!oe_is_outside_enclave(
+            (void*)arg_in, sizeof(oe_thread_pool_worker_args_t)) ||
+        (arg_in % 8) != 0)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    oe_mutex_lock(&_lock);
+    if (_num_entered < _num_threads && !_stopping)
+    {
+        _num_entered++;
+        entered = true;
+    }
+    oe_mutex_unlock(&_lock);
+
+    if (!entered)
+        OE_RAISE(OE_UNEXPECTED);
+
+    OE_WRITE_VALUE_WITH_BARRIER(
+        &((oe_thread_pool_worker_args_t*)arg_in)->started, 1);
+
+    _run_worker();
+
+    result = OE_OK;
+
+done:
+    return result;
+}
+
+oe_result_t oe_handle_stop_thread_pool(uint64_t arg_in)
+{
+    OE_UNUSED(arg_in);
+
+    oe_mutex_lock(&_lock);
+    _stopping = true;
+    oe_cond_broadcast(&_cond);
+    oe_mutex_unlock(&_lock);
+
+    return OE_OK;
+}
+
+oe_result_t oe_thread_pool_run(void (*function)(void*), void* arg)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    job_t* job = NULL;
+    bool locked = false;
+
+    if (!function)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    if (!(job = (job_t*)oe_calloc(1, sizeof(job_t))))
+        OE_RAISE(OE_OUT_OF_MEMORY);
+
+    job->function = function;
+    job->arg = arg;
+
+    oe_mutex_lock(&_lock);
+    locked = true;
+
+    if (!_num_threads)
+        OE_RAISE_NO_TRACE(OE_UNSUPPORTED);
+
+    if (_stopping || _num_queued >= _num_free)
+        OE_RAISE_NO_TRACE(OE_OUT_OF_THREADS);
+
+    if (_tail)
+        _tail->next = job;
+    else
+        _head = job;
+    _tail = job;
+    __atomic_store_n(&_num_queued, _num_queued + 1, __ATOMIC_RELAXED);
+    job = NULL;
+
+    oe_cond_signal(&_cond);
+
+    result = OE_OK;
+
+done:
+    if (locked)
+        oe_mutex_unlock(&_lock);
+
+    oe_free(job);
+    return result;
+}
+
+oe_result_t oe_thread_pool_parallel_for(
+    size_t count,
+    void (*function)(size_t index, void* arg),
+    void* arg)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    loop_t loop = {0};
+
+    if (!function)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    if (count == 0)
+    {
+        result = OE_OK;
+        goto done;
+    }
+
+    oe_mutex_lock(&_lock);
+    loop.num_ranges = _num_threads + 1;
+    oe_mutex_unlock(&_lock);
+
+    if (!(loop.ranges = (padded_range_t*)oe_memalign(
+              CACHE_LINE_SIZE, loop.num_ranges * sizeof(padded_range_t))))
+        OE_RAISE(OE_OUT_OF_MEMORY);
+
+    memset(loop.ranges, 0, loop.num_ranges * sizeof(padded_range_t));
+    loop.function = function;
+    loop.arg = arg;
+    loop.grain = count / (loop.num_ranges * 8);
+    if (loop.grain == 0)
+        loop.grain = 1;
+
+    // The calling thread starts with all the indices.
+    loop.ranges[0].range.end = count;
+    loop.num_joined = 1;
+
+    if (loop.num_ranges > 1)
+    {
+        oe_mutex_lock(&_lock);
+        loop.next = _loops;
+        _loops = &loop;
+        oe_cond_broadcast(&_cond);
+        oe_mutex_unlock(&_lock);
+    }
+
+    _participate(&loop, 0);
+
+    if (loop.num_ranges > 1)
+    {
+        loop_t** p = &_loops;
+
+        oe_mutex_lock(&_lock);
+
+        while (*p != &loop)
+            p = &(*p)->next;
+        *p = loop.next;
+
+        while (loop.num_participants)
+            oe_cond_wait(&_done, &_lock);
+
+        oe_mutex_unlock(&_lock);
+
+        // Make the calls left behind by workers that ran queued functions.
+        _participate(&loop, 0);
+    }
+
+    result = OE_OK;
+
+done:
+    oe_memalign_free(loop.ranges);
+    return result;
+}
+
+size_t oe_thread_pool_get_num_threads(void)
+{
+    size_t num_threads;
+
+    oe_mutex_lock(&_lock);
+    num_threads = _num_threads;
+    oe_mutex_unlock(&_lock);
+
+    return num_threads;
+}
@@ -0,0 +1,190 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/enclave.h>
+#include <openenclave/internal/calls.h>
+#include <openenclave/internal/raise.h>
+#include <openenclave/internal/time.h>
+#include "rdtsc.h"
+
+/*
+**==============================================================================
+**
+** Clocks read from the time page of the host (see host/sgx/timepage.c).
+**
+**     The page is only trusted as much as the host is for the time: the
+**     enclave checks that the page is consistent, that the interpolation
+**     stays short, and that the monotonic clocks never go backwards. If a
+**     check fails, the enclave asks the host to update the page with an
+**     OCALL, which is also how the clocks are read when RDTSC is illegal in
+**     the enclave (SGX1) or the TSC of the host is not invariant.
+**
+**==============================================================================
+*/
+
+/* Longest interpolation from the last update of the page in nanoseconds */
+#define MAX_INTERPOLATION 1000000000
+
+/* Largest TSC period accepted, 256 nanoseconds in 32.32 fixed point */
+#define MAX_TSC_MULT (256ULL << 32)
+
+/* Number of attempts to read a consistent page before updating it */
+#define MAX_READ_ATTEMPTS 64
+
+static oe_time_page_t* _page;
+static bool _tsc_unusable;
+
+/* Latest times returned by the monotonic clocks */
+static uint64_t _last_monotonic;
+static uint64_t _last_monotonic_raw;
+
+static oe_result_t _update_page(oe_time_page_t** page_out)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    uint64_t arg_out = 0;
+    oe_time_page_t* page;
+
+    OE_CHECK(oe_ocall(OE_OCALL_GET_TIME_PAGE, 0, &arg_out));
+
+    page = (oe_time_page_t*)arg_out;
+    if (!page || (arg_out % 64) != 0 ||
+        !oe_is_outside_enclave(page, sizeof(oe_time_page_t)))
+        OE_RAISE(OE_UNEXPECTED);
+
+    __atomic_store_n(&_page, page, __ATOMIC_RELEASE);
+    *page_out = page;
+
+    result = OE_OK;
+
+done:
+    return result;
+}
+
+/* Copy the page unless the host is updating it */
+static bool _read_page(const oe_time_page_t* page, oe_time_page_t* copy)
+{
+    for (size_t i = 0; i < MAX_READ_ATTEMPTS; i++)
+    {
+        uint64_t sequence = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+
+        if ((sequence & 1) == 0)
+        {
+            *copy = *page;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+            if (__atomic_load_n(&page->sequence, __ATOMIC_RELAXED) == sequence)
+                return copy->magic == OE_TIME_PAGE_MAGIC;
+        }
+
+        asm volatile("pause");
+    }
+
+    return false;
+}
+
+/* Get the nanoseconds elapsed since the last update of the page */
+static bool _interpolate(const oe_time_page_t* page, uint64_t* elapsed)
+{
+    unsigned __int128 nanoseconds;
+    uint64_t tsc;
+
+    if (!page->tsc || !page->tsc_mult || page->tsc_mult > MAX_TSC_MULT ||
+        __atomic_load_n(&_tsc_unusable, __ATOMIC_RELAXED))
+        return false;
+
+    if (!(tsc = oe_rdtsc()))
+    {
+        __atomic_store_n(&_tsc_unusable, true, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    /* The page must not be from the future */
+    if (tsc < page->tsc)
+        return false;
+
+    nanoseconds =
+        ((unsigned __int128)(tsc - page->tsc) * page->tsc_mult) >> 32;
+    if (nanoseconds > MAX_INTERPOLATION)
+        return false;
+
+    *elapsed = (uint64_t)nanoseconds;
+    return true;
+}
+
+/* Return the later of the given time and the latest time returned */
+static uint64_t _make_monotonic(uint64_t* last, uint64_t time)
+{
+    uint64_t previous = __atomic_load_n(last, __ATOMIC_RELAXED);
+
+    while (time > previous)
+    {
+        if (__atomic_compare_exchange_n(
+                last,
+                &previous,
+                time,
+                true,
+                __ATOMIC_RELAXED,
+                __ATOMIC_RELAXED))
+            return time;
+    }
+
+    return previous;
+}
+
+oe_result_t oe_get_clock_time(int clock_id, uint64_t* nanoseconds)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_time_page_t* page = __atomic_load_n(&_page, __ATOMIC_ACQUIRE);
+    oe_time_page_t copy;
+    uint64_t elapsed = 0;
+
+    if (!nanoseconds)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    switch (clock_id)
+    {
+        case CLOCK_REALTIME:
+        case CLOCK_REALTIME_COARSE:
+        case CLOCK_MONOTONIC:
+        case CLOCK_MONOTONIC_COARSE:
+        case CLOCK_MONOTONIC_RAW:
+            break;
+        default:
+            OE_RAISE_NO_TRACE(OE_UNSUPPORTED);
+    }
+
+    /* The fast path reads the page without leaving the enclave */
+    if (!page || !_read_page(page, &copy) || !_interpolate(&copy, &elapsed))
+    {
+        OE_CHECK(_update_page(&page));
+
+        if (!_read_page(page, &copy))
+            OE_RAISE(OE_UNEXPECTED);
+
+        /* The page was just updated */
+        if (!_interpolate(&copy, &elapsed))
+            elapsed = 0;
+    }
+
+    switch (clock_id)
+    {
+        case CLOCK_REALTIME:
+        case CLOCK_REALTIME_COARSE:
+            *nanoseconds = copy.realtime + elapsed;
+            break;
+        case CLOCK_MONOTONIC:
+        case CLOCK_MONOTONIC_COARSE:
+            *nanoseconds =
+                _make_monotonic(&_last_monotonic, copy.monotonic + elapsed);
+            break;
+        default:
+            *nanoseconds = _make_monotonic(
+                &_last_monotonic_raw, copy.monotonic_raw + elapsed);
+            break;
+    }
+
+    result = OE_OK;
+
+done:
+    return result;
+}
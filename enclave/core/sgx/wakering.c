@@ -0,0 +1,81 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include "wakering.h"
+#include <openenclave/bits/sgx/writebarrier.h>
+#include <openenclave/enclave.h>
+#include <openenclave/internal/raise.h>
+#include <openenclave/internal/wakering.h>
+#include "handle_ecall.h"
+
+/* The ring set up by the host (see host/sgx/wakering.c), if any, and the
+ * number of its slots as read when it was set up */
+static oe_wake_ring_t* _ring;
+static uint64_t _num_slots;
+
+oe_result_t oe_handle_init_wake_ring(uint64_t arg_in)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_wake_ring_t* ring = (oe_wake_ring_t*)arg_in;
+    uint64_t num_slots;
+
+    if (__atomic_load_n(&_ring, __ATOMIC_ACQUIRE))
+        OE_RAISE(OE_ALREADY_INITIALIZED);
+
+    // Ensure that the header lies outside the enclave and is aligned like
+    // the structure.
+    if (!ring || (arg_in % 64) != 0 ||
+        !oe_is_outside_enclave(ring, sizeof(oe_wake_ring_t)))
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    // Read the number of slots once, as the host may change it.
+    num_slots = *(volatile uint64_t*)&ring->num_slots;
+    if (num_slots == 0 || num_slots > OE_WAKE_RING_MAX_SLOTS ||
+        (num_slots & (num_slots - 1)) != 0 ||
+        !oe_is_outside_enclave(ring, OE_WAKE_RING_SIZE(num_slots)))
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    _num_slots = num_slots;
+    __atomic_store_n(&_ring, ring, __ATOMIC_RELEASE);
+
+    result = OE_OK;
+
+done:
+    return result;
+}
+
+bool oe_post_wake(const void* tcs)
+{
+    oe_wake_ring_t* ring = __atomic_load_n(&_ring, __ATOMIC_ACQUIRE);
+    uint64_t ticket;
+    bool running;
+
+    if (!ring || ring->state != OE_WAKE_RING_RUNNING)
+        return false;
+
+    // Claim a ticket, unless the ring is full. The head comes from the host,
+    // which can only make the enclave fall back to OCALLs by lying about it.
+    ticket = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    do
+    {
+        if (ticket - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) >=
+            _num_slots)
+            return false;
+    } while (!__atomic_compare_exchange_n(
+        &ring->tail,
+        &ticket,
+        ticket + 1,
+        true,
+        __ATOMIC_SEQ_CST,
+        __ATOMIC_RELAXED));
+
+    // The helper checks the tail after it announces that it stops running
+    running = __atomic_load_n(&ring->state, __ATOMIC_SEQ_CST) ==
+              OE_WAKE_RING_RUNNING;
+
+    OE_WRITE_VALUE_WITH_BARRIER(
+        &ring->slots[ticket & (_num_slots - 1)],
+        running ? (uint64_t)tcs : OE_WAKE_RING_CANCELLED);
+
+    return running;
+}
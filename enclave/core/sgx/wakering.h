@@ -0,0 +1,15 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#ifndef _OE_WAKERING_ENCLAVE_H
+#define _OE_WAKERING_ENCLAVE_H
+
+#include <openenclave/bits/types.h>
+
+/* Ask the host to wake the thread of the given TCS through the wake ring.
+ * Return false if the request must be made with OE_OCALL_THREAD_WAKE
+ * instead, i.e. if there is no ring, it is full, or its helper thread is not
+ * running. */
+bool oe_post_wake(const void* tcs);
+
+#endif /* _OE_WAKERING_ENCLAVE_H */
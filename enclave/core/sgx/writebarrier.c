@@ -3,13 +3,28 @@
 
 #include <openenclave/corelibc/string.h>
 #include <openenclave/enclave.h>
+#include <openenclave/internal/cpuid.h>
 #include <openenclave/internal/raise.h>
+#include <openenclave/internal/sgx/writebarrier.h>
+#include "cpuid.h"
 
 #define ALIGNMENT_MINUS_ONE 7
 #define MEMSET_PATTERN_U64 0x0101010101010101
 #define MEMSET_PATTERN_U32 0x01010101
 #define MEMSET_PATTERN_U16 0x0101
 
+/* The vector paths store 32-byte-aligned blocks of 128 bytes, and are used
+ * for aligned bulks of at least VECTOR_THRESHOLD bytes */
+#define VECTOR_ALIGNMENT 32
+#define VECTOR_BLOCK_SIZE 128
+#define VECTOR_THRESHOLD 256
+
+/* The XCR0 bits of the SSE and AVX (YMM) states */
+#define XCR0_SSE_AVX_STATES 0x6
+
+static bool _avx2_supported;
+static bool _use_avx2;
+
 OE_ALWAYS_INLINE
 static void _memset_aligned(void* dest, int character, size_t count)
 {
@@ -21,6 +36,143 @@ static void _memset_aligned(void* dest, int character, size_t count)
         ((uint64_t*)dest)[i] = pattern;
 }
 
+/*
+**==============================================================================
+**
+** Vector bulk paths
+**
+**     The MMIO stale data mitigation concerns partial writes only: stores
+**     that are 8-byte aligned and whose sizes are multiples of 8 bytes do not
+**     need a barrier. So the 8-byte-aligned bulk of a write can use 32-byte
+**     aligned AVX2 stores. The bytes up to the first 32-byte boundary, and
+**     those after the last full block, are written with 8-byte stores.
+**
+**==============================================================================
+*/
+
+static void _memcpy_aligned_avx2(void* dest, const void* src, size_t count)
+{
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    size_t head = (size_t)(-(uint64_t)d & (VECTOR_ALIGNMENT - 1));
+    size_t bulk = 0;
+
+    /* head is a multiple of 8, since dest is 8-byte aligned */
+    oe_memcpy_aligned(d, s, head);
+    d += head;
+    s += head;
+    count -= head;
+
+    if ((bulk = count & ~(size_t)(VECTOR_BLOCK_SIZE - 1)))
+    {
+        count -= bulk;
+        asm volatile("1:\n\t"
+                     "vmovdqu (%1), %%ymm0\n\t"
+                     "vmovdqu 32(%1), %%ymm1\n\t"
+                     "vmovdqu 64(%1), %%ymm2\n\t"
+                     "vmovdqu 96(%1), %%ymm3\n\t"
+                     "vmovdqa %%ymm0, (%0)\n\t"
+                     "vmovdqa %%ymm1, 32(%0)\n\t"
+                     "vmovdqa %%ymm2, 64(%0)\n\t"
+                     "vmovdqa %%ymm3, 96(%0)\n\t"
+                     "add $128, %1\n\t"
+                     "add $128, %0\n\t"
+                     "sub $128, %2\n\t"
+                     "jnz 1b\n\t"
+                     "vzeroupper\n\t"
+                     : "+r"(d), "+r"(s), "+r"(bulk)
+                     :
+                     : "xmm0", "xmm1", "xmm2", "xmm3", "memory", "cc");
+    }
+
+    oe_memcpy_aligned(d, s, count);
+}
+
+static void _memset_aligned_avx2(void* dest, int character, size_t count)
+{
+    uint8_t* d = (uint8_t*)dest;
+    uint64_t pattern = MEMSET_PATTERN_U64 * (uint8_t)character;
+    size_t head = (size_t)(-(uint64_t)d & (VECTOR_ALIGNMENT - 1));
+    size_t bulk = 0;
+
+    /* head is a multiple of 8, since dest is 8-byte aligned */
+    _memset_aligned(d, character, head);
+    d += head;
+    count -= head;
+
+    if ((bulk = count & ~(size_t)(VECTOR_BLOCK_SIZE - 1)))
+    {
+        count -= bulk;
+        asm volatile("vmovq %2, %%xmm0\n\t"
+                     "vpbroadcastq %%xmm0, %%ymm0\n\t"
+                     "1:\n\t"
+                     "vmovdqa %%ymm0, (%0)\n\t"
+                     "vmovdqa %%ymm0, 32(%0)\n\t"
+                     "vmovdqa %%ymm0, 64(%0)\n\t"
+                     "vmovdqa %%ymm0, 96(%0)\n\t"
+                     "add $128, %0\n\t"
+                     "sub $128, %1\n\t"
+                     "jnz 1b\n\t"
+                     "vzeroupper\n\t"
+                     : "+r"(d), "+r"(bulk)
+                     : "r"(pattern)
+                     : "xmm0", "memory", "cc");
+    }
+
+    _memset_aligned(d, character, count);
+}
+
+/* Copy count bytes (a multiple of 8) to the 8-byte-aligned dest */
+OE_ALWAYS_INLINE
+static void _memcpy_bulk(void* dest, const void* src, size_t count)
+{
+    if (_use_avx2 && count >= VECTOR_THRESHOLD)
+        _memcpy_aligned_avx2(dest, src, count);
+    else
+        oe_memcpy_aligned(dest, src, count);
+}
+
+/* Fill count bytes (a multiple of 8) at the 8-byte-aligned dest */
+OE_ALWAYS_INLINE
+static void _memset_bulk(void* dest, int character, size_t count)
+{
+    if (_use_avx2 && count >= VECTOR_THRESHOLD)
+        _memset_aligned_avx2(dest, character, count);
+    else
+        _memset_aligned(dest, character, count);
+}
+
+void oe_initialize_write_barrier(void)
+{
+    uint64_t rax = 1, rbx = 0, rcx = 0, rdx = 0;
+    uint32_t xcr0 = 0, xcr0_high = 0;
+
+    /* AVX2 needs the AVX feature bits, and the AVX state enabled in the XFRM
+     * of the enclave (which is the XCR0 value in the enclave) */
+    if (oe_emulate_cpuid(&rax, &rbx, &rcx, &rdx) != 0 ||
+        !(rcx & OE_CPUID_OSXSAVE_FEATURE) || !(rcx & OE_CPUID_AVX_FEATURE))
+        return;
+
+    asm volatile("xgetbv" : "=a"(xcr0), "=d"(xcr0_high) : "c"(0));
+    if ((xcr0 & XCR0_SSE_AVX_STATES) != XCR0_SSE_AVX_STATES)
+        return;
+
+    rax = 7;
+    rcx = 0;
+    if (oe_emulate_cpuid(&rax, &rbx, &rcx, &rdx) != 0 ||
+        !(rbx & OE_CPUID_AVX2_FEATURE))
+        return;
+
+    _avx2_supported = true;
+    _use_avx2 = true;
+}
+
+bool oe_set_write_barrier_vector_enabled(bool enabled)
+{
+    _use_avx2 = enabled && _avx2_supported;
+    return _use_avx2;
+}
+
 OE_NEVER_INLINE
 static void* _memset_unaligned_with_barrier(
     void* dest,
@@ -33,10 +185,10 @@ static void* _memset_unaligned_with_barrier(
     {
         if (dest_addr % 8 == 0)
         {
-            /* for 8-byte-aligned memory, use regular memset with the size being
-             * the multiples of 8 */
+            /* for 8-byte-aligned memory, use the bulk memset with the size
+             * being the multiples of 8 */
             size_t count_aligned = count - count % 8;
-            _memset_aligned((void*)dest_addr, character, count_aligned);
+            _memset_bulk((void*)dest_addr, character, count_aligned);
             dest_addr += count_aligned;
             count -= count_aligned;
         }
@@ -113,7 +265,7 @@ void* oe_memset_with_barrier(void* dest, int value, size_t count)
      * Note that the hardened memset should not be inline, otherwise the
      * fence instructions in branches will slowdown the fallback path. */
     if (((uint64_t)dest % 8 == 0) && (count % 8 == 0))
-        _memset_aligned(dest, value, count);
+        _memset_bulk(dest, value, count);
     else
         _memset_unaligned_with_barrier(dest, value, count);
 
@@ -133,10 +285,10 @@ static void* _memcpy_unaligned_with_barrier(
     {
         if (dest_addr % 8 == 0)
         {
-            /* for 8-byte-aligned memory, use regular memcpy with the size being
-             * the multiples of 8 */
+            /* for 8-byte-aligned memory, use the bulk memcpy with the size
+             * being the multiples of 8 */
             size_t count_aligned = count - count % 8;
-            oe_memcpy_aligned(
+            _memcpy_bulk(
                 (void*)dest_addr, (const void*)src_addr, count_aligned);
             src_addr += count_aligned;
             dest_addr += count_aligned;
@@ -217,7 +369,7 @@ void* oe_memcpy_with_barrier(void* dest, const void* src, size_t count)
      * Note that the hardened memcpy should not be inline, otherwise the
      * fence instructions in branches will slowdown the fallback path. */
     if (((uint64_t)dest % 8 == 0) && (count % 8 == 0))
-        oe_memcpy_aligned(dest, src, count);
+        _memcpy_bulk(dest, src, count);
     else
         _memcpy_unaligned_with_barrier(dest, src, count);
 
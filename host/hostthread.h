@@ -79,6 +79,20 @@ int oe_thread_create(oe_thread_t* thread, void* (*func)(void*), void* arg);
  */
 int oe_thread_join(oe_thread_t thread);
 
+/**
+ * Restrict a platform-specific thread to the given logical CPUs.
+ *
+ * @param thread The thread created by oe_thread_create().
+ * @param cpus The array of logical CPU numbers.
+ * @param num_cpus The number of elements in **cpus**.
+ *
+ * @returns Returns zero on success.
+ */
+int oe_thread_set_affinity(
+    oe_thread_t thread,
+    const uint32_t* cpus,
+    size_t num_cpus);
+
 /**
  * Returns the identifier of the current thread.
  *
@@ -243,6 +257,46 @@ int oe_thread_setspecific(oe_thread_key key, void* value);
  */
 void* oe_thread_getspecific(oe_thread_key key);
 
+/**
+ * The timeout of oe_wait_on_address() that never expires.
+ */
+#define OE_H_WAIT_INFINITE OE_UINT64_MAX
+
+/**
+ * Waits on an address while it holds the given value.
+ *
+ * This function blocks the calling thread until another thread calls
+ * oe_wake_by_address() on the same address, or the timeout expires. It
+ * returns right away if **address** no longer holds **value**. It uses a
+ * futex on Linux and WaitOnAddress() on Windows, and may also return
+ * spuriously, so callers check the value again in a loop.
+ *
+ * @param address The address to wait on.
+ * @param value The value that the address holds while the caller waits.
+ * @param timeout The timeout in nanoseconds, or OE_H_WAIT_INFINITE.
+ */
+void oe_wait_on_address(
+    volatile uint32_t* address,
+    uint32_t value,
+    uint64_t timeout);
+
+/**
+ * Wakes one thread that waits on an address.
+ *
+ * This function wakes one of the threads blocked in oe_wait_on_address() on
+ * the same address, if any. The caller changes the value first.
+ *
+ * @param address The address that the threads wait on.
+ */
+void oe_wake_by_address(volatile uint32_t* address);
+
+/**
+ * Gets the value of a monotonic clock.
+ *
+ * @returns Returns the time in nanoseconds since an unspecified point.
+ */
+uint64_t oe_get_monotonic_time(void);
+
 OE_EXTERNC_END
 
 #endif /* _HOSTTHREAD_H */
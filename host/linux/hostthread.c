@@ -3,8 +3,14 @@
 
 #include "../hostthread.h"
 #include <assert.h>
+#include <errno.h>
+#include <linux/futex.h>
 #include <openenclave/host.h>
 #include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
 
 /*
 **==============================================================================
@@ -23,6 +29,27 @@ int oe_thread_join(oe_thread_t thread)
     return pthread_join((pthread_t)thread, NULL);
 }
 
+int oe_thread_set_affinity(
+    oe_thread_t thread,
+    const uint32_t* cpus,
+    size_t num_cpus)
+{
+    cpu_set_t set;
+
+    if (!cpus || num_cpus == 0)
+        return EINVAL;
+
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < num_cpus; i++)
+    {
+        if (cpus[i] >= CPU_SETSIZE)
+            return EINVAL;
+        CPU_SET(cpus[i], &set);
+    }
+
+    return pthread_setaffinity_np((pthread_t)thread, sizeof(set), &set);
+}
+
 oe_thread_t oe_thread_self(void)
 {
     return (oe_thread_t)pthread_self();
@@ -109,3 +136,53 @@ void* oe_thread_getspecific(oe_thread_key key)
 {
     return pthread_getspecific(key);
 }
+
+/*
+**==============================================================================
+**
+** oe_wait_on_address
+**
+**==============================================================================
+*/
+
+void oe_wait_on_address(
+    volatile uint32_t* address,
+    uint32_t value,
+    uint64_t timeout)
+{
+    struct timespec ts = {
+        (time_t)(timeout / 1000000000), (long)(timeout % 1000000000)};
+
+    // Errors are ignored, as the callers check the value again.
+    syscall(
+        __NR_futex,
+        address,
+        FUTEX_WAIT_PRIVATE,
+        value,
+        timeout == OE_H_WAIT_INFINITE ? NULL : &ts,
+        NULL,
+        0);
+}
+
+void oe_wake_by_address(volatile uint32_t* address)
+{
+    syscall(__NR_futex, address, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/*
+**==============================================================================
+**
+** oe_get_monotonic_time
+**
+**==============================================================================
+*/
+
+uint64_t oe_get_monotonic_time(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+        return 0;
+
+    return (uint64_t)ts.tv_sec * 1000000000UL + (uint64_t)ts.tv_nsec;
+}
@@ -20,6 +20,7 @@
 
 #include <openenclave/bits/sgx/sgxtypes.h>
 #include <openenclave/host.h>
+#include <openenclave/internal/atomic.h>
 #include <openenclave/internal/calls.h>
 #include <openenclave/internal/debugrt/host.h>
 #include <openenclave/internal/raise.h>
@@ -35,6 +36,7 @@
 #include "asmdefs.h"
 #include "enclave.h"
 #include "ocalls/ocalls.h"
+#include "wakering.h"
 
 /*
 **==============================================================================
@@ -282,6 +284,55 @@ done:
     return result;
 }
 
+/*
+**==============================================================================
+**
+** oe_handle_call_host_function_batch()
+**
+** Handle a batch of calls from the enclave made with a single OCALL.
+**
+**==============================================================================
+*/
+
+oe_result_t oe_handle_call_host_function_batch(
+    uint64_t arg,
+    oe_enclave_t* enclave)
+{
+    oe_call_host_function_batch_args_t* batch_ptr = NULL;
+    oe_result_t result = OE_OK;
+
+    batch_ptr = (oe_call_host_function_batch_args_t*)arg;
+    if (batch_ptr == NULL || batch_ptr->calls == NULL)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    for (uint64_t i = 0; i < batch_ptr->num_calls; i++)
+    {
+        oe_call_host_function_args_t* args_ptr = &batch_ptr->calls[i];
+        oe_result_t call_result =
+            oe_handle_call_host_function((uint64_t)args_ptr, enclave);
+
+        // A call fails if it could not be dispatched, or if its marshaling
+        // struct reports an error.
+        if (call_result != OE_OK)
+            args_ptr->result = call_result;
+        else
+            call_result =
+                ((oe_call_function_return_args_t*)args_ptr->output_buffer)
+                    ->result;
+
+        batch_ptr->num_calls_completed = i + 1;
+
+        if (call_result != OE_OK &&
+            (batch_ptr->flags & OE_HOST_FUNCTION_BATCH_STOP_ON_FAILURE))
+            break;
+    }
+
+    result = OE_OK;
+done:
+
+    return result;
+}
+
 static const char* oe_ocall_str(oe_func_t ocall)
 {
     // clang-format off
@@ -292,7 +343,9 @@ static const char* oe_ocall_str(oe_func_t ocall)
         "THREAD_WAIT",
         "MALLOC",
         "FREE",
-        "GET_TIME"
+        "GET_TIME",
+        "CALL_HOST_FUNCTION_BATCH",
+        "GET_TIME_PAGE"
     };
     // clang-format on
 
@@ -313,7 +366,13 @@ static const char* oe_ecall_str(oe_func_t ecall)
         "INIT_ENCLAVE",
         "CALL_ENCLAVE_FUNCTION",
         "VIRTUAL_EXCEPTION_HANDLER",
-        "CALL_AT_EXIT_FUNCTIONS"
+        "CALL_AT_EXIT_FUNCTIONS",
+        "CALL_ENCLAVE_FUNCTION_BATCH",
+        "GET_STACK_USAGE",
+        "INIT_WAKE_RING",
+        "INIT_THREAD_POOL",
+        "THREAD_POOL_WORKER",
+        "STOP_THREAD_POOL"
     };
     // clang-format on
 
@@ -355,7 +414,10 @@ static oe_result_t _handle_ocall(
         "%s 0x%x %s: %s\n",
         enclave->path,
         enclave->start_address,
-        func == OE_OCALL_CALL_HOST_FUNCTION ? "EDL_OCALL" : "OE_OCALL",
+        (func == OE_OCALL_CALL_HOST_FUNCTION ||
+         func == OE_OCALL_CALL_HOST_FUNCTION_BATCH)
+            ? "EDL_OCALL"
+            : "OE_OCALL",
         oe_ocall_str(func));
 
     switch ((oe_func_t)func)
@@ -364,6 +426,10 @@ static oe_result_t _handle_ocall(
             OE_CHECK(oe_handle_call_host_function(arg_in, enclave));
             break;
 
+        case OE_OCALL_CALL_HOST_FUNCTION_BATCH:
+            OE_CHECK(oe_handle_call_host_function_batch(arg_in, enclave));
+            break;
+
         case OE_OCALL_MALLOC:
             HandleMalloc(arg_in, arg_out);
             break;
@@ -384,6 +450,10 @@ static oe_result_t _handle_ocall(
             oe_handle_get_time(arg_in, arg_out);
             break;
 
+        case OE_OCALL_GET_TIME_PAGE:
+            oe_handle_get_time_page(arg_in, arg_out);
+            break;
+
         default:
         {
             /* No function found with the number */
@@ -442,6 +512,15 @@ int __oe_dispatch_ocall(
         oe_thread_binding_t* binding = oe_get_thread_binding();
         uint64_t arg_out = 0;
 
+        if (binding && binding->tcs == (uint64_t)tcs)
+        {
+            binding->num_ocalls++;
+
+            if (func == OE_OCALL_CALL_HOST_FUNCTION && arg)
+                oe_record_ocall_buffer_use(
+                    binding, (const oe_call_host_function_args_t*)arg);
+        }
+
         oe_result_t result = _handle_ocall(enclave, tcs, func, arg, &arg_out);
         *arg1_out = oe_make_call_arg1(OE_CODE_ORET, func, 0, result);
         *arg2_out = arg_out;
@@ -455,6 +534,199 @@ int __oe_dispatch_ocall(
     return 1;
 }
 
+/*
+**==============================================================================
+**
+** _pop_free_binding()
+** _push_free_binding()
+**
+**     Take a binding from, and return a binding to, the lock-free stack of
+**     free bindings. Every update bumps the tag in the high 32 bits of the
+**     stack head, so that a binding that is taken and returned between the
+**     read of the head and the compare-and-swap cannot corrupt the stack.
+**
+**==============================================================================
+*/
+
+static oe_thread_binding_t* _pop_free_binding(oe_enclave_t* enclave)
+{
+    oe_thread_binding_t* binding = NULL;
+    uint64_t head;
+    uint64_t new_head;
+
+    do
+    {
+        head = oe_atomic_load((volatile uint64_t*)&enclave->free_bindings);
+        if ((uint32_t)head == 0)
+            return NULL;
+
+        binding = &enclave->bindings[(uint32_t)head - 1];
+        new_head = ((head >> 32) + 1) << 32 | binding->next_free;
+    } while (!oe_atomic_compare_and_swap(
+        &enclave->free_bindings, (int64_t)head, (int64_t)new_head));
+
+    return binding;
+}
+
+static void _push_free_binding(
+    oe_enclave_t* enclave,
+    oe_thread_binding_t* binding)
+{
+    uint64_t index = (uint64_t)(binding - enclave->bindings) + 1;
+    uint64_t head;
+    uint64_t new_head;
+
+    do
+    {
+        head = oe_atomic_load((volatile uint64_t*)&enclave->free_bindings);
+        binding->next_free = (uint32_t)head;
+        new_head = ((head >> 32) + 1) << 32 | index;
+    } while (!oe_atomic_compare_and_swap(
+        &enclave->free_bindings, (int64_t)head, (int64_t)new_head));
+}
+
+/*
+**==============================================================================
+**
+** TCS admission
+**
+**     When the enclave is created with oe_enclave_setting_tcs_admission_t, an
+**     ecall that finds every TCS busy queues up instead of failing. Releasing
+**     threads put their binding back on the free stack and then hand free
+**     bindings to the oldest waiters. New ecalls also queue up while anyone
+**     is waiting, so that bindings go to waiters in arrival order.
+**
+**==============================================================================
+*/
+
+typedef struct _oe_tcs_waiter
+{
+    struct _oe_tcs_waiter* next;
+
+    /* The binding handed to the waiter */
+    oe_thread_binding_t* binding;
+
+    /* Set to 1 once the binding has been handed over */
+    volatile uint32_t granted;
+} oe_tcs_waiter_t;
+
+/* Wait until the waiter is granted a binding or the deadline (in ns, 0 for
+ * none) passes. Returns true if the binding was granted. */
+static bool _wait_for_tcs_grant(oe_tcs_waiter_t* waiter, uint64_t deadline)
+{
+    while (!waiter->granted)
+    {
+        uint64_t timeout = OE_H_WAIT_INFINITE;
+
+        if (deadline)
+        {
+            uint64_t now = oe_get_monotonic_time();
+            if (now >= deadline)
+                return false;
+
+            timeout = deadline - now;
+        }
+
+        oe_wait_on_address(&waiter->granted, 0, timeout);
+    }
+
+    OE_ATOMIC_MEMORY_BARRIER_ACQUIRE();
+    return true;
+}
+
+static void _grant_tcs(oe_tcs_waiter_t* waiter, oe_thread_binding_t* binding)
+{
+    waiter->binding = binding;
+    OE_ATOMIC_MEMORY_BARRIER_RELEASE();
+    waiter->granted = 1;
+    oe_wake_by_address(&waiter->granted);
+}
+
+/* Hand free bindings to the oldest waiters. Called with admission_lock held.
+ */
+static void _admit_tcs_waiters(oe_enclave_t* enclave)
+{
+    while (enclave->tcs_waiters_head)
+    {
+        oe_tcs_waiter_t* waiter = enclave->tcs_waiters_head;
+        oe_thread_binding_t* binding = _pop_free_binding(enclave);
+
+        if (!binding)
+            break;
+
+        enclave->tcs_waiters_head = waiter->next;
+        if (!enclave->tcs_waiters_head)
+            enclave->tcs_waiters_tail = NULL;
+        oe_atomic_decrement(&enclave->num_tcs_waiters);
+
+        _grant_tcs(waiter, binding);
+    }
+}
+
+/* Queue up for a binding. Returns NULL if the wait timed out. */
+static oe_thread_binding_t* _wait_for_free_binding(oe_enclave_t* enclave)
+{
+    oe_tcs_waiter_t waiter = {0};
+    uint64_t start_time = oe_get_monotonic_time();
+    uint64_t deadline = 0;
+    uint64_t depth = 0;
+    bool granted = false;
+
+    if (enclave->tcs_wait_timeout_ms)
+        deadline = start_time + enclave->tcs_wait_timeout_ms * 1000000ULL;
+
+    oe_mutex_lock(&enclave->admission_lock);
+    {
+        if (enclave->tcs_waiters_tail)
+            enclave->tcs_waiters_tail->next = &waiter;
+        else
+            enclave->tcs_waiters_head = &waiter;
+        enclave->tcs_waiters_tail = &waiter;
+
+        // Announce the waiter before looking at the free stack again. A
+        // releasing thread pushes its binding before checking for waiters, so
+        // either this thread sees the binding or that thread sees the waiter.
+        depth = oe_atomic_increment(&enclave->num_tcs_waiters);
+        if (depth > enclave->max_tcs_queue_depth)
+            enclave->max_tcs_queue_depth = depth;
+
+        _admit_tcs_waiters(enclave);
+    }
+    oe_mutex_unlock(&enclave->admission_lock);
+
+    granted = _wait_for_tcs_grant(&waiter, deadline);
+
+    oe_mutex_lock(&enclave->admission_lock);
+    {
+        // The binding may have been granted while the wait timed out.
+        if (!granted && !waiter.granted)
+        {
+            oe_tcs_waiter_t** link = &enclave->tcs_waiters_head;
+            oe_tcs_waiter_t* previous = NULL;
+
+            while (*link != &waiter)
+            {
+                previous = *link;
+                link = &(*link)->next;
+            }
+
+            *link = waiter.next;
+            if (enclave->tcs_waiters_tail == &waiter)
+                enclave->tcs_waiters_tail = previous;
+            oe_atomic_decrement(&enclave->num_tcs_waiters);
+
+            enclave->num_tcs_wait_timeouts++;
+        }
+
+        enclave->num_tcs_waits++;
+        enclave->tcs_wait_time += oe_get_monotonic_time() - start_time;
+    }
+    oe_mutex_unlock(&enclave->admission_lock);
+
+    OE_ATOMIC_MEMORY_BARRIER_ACQUIRE();
+    return waiter.granted ? waiter.binding : NULL;
+}
+
 /*
 **==============================================================================
 **
@@ -476,61 +748,55 @@ int __oe_dispatch_ocall(
 
 static void* _assign_tcs(oe_enclave_t* enclave)
 {
-    void* tcs = NULL;
-    size_t i;
-    oe_thread_t thread = oe_thread_self();
+    oe_thread_binding_t* current = oe_get_thread_binding();
+    oe_thread_binding_t* binding = current;
 
-    oe_mutex_lock(&enclave->lock);
+    /* First attempt to find a binding of this thread to the enclave */
+    while (binding && binding->enclave != enclave)
+        binding = binding->outer;
+
+    if (binding)
     {
-        /* First attempt to find a busy oe_sgx_td_t owned by this thread */
-        for (i = 0; i < enclave->num_bindings; i++)
-        {
-            oe_thread_binding_t* binding = &enclave->bindings[i];
+        binding->count++;
+    }
+    else
+    {
+        /* Else take an available binding, waiting for one if so configured.
+         * Ecalls that arrive while others wait go to the back of the queue.
+         */
+        if (!enclave->wait_for_tcs)
+            binding = _pop_free_binding(enclave);
+        else if (oe_atomic_load(&enclave->num_tcs_waiters) == 0)
+            binding = _pop_free_binding(enclave);
+
+        if (!binding && enclave->wait_for_tcs)
+            binding = _wait_for_free_binding(enclave);
+
+        if (!binding)
+            return NULL;
+
+        binding->flags |= _OE_THREAD_BUSY;
+        binding->thread = oe_thread_self();
+        binding->count = 1;
+        binding->outer = current;
+    }
 
-            if ((binding->flags & _OE_THREAD_BUSY) && binding->thread == thread)
-            {
-                binding->count++;
-                tcs = (void*)binding->tcs;
-
-                /* Notify the debugger runtime */
-                if (enclave->debug && enclave->debug_enclave != NULL)
-                    oe_debug_push_thread_binding(
-                        enclave->debug_enclave, (sgx_tcs_t*)tcs);
-                break;
-            }
-        }
+    binding->num_ecalls++;
 
-        /* If binding not found above, look for an available ThreadBinding */
-        if (!tcs)
-        {
-            for (i = 0; i < enclave->num_bindings; i++)
-            {
-                oe_thread_binding_t* binding = &enclave->bindings[i];
-
-                if (!(binding->flags & _OE_THREAD_BUSY))
-                {
-                    binding->flags |= _OE_THREAD_BUSY;
-                    binding->thread = thread;
-                    binding->count = 1;
-
-                    tcs = (void*)binding->tcs;
-
-                    /* Set into TSD so asynchronous exceptions can get it */
-                    _set_thread_binding(binding);
-                    assert(oe_get_thread_binding() == binding);
-
-                    /* Notify the debugger runtime */
-                    if (enclave->debug && enclave->debug_enclave != NULL)
-                        oe_debug_push_thread_binding(
-                            enclave->debug_enclave, (sgx_tcs_t*)tcs);
-                    break;
-                }
-            }
-        }
+    /* Set into TSD so asynchronous exceptions can get it. The binding that
+     * was current is restored when the enclosing ocall returns. */
+    if (binding != current)
+    {
+        _set_thread_binding(binding);
+        assert(oe_get_thread_binding() == binding);
     }
-    oe_mutex_unlock(&enclave->lock);
 
-    return tcs;
+    /* Notify the debugger runtime */
+    if (enclave->debug && enclave->debug_enclave != NULL)
+        oe_debug_push_thread_binding(
+            enclave->debug_enclave, (sgx_tcs_t*)binding->tcs);
+
+    return (void*)binding->tcs;
 }
 
 /*
@@ -546,36 +812,39 @@ static void* _assign_tcs(oe_enclave_t* enclave)
 
 static void _release_tcs(oe_enclave_t* enclave, void* tcs)
 {
-    size_t i;
+    oe_thread_binding_t* binding = oe_get_tcs_binding(enclave, (uint64_t)tcs);
 
-    oe_mutex_lock(&enclave->lock);
+    if (!binding || !(binding->flags & _OE_THREAD_BUSY))
+        return;
+
+    binding->count--;
+
+    /* Notify the debugger runtime */
+    if (enclave->debug && enclave->debug_enclave != NULL)
+        oe_debug_pop_thread_binding();
+
+    if (binding->count == 0)
     {
-        for (i = 0; i < enclave->num_bindings; i++)
-        {
-            oe_thread_binding_t* binding = &enclave->bindings[i];
+        oe_thread_binding_t* outer = binding->outer;
 
-            if ((binding->flags & _OE_THREAD_BUSY) &&
-                (void*)binding->tcs == tcs)
-            {
-                binding->count--;
-
-                /* Notify the debugger runtime */
-                if (enclave->debug && enclave->debug_enclave != NULL)
-                    oe_debug_pop_thread_binding();
-
-                if (binding->count == 0)
-                {
-                    binding->flags &= (~_OE_THREAD_BUSY);
-                    binding->thread = 0;
-                    memset(&binding->event, 0, sizeof(binding->event));
-                    _set_thread_binding(NULL);
-                    assert(oe_get_thread_binding() == NULL);
-                }
-                break;
-            }
+        binding->flags &= (~_OE_THREAD_BUSY);
+        binding->thread = 0;
+        binding->outer = NULL;
+        memset(&binding->event, 0, sizeof(binding->event));
+        _set_thread_binding(outer);
+        assert(oe_get_thread_binding() == outer);
+
+        /* Hand the binding to the next thread */
+        _push_free_binding(enclave, binding);
+
+        if (enclave->wait_for_tcs &&
+            oe_atomic_load(&enclave->num_tcs_waiters) != 0)
+        {
+            oe_mutex_lock(&enclave->admission_lock);
+            _admit_tcs_waiters(enclave);
+            oe_mutex_unlock(&enclave->admission_lock);
         }
     }
-    oe_mutex_unlock(&enclave->lock);
 }
 
 /*
@@ -615,7 +884,10 @@ oe_result_t oe_ecall(
         "%s 0x%x %s: %s\n",
         enclave->path,
         enclave->start_address,
-        func == OE_ECALL_CALL_ENCLAVE_FUNCTION ? "EDL_ECALL" : "OE_ECALL",
+        (func == OE_ECALL_CALL_ENCLAVE_FUNCTION ||
+         func == OE_ECALL_CALL_ENCLAVE_FUNCTION_BATCH)
+            ? "EDL_ECALL"
+            : "OE_ECALL",
         oe_ecall_str(func));
 
     /* Perform ECALL or ORET */
@@ -652,3 +924,118 @@ done:
 
     return result;
 }
+
+/*
+**==============================================================================
+**
+** oe_get_enclave_call_statistics()
+**
+**     Sum the call counters of the thread bindings, of the switchless
+**     manager and of the wake ring.
+**
+**==============================================================================
+*/
+
+oe_result_t oe_get_enclave_call_statistics(
+    oe_enclave_t* enclave,
+    oe_enclave_call_statistics_t* statistics)
+{
+    oe_result_t result = OE_UNEXPECTED;
+
+    if (statistics)
+        memset(statistics, 0, sizeof(*statistics));
+
+    if (!enclave || enclave->magic != ENCLAVE_MAGIC || !statistics)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    for (size_t i = 0; i < enclave->num_bindings; i++)
+    {
+        const oe_thread_binding_t* binding = &enclave->bindings[i];
+
+        statistics->num_ecalls += binding->num_ecalls;
+        statistics->num_ocalls += binding->num_ocalls;
+        statistics->num_ocall_buffer_misses +=
+            binding->num_ocall_buffer_misses;
+
+        if (binding->ocall_buffer_size > statistics->max_ocall_buffer_size)
+            statistics->max_ocall_buffer_size = binding->ocall_buffer_size;
+    }
+
+    if (enclave->wait_for_tcs)
+    {
+        oe_mutex_lock(&enclave->admission_lock);
+        statistics->num_tcs_waits = enclave->num_tcs_waits;
+        statistics->num_tcs_wait_timeouts = enclave->num_tcs_wait_timeouts;
+        statistics->tcs_wait_time = enclave->tcs_wait_time;
+        statistics->tcs_queue_depth =
+            oe_atomic_load(&enclave->num_tcs_waiters);
+        statistics->max_tcs_queue_depth = enclave->max_tcs_queue_depth;
+        oe_mutex_unlock(&enclave->admission_lock);
+    }
+
+    statistics->num_ring_wakes = oe_get_num_ring_wakes(enclave);
+
+    OE_CHECK(oe_get_switchless_call_statistics(enclave, statistics));
+
+    result = OE_OK;
+
+done:
+    return result;
+}
+
+void oe_free_enclave_call_statistics(oe_enclave_call_statistics_t* statistics)
+{
+    if (statistics)
+    {
+        free(statistics->host_workers);
+        free(statistics->enclave_workers);
+        statistics->host_workers = NULL;
+        statistics->enclave_workers = NULL;
+        statistics->num_host_workers = 0;
+        statistics->num_enclave_workers = 0;
+    }
+}
+
+/*
+**==============================================================================
+**
+** oe_get_enclave_stack_usage()
+**
+**     Ask the enclave to scan the stack of each thread for the fill pattern.
+**
+**==============================================================================
+*/
+
+oe_result_t oe_get_enclave_stack_usage(
+    oe_enclave_t* enclave,
+    uint64_t* stack_usage,
+    size_t* num_threads,
+    size_t* stack_size)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_get_stack_usage_args_t args = {0};
+    uint64_t arg_out = 0;
+
+    if (!enclave || enclave->magic != ENCLAVE_MAGIC || !num_threads ||
+        (*num_threads && !stack_usage))
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    args.stack_usage = stack_usage;
+    args.num_threads = *num_threads;
+
+    OE_CHECK(oe_ecall(
+        enclave, OE_ECALL_GET_STACK_USAGE, (uint64_t)&args, &arg_out));
+
+    /* The enclave reports its number of threads even if the buffer is too
+     * small */
+    result = (oe_result_t)arg_out;
+    if (result != OE_OK && result != OE_BUFFER_TOO_SMALL)
+        OE_RAISE(result);
+
+    *num_threads = args.num_threads;
+    if (stack_size)
+        *stack_size = args.stack_size;
+
+done:
+    return result;
+}
@@ -62,7 +62,9 @@ static char* get_fullpath(const char* path)
 #include "exception.h"
 #include "platform_u.h"
 #include "sgxload.h"
+#include "threadpool.h"
 #include "vdso.h"
+#include "wakering.h"
 #include "xstate.h"
 
 static volatile oe_load_extra_enclave_data_hook_t
@@ -596,14 +598,61 @@ static oe_result_t _configure_enclave(
             // Configure the switchless ocalls, such as the number of workers.
             case OE_ENCLAVE_SETTING_CONTEXT_SWITCHLESS:
             {
-                size_t max_host_workers =
-                    settings[i].u.context_switchless_setting->max_host_workers;
-                size_t max_enclave_workers =
-                    settings[i]
-                        .u.context_switchless_setting->max_enclave_workers;
-
                 OE_CHECK(oe_start_switchless_manager(
-                    enclave, max_host_workers, max_enclave_workers));
+                    enclave, settings[i].u.context_switchless_setting));
+                break;
+            }
+            // Let ecalls wait for a TCS instead of failing when all are busy.
+            case OE_ENCLAVE_SETTING_TCS_ADMISSION:
+            {
+                const oe_enclave_setting_tcs_admission_t* setting =
+                    settings[i].u.tcs_admission_setting;
+
+                if (!setting)
+                    OE_RAISE(OE_INVALID_PARAMETER);
+
+                if (setting->wait_for_tcs && !enclave->wait_for_tcs)
+                {
+                    if (oe_mutex_init(&enclave->admission_lock))
+                        OE_RAISE(OE_FAILURE);
+
+                    enclave->wait_for_tcs = true;
+                }
+
+                enclave->tcs_wait_timeout_ms = setting->timeout_ms;
+                break;
+            }
+            // Size the ocall buffers of the enclave threads.
+            case OE_ENCLAVE_SETTING_OCALL_BUFFER:
+            {
+                const oe_enclave_setting_ocall_buffer_t* setting =
+                    settings[i].u.ocall_buffer_setting;
+
+                if (!setting ||
+                    setting->initial_size > OE_MAX_OCALL_BUFFER_SIZE ||
+                    setting->max_size > OE_MAX_OCALL_BUFFER_SIZE ||
+                    (setting->max_size &&
+                     setting->max_size < setting->initial_size))
+                    OE_RAISE(OE_INVALID_PARAMETER);
+
+                enclave->ocall_buffer_initial_size = oe_round_up_to_multiple(
+                    setting->initial_size, OE_PAGE_SIZE);
+                enclave->ocall_buffer_max_size = oe_round_up_to_multiple(
+                    setting->max_size, OE_PAGE_SIZE);
+                break;
+            }
+            // Wake enclave threads through a ring polled by a host thread.
+            case OE_ENCLAVE_SETTING_WAKE_RING:
+            {
+                OE_CHECK(oe_start_wake_ring(
+                    enclave, settings[i].u.wake_ring_setting));
+                break;
+            }
+            // Start the threads that the enclave runs its own threads on.
+            case OE_ENCLAVE_SETTING_THREAD_POOL:
+            {
+                OE_CHECK(oe_start_thread_pool(
+                    enclave, settings[i].u.thread_pool_setting));
                 break;
             }
             case OE_SGX_ENCLAVE_CONFIG_DATA:
@@ -1346,6 +1395,9 @@ oe_result_t oe_create_enclave(
     /* Build the enclave */
     OE_CHECK(oe_sgx_build_enclave(&context, enclave_path, NULL, enclave));
 
+    /* Every TCS has been added. Make the bindings available to ecalls. */
+    oe_init_thread_bindings(enclave);
+
     /* Push the new created enclave to the global list. */
     if (oe_push_enclave_instance(enclave) != 0)
     {
@@ -1423,6 +1475,8 @@ done:
 
     if (result != OE_OK && enclave)
     {
+        oe_stop_thread_pool(enclave);
+        oe_stop_wake_ring(enclave);
         free(enclave);
     }
 
@@ -1431,6 +1485,51 @@ done:
     return result;
 }
 
+/* Log the stack high watermark of each enclave thread, from which the
+ * NumStackPages setting of the enclave can be tuned */
+static void _log_stack_usage(oe_enclave_t* enclave)
+{
+    uint64_t* stack_usage = NULL;
+    size_t num_threads = enclave->num_bindings;
+    size_t stack_size = 0;
+    uint64_t max_usage = 0;
+
+    if (!enclave->debug || oe_get_current_logging_level() < OE_LOG_LEVEL_INFO)
+        return;
+
+    if (!(stack_usage = calloc(num_threads, sizeof(uint64_t))))
+        return;
+
+    if (oe_get_enclave_stack_usage(
+            enclave, stack_usage, &num_threads, &stack_size) != OE_OK)
+        goto done;
+
+    for (size_t i = 0; i < num_threads; i++)
+    {
+        oe_log(
+            OE_LOG_LEVEL_INFO,
+            "%s: stack usage of thread %zu: %llu of %zu bytes\n",
+            enclave->path,
+            i,
+            (unsigned long long)stack_usage[i],
+            stack_size);
+
+        if (stack_usage[i] > max_usage)
+            max_usage = stack_usage[i];
+    }
+
+    oe_log(
+        OE_LOG_LEVEL_INFO,
+        "%s: deepest stack usage: %llu bytes (%llu of %zu stack pages)\n",
+        enclave->path,
+        (unsigned long long)max_usage,
+        (unsigned long long)oe_round_up_to_page_size(max_usage) / OE_PAGE_SIZE,
+        stack_size / OE_PAGE_SIZE);
+
+done:
+    free(stack_usage);
+}
+
 oe_result_t oe_terminate_enclave(oe_enclave_t* enclave)
 {
     oe_result_t result = OE_UNEXPECTED;
@@ -1453,12 +1552,21 @@ oe_result_t oe_terminate_enclave(oe_enclave_t* enclave)
     else if (result != OE_OK)
         OE_RAISE(result);
 
+    /* Stop the thread pool after calling exit functions, which may still
+     * create and join threads */
+    OE_CHECK(oe_stop_thread_pool(enclave));
+
     /* Shut down the switchless manager after calling exit functions, which
      * allows the exit functions to use switchless OCALLs and ECALLs (nested) */
     OE_CHECK(oe_stop_switchless_manager(enclave));
 
-    /* Call the enclave destructor */
-    OE_CHECK(oe_ecall(enclave, OE_ECALL_DESTRUCTOR, 0, NULL));
+    _log_stack_usage(enclave);
+
+    /* Call the enclave destructor, which may still wake threads through the
+     * wake ring */
+    result = oe_ecall(enclave, OE_ECALL_DESTRUCTOR, 0, NULL);
+    oe_stop_wake_ring(enclave);
+    OE_CHECK(result);
 
     if (enclave->debug_enclave)
     {
@@ -1513,6 +1621,9 @@ oe_result_t oe_terminate_enclave(oe_enclave_t* enclave)
     oe_mutex_unlock(&enclave->lock);
     oe_mutex_destroy(&enclave->lock);
 
+    if (enclave->wait_for_tcs)
+        oe_mutex_destroy(&enclave->admission_lock);
+
     /* Clear the contents of the enclave structure */
 
     memset(enclave, 0, sizeof(oe_enclave_t));
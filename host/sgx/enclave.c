@@ -4,31 +4,214 @@
 #include "enclave.h"
 #include <assert.h>
 #include <openenclave/host.h>
+#include <openenclave/internal/safemath.h>
+#include <openenclave/internal/utils.h>
+#include <stdlib.h>
+#include <string.h>
+
+void oe_init_thread_bindings(oe_enclave_t* enclave)
+{
+    size_t num_bindings = enclave->num_bindings;
+    oe_thread_binding_t* bindings = enclave->bindings;
+
+    /* The TCSs are laid out at a fixed distance from each other, which lets
+     * oe_get_tcs_binding() compute the index of a TCS. */
+    enclave->tcs_stride = 0;
+    if (num_bindings > 1 && bindings[1].tcs > bindings[0].tcs)
+    {
+        enclave->tcs_stride = bindings[1].tcs - bindings[0].tcs;
+
+        for (size_t i = 2; i < num_bindings; i++)
+        {
+            if (bindings[i].tcs !=
+                bindings[0].tcs + i * enclave->tcs_stride)
+            {
+                enclave->tcs_stride = 0;
+                break;
+            }
+        }
+    }
+
+    /* Stack the bindings so that the first one is handed out first */
+    for (size_t i = 0; i < num_bindings; i++)
+        bindings[i].next_free = (i + 1 < num_bindings) ? (uint32_t)(i + 2) : 0;
+
+    enclave->free_bindings = num_bindings ? 1 : 0;
+}
+
+/* Get the binding of the given TCS. The TCS addresses do not change after the
+ * enclave is created, so no lock is needed. */
+oe_thread_binding_t* oe_get_tcs_binding(oe_enclave_t* enclave, uint64_t tcs)
+{
+    oe_thread_binding_t* bindings = enclave->bindings;
+    size_t num_bindings = enclave->num_bindings;
+
+    if (num_bindings == 0 || tcs < bindings[0].tcs)
+        return NULL;
+
+    if (enclave->tcs_stride)
+    {
+        uint64_t offset = tcs - bindings[0].tcs;
+        uint64_t index = offset / enclave->tcs_stride;
+
+        if (offset % enclave->tcs_stride || index >= num_bindings)
+            return NULL;
+
+        return &bindings[index];
+    }
+
+    for (size_t i = 0; i < num_bindings; i++)
+    {
+        if (bindings[i].tcs == tcs)
+            return &bindings[i];
+    }
+
+    return NULL;
+}
 
 /* Get the event object from the enclave for the given TCS */
 EnclaveEvent* GetEnclaveEvent(oe_enclave_t* enclave, uint64_t tcs)
 {
-    EnclaveEvent* event = NULL;
+    oe_thread_binding_t* binding = NULL;
 
     if (!enclave)
         return NULL;
 
-    oe_mutex_lock(&enclave->lock);
+    binding = oe_get_tcs_binding(enclave, tcs);
+
+    return binding ? &binding->event : NULL;
+}
+
+/*
+**==============================================================================
+**
+** Adaptive ocall buffers
+**
+**     Ocalls whose payload (the marshaled inputs and outputs) does not fit the
+**     ocall buffer of the binding are misses: the enclave has to allocate the
+**     payload elsewhere. The payload sizes are sampled into a histogram of
+**     power-of-two size classes. At the end of each window of samples, the
+**     target size of the buffer becomes the largest payload seen in the
+**     smallest size classes that hold 7/8 of the samples, so that a size
+**     which keeps missing an eighth of the ocalls or more makes the buffer
+**     grow, while rare outliers do not. The buffer only grows, up to the
+**     maximum size configured for the enclave.
+**
+**==============================================================================
+*/
+
+static uint64_t _get_initial_ocall_buffer_size(oe_enclave_t* enclave)
+{
+    if (enclave && enclave->ocall_buffer_initial_size)
+        return enclave->ocall_buffer_initial_size;
+
+    return OE_DEFAULT_OCALL_BUFFER_SIZE;
+}
+
+static uint64_t _get_max_ocall_buffer_size(oe_enclave_t* enclave)
+{
+    uint64_t initial_size = _get_initial_ocall_buffer_size(enclave);
+
+    if (enclave && enclave->ocall_buffer_max_size)
+        return enclave->ocall_buffer_max_size;
+
+    return initial_size > OE_DEFAULT_MAX_OCALL_BUFFER_SIZE
+               ? initial_size
+               : OE_DEFAULT_MAX_OCALL_BUFFER_SIZE;
+}
+
+void oe_prepare_ocall_buffer(oe_thread_binding_t* binding)
+{
+    uint64_t size = _get_initial_ocall_buffer_size(binding->enclave);
+    void* buffer = NULL;
+
+    if (binding->ocall_buffer)
     {
-        size_t i;
+        /* A nested ecall must not move the buffer of the outer ecall */
+        if (binding->count > 1)
+            return;
 
-        for (i = 0; i < enclave->num_bindings; i++)
-        {
-            oe_thread_binding_t* binding = &enclave->bindings[i];
+        if (binding->ocall_buffer_size > size)
+            size = binding->ocall_buffer_size;
+    }
 
-            if (binding->tcs == tcs)
-            {
-                event = &binding->event;
-                break;
-            }
-        }
+    if (binding->ocall_buffer_target_size > size)
+        size = binding->ocall_buffer_target_size;
+
+    if (binding->ocall_buffer && size == binding->ocall_buffer_size)
+        return;
+
+    // Lazily allocate buffer for making ocalls. Bound to the tcs.
+    // Will be cleaned up by enclave during termination.
+    if (!(buffer = malloc(size)))
+    {
+        /* Keep the current buffer, and stop trying to grow it */
+        binding->ocall_buffer_target_size = 0;
+        if (binding->ocall_buffer)
+            return;
+
+        size = 0;
     }
-    oe_mutex_unlock(&enclave->lock);
 
-    return event;
+    free(binding->ocall_buffer);
+    binding->ocall_buffer = buffer;
+    binding->ocall_buffer_size = size;
+}
+
+void oe_record_ocall_buffer_use(
+    oe_thread_binding_t* binding,
+    const oe_call_host_function_args_t* args)
+{
+    uint64_t payload_size = 0;
+    uint64_t target_size = 0;
+    uint64_t threshold = 0;
+    uint64_t count = 0;
+    size_t i = 0;
+
+    /* The arguments live in host memory and are validated by the handler of
+     * the ocall. Only the sizes are read here. */
+    if (oe_safe_add_u64(
+            args->input_buffer_size,
+            args->output_buffer_size,
+            &payload_size) != OE_OK)
+        return;
+
+    if (payload_size > binding->ocall_buffer_size)
+        binding->num_ocall_buffer_misses++;
+
+    while (i + 1 < OE_OCALL_BUFFER_SIZE_CLASSES &&
+           payload_size > ((uint64_t)OE_PAGE_SIZE << i))
+        i++;
+
+    binding->ocall_size_counts[i]++;
+    if (payload_size > binding->ocall_size_max[i])
+        binding->ocall_size_max[i] = payload_size;
+
+    if (++binding->num_ocall_size_samples < OE_OCALL_BUFFER_SAMPLE_WINDOW)
+        return;
+
+    threshold = OE_OCALL_BUFFER_SAMPLE_WINDOW -
+                OE_OCALL_BUFFER_SAMPLE_WINDOW / 8;
+
+    for (i = 0; i < OE_OCALL_BUFFER_SIZE_CLASSES; i++)
+    {
+        count += binding->ocall_size_counts[i];
+        if (binding->ocall_size_max[i] > target_size)
+            target_size = binding->ocall_size_max[i];
+
+        if (count >= threshold)
+            break;
+    }
+
+    target_size = oe_round_up_to_multiple(target_size, OE_PAGE_SIZE);
+    if (target_size > _get_max_ocall_buffer_size(binding->enclave))
+        target_size = _get_max_ocall_buffer_size(binding->enclave);
+
+    if (target_size > binding->ocall_buffer_size &&
+        target_size > binding->ocall_buffer_target_size)
+        binding->ocall_buffer_target_size = target_size;
+
+    memset(binding->ocall_size_counts, 0, sizeof(binding->ocall_size_counts));
+    memset(binding->ocall_size_max, 0, sizeof(binding->ocall_size_max));
+    binding->num_ocall_size_samples = 0;
 }
@@ -52,6 +52,10 @@ typedef struct _enclave_event
 
 #define ENCLAVE_MAGIC 0x20dc98463a5ad8b8
 
+/* Number of power-of-two size classes (from one page up to
+ * OE_MAX_OCALL_BUFFER_SIZE) in the histogram of ocall payload sizes */
+#define OE_OCALL_BUFFER_SIZE_CLASSES 19
+
 /*
 **==============================================================================
 **
@@ -70,6 +74,12 @@ typedef struct _enclave_event
 **     context more than once. The ThreadBinding.count field indicates how
 **     many bindings are in effect.
 **
+**     Free bindings are kept in a lock-free stack (oe_enclave_t.free_bindings)
+**     so that binding a thread does not depend on the number of TCSs. A
+**     thread that holds bindings to several enclaves (by making ecalls from
+**     ocalls) finds them by following ThreadBinding.outer from the binding in
+**     its thread-specific data.
+**
 **==============================================================================
 */
 
@@ -97,6 +107,29 @@ typedef struct _thread_binding
     /* Buffer used for ocall parameters */
     void* ocall_buffer;
     uint64_t ocall_buffer_size;
+
+    /* Adaptive sizing of the ocall buffer. The payload sizes of the ocalls
+     * made through this binding are sampled into a histogram, and when enough
+     * of them would not fit, ocall_buffer_target_size is raised. The buffer
+     * is resized at the start of the next outermost ecall. Only updated by
+     * the thread that holds the binding. */
+    uint64_t ocall_buffer_target_size;
+    uint64_t num_ocall_buffer_misses;
+    uint32_t ocall_size_counts[OE_OCALL_BUFFER_SIZE_CLASSES];
+    uint32_t num_ocall_size_samples;
+    uint64_t ocall_size_max[OE_OCALL_BUFFER_SIZE_CLASSES];
+
+    /* Number of ecalls and ocalls made through this binding. Only updated by
+     * the thread that holds the binding. */
+    uint64_t num_ecalls;
+    uint64_t num_ocalls;
+
+    /* Binding that the thread held before this one (possibly to another
+     * enclave), or NULL. Only valid while the binding is busy. */
+    struct _thread_binding* outer;
+
+    /* Index (plus one) of the next binding in the free stack, or 0 */
+    volatile uint32_t next_free;
 } oe_thread_binding_t;
 
 /* Whether this binding is busy */
@@ -135,6 +168,35 @@ typedef struct _oe_enclave
     size_t num_bindings;
     oe_mutex lock;
 
+    /* Lock-free stack of free bindings. The low 32 bits hold the index (plus
+     * one) of the top binding, and the high 32 bits a tag that is bumped on
+     * every update to guard against ABA. */
+    volatile int64_t free_bindings;
+
+    /* Distance between consecutive TCSs (0 if they are not evenly spaced) */
+    uint64_t tcs_stride;
+
+    /* Admission of ecalls when every TCS is busy. When wait_for_tcs is set,
+     * such ecalls queue up (in FIFO order) under admission_lock, and the
+     * releasing thread hands its binding to the oldest one. */
+    bool wait_for_tcs;
+    uint32_t tcs_wait_timeout_ms;
+    oe_mutex admission_lock;
+    struct _oe_tcs_waiter* tcs_waiters_head;
+    struct _oe_tcs_waiter* tcs_waiters_tail;
+    volatile uint64_t num_tcs_waiters;
+
+    /* Initial and maximum sizes of the ocall buffers of the bindings, set
+     * with oe_enclave_setting_ocall_buffer_t (0 for the defaults) */
+    uint64_t ocall_buffer_initial_size;
+    uint64_t ocall_buffer_max_size;
+
+    /* Admission counters. Updated under admission_lock. */
+    uint64_t num_tcs_waits;
+    uint64_t num_tcs_wait_timeouts;
+    uint64_t tcs_wait_time;
+    uint64_t max_tcs_queue_depth;
+
     /* Hash of enclave (MRENCLAVE) */
     OE_SHA256 hash;
 
@@ -155,6 +217,12 @@ typedef struct _oe_enclave
     /* Manager for switchless calls */
     oe_switchless_call_manager_t* switchless_manager;
 
+    /* Helper thread that wakes enclave threads for the wake ring, if any */
+    struct _oe_wake_ring_helper* wake_ring_helper;
+
+    /* Threads of the thread pool of the enclave, if any */
+    struct _oe_thread_pool* thread_pool;
+
     /* Table of global to local ecall ids */
     oe_ecall_id_t* ecall_id_table;
     size_t ecall_id_table_size;
@@ -164,13 +232,37 @@ typedef struct _oe_enclave
 /* Get the event for the given TCS */
 EnclaveEvent* GetEnclaveEvent(oe_enclave_t* enclave, uint64_t tcs);
 
+/* Index the TCSs and put every binding on the free stack. Called once all the
+ * TCSs have been added. */
+void oe_init_thread_bindings(oe_enclave_t* enclave);
+
+/* Get the binding of the given TCS, or NULL if the enclave has no such TCS */
+oe_thread_binding_t* oe_get_tcs_binding(oe_enclave_t* enclave, uint64_t tcs);
+
 /**
- * Size of ocall buffers passed in ecall_contexts. Large enough for most ocalls.
- * If an ocall requires more than this size, then the enclave will make an
- * ocall to allocate the buffer instead of using the ecall_context's buffer.
+ * Initial size of ocall buffers passed in ecall_contexts. Large enough for most
+ * ocalls. If an ocall requires more than this size, then the enclave allocates
+ * the buffer elsewhere instead of using the ecall_context's buffer, and the
+ * buffer of the binding grows (up to OE_DEFAULT_MAX_OCALL_BUFFER_SIZE, unless
+ * configured otherwise) if such ocalls are frequent.
  * Note: Currently, quotes are about 10KB.
  */
 #define OE_DEFAULT_OCALL_BUFFER_SIZE (16 * 1024)
+#define OE_DEFAULT_MAX_OCALL_BUFFER_SIZE (1024 * 1024)
+#define OE_MAX_OCALL_BUFFER_SIZE (1024 * 1024 * 1024)
+
+/* Number of ocalls sampled before the target size of an ocall buffer is
+ * reconsidered */
+#define OE_OCALL_BUFFER_SAMPLE_WINDOW 64
+
+/* Allocate or resize the ocall buffer of the binding of the calling thread
+ * (called when an ecall is entered) */
+void oe_prepare_ocall_buffer(oe_thread_binding_t* binding);
+
+/* Record the payload size of an ocall made through the binding */
+void oe_record_ocall_buffer_use(
+    oe_thread_binding_t* binding,
+    const oe_call_host_function_args_t* args);
 
 void oe_setup_ecall_context(oe_ecall_context_t* ecall_context);
 
@@ -174,18 +174,11 @@ oe_enclave_t* oe_query_enclave_instance(void* tcs)
         {
             oe_enclave_t* enclave = tmp->enclave;
 
-            oe_mutex_lock(&enclave->lock);
-
-            for (uint32_t i = 0; i < OE_COUNTOF(enclave->bindings); i++)
+            if (oe_get_tcs_binding(enclave, (uint64_t)tcs))
             {
-                if (enclave->bindings[i].tcs == (uint64_t)tcs)
-                {
-                    ret = enclave;
-                    break;
-                }
+                ret = enclave;
+                break;
             }
-
-            oe_mutex_unlock(&enclave->lock);
         }
     }
 
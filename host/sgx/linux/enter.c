@@ -116,13 +116,7 @@ void oe_setup_ecall_context(oe_ecall_context_t* ecall_context)
 {
     oe_thread_binding_t* binding = oe_get_thread_binding();
 
-    if (binding->ocall_buffer == NULL)
-    {
-        // Lazily allocate buffer for making ocalls. Bound to the tcs.
-        // Will be cleaned up by enclave during termination.
-        binding->ocall_buffer = malloc(OE_DEFAULT_OCALL_BUFFER_SIZE);
-        binding->ocall_buffer_size = OE_DEFAULT_OCALL_BUFFER_SIZE;
-    }
+    oe_prepare_ocall_buffer(binding);
 
     ecall_context->ocall_buffer = binding->ocall_buffer;
     ecall_context->ocall_buffer_size = binding->ocall_buffer_size;
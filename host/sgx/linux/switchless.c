@@ -4,7 +4,12 @@
 #include <openenclave/internal/switchless.h>
 
 #include <linux/futex.h>
+#include <linux/mempolicy.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/mman.h>
 #include <sys/syscall.h>
+#include <time.h>
 #include <unistd.h>
 
 static void _worker_wait(volatile int64_t* event)
@@ -69,3 +74,124 @@ void oe_enclave_worker_wake(oe_enclave_worker_context_t* context)
 {
     _worker_wake(&context->event);
 }
+
+oe_result_t oe_switchless_get_numa_node_cpus(
+    uint32_t node,
+    uint32_t* cpus,
+    size_t max_cpus,
+    size_t* num_cpus)
+{
+    char path[64];
+    FILE* file = NULL;
+    unsigned int first = 0;
+    unsigned int last = 0;
+    size_t count = 0;
+    int c = 0;
+
+    if (!cpus || !num_cpus)
+        return OE_INVALID_PARAMETER;
+
+    *num_cpus = 0;
+
+    snprintf(
+        path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+    if (!(file = fopen(path, "r")))
+        return OE_NOT_FOUND;
+
+    // The list has the form "0-3,8,10-11".
+    while (fscanf(file, "%u", &first) == 1)
+    {
+        last = first;
+        c = fgetc(file);
+        if (c == '-')
+        {
+            if (fscanf(file, "%u", &last) != 1)
+                break;
+            c = fgetc(file);
+        }
+
+        for (unsigned int cpu = first; cpu <= last && count < max_cpus; cpu++)
+            cpus[count++] = cpu;
+
+        if (c != ',')
+            break;
+    }
+
+    fclose(file);
+
+    if (count == 0)
+        return OE_NOT_FOUND;
+
+    *num_cpus = count;
+    return OE_OK;
+}
+
+void* oe_switchless_alloc_shared(size_t size, const uint32_t* numa_node)
+{
+    // The memory is mapped anonymously so that it has pages of its own that
+    // have never been touched: placement applies to them at first touch and
+    // goes away with the mapping. The first cache line of the mapping
+    // records its length for oe_switchless_free_shared().
+    const size_t header_size = OE_SWITCHLESS_CONTEXT_ALIGNMENT;
+    size_t length = 0;
+    uint8_t* base = NULL;
+
+    OE_STATIC_ASSERT(OE_SWITCHLESS_CONTEXT_ALIGNMENT >= sizeof(size_t));
+
+    if (size > SIZE_MAX - header_size - OE_PAGE_SIZE)
+        return NULL;
+
+    length = header_size + size + OE_PAGE_SIZE - 1;
+    length &= ~((size_t)OE_PAGE_SIZE - 1);
+
+    base = mmap(
+        NULL,
+        length,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+    if (base == MAP_FAILED)
+        return NULL;
+
+    // Set the policy before anything (including the header) touches the
+    // pages. Failure to apply the policy (e.g., on a kernel without NUMA
+    // support) is not fatal.
+    if (numa_node && *numa_node < sizeof(unsigned long) * 8 - 1)
+    {
+        unsigned long nodemask = 1UL << *numa_node;
+        syscall(
+            __NR_mbind,
+            base,
+            length,
+            MPOL_PREFERRED,
+            &nodemask,
+            sizeof(nodemask) * 8,
+            0);
+    }
+
+    // Anonymous mappings are zero-filled.
+    *(size_t*)base = length;
+    return base + header_size;
+}
+
+void oe_switchless_free_shared(void* ptr)
+{
+    uint8_t* base = NULL;
+
+    if (!ptr)
+        return;
+
+    base = (uint8_t*)ptr - OE_SWITCHLESS_CONTEXT_ALIGNMENT;
+    munmap(base, *(size_t*)base);
+}
+
+uint64_t oe_switchless_get_monotonic_time(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+        return 0;
+
+    return (uint64_t)ts.tv_sec * 1000000000UL + (uint64_t)ts.tv_nsec;
+}
@@ -7,6 +7,7 @@
 #include <openenclave/internal/safecrt.h>
 #include <openenclave/internal/safemath.h>
 
+#include "../../fopen.h"
 #include "../enclave.h"
 #include "openenclave/internal/trace.h"
 #include "openenclave/log.h"
@@ -169,3 +170,43 @@ done:
 
     return result;
 }
+
+oe_result_t oe_sgx_write_heap_profile_ocall(
+    oe_enclave_t* oe_enclave,
+    const char* path,
+    const void* profile,
+    size_t size)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    FILE* stream = NULL;
+
+    /* Reject invalid parameters. */
+    if (!oe_enclave || oe_enclave->magic != ENCLAVE_MAGIC || !path ||
+        (!profile && size))
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    if (oe_fopen(&stream, path, "w") != 0)
+        OE_RAISE_MSG(OE_FAILURE, "cannot open %s", path);
+
+    if (size && fwrite(profile, 1, size, stream) != size)
+        OE_RAISE_MSG(OE_FAILURE, "cannot write %s", path);
+
+    /* pprof maps the sampled addresses back to the enclave image with the
+     * same section that gperftools takes from /proc/self/maps */
+    if (fprintf(
+            stream,
+            "\nMAPPED_LIBRARIES:\n%llx-%llx r-xp 00000000 00:00 0 %s\n",
+            (unsigned long long)oe_enclave->start_address,
+            (unsigned long long)(oe_enclave->base_address + oe_enclave->size),
+            oe_enclave->path) < 0)
+        OE_RAISE_MSG(OE_FAILURE, "cannot write %s", path);
+
+    result = OE_OK;
+
+done:
+
+    if (stream && fclose(stream) != 0 && result == OE_OK)
+        result = OE_FAILURE;
+
+    return result;
+}
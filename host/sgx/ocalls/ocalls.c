@@ -33,6 +33,7 @@
 #include "../quote.h"
 #include "../sgxquote.h"
 #include "../sgxquoteprovider.h"
+#include "../wakering.h"
 #include "ocalls.h"
 #include "platform_u.h"
 
@@ -42,6 +43,9 @@ void HandleThreadWait(oe_enclave_t* enclave, uint64_t arg_in)
     EnclaveEvent* event = GetEnclaveEvent(enclave, tcs);
     assert(event);
 
+    /* The thread will be woken by another, possibly through the ring */
+    oe_notify_wake_ring(enclave);
+
 #if defined(__linux__)
 
     if (__sync_fetch_and_add(&event->value, (uint32_t)-1) == 0)
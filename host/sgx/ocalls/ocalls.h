@@ -9,4 +9,6 @@
 void HandleThreadWait(oe_enclave_t* enclave, uint64_t arg);
 void HandleThreadWake(oe_enclave_t* enclave, uint64_t arg);
 
+void oe_handle_get_time_page(uint64_t arg_in, uint64_t* arg_out);
+
 #endif /* _OE_HOST_SGX_OCALLS_H */
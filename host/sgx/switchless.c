@@ -23,6 +23,34 @@
  */
 #define OE_ENCLAVE_WORKER_SPIN_COUNT_THRESHOLD (4096U)
 
+/**
+ * Bounds of the spin budget picked by the adaptive spin policies.
+ */
+#define OE_SWITCHLESS_MIN_SPIN_BUDGET (64U)
+#define OE_SWITCHLESS_MAX_SPIN_BUDGET (1U << 20)
+
+/**
+ * Estimated cost in nanoseconds of parking a worker and waking it up again.
+ * Spinning through gaps shorter than this is cheaper than parking.
+ */
+#define OE_SWITCHLESS_PARK_COST_NS (20000U)
+
+/**
+ * A worker (other than the first) retires when the gaps between its calls
+ * are this many times longer than the cost of parking.
+ */
+#define OE_SWITCHLESS_RETIRE_GAP_FACTOR (16U)
+
+/**
+ * Assumed duration of a spin iteration (in 1/16 ns) until it is measured.
+ */
+#define OE_SWITCHLESS_DEFAULT_ITERATION_TIME (16U * 40U)
+
+/**
+ * Maximum number of CPUs of a NUMA node that workers are pinned to.
+ */
+#define OE_SWITCHLESS_MAX_NUMA_NODE_CPUS (1024U)
+
 /**
  * Declare the prototypes of the following functions to avoid missing-prototypes
  * warning.
@@ -35,6 +63,15 @@ OE_UNUSED_FUNC oe_result_t _oe_sgx_init_context_switchless_ecall(
 OE_UNUSED_FUNC oe_result_t _oe_sgx_switchless_enclave_worker_thread_ecall(
     oe_enclave_t* enclave,
     oe_enclave_worker_context_t* context);
+OE_UNUSED_FUNC oe_result_t _oe_sgx_init_switchless_ocall_ring_ecall(
+    oe_enclave_t* enclave,
+    oe_result_t* _retval,
+    void* ring,
+    uint64_t capacity);
+OE_UNUSED_FUNC oe_result_t _oe_sgx_init_switchless_statistics_ecall(
+    oe_enclave_t* enclave,
+    oe_result_t* _retval,
+    void* statistics);
 
 /**
  * Make the following ECALLs weak to support the system EDL opt-in.
@@ -75,6 +112,290 @@ OE_WEAK_ALIAS(
     _oe_sgx_switchless_enclave_worker_thread_ecall,
     oe_sgx_switchless_enclave_worker_thread_ecall);
 
+oe_result_t _oe_sgx_init_switchless_ocall_ring_ecall(
+    oe_enclave_t* enclave,
+    oe_result_t* _retval,
+    void* ring,
+    uint64_t capacity)
+{
+    OE_UNUSED(enclave);
+    OE_UNUSED(ring);
+    OE_UNUSED(capacity);
+
+    if (_retval)
+        *_retval = OE_UNSUPPORTED;
+
+    return OE_UNSUPPORTED;
+}
+OE_WEAK_ALIAS(
+    _oe_sgx_init_switchless_ocall_ring_ecall,
+    oe_sgx_init_switchless_ocall_ring_ecall);
+
+oe_result_t _oe_sgx_init_switchless_statistics_ecall(
+    oe_enclave_t* enclave,
+    oe_result_t* _retval,
+    void* statistics)
+{
+    OE_UNUSED(enclave);
+    OE_UNUSED(statistics);
+
+    if (_retval)
+        *_retval = OE_UNSUPPORTED;
+
+    return OE_UNSUPPORTED;
+}
+OE_WEAK_ALIAS(
+    _oe_sgx_init_switchless_statistics_ecall,
+    oe_sgx_init_switchless_statistics_ecall);
+
+/*
+** Allocate a submission ring with the given (power of two) capacity. Slot i
+** starts with sequence i, which marks it free for the first lap.
+*/
+static oe_switchless_ring_t* _create_ocall_ring(
+    uint64_t capacity,
+    const uint32_t* numa_node)
+{
+    oe_switchless_ring_t* ring = NULL;
+    oe_switchless_ring_slot_t* slots = NULL;
+
+    OE_STATIC_ASSERT(
+        OE_SWITCHLESS_RING_ALIGNMENT == OE_SWITCHLESS_CONTEXT_ALIGNMENT);
+
+    ring = (oe_switchless_ring_t*)oe_switchless_alloc_shared(
+        oe_switchless_ring_size(capacity), numa_node);
+    if (ring == NULL)
+        return NULL;
+
+    ring->capacity = capacity;
+
+    slots = oe_switchless_ring_slots(ring);
+    for (uint64_t i = 0; i < capacity; i++)
+        slots[i].sequence = i;
+
+    return ring;
+}
+
+/*
+** Take the oldest call from the submission ring. Returns NULL if the ring is
+** empty.
+*/
+static void* _ocall_ring_pop(oe_switchless_ring_t* ring)
+{
+    oe_switchless_ring_slot_t* slots = oe_switchless_ring_slots(ring);
+    uint64_t mask = ring->capacity - 1;
+    uint64_t pos = oe_atomic_load(&ring->dequeue_pos);
+
+    while (true)
+    {
+        oe_switchless_ring_slot_t* slot = &slots[pos & mask];
+        uint64_t sequence = oe_atomic_load(&slot->sequence);
+        int64_t diff = (int64_t)(sequence - (pos + 1));
+
+        if (diff == 0)
+        {
+            // The slot holds a posted call. Try to take it.
+            if (oe_atomic_compare_and_swap(
+                    (volatile int64_t*)&ring->dequeue_pos,
+                    (int64_t)pos,
+                    (int64_t)(pos + 1)))
+            {
+                void* call_arg = slot->call_arg;
+
+                // Hand the slot back to the enclave for the next lap.
+                OE_ATOMIC_MEMORY_BARRIER_RELEASE();
+                slot->sequence = pos + mask + 1;
+                return call_arg;
+            }
+        }
+        else if (diff < 0)
+        {
+            // The ring is empty, or the enclave has claimed the slot but not
+            // yet published the call.
+            return NULL;
+        }
+
+        pos = oe_atomic_load(&ring->dequeue_pos);
+    }
+}
+
+/*
+**==============================================================================
+**
+** Spin controller
+**
+** Under the adaptive spin policies, each worker measures the gaps between the
+** calls it handles (in spin iterations) and sizes its spin budget from them,
+** following the rule that a worker should only spin for as long as parking
+** would cost:
+**
+**   - If the smoothed gap is shorter than the cost of parking, the worker
+**     spins for twice the gap, which covers most arrivals.
+**   - Otherwise the worker spins for the cost of parking and then parks. This
+**     bounds the time wasted by spinning to that of parking.
+**
+** Under OE_SWITCHLESS_SPIN_POLICY_CPU_BUDGET, the budget is further limited to
+** the configured share of the gap. A worker whose gaps are much longer than
+** the cost of parking retires; see OE_SWITCHLESS_WORKER_RETIRED.
+**
+**==============================================================================
+*/
+
+/* Fold a sample into a smoothed value with weight 1/8. */
+static uint64_t _smooth(uint64_t average, uint64_t sample)
+{
+    // Keep pathological samples (e.g., very long sleeps) from overflowing.
+    if (sample > UINT32_MAX)
+        sample = UINT32_MAX;
+
+    return (average * 7 + sample) / 8;
+}
+
+static void _spin_controller_init(
+    oe_switchless_spin_controller_t* controller,
+    uint64_t budget)
+{
+    controller->budget = budget;
+    controller->gap = budget;
+    controller->iteration_time = OE_SWITCHLESS_DEFAULT_ITERATION_TIME;
+    controller->spin_start_time = oe_switchless_get_monotonic_time();
+}
+
+static void _spin_controller_update_budget(
+    oe_switchless_call_manager_t* manager,
+    oe_switchless_spin_controller_t* controller)
+{
+    uint64_t gap = controller->gap;
+    uint64_t park_cost =
+        (uint64_t)OE_SWITCHLESS_PARK_COST_NS * 16 / controller->iteration_time;
+    uint64_t budget = (gap <= park_cost) ? 2 * gap : park_cost;
+
+    if (manager->spin_policy == OE_SWITCHLESS_SPIN_POLICY_CPU_BUDGET)
+    {
+        uint64_t cap = gap * manager->cpu_budget_percent / 100;
+        if (budget > cap)
+            budget = cap;
+    }
+
+    if (budget < OE_SWITCHLESS_MIN_SPIN_BUDGET)
+        budget = OE_SWITCHLESS_MIN_SPIN_BUDGET;
+    if (budget > OE_SWITCHLESS_MAX_SPIN_BUDGET)
+        budget = OE_SWITCHLESS_MAX_SPIN_BUDGET;
+
+    controller->budget = budget;
+}
+
+/* A call arrived after the worker had spun for the given iterations. */
+static void _spin_controller_on_call(
+    oe_switchless_call_manager_t* manager,
+    oe_switchless_spin_controller_t* controller,
+    uint64_t spin_count)
+{
+    controller->gap = _smooth(controller->gap, spin_count);
+    _spin_controller_update_budget(manager, controller);
+}
+
+/* The worker is about to park after spinning for the given iterations since
+ * the start of the spin phase. */
+static void _spin_controller_on_park(
+    oe_switchless_spin_controller_t* controller,
+    uint64_t spin_count)
+{
+    uint64_t now = oe_switchless_get_monotonic_time();
+
+    if (spin_count && now > controller->spin_start_time)
+    {
+        uint64_t sample =
+            (now - controller->spin_start_time) * 16 / spin_count;
+
+        // The iteration time is a divisor. Keep it non-zero.
+        controller->iteration_time =
+            _smooth(controller->iteration_time, sample) | 1;
+    }
+
+    controller->park_time = now;
+}
+
+/* The worker woke up. Count the sleep as part of the gap. */
+static void _spin_controller_on_wake(
+    oe_switchless_call_manager_t* manager,
+    oe_switchless_spin_controller_t* controller)
+{
+    uint64_t now = oe_switchless_get_monotonic_time();
+    uint64_t slept = 0;
+
+    if (now > controller->park_time)
+        slept = (now - controller->park_time) * 16 / controller->iteration_time;
+
+    controller->gap = _smooth(controller->gap, controller->budget + slept);
+    controller->spin_start_time = now;
+    _spin_controller_update_budget(manager, controller);
+}
+
+/* Whether the traffic seen by the worker is light enough for it to retire. */
+static bool _spin_controller_should_retire(
+    oe_switchless_spin_controller_t* controller)
+{
+    uint64_t gap_ns = controller->gap * controller->iteration_time / 16;
+
+    return gap_ns > (uint64_t)OE_SWITCHLESS_PARK_COST_NS *
+                        OE_SWITCHLESS_RETIRE_GAP_FACTOR;
+}
+
+/*
+** Put the host worker to sleep until the enclave wakes it up.
+*/
+static void _host_worker_sleep(
+    oe_host_worker_context_t* context,
+    oe_switchless_ring_t* ring)
+{
+    if (ring == NULL)
+    {
+        oe_host_worker_wait(context);
+        return;
+    }
+
+    // Announce the intent to sleep before checking the ring one last time.
+    // The enclave publishes a call before checking for sleeping workers, so
+    // either this worker sees the call or the enclave sees this worker. The
+    // flag is set before the count so that the enclave, which reads the count
+    // first, finds the flag of every counted worker.
+    context->is_sleeping = 1;
+    oe_atomic_increment(&ring->num_sleeping_workers);
+
+    if (oe_atomic_load(&ring->enqueue_pos) ==
+        oe_atomic_load(&ring->dequeue_pos))
+        oe_host_worker_wait(context);
+
+    context->is_sleeping = 0;
+    oe_atomic_decrement(&ring->num_sleeping_workers);
+}
+
+/*
+** Handle a switchless ocall. If the call cannot be dispatched, report the
+** error through its result so that the enclave thread, which may not be
+** waiting for it, sees the call complete.
+*/
+static void _handle_switchless_ocall(
+    volatile oe_call_host_function_args_t* call_arg,
+    oe_enclave_t* enclave,
+    oe_switchless_worker_counters_t* counters)
+{
+    uint64_t start_time = oe_switchless_get_monotonic_time();
+    oe_result_t result =
+        oe_handle_call_host_function((uint64_t)call_arg, enclave);
+
+    if (result != OE_OK)
+    {
+        OE_ATOMIC_MEMORY_BARRIER_RELEASE();
+        call_arg->result = result;
+    }
+
+    // Only this worker updates these counters.
+    counters->num_calls++;
+    counters->busy_time += oe_switchless_get_monotonic_time() - start_time;
+}
+
 /*
 ** The thread function that handles switchless ocalls
 **
@@ -82,18 +403,34 @@ OE_WEAK_ALIAS(
 static void* _switchless_ocall_worker(void* arg)
 {
     oe_host_worker_context_t* context = (oe_host_worker_context_t*)arg;
+    oe_switchless_call_manager_t* manager = context->enc->switchless_manager;
+    oe_switchless_ring_t* ring = manager->ocall_ring;
+    size_t index = (size_t)(context - manager->host_worker_contexts);
+    oe_switchless_spin_controller_t* controller = NULL;
+    oe_switchless_worker_counters_t* counters =
+        &manager->host_worker_counters[index];
+    uint64_t spin_count_threshold = OE_HOST_WORKER_SPIN_COUNT_THRESHOLD;
+
+    if (manager->host_worker_controllers)
+        controller = &manager->host_worker_controllers[index];
 
     while (!context->is_stopping)
     {
-        volatile oe_call_host_function_args_t* local_call_arg = NULL;
-        if ((local_call_arg = context->call_arg) != NULL)
+        volatile oe_call_host_function_args_t* local_call_arg =
+            context->call_arg;
+
+        if (local_call_arg != NULL &&
+            local_call_arg != OE_SWITCHLESS_WORKER_RETIRED)
         {
+            if (controller)
+                _spin_controller_on_call(
+                    manager, controller, context->spin_count);
+
             // Handle the switchless call, but do not clear the slot yet. Since
             // the slot is not empty, any new incoming switchless call request
             // will be scheduled in another available work thread and get
             // handled immediately.
-            oe_handle_call_host_function(
-                (uint64_t)local_call_arg, context->enc);
+            _handle_switchless_ocall(local_call_arg, context->enc, counters);
 
             // After handling the switchless call, mark this worker thread
             // as free by clearing the slot.
@@ -102,17 +439,69 @@ static void* _switchless_ocall_worker(void* arg)
             // Reset spin count for next message.
             context->total_spin_count += context->spin_count;
             context->spin_count = 0;
+
+            if (controller)
+                controller->spin_start_time =
+                    oe_switchless_get_monotonic_time();
+        }
+        else if (ring && (local_call_arg = _ocall_ring_pop(ring)) != NULL)
+        {
+            if (controller)
+                _spin_controller_on_call(
+                    manager, controller, context->spin_count);
+
+            // Handle a call that was queued while every worker was busy.
+            _handle_switchless_ocall(local_call_arg, context->enc, counters);
+
+            // Reset spin count for next message.
+            context->total_spin_count += context->spin_count;
+            context->spin_count = 0;
+
+            if (controller)
+                controller->spin_start_time =
+                    oe_switchless_get_monotonic_time();
+        }
+        else if (local_call_arg == OE_SWITCHLESS_WORKER_RETIRED)
+        {
+            // A retired worker does not spin. It sleeps until the enclave
+            // revives it with a call, or wakes it to drain the ring.
+            counters->num_sleeps++;
+            _host_worker_sleep(context, ring);
+
+            if (controller)
+                controller->spin_start_time =
+                    oe_switchless_get_monotonic_time();
         }
         else
         {
+            if (controller)
+                spin_count_threshold = controller->budget;
+
             // If there is no message, increment spin count until threshold is
             // reached.
-            if (++context->spin_count >= OE_HOST_WORKER_SPIN_COUNT_THRESHOLD)
+            if (++context->spin_count >= spin_count_threshold)
             {
+                if (controller)
+                {
+                    _spin_controller_on_park(controller, context->spin_count);
+
+                    // Keep the first worker active. Retiring fails if the
+                    // enclave has just posted a call to this worker.
+                    if (index > 0 && _spin_controller_should_retire(controller))
+                        oe_atomic_compare_and_swap_ptr(
+                            (void* volatile*)&context->call_arg,
+                            NULL,
+                            OE_SWITCHLESS_WORKER_RETIRED);
+                }
+
                 // Reset spin count and go to sleep until event is fired.
                 context->total_spin_count += context->spin_count;
                 context->spin_count = 0;
-                oe_host_worker_wait(context);
+                counters->num_sleeps++;
+                _host_worker_sleep(context, ring);
+
+                if (controller)
+                    _spin_controller_on_wake(manager, controller);
             }
 
             /* Yield CPU */
@@ -124,8 +513,70 @@ static void* _switchless_ocall_worker(void* arg)
 
 void oe_sgx_sleep_switchless_worker_ocall(oe_enclave_worker_context_t* context)
 {
+    oe_switchless_call_manager_t* manager = context->enc->switchless_manager;
+    oe_switchless_spin_controller_t* controller = NULL;
+    size_t index = (size_t)(context - manager->enclave_worker_contexts);
+    bool retired = context->call_arg == OE_SWITCHLESS_WORKER_RETIRED;
+    uint64_t iterations = 0;
+    uint64_t num_posted_calls = 0;
+
+    if (index < manager->num_enclave_workers)
+        manager->enclave_worker_counters[index].num_sleeps++;
+
+    if (manager->enclave_worker_controllers == NULL ||
+        index >= manager->num_enclave_workers)
+    {
+        // Wait for messages.
+        oe_enclave_worker_wait(context);
+        return;
+    }
+
+    controller = &manager->enclave_worker_controllers[index];
+
+    if (!retired)
+    {
+        // Take the count of the calls that were posted while the worker was
+        // spinning, and fold in the gap seen by the latest one. Without any,
+        // the worker spun for the whole time since it was woken, which gives
+        // a measure of the duration of an iteration.
+        do
+        {
+            num_posted_calls = oe_atomic_load(&controller->num_posted_calls);
+        } while (!oe_atomic_compare_and_swap(
+            (volatile int64_t*)&controller->num_posted_calls,
+            (int64_t)num_posted_calls,
+            0));
+
+        if (num_posted_calls)
+            _spin_controller_on_call(
+                manager, controller, controller->posted_gap);
+        else
+            iterations =
+                context->total_spin_count - controller->last_total_spin_count;
+
+        _spin_controller_on_park(controller, iterations);
+
+        // Keep the first worker active. Retiring fails if a call has just
+        // been posted to this worker.
+        if (index > 0 && _spin_controller_should_retire(controller))
+            oe_atomic_compare_and_swap_ptr(
+                (void* volatile*)&context->call_arg,
+                NULL,
+                OE_SWITCHLESS_WORKER_RETIRED);
+    }
+
     // Wait for messages.
     oe_enclave_worker_wait(context);
+
+    if (retired)
+        controller->spin_start_time = oe_switchless_get_monotonic_time();
+    else
+        _spin_controller_on_wake(manager, controller);
+
+    controller->last_total_spin_count = context->total_spin_count;
+
+    // The enclave picks up the new budget when it returns from this ocall.
+    context->spin_count_threshold = controller->budget;
 }
 
 /*
@@ -143,9 +594,54 @@ static void* _switchless_ecall_worker(void* arg)
         OE_TRACE_ERROR("Switchless enclave worker thread failed\n");
     }
 
+    // The worker has left the enclave. If the enclave rejected the context,
+    // this also releases oe_start_switchless_manager from waiting on it.
+    context->is_stopping = true;
+
     return NULL;
 }
 
+/*
+** Pin a worker thread. An explicit CPU list takes precedence over the CPUs of
+** the NUMA node. Without either, the thread is left unpinned.
+*/
+static oe_result_t _set_worker_affinity(
+    oe_thread_t thread,
+    size_t index,
+    const uint32_t* cpus,
+    size_t num_cpus,
+    const uint32_t* node_cpus,
+    size_t num_node_cpus)
+{
+    oe_result_t result = OE_UNEXPECTED;
+
+    if (cpus && num_cpus)
+    {
+        cpus = &cpus[index % num_cpus];
+        num_cpus = 1;
+    }
+    else if (node_cpus && num_node_cpus)
+    {
+        cpus = node_cpus;
+        num_cpus = num_node_cpus;
+    }
+    else
+    {
+        result = OE_OK;
+        goto done;
+    }
+
+    if (oe_thread_set_affinity(thread, cpus, num_cpus) != 0)
+        OE_RAISE_MSG(
+            OE_INVALID_PARAMETER,
+            "Failed to set the affinity of switchless worker thread %d",
+            (int)index);
+
+    result = OE_OK;
+done:
+    return result;
+}
+
 static oe_result_t oe_stop_worker_threads(oe_switchless_call_manager_t* manager)
 {
     oe_result_t result = OE_UNEXPECTED;
@@ -158,6 +654,13 @@ static oe_result_t oe_stop_worker_threads(oe_switchless_call_manager_t* manager)
             "Switchless host worker thread %d spun for %lu times",
             (int)i,
             manager->host_worker_contexts[i].total_spin_count);
+
+        if (manager->host_worker_controllers)
+            OE_TRACE_INFO(
+                "Switchless host worker thread %d ended with a spin budget of "
+                "%lu",
+                (int)i,
+                manager->host_worker_controllers[i].budget);
     }
     for (size_t i = 0; i < manager->num_enclave_workers; i++)
     {
@@ -186,8 +689,7 @@ done:
 
 oe_result_t oe_start_switchless_manager(
     oe_enclave_t* enclave,
-    size_t num_host_workers,
-    size_t num_enclave_workers)
+    const oe_enclave_setting_context_switchless_t* setting)
 {
     oe_result_t result = OE_UNEXPECTED;
     oe_result_t result_out = 0;
@@ -196,10 +698,37 @@ oe_result_t oe_start_switchless_manager(
     oe_thread_t* host_threads = NULL;
     oe_enclave_worker_context_t* enclave_contexts = NULL;
     oe_thread_t* enclave_threads = NULL;
+    oe_switchless_ring_t* ocall_ring = NULL;
+    oe_switchless_spin_controller_t* host_controllers = NULL;
+    oe_switchless_spin_controller_t* enclave_controllers = NULL;
+    oe_switchless_worker_counters_t* host_counters = NULL;
+    oe_switchless_worker_counters_t* enclave_counters = NULL;
+    oe_switchless_statistics_t* statistics = NULL;
+    size_t num_host_workers = 0;
+    size_t num_enclave_workers = 0;
+    uint64_t ocall_ring_depth = 0;
+    const uint32_t* numa_node = NULL;
+    uint32_t* node_cpus = NULL;
+    size_t num_node_cpus = 0;
+
+    if (enclave == NULL || setting == NULL)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    if ((setting->num_host_worker_cpus && !setting->host_worker_cpus) ||
+        (setting->num_enclave_worker_cpus && !setting->enclave_worker_cpus))
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    if (setting->spin_policy > OE_SWITCHLESS_SPIN_POLICY_CPU_BUDGET)
+        OE_RAISE(OE_INVALID_PARAMETER);
 
-    if (enclave == NULL)
+    if (setting->spin_policy == OE_SWITCHLESS_SPIN_POLICY_CPU_BUDGET &&
+        (setting->cpu_budget_percent == 0 ||
+         setting->cpu_budget_percent > 100))
         OE_RAISE(OE_INVALID_PARAMETER);
 
+    num_host_workers = setting->max_host_workers;
+    num_enclave_workers = setting->max_enclave_workers;
+
     if (enclave->switchless_manager != NULL)
         OE_RAISE(OE_UNEXPECTED);
 
@@ -216,12 +745,32 @@ oe_result_t oe_start_switchless_manager(
     if (num_enclave_workers > enclave->num_bindings)
         num_enclave_workers = (uint32_t)enclave->num_bindings;
 
-    // Allocate memory for the manager and its arrays
+    if (setting->pin_to_numa_node)
+    {
+        numa_node = &setting->numa_node;
+
+        node_cpus = calloc(OE_SWITCHLESS_MAX_NUMA_NODE_CPUS, sizeof(uint32_t));
+        if (node_cpus == NULL)
+            OE_RAISE(OE_OUT_OF_MEMORY);
+
+        OE_CHECK_MSG(
+            oe_switchless_get_numa_node_cpus(
+                *numa_node,
+                node_cpus,
+                OE_SWITCHLESS_MAX_NUMA_NODE_CPUS,
+                &num_node_cpus),
+            "Failed to get the CPUs of NUMA node %u",
+            *numa_node);
+    }
+
+    // Allocate memory for the manager and its arrays. The worker contexts are
+    // cache-line aligned so that each one occupies a line of its own.
     manager = calloc(1, sizeof(oe_switchless_call_manager_t));
     if (manager == NULL)
         OE_RAISE(OE_OUT_OF_MEMORY);
 
-    host_contexts = calloc(num_host_workers, sizeof(oe_host_worker_context_t));
+    host_contexts = oe_switchless_alloc_shared(
+        num_host_workers * sizeof(oe_host_worker_context_t), numa_node);
     if (host_contexts == NULL)
         OE_RAISE(OE_OUT_OF_MEMORY);
 
@@ -229,8 +778,8 @@ oe_result_t oe_start_switchless_manager(
     if (host_threads == NULL)
         OE_RAISE(OE_OUT_OF_MEMORY);
 
-    enclave_contexts =
-        calloc(num_enclave_workers, sizeof(oe_enclave_worker_context_t));
+    enclave_contexts = oe_switchless_alloc_shared(
+        num_enclave_workers * sizeof(oe_enclave_worker_context_t), numa_node);
     if (enclave_contexts == NULL)
         OE_RAISE(OE_OUT_OF_MEMORY);
 
@@ -238,18 +787,83 @@ oe_result_t oe_start_switchless_manager(
     if (enclave_threads == NULL)
         OE_RAISE(OE_OUT_OF_MEMORY);
 
+    host_counters = oe_switchless_alloc_shared(
+        num_host_workers * sizeof(oe_switchless_worker_counters_t), numa_node);
+    if (host_counters == NULL)
+        OE_RAISE(OE_OUT_OF_MEMORY);
+
+    enclave_counters = oe_switchless_alloc_shared(
+        num_enclave_workers * sizeof(oe_switchless_worker_counters_t),
+        numa_node);
+    if (enclave_counters == NULL)
+        OE_RAISE(OE_OUT_OF_MEMORY);
+
+    // Round the ring depth up to a power of two so that the enclave can mask
+    // positions into the slot array.
+    if (num_host_workers > 0 && setting->ocall_ring_depth > 0)
+    {
+        ocall_ring_depth = 1;
+        while (ocall_ring_depth < setting->ocall_ring_depth &&
+               ocall_ring_depth < OE_SWITCHLESS_OCALL_RING_MAX_DEPTH)
+            ocall_ring_depth <<= 1;
+
+        ocall_ring = _create_ocall_ring(ocall_ring_depth, numa_node);
+        if (ocall_ring == NULL)
+            OE_RAISE(OE_OUT_OF_MEMORY);
+    }
+
+    // Under the adaptive policies, every worker gets a spin controller that
+    // starts out with the fixed budget.
+    if (setting->spin_policy != OE_SWITCHLESS_SPIN_POLICY_FIXED)
+    {
+        host_controllers = oe_switchless_alloc_shared(
+            num_host_workers * sizeof(oe_switchless_spin_controller_t),
+            numa_node);
+        if (host_controllers == NULL)
+            OE_RAISE(OE_OUT_OF_MEMORY);
+
+        enclave_controllers = oe_switchless_alloc_shared(
+            num_enclave_workers * sizeof(oe_switchless_spin_controller_t),
+            numa_node);
+        if (enclave_controllers == NULL)
+            OE_RAISE(OE_OUT_OF_MEMORY);
+
+        for (size_t i = 0; i < num_host_workers; i++)
+            _spin_controller_init(
+                &host_controllers[i], OE_HOST_WORKER_SPIN_COUNT_THRESHOLD);
+
+        for (size_t i = 0; i < num_enclave_workers; i++)
+            _spin_controller_init(
+                &enclave_controllers[i],
+                OE_ENCLAVE_WORKER_SPIN_COUNT_THRESHOLD);
+    }
+
+    manager->spin_policy = (uint32_t)setting->spin_policy;
+    manager->cpu_budget_percent = setting->cpu_budget_percent;
+    manager->host_worker_controllers = host_controllers;
+    manager->enclave_worker_controllers = enclave_controllers;
+    manager->host_worker_counters = host_counters;
+    manager->enclave_worker_counters = enclave_counters;
     manager->num_host_workers = num_host_workers;
     manager->host_worker_contexts = host_contexts;
     manager->host_worker_threads = host_threads;
+    manager->ocall_ring = ocall_ring;
     manager->num_enclave_workers = num_enclave_workers;
     manager->enclave_worker_contexts = enclave_contexts;
     manager->enclave_worker_threads = enclave_threads;
 
+    // Each enclave has at most one switchless manager. Attach it before
+    // starting any worker so that the workers can reach the shared ring, and
+    // so that oe_stop_switchless_manager cleans up if anything below fails.
+    enclave->switchless_manager = manager;
+
     // Start the host worker threads, and assign each one a private context.
     for (size_t i = 0; i < num_host_workers; i++)
     {
         OE_TRACE_INFO("Creating switchless host worker thread %d\n", (int)i);
         manager->host_worker_contexts[i].enc = enclave;
+        manager->host_worker_contexts[i].version =
+            OE_SWITCHLESS_CONTEXT_VERSION;
         if (oe_thread_create(
                 &manager->host_worker_threads[i],
                 _switchless_ocall_worker,
@@ -257,6 +871,14 @@ oe_result_t oe_start_switchless_manager(
         {
             OE_RAISE(OE_THREAD_CREATE_ERROR);
         }
+
+        OE_CHECK(_set_worker_affinity(
+            manager->host_worker_threads[i],
+            i,
+            setting->host_worker_cpus,
+            setting->num_host_worker_cpus,
+            node_cpus,
+            num_node_cpus));
     }
 
     // Inform the enclave about the switchless manager through an ECALL
@@ -268,6 +890,28 @@ oe_result_t oe_start_switchless_manager(
             manager->host_worker_contexts,
             manager->num_host_workers));
         OE_CHECK(result_out);
+
+        if (ocall_ring)
+        {
+            OE_CHECK(oe_sgx_init_switchless_ocall_ring_ecall(
+                enclave, &result_out, ocall_ring, ocall_ring_depth));
+            OE_CHECK(result_out);
+        }
+
+        // The enclave counts the switchless ocalls that it could not post.
+        // Statistics are optional: enclaves built before they were added
+        // do not support them.
+        statistics = oe_switchless_alloc_shared(
+            sizeof(oe_switchless_statistics_t), numa_node);
+        if (statistics == NULL)
+            OE_RAISE(OE_OUT_OF_MEMORY);
+
+        if (oe_sgx_init_switchless_statistics_ecall(
+                enclave, &result_out, statistics) == OE_OK &&
+            result_out == OE_OK)
+            manager->statistics = statistics;
+        else
+            oe_switchless_free_shared(statistics);
     }
 
     // Start the enclave worker threads, and assign each one a private context.
@@ -279,6 +923,8 @@ oe_result_t oe_start_switchless_manager(
         manager->enclave_worker_contexts[i].enc = enclave;
         manager->enclave_worker_contexts[i].spin_count_threshold =
             OE_ENCLAVE_WORKER_SPIN_COUNT_THRESHOLD;
+        manager->enclave_worker_contexts[i].version =
+            OE_SWITCHLESS_CONTEXT_VERSION;
         if (oe_thread_create(
                 &manager->enclave_worker_threads[i],
                 _switchless_ecall_worker,
@@ -287,6 +933,14 @@ oe_result_t oe_start_switchless_manager(
             OE_RAISE(OE_THREAD_CREATE_ERROR);
         }
 
+        OE_CHECK(_set_worker_affinity(
+            manager->enclave_worker_threads[i],
+            i,
+            setting->enclave_worker_cpus,
+            setting->num_enclave_worker_cpus,
+            node_cpus,
+            num_node_cpus));
+
         // Wait until the enclave worker thread has started.
         // If so, spin_count and/or total_spin_count will be non zero.
         // This ensures that each ecall worker thread has a dedicated tcs.
@@ -294,13 +948,16 @@ oe_result_t oe_start_switchless_manager(
             &manager->enclave_worker_contexts[i];
         while (!ctx->spin_count && !ctx->total_spin_count)
         {
+            if (ctx->is_stopping)
+                OE_RAISE_MSG(
+                    OE_UNEXPECTED,
+                    "Switchless enclave worker thread %d failed to start",
+                    (int)i);
+
             oe_yield_cpu();
         }
     }
 
-    // Each enclave has at most one switchless manager.
-    enclave->switchless_manager = manager;
-
     result = OE_OK;
 
 done:
@@ -312,9 +969,28 @@ done:
 
     if (result != OE_OK)
     {
-        oe_stop_switchless_manager(enclave);
+        if (enclave && enclave->switchless_manager == manager)
+        {
+            oe_stop_switchless_manager(enclave);
+        }
+        else if (manager)
+        {
+            // Nothing was started yet. Release the partial allocations.
+            oe_switchless_free_shared(host_contexts);
+            free(host_threads);
+            oe_switchless_free_shared(enclave_contexts);
+            free(enclave_threads);
+            oe_switchless_free_shared(ocall_ring);
+            oe_switchless_free_shared(host_controllers);
+            oe_switchless_free_shared(enclave_controllers);
+            oe_switchless_free_shared(host_counters);
+            oe_switchless_free_shared(enclave_counters);
+            free(manager);
+        }
     }
 
+    free(node_cpus);
+
     return result;
 }
 
@@ -331,13 +1007,25 @@ oe_result_t oe_stop_switchless_manager(oe_enclave_t* enclave)
 
         // Free all allocated buffers.
         if (manager->host_worker_contexts != NULL)
-            free(manager->host_worker_contexts);
+            oe_switchless_free_shared(manager->host_worker_contexts);
         if (manager->host_worker_threads != NULL)
             free(manager->host_worker_threads);
         if (manager->enclave_worker_contexts != NULL)
-            free(manager->enclave_worker_contexts);
+            oe_switchless_free_shared(manager->enclave_worker_contexts);
         if (manager->enclave_worker_threads != NULL)
             free(manager->enclave_worker_threads);
+        if (manager->ocall_ring != NULL)
+            oe_switchless_free_shared(manager->ocall_ring);
+        if (manager->host_worker_controllers != NULL)
+            oe_switchless_free_shared(manager->host_worker_controllers);
+        if (manager->enclave_worker_controllers != NULL)
+            oe_switchless_free_shared(manager->enclave_worker_controllers);
+        if (manager->host_worker_counters != NULL)
+            oe_switchless_free_shared(manager->host_worker_counters);
+        if (manager->enclave_worker_counters != NULL)
+            oe_switchless_free_shared(manager->enclave_worker_counters);
+        if (manager->statistics != NULL)
+            oe_switchless_free_shared(manager->statistics);
         free(manager);
     }
     result = OE_OK;
@@ -345,11 +1033,225 @@ done:
     return result;
 }
 
+/*
+** Copy the counters of the given workers into a newly allocated array. The
+** spin counts are kept in the worker contexts and filled in by the caller.
+*/
+static oe_switchless_worker_statistics_t* _get_worker_statistics(
+    const oe_switchless_worker_counters_t* counters,
+    size_t num_workers)
+{
+    oe_switchless_worker_statistics_t* workers = NULL;
+
+    if (num_workers == 0)
+        return NULL;
+
+    workers = calloc(num_workers, sizeof(oe_switchless_worker_statistics_t));
+    if (workers == NULL)
+        return NULL;
+
+    for (size_t i = 0; i < num_workers; i++)
+    {
+        workers[i].num_calls = counters[i].num_calls;
+        workers[i].busy_time = counters[i].busy_time;
+        workers[i].num_sleeps = counters[i].num_sleeps;
+        workers[i].num_wakes = counters[i].num_wakes;
+    }
+
+    return workers;
+}
+
+oe_result_t oe_get_switchless_call_statistics(
+    oe_enclave_t* enclave,
+    oe_enclave_call_statistics_t* statistics)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_switchless_call_manager_t* manager = enclave->switchless_manager;
+    oe_switchless_worker_statistics_t* host_workers = NULL;
+    oe_switchless_worker_statistics_t* enclave_workers = NULL;
+
+    if (manager == NULL)
+    {
+        result = OE_OK;
+        goto done;
+    }
+
+    host_workers = _get_worker_statistics(
+        manager->host_worker_counters, manager->num_host_workers);
+    if (manager->num_host_workers && host_workers == NULL)
+        OE_RAISE(OE_OUT_OF_MEMORY);
+
+    enclave_workers = _get_worker_statistics(
+        manager->enclave_worker_counters, manager->num_enclave_workers);
+    if (manager->num_enclave_workers && enclave_workers == NULL)
+        OE_RAISE(OE_OUT_OF_MEMORY);
+
+    for (size_t i = 0; i < manager->num_host_workers; i++)
+    {
+        oe_host_worker_context_t* context = &manager->host_worker_contexts[i];
+
+        host_workers[i].spin_count =
+            context->total_spin_count + context->spin_count;
+        statistics->switchless_ocalls.num_hits += host_workers[i].num_calls;
+        statistics->num_wake_ocalls += host_workers[i].num_wakes;
+    }
+
+    for (size_t i = 0; i < manager->num_enclave_workers; i++)
+    {
+        oe_enclave_worker_context_t* context =
+            &manager->enclave_worker_contexts[i];
+
+        enclave_workers[i].spin_count =
+            context->total_spin_count + context->spin_count;
+        statistics->switchless_ecalls.num_hits += enclave_workers[i].num_calls;
+        statistics->num_sleep_ocalls += enclave_workers[i].num_sleeps;
+    }
+
+    statistics->switchless_ecalls.num_fallbacks =
+        oe_atomic_load(&manager->num_ecall_fallbacks);
+    if (manager->statistics)
+        statistics->switchless_ocalls.num_fallbacks =
+            oe_atomic_load(&manager->statistics->num_ocall_fallbacks);
+
+    statistics->switchless_ecalls.num_posts =
+        statistics->switchless_ecalls.num_hits +
+        statistics->switchless_ecalls.num_fallbacks;
+    statistics->switchless_ocalls.num_posts =
+        statistics->switchless_ocalls.num_hits +
+        statistics->switchless_ocalls.num_fallbacks;
+
+    statistics->host_workers = host_workers;
+    statistics->num_host_workers = manager->num_host_workers;
+    statistics->enclave_workers = enclave_workers;
+    statistics->num_enclave_workers = manager->num_enclave_workers;
+    host_workers = NULL;
+    enclave_workers = NULL;
+
+    result = OE_OK;
+
+done:
+    free(host_workers);
+    free(enclave_workers);
+    return result;
+}
+
 void oe_sgx_wake_switchless_worker_ocall(oe_host_worker_context_t* context)
 {
+    oe_switchless_call_manager_t* manager = context->enc->switchless_manager;
+    size_t index = (size_t)(context - manager->host_worker_contexts);
+
+    if (index < manager->num_host_workers)
+        oe_atomic_increment(&manager->host_worker_counters[index].num_wakes);
+
     oe_host_worker_wake(context);
 }
 
+/*
+**==============================================================================
+**
+** _post_switchless_ecall()
+**
+** Post the call to an enclave worker whose slot holds the expected value
+** (NULL for a free worker) and wait for the worker to handle it. Return false
+** if no such worker was found.
+**
+**==============================================================================
+*/
+static bool _post_switchless_ecall(
+    oe_switchless_call_manager_t* manager,
+    void* expected,
+    oe_call_enclave_function_args_t* args)
+{
+    oe_enclave_worker_context_t* contexts = manager->enclave_worker_contexts;
+    oe_switchless_worker_counters_t* counters = NULL;
+    uint64_t start_time = 0;
+
+    // Cycle through the worker contexts until we find a free worker.
+    size_t tries = manager->num_enclave_workers;
+    while (tries--)
+    {
+        // Check if the worker's slot is free.
+        if (contexts[tries].call_arg == expected)
+        {
+            // Try to atomically grab the slot by placing args in the slot.
+            // If the atomic operation was successful, then the worker
+            // thread will execute this switchless ecall. If the atomic
+            // operation failed, this means that the slot was grabbed by
+            // another switchless ocall and therefore, we must scan for
+            // another worker thread with a free slot.
+            if (oe_atomic_compare_and_swap_ptr(
+                    (void* volatile*)&contexts[tries].call_arg,
+                    expected,
+                    args))
+            {
+                counters = &manager->enclave_worker_counters[tries];
+                start_time = oe_switchless_get_monotonic_time();
+
+                // The worker thread has been marked to execute this
+                // switchless call. Determine if it needs to be woken up or
+                // not.
+                //
+                // If event is 0, it means that it has gone to sleep. Wake
+                // it by making an ocall
+                // (oe_sgx_wake_switchless_worker_ocall). Note: it is
+                // important to use an atomic cas operation to set the value
+                // to 1 before making the ocall. Setting the value to 1
+                // prevents the host worker from simulataneously going to
+                // sleep. If instead, just a compare operation is used to
+                // determine if the host thread is sleeping or not, the host
+                // thread could go to sleep after the enclave has determined
+                // that the host is not sleeping, causing a deadlock.
+                //
+                // If event is 1, that indicates a pending wake
+                // notification.
+                int64_t oldval = 0;
+                int64_t newval = 1;
+                // Weak operation could sporadically fail.
+                // We need a strong operation.
+                if (oe_atomic_compare_and_swap(
+                        &contexts[tries].event, oldval, newval))
+                {
+                    // The previous value of the event was 0 which means
+                    // that the worker was previously sleeping. Wake it.
+                    oe_atomic_increment(&counters->num_wakes);
+                    oe_enclave_worker_wake(&contexts[tries]);
+                }
+                else if (manager->enclave_worker_controllers)
+                {
+                    // The worker was spinning. Report how long it waited
+                    // for this call to its spin controller.
+                    oe_switchless_spin_controller_t* controller =
+                        &manager->enclave_worker_controllers[tries];
+
+                    controller->posted_gap = contexts[tries].spin_count;
+                    oe_atomic_increment(&controller->num_posted_calls);
+                }
+
+                // Wait for the  call to complete.
+                while (true)
+                {
+                    if (oe_atomic_load((uint64_t*)&contexts[tries].call_arg) !=
+                        (uint64_t)args)
+                        break;
+
+                    /* Yield CPU */
+                    oe_yield_cpu();
+                }
+
+                // The next caller may already be using the worker. Update
+                // its counters atomically.
+                oe_atomic_increment(&counters->num_calls);
+                oe_atomic_add(
+                    &counters->busy_time,
+                    oe_switchless_get_monotonic_time() - start_time);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
 /*
 **==============================================================================
 **
@@ -372,8 +1274,6 @@ static oe_result_t _switchless_call_enclave_function_impl(
     bool switchless_call_posted = false;
     oe_call_enclave_function_args_t args;
     oe_switchless_call_manager_t* manager = enclave->switchless_manager;
-    oe_enclave_worker_context_t* contexts = NULL;
-    size_t tries = 0;
 
     /* Reject invalid parameters */
     if (!enclave)
@@ -393,78 +1293,23 @@ static oe_result_t _switchless_call_enclave_function_impl(
     /* Do the switchless ECALL only if the manager is initialized. */
     if (manager)
     {
-        contexts = manager->enclave_worker_contexts;
         // Schedule the switchless call.
         OE_ATOMIC_MEMORY_BARRIER_RELEASE();
         args.result = __OE_RESULT_MAX; // Means the call hasn't been processed.
 
-        // Cycle through the worker contexts until we find a free worker.
-        tries = manager->num_enclave_workers;
-        while (tries--)
-        {
-            // Check if the worker's slot is free.
-            if (contexts[tries].call_arg == NULL)
-            {
-                // Try to atomically grab the slot by placing args in the slot.
-                // If the atomic operation was successful, then the worker
-                // thread will execute this switchless ecall. If the atomic
-                // operation failed, this means that the slot was grabbed by
-                // another switchless ocall and therefore, we must scan for
-                // another worker thread with a free slot.
-                if (oe_atomic_compare_and_swap_ptr(
-                        (void* volatile*)&contexts[tries].call_arg,
-                        NULL,
-                        &args))
-                {
-                    // The worker thread has been marked to execute this
-                    // switchless call. Determine if it needs to be woken up or
-                    // not.
-                    //
-                    // If event is 0, it means that it has gone to sleep. Wake
-                    // it by making an ocall
-                    // (oe_sgx_wake_switchless_worker_ocall). Note: it is
-                    // important to use an atomic cas operation to set the value
-                    // to 1 before making the ocall. Setting the value to 1
-                    // prevents the host worker from simulataneously going to
-                    // sleep. If instead, just a compare operation is used to
-                    // determine if the host thread is sleeping or not, the host
-                    // thread could go to sleep after the enclave has determined
-                    // that the host is not sleeping, causing a deadlock.
-                    //
-                    // If event is 1, that indicates a pending wake
-                    // notification.
-                    int64_t oldval = 0;
-                    int64_t newval = 1;
-                    // Weak operation could sporadically fail.
-                    // We need a strong operation.
-                    if (oe_atomic_compare_and_swap(
-                            &contexts[tries].event, oldval, newval))
-                    {
-                        // The previous value of the event was 0 which means
-                        // that the worker was previously sleeping. Wake it.
-                        oe_enclave_worker_wake(&contexts[tries]);
-                    }
-
-                    switchless_call_posted = true;
-                    // Wait for the  call to complete.
-                    while (true)
-                    {
-                        if (oe_atomic_load(
-                                (uint64_t*)&contexts[tries].call_arg) !=
-                            (uint64_t)&args)
-                            break;
-
-                        /* Yield CPU */
-                        oe_yield_cpu();
-                    }
-                    break;
-                }
-            }
-        }
+        // Post to a free worker. If every active worker is busy, revive a
+        // retired one.
+        switchless_call_posted =
+            _post_switchless_ecall(manager, NULL, &args) ||
+            _post_switchless_ecall(
+                manager, OE_SWITCHLESS_WORKER_RETIRED, &args);
     }
 
     if (!switchless_call_posted)
     {
+        if (manager)
+            oe_atomic_increment(&manager->num_ecall_fallbacks);
+
         // Dispatch as normal ecall.
         OE_CHECK(oe_ecall(
             enclave, OE_ECALL_CALL_ENCLAVE_FUNCTION, (uint64_t)&args, NULL));
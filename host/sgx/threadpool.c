@@ -0,0 +1,172 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include "threadpool.h"
+#include <openenclave/internal/atomic.h>
+#include <openenclave/internal/calls.h>
+#include <openenclave/internal/raise.h>
+#include <openenclave/internal/trace.h>
+#include <stdlib.h>
+#include "../hostthread.h"
+#include "enclave.h"
+
+/*
+**==============================================================================
+**
+** The thread pool.
+**
+**     Each thread of the pool makes a single OE_ECALL_THREAD_POOL_WORKER,
+**     which keeps its TCS until OE_ECALL_STOP_THREAD_POOL. The enclave runs
+**     its pthreads and parallel loops on these threads (see
+**     enclave/core/sgx/threadpool.c), so it needs no ecall per thread or
+**     task.
+**
+**==============================================================================
+*/
+
+typedef struct _oe_thread_pool_worker
+{
+    oe_enclave_t* enclave;
+    oe_thread_t thread;
+    bool created;
+
+    /* Set by the thread once it has left the enclave */
+    volatile bool exited;
+
+    /* The enclave sets args.started once the thread has entered it */
+    oe_thread_pool_worker_args_t args;
+} oe_thread_pool_worker_t;
+
+typedef struct _oe_thread_pool
+{
+    oe_thread_pool_worker_t* workers;
+    size_t num_workers;
+} oe_thread_pool_t;
+
+static void* _thread_pool_worker(void* arg)
+{
+    oe_thread_pool_worker_t* worker = (oe_thread_pool_worker_t*)arg;
+    uint64_t result_out = 0;
+
+    if (oe_ecall(
+            worker->enclave,
+            OE_ECALL_THREAD_POOL_WORKER,
+            (uint64_t)&worker->args,
+            &result_out) != OE_OK ||
+        (oe_result_t)result_out != OE_OK)
+    {
+        OE_TRACE_ERROR("Thread pool worker thread failed\n");
+    }
+
+    // This also releases oe_start_thread_pool from waiting on the thread.
+    worker->exited = true;
+
+    return NULL;
+}
+
+oe_result_t oe_start_thread_pool(
+    oe_enclave_t* enclave,
+    const oe_enclave_setting_thread_pool_t* setting)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_thread_pool_t* pool = NULL;
+    uint64_t result_out = 0;
+
+    if (!enclave || !setting || setting->num_threads == 0 ||
+        enclave->thread_pool)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    // Leave at least one TCS to the ecalls.
+    if (setting->num_threads >= enclave->num_bindings)
+        OE_RAISE_MSG(
+            OE_INVALID_PARAMETER,
+            "The thread pool needs %u TCSs, but the enclave only has %zu, one "
+            "of which must remain available to ecalls",
+            setting->num_threads,
+            enclave->num_bindings);
+
+    OE_CHECK(oe_ecall(
+        enclave,
+        OE_ECALL_INIT_THREAD_POOL,
+        setting->num_threads,
+        &result_out));
+    OE_CHECK((oe_result_t)result_out);
+
+    if (!(pool = (oe_thread_pool_t*)calloc(1, sizeof(oe_thread_pool_t))) ||
+        !(pool->workers = (oe_thread_pool_worker_t*)calloc(
+              setting->num_threads, sizeof(oe_thread_pool_worker_t))))
+    {
+        free(pool);
+        OE_RAISE(OE_OUT_OF_MEMORY);
+    }
+
+    pool->num_workers = setting->num_threads;
+    enclave->thread_pool = pool;
+
+    for (size_t i = 0; i < pool->num_workers; i++)
+    {
+        volatile oe_thread_pool_worker_t* worker = &pool->workers[i];
+
+        pool->workers[i].enclave = enclave;
+        if (oe_thread_create(
+                &pool->workers[i].thread,
+                _thread_pool_worker,
+                &pool->workers[i]) != 0)
+            OE_RAISE(OE_THREAD_CREATE_ERROR);
+
+        pool->workers[i].created = true;
+
+        // Wait until the thread has entered the enclave, which ensures that
+        // it has a dedicated TCS.
+        while (!oe_atomic_load((volatile uint64_t*)&worker->args.started))
+        {
+            if (worker->exited)
+                OE_RAISE_MSG(
+                    OE_UNEXPECTED,
+                    "Thread pool worker thread %d failed to start",
+                    (int)i);
+
+            oe_yield_cpu();
+        }
+    }
+
+    result = OE_OK;
+
+done:
+    if (result != OE_OK && enclave && enclave->thread_pool)
+        oe_stop_thread_pool(enclave);
+
+    return result;
+}
+
+oe_result_t oe_stop_thread_pool(oe_enclave_t* enclave)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_thread_pool_t* pool = enclave->thread_pool;
+
+    if (!pool)
+    {
+        result = OE_OK;
+        goto done;
+    }
+
+    // The threads that are still running enclave threads leave once these
+    // return.
+    OE_CHECK(oe_ecall(enclave, OE_ECALL_STOP_THREAD_POOL, 0, NULL));
+
+    for (size_t i = 0; i < pool->num_workers; i++)
+    {
+        if (pool->workers[i].created &&
+            oe_thread_join(pool->workers[i].thread))
+            OE_RAISE(OE_THREAD_JOIN_ERROR);
+    }
+
+    enclave->thread_pool = NULL;
+    free(pool->workers);
+    free(pool);
+
+    result = OE_OK;
+
+done:
+    return result;
+}
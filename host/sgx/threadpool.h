@@ -0,0 +1,18 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#ifndef _OE_HOST_THREADPOOL_H
+#define _OE_HOST_THREADPOOL_H
+
+#include <openenclave/host.h>
+
+/* Start the threads of the thread pool of the enclave and wait until each
+ * has entered the enclave */
+oe_result_t oe_start_thread_pool(
+    oe_enclave_t* enclave,
+    const oe_enclave_setting_thread_pool_t* setting);
+
+/* Make the threads of the thread pool leave the enclave and join them */
+oe_result_t oe_stop_thread_pool(oe_enclave_t* enclave);
+
+#endif /* _OE_HOST_THREADPOOL_H */
@@ -0,0 +1,167 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/internal/atomic.h>
+#include <openenclave/internal/time.h>
+#if defined(__linux__)
+#include <time.h>
+#include <x86intrin.h>
+#elif defined(_WIN32)
+#include <Windows.h>
+#include <intrin.h>
+#endif
+#include "../hostthread.h"
+#include "cpuid.h"
+#include "ocalls/ocalls.h"
+
+/*
+**==============================================================================
+**
+** The time page.
+**
+**     A single page serves all the enclaves of the process. It is updated
+**     when an enclave asks for it with OE_OCALL_GET_TIME_PAGE, which the
+**     enclave does on its first clock read and then whenever it would have to
+**     interpolate too far (see enclave/core/sgx/timepage.c). The TSC
+**     frequency is measured against the raw monotonic clock, over a longer
+**     interval with each update.
+**
+**==============================================================================
+*/
+
+#define CPUID_ADVANCED_POWER_MANAGEMENT_LEAF 0x80000007
+#define CPUID_INVARIANT_TSC_MASK 0x100
+
+/* Length of the first measurement of the TSC frequency in nanoseconds */
+#define CALIBRATION_TIME 10000000
+
+static OE_ALIGNED(64) oe_time_page_t _page;
+static oe_mutex _lock;
+static oe_once_type _once = OE_H_ONCE_INITIALIZER;
+static bool _tsc_invariant;
+
+/* The TSC and raw monotonic clock of the first update */
+static uint64_t _base_tsc;
+static uint64_t _base_raw;
+
+#if defined(_WIN32)
+/* 100-ns ticks from 1601-01-01 to 1970-01-01 (UTC) */
+#define POSIX_TO_WINDOWS_EPOCH_TICKS 0x19DB1DED53E8000ULL
+#endif
+
+static void _read_clocks(
+    uint64_t* realtime,
+    uint64_t* monotonic,
+    uint64_t* monotonic_raw)
+{
+#if defined(__linux__)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    *realtime = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    *monotonic = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    *monotonic_raw = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#elif defined(_WIN32)
+    FILETIME ft;
+    ULARGE_INTEGER x;
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    uint64_t ticks;
+    uint64_t rate;
+
+    GetSystemTimePreciseAsFileTime(&ft);
+    x.u.LowPart = ft.dwLowDateTime;
+    x.u.HighPart = ft.dwHighDateTime;
+    *realtime = (x.QuadPart - POSIX_TO_WINDOWS_EPOCH_TICKS) * 100;
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    ticks = (uint64_t)counter.QuadPart;
+    rate = (uint64_t)frequency.QuadPart;
+
+    /* Windows has no slewed monotonic clock */
+    *monotonic = ticks / rate * 1000000000 + ticks % rate * 1000000000 / rate;
+    *monotonic_raw = *monotonic;
+#endif
+}
+
+static void _initialize(void)
+{
+    unsigned int eax = 0;
+    unsigned int ebx = 0;
+    unsigned int ecx = 0;
+    unsigned int edx = 0;
+
+    oe_mutex_init(&_lock);
+
+    /* Interpolation needs a TSC with a constant rate in all power states */
+    oe_get_cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= CPUID_ADVANCED_POWER_MANAGEMENT_LEAF)
+    {
+        oe_get_cpuid(
+            CPUID_ADVANCED_POWER_MANAGEMENT_LEAF, 0, &eax, &ebx, &ecx, &edx);
+        _tsc_invariant = (edx & CPUID_INVARIANT_TSC_MASK) != 0;
+    }
+
+    _page.magic = OE_TIME_PAGE_MAGIC;
+}
+
+static void _update(void)
+{
+    uint64_t realtime;
+    uint64_t monotonic;
+    uint64_t monotonic_raw;
+    uint64_t tsc = 0;
+    uint64_t tsc_mult = 0;
+
+    if (_tsc_invariant)
+    {
+        if (!_base_tsc)
+        {
+            _read_clocks(&realtime, &monotonic, &_base_raw);
+            _base_tsc = __rdtsc();
+
+            do
+                _read_clocks(&realtime, &monotonic, &monotonic_raw);
+            while (monotonic_raw - _base_raw < CALIBRATION_TIME);
+        }
+
+        _read_clocks(&realtime, &monotonic, &monotonic_raw);
+        tsc = __rdtsc();
+
+        /* Nanoseconds per tick in 32.32 fixed point */
+        tsc_mult = (uint64_t)(
+            (double)(monotonic_raw - _base_raw) /
+            (double)(tsc - _base_tsc) * 4294967296.0);
+    }
+    else
+    {
+        _read_clocks(&realtime, &monotonic, &monotonic_raw);
+    }
+
+    /* An odd sequence tells the readers that the update is in progress. The
+     * increments are full barriers. */
+    oe_atomic_increment(&_page.sequence);
+    _page.tsc = tsc;
+    _page.tsc_mult = tsc_mult;
+    _page.realtime = realtime;
+    _page.monotonic = monotonic;
+    _page.monotonic_raw = monotonic_raw;
+    oe_atomic_increment(&_page.sequence);
+}
+
+void oe_handle_get_time_page(uint64_t arg_in, uint64_t* arg_out)
+{
+    OE_UNUSED(arg_in);
+
+    oe_once(&_once, _initialize);
+
+    oe_mutex_lock(&_lock);
+    _update();
+    oe_mutex_unlock(&_lock);
+
+    if (arg_out)
+        *arg_out = (uint64_t)&_page;
+}
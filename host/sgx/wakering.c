@@ -0,0 +1,241 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include "wakering.h"
+#include <openenclave/internal/atomic.h>
+#include <openenclave/internal/calls.h>
+#include <openenclave/internal/raise.h>
+#include <openenclave/internal/wakering.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../hostthread.h"
+#include "../memalign.h"
+#include "enclave.h"
+#include "ocalls/ocalls.h"
+
+/*
+**==============================================================================
+**
+** The wake ring.
+**
+**     The helper thread consumes the wake requests posted by the enclave (see
+**     include/openenclave/internal/wakering.h) and makes the same futex (or
+**     event) calls as OE_OCALL_THREAD_WAKE would. When idle for spin_count
+**     polls, it sleeps until a thread of the enclave blocks, which is when
+**     the next wake request is to be expected.
+**
+**==============================================================================
+*/
+
+#define DEFAULT_SPIN_COUNT 4096
+
+typedef struct _oe_wake_ring_helper
+{
+    oe_enclave_t* enclave;
+    oe_wake_ring_t* ring;
+    uint64_t num_slots;
+    uint32_t spin_count;
+    oe_thread_t thread;
+
+    /* Number of wakes made, written by the helper thread only */
+    volatile uint64_t num_wakes;
+} oe_wake_ring_helper_t;
+
+/* The states fit in the low half of the state word, which is the one waited
+ * on (x86 is little-endian) */
+static void _wait_while_sleeping(volatile uint64_t* state)
+{
+    while (*state == OE_WAKE_RING_SLEEPING)
+        oe_wait_on_address(
+            (volatile uint32_t*)state,
+            OE_WAKE_RING_SLEEPING,
+            OE_H_WAIT_INFINITE);
+}
+
+static void _wake_sleeping(volatile uint64_t* state)
+{
+    oe_wake_by_address((volatile uint32_t*)state);
+}
+
+/* Change the state of the helper from old to new, if it is old */
+static bool _set_state(oe_wake_ring_t* ring, uint64_t old, uint64_t new_state)
+{
+    return oe_atomic_compare_and_swap(
+        (volatile int64_t*)&ring->state, (int64_t)old, (int64_t)new_state);
+}
+
+static void* _helper_thread(void* arg)
+{
+    oe_wake_ring_helper_t* helper = (oe_wake_ring_helper_t*)arg;
+    oe_wake_ring_t* ring = helper->ring;
+    const uint64_t mask = helper->num_slots - 1;
+    uint64_t head = ring->head;
+    uint64_t stop_tail = 0;
+    bool stopped = false;
+    uint32_t idle = 0;
+
+    for (;;)
+    {
+        volatile uint64_t* slot = &ring->slots[head & mask];
+        uint64_t value;
+
+        // Once stopped, drain the tickets claimed before the enclave could
+        // see it, which the tail read after the state includes.
+        if (!stopped &&
+            oe_atomic_load(&ring->state) == OE_WAKE_RING_STOPPED)
+        {
+            stopped = true;
+            stop_tail = oe_atomic_load(&ring->tail);
+        }
+
+        if (stopped && head == stop_tail)
+            break;
+
+        if (head == oe_atomic_load(&ring->tail))
+        {
+            if (++idle < helper->spin_count)
+            {
+                oe_yield_cpu();
+                continue;
+            }
+
+            // Announce the sleep before checking the tail one last time.
+            // The enclave claims a ticket before checking the state, so
+            // either this thread sees the ticket or the enclave sees it
+            // sleep.
+            idle = 0;
+            if (_set_state(ring, OE_WAKE_RING_RUNNING, OE_WAKE_RING_SLEEPING))
+            {
+                if (head == oe_atomic_load(&ring->tail))
+                    _wait_while_sleeping(&ring->state);
+                else
+                    _set_state(
+                        ring, OE_WAKE_RING_SLEEPING, OE_WAKE_RING_RUNNING);
+            }
+
+            continue;
+        }
+
+        // A ticket was claimed. Wait for the enclave to fill its slot. An
+        // enclave that aborted after claiming the ticket never fills it, so
+        // give up once the ring is stopped and the slot stays empty.
+        for (uint32_t polls = 0; (value = *slot) == 0; oe_yield_cpu())
+        {
+            if (oe_atomic_load(&ring->state) == OE_WAKE_RING_STOPPED &&
+                ++polls >= helper->spin_count)
+                return NULL;
+        }
+
+        *slot = 0;
+        ring->head = ++head;
+        idle = 0;
+
+        if (value != OE_WAKE_RING_CANCELLED)
+        {
+            HandleThreadWake(helper->enclave, value);
+            helper->num_wakes++;
+        }
+    }
+
+    return NULL;
+}
+
+oe_result_t oe_start_wake_ring(
+    oe_enclave_t* enclave,
+    const oe_enclave_setting_wake_ring_t* setting)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    oe_wake_ring_helper_t* helper = NULL;
+    uint64_t num_slots;
+    uint64_t result_out = 0;
+
+    if (!enclave || !setting || enclave->wake_ring_helper)
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    num_slots = setting->num_slots ? setting->num_slots
+                                   : OE_WAKE_RING_DEFAULT_SLOTS;
+    if (num_slots > OE_WAKE_RING_MAX_SLOTS || (num_slots & (num_slots - 1)))
+        OE_RAISE(OE_INVALID_PARAMETER);
+
+    if (!(helper = (oe_wake_ring_helper_t*)calloc(1, sizeof(*helper))))
+        OE_RAISE(OE_OUT_OF_MEMORY);
+
+    if (!(helper->ring = (oe_wake_ring_t*)oe_memalign(
+              64, OE_WAKE_RING_SIZE(num_slots))))
+        OE_RAISE(OE_OUT_OF_MEMORY);
+
+    memset(helper->ring, 0, OE_WAKE_RING_SIZE(num_slots));
+    helper->ring->num_slots = num_slots;
+    helper->ring->state = OE_WAKE_RING_RUNNING;
+    helper->enclave = enclave;
+    helper->num_slots = num_slots;
+    helper->spin_count =
+        setting->spin_count ? setting->spin_count : DEFAULT_SPIN_COUNT;
+
+    if (oe_thread_create(&helper->thread, _helper_thread, helper) != 0)
+        OE_RAISE(OE_THREAD_CREATE_ERROR);
+
+    enclave->wake_ring_helper = helper;
+
+    // Hand the ring to the enclave. Until then, wakes are made with ocalls.
+    OE_CHECK(oe_ecall(
+        enclave, OE_ECALL_INIT_WAKE_RING, (uint64_t)helper->ring, &result_out));
+    OE_CHECK((oe_result_t)result_out);
+
+    helper = NULL;
+    result = OE_OK;
+
+done:
+    if (helper)
+    {
+        if (enclave->wake_ring_helper == helper)
+        {
+            oe_stop_wake_ring(enclave);
+        }
+        else
+        {
+            oe_memalign_free(helper->ring);
+            free(helper);
+        }
+    }
+
+    return result;
+}
+
+void oe_stop_wake_ring(oe_enclave_t* enclave)
+{
+    oe_wake_ring_helper_t* helper = enclave->wake_ring_helper;
+
+    if (!helper)
+        return;
+
+    enclave->wake_ring_helper = NULL;
+
+    while (!_set_state(
+               helper->ring, OE_WAKE_RING_RUNNING, OE_WAKE_RING_STOPPED) &&
+           !_set_state(
+               helper->ring, OE_WAKE_RING_SLEEPING, OE_WAKE_RING_STOPPED))
+        ;
+
+    _wake_sleeping(&helper->ring->state);
+    oe_thread_join(helper->thread);
+
+    oe_memalign_free(helper->ring);
+    free(helper);
+}
+
+void oe_notify_wake_ring(oe_enclave_t* enclave)
+{
+    oe_wake_ring_helper_t* helper = enclave->wake_ring_helper;
+
+    if (helper && helper->ring->state == OE_WAKE_RING_SLEEPING &&
+        _set_state(helper->ring, OE_WAKE_RING_SLEEPING, OE_WAKE_RING_RUNNING))
+        _wake_sleeping(&helper->ring->state);
+}
+
+uint64_t oe_get_num_ring_wakes(oe_enclave_t* enclave)
+{
+    oe_wake_ring_helper_t* helper = enclave->wake_ring_helper;
+
+    return helper ? helper->num_wakes : 0;
+}
@@ -0,0 +1,25 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#ifndef _OE_HOST_WAKERING_H
+#define _OE_HOST_WAKERING_H
+
+#include <openenclave/host.h>
+
+/* Set up the wake ring of the enclave and start its helper thread */
+oe_result_t oe_start_wake_ring(
+    oe_enclave_t* enclave,
+    const oe_enclave_setting_wake_ring_t* setting);
+
+/* Stop the helper thread, once the enclave no longer runs, and release the
+ * ring */
+void oe_stop_wake_ring(oe_enclave_t* enclave);
+
+/* Make sure that the helper thread is polling the ring, as a thread of the
+ * enclave is about to block */
+void oe_notify_wake_ring(oe_enclave_t* enclave);
+
+/* Number of wakes made through the ring */
+uint64_t oe_get_num_ring_wakes(oe_enclave_t* enclave);
+
+#endif /* _OE_HOST_WAKERING_H */
@@ -127,27 +127,13 @@ int __oe_host_stack_bridge(
     return ret;
 }
 
-/**
- * Size of ocall buffers passed in ecall_contexts. Large enough for most ocalls.
- * If an ocall requires more than this size, then the enclave will make an
- * ocall to allocate the buffer instead of using the ecall_context's buffer.
- * Note: Currently, quotes are about 10KB.
- */
-#define OE_DEFAULT_OCALL_BUFFER_SIZE (16 * 1024)
-
 /**
  * Setup the ecall_context.
  */
 OE_INLINE void _setup_ecall_context(oe_ecall_context_t* ecall_context)
 {
     oe_thread_binding_t* binding = oe_get_thread_binding();
-    if (binding->ocall_buffer == NULL)
-    {
-        // Lazily allocate buffer for making ocalls. Bound to the tcs.
-        // Will be cleaned up by enclave during termination.
-        binding->ocall_buffer = malloc(OE_DEFAULT_OCALL_BUFFER_SIZE);
-        binding->ocall_buffer_size = OE_DEFAULT_OCALL_BUFFER_SIZE;
-    }
+    oe_prepare_ocall_buffer(binding);
     ecall_context->ocall_buffer = binding->ocall_buffer;
     ecall_context->ocall_buffer_size = binding->ocall_buffer_size;
 }
@@ -47,3 +47,73 @@ void oe_enclave_worker_wake(oe_enclave_worker_context_t* context)
 {
     _worker_wake(&context->event);
 }
+
+oe_result_t oe_switchless_get_numa_node_cpus(
+    uint32_t node,
+    uint32_t* cpus,
+    size_t max_cpus,
+    size_t* num_cpus)
+{
+    GROUP_AFFINITY affinity = {0};
+    size_t count = 0;
+
+    if (!cpus || !num_cpus || node > MAXUSHORT)
+        return OE_INVALID_PARAMETER;
+
+    *num_cpus = 0;
+
+    if (!GetNumaNodeProcessorMaskEx((USHORT)node, &affinity) ||
+        affinity.Mask == 0)
+        return OE_NOT_FOUND;
+
+    // Affinity masks address the processors of a single processor group.
+    for (uint32_t cpu = 0; cpu < sizeof(affinity.Mask) * 8 && count < max_cpus;
+         cpu++)
+    {
+        if (affinity.Mask & ((KAFFINITY)1 << cpu))
+            cpus[count++] = cpu;
+    }
+
+    *num_cpus = count;
+    return OE_OK;
+}
+
+void* oe_switchless_alloc_shared(size_t size, const uint32_t* numa_node)
+{
+    // VirtualAlloc returns zero-filled, page-aligned memory.
+    if (size == 0)
+        size = 1;
+
+    if (numa_node)
+        return VirtualAllocExNuma(
+            GetCurrentProcess(),
+            NULL,
+            size,
+            MEM_RESERVE | MEM_COMMIT,
+            PAGE_READWRITE,
+            *numa_node);
+
+    return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void oe_switchless_free_shared(void* ptr)
+{
+    if (ptr)
+        VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+uint64_t oe_switchless_get_monotonic_time(void)
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+
+    QueryPerformanceCounter(&counter);
+
+    // Split the conversion to avoid overflowing the intermediate product.
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL /
+               (uint64_t)frequency.QuadPart;
+}
@@ -34,6 +34,28 @@ int oe_thread_join(oe_thread_t thread)
     return OE_EINVAL;
 }
 
+int oe_thread_set_affinity(
+    oe_thread_t thread,
+    const uint32_t* cpus,
+    size_t num_cpus)
+{
+    DWORD_PTR mask = 0;
+
+    if (!cpus || num_cpus == 0)
+        return OE_EINVAL;
+
+    // Only the processors of the thread's current processor group can be
+    // addressed through the affinity mask.
+    for (size_t i = 0; i < num_cpus; i++)
+    {
+        if (cpus[i] >= sizeof(DWORD_PTR) * 8)
+            return OE_EINVAL;
+        mask |= (DWORD_PTR)1 << cpus[i];
+    }
+
+    return SetThreadAffinityMask((HANDLE)thread, mask) == 0 ? OE_EINVAL : 0;
+}
+
 oe_thread_t oe_thread_self(void)
 {
     return (oe_thread_t)GetCurrentThreadId();
@@ -152,3 +174,57 @@ void* oe_thread_getspecific(oe_thread_key key)
 {
     return TlsGetValue(key);
 }
+
+/*
+**==============================================================================
+**
+** oe_wait_on_address
+**
+**==============================================================================
+*/
+
+void oe_wait_on_address(
+    volatile uint32_t* address,
+    uint32_t value,
+    uint64_t timeout)
+{
+    DWORD milliseconds = INFINITE;
+
+    // Round up, and keep finite timeouts short of INFINITE.
+    if (timeout != OE_H_WAIT_INFINITE)
+    {
+        uint64_t ms = timeout / 1000000 + (timeout % 1000000 != 0);
+        milliseconds = ms < INFINITE ? (DWORD)ms : INFINITE - 1;
+    }
+
+    WaitOnAddress(address, &value, sizeof(value), milliseconds);
+}
+
+void oe_wake_by_address(volatile uint32_t* address)
+{
+    WakeByAddressSingle((PVOID)address);
+}
+
+/*
+**==============================================================================
+**
+** oe_get_monotonic_time
+**
+**==============================================================================
+*/
+
+uint64_t oe_get_monotonic_time(void)
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+
+    QueryPerformanceCounter(&counter);
+
+    // Split the conversion to avoid overflowing the intermediate product.
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL /
+               (uint64_t)frequency.QuadPart;
+}
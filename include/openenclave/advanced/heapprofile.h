@@ -0,0 +1,84 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+/**
+ * @file heapprofile.h
+ *
+ * This file defines the programming interface of the sampling heap profiler.
+ *
+ * Unlike debug malloc, which tracks every block, the heap profiler records a
+ * backtrace for about one allocation per sampling interval, so that it can be
+ * left on in production enclaves. It keeps the number of sampled bytes that
+ * are still in use per call site, and writes them in the heap profile format
+ * of gperftools, which pprof reads:
+ *
+ *     pprof --text enclave.signed heap.prof
+ *
+ */
+
+#ifndef OE_ADVANCED_HEAPPROFILE_H
+#define OE_ADVANCED_HEAPPROFILE_H
+
+#include <openenclave/bits/result.h>
+
+/**
+ * @cond IGNORE
+ */
+OE_EXTERNC_BEGIN
+
+/**
+ * @endcond
+ */
+
+/**
+ * Default mean number of bytes allocated between two samples.
+ */
+#define OE_HEAP_PROFILE_DEFAULT_SAMPLE_INTERVAL (512 * 1024)
+
+/**
+ * Start sampling heap allocations.
+ *
+ * The distance between two samples, in bytes allocated, follows an
+ * exponential distribution, so that pprof can estimate the actual number of
+ * blocks and bytes from the samples. A new session discards the samples of
+ * the previous one.
+ *
+ * @param sample_interval Mean number of bytes allocated between two samples,
+ * or 0 for OE_HEAP_PROFILE_DEFAULT_SAMPLE_INTERVAL. Must not exceed 1 GB.
+ *
+ * @retval OE_OK The profiler was started.
+ * @retval OE_INVALID_PARAMETER The sampling interval is too large.
+ * @retval OE_UNEXPECTED The profiler is already running.
+ * @retval OE_OUT_OF_MEMORY There is not enough memory for the profiler tables.
+ */
+oe_result_t oe_heap_profile_start(size_t sample_interval);
+
+/**
+ * Stop sampling heap allocations.
+ *
+ * @retval OE_OK The profiler was stopped.
+ * @retval OE_UNEXPECTED The profiler is not running.
+ */
+oe_result_t oe_heap_profile_stop(void);
+
+/**
+ * Write the heap profile to a file on the host.
+ *
+ * The profile holds, per call site, the sampled blocks that are still in use
+ * and all the sampled blocks since the profiler was started. The host appends
+ * the location of the enclave image, so that pprof can symbolize it.
+ *
+ * This requires the enclave to import openenclave/edl/sgx/debug.edl.
+ *
+ * @param path Path of the file on the host.
+ *
+ * @retval OE_OK The profile was written.
+ * @retval OE_INVALID_PARAMETER The path is null.
+ * @retval OE_UNEXPECTED The profiler is not running.
+ * @retval OE_UNSUPPORTED The platform or the enclave EDL does not support it.
+ * @retval OE_FAILURE The host failed to write the file.
+ */
+oe_result_t oe_heap_profile_dump(const char* path);
+
+OE_EXTERNC_END
+
+#endif /* OE_ADVANCED_HEAPPROFILE_H */
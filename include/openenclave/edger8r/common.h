@@ -34,6 +34,12 @@ OE_EXTERNC_BEGIN
 
 #define OE_EDGER8R_BUFFER_ALIGNMENT (2 * sizeof(void*))
 
+/**
+ * Flag of oe_call_host_function_batch(): do not make the calls that follow
+ * the first failing call of a batch.
+ */
+#define OE_HOST_FUNCTION_BATCH_STOP_ON_FAILURE 0x1
+
 /**
  * Add a size value, rounding to OE_EDGER8R_BUFFER_ALIGNMENT
  */
@@ -117,6 +117,129 @@ oe_result_t oe_switchless_call_host_function(
     size_t output_buffer_size,
     size_t* output_bytes_written);
 
+/**
+ * A call queued in a batch for oe_call_host_function_batch().
+ *
+ * The caller fills in the function id and the marshaled buffers, which use
+ * the same layout as the buffers passed to oe_call_host_function().
+ */
+typedef struct _oe_host_function_call
+{
+    /** The id of the host function. */
+    size_t function_id;
+
+    /** Buffer containing the input data and its size. */
+    const void* input_buffer;
+    size_t input_buffer_size;
+
+    /** Enclave buffer where the outputs are written and its size. */
+    void* output_buffer;
+    size_t output_buffer_size;
+
+    /** Number of bytes written in the output buffer (set on return). */
+    size_t output_bytes_written;
+
+    /** The result of this call (set on return). */
+    oe_result_t result;
+} oe_host_function_call_t;
+
+/**
+ * Perform a batch of high-level host function calls (OCALLs) with a single
+ * exit from the enclave.
+ *
+ * The inputs of all the calls are copied into one host buffer and the host
+ * makes the calls in order. The outcome of each call is reported in its
+ * **result** field. With OE_HOST_FUNCTION_BATCH_STOP_ON_FAILURE, the host
+ * does not make the calls that follow the first failing one, and their
+ * result is OE_UNEXPECTED.
+ *
+ * @param calls The calls to make.
+ * @param num_calls The number of elements in **calls**.
+ * @param flags Zero or OE_HOST_FUNCTION_BATCH_STOP_ON_FAILURE.
+ *
+ * @return OE_OK the batch was submitted.
+ * @return OE_INVALID_PARAMETER a parameter is invalid.
+ * @return OE_OUT_OF_MEMORY the host buffer could not be allocated.
+ */
+oe_result_t oe_call_host_function_batch(
+    oe_host_function_call_t* calls,
+    size_t num_calls,
+    uint32_t flags);
+
+/**
+ * Handle of an asynchronous switchless host function call.
+ */
+typedef struct _oe_switchless_call oe_switchless_call_t;
+
+/**
+ * Start a high-level host function call (OCALL) switchlessly, without waiting
+ * for it to complete.
+ *
+ * The input data is copied into a completion buffer that is allocated from
+ * the shared memory arena of the calling thread, along with room for the
+ * outputs. The call completes while the enclave thread carries on. If no host
+ * worker is available, the call is made synchronously as a regular OCALL.
+ *
+ * If **call** is NULL, the call is fire-and-forget: its result and outputs
+ * are dropped, so the host function should not return deep-copied outputs.
+ * Otherwise, the caller must pass the returned handle to
+ * oe_switchless_call_wait() to get the outputs and release the handle.
+ *
+ * Outstanding calls are bound to the calling thread and to the current ECALL:
+ * before the ECALL returns to the host, the enclave waits for all of them to
+ * complete and invalidates their handles.
+ *
+ * @param function_id The id of the host function that will be called.
+ * @param input_buffer Buffer containing inputs data.
+ * @param input_buffer_size Size of the input data buffer.
+ * @param output_buffer_size Size of the buffer for the outputs of the host
+ * function.
+ * @param call Optional pointer that receives the handle of the call.
+ *
+ * @return OE_OK the call was started (or made, if it fell back to a regular
+ * OCALL).
+ * @return OE_INVALID_PARAMETER a parameter is invalid.
+ * @return OE_OUT_OF_MEMORY the arena has no room for the completion buffer.
+ */
+oe_result_t oe_switchless_call_host_function_async(
+    size_t function_id,
+    const void* input_buffer,
+    size_t input_buffer_size,
+    size_t output_buffer_size,
+    oe_switchless_call_t** call);
+
+/**
+ * Check whether an asynchronous switchless call has completed, without
+ * blocking.
+ *
+ * @param call The handle returned by oe_switchless_call_host_function_async().
+ *
+ * @return true if the host has completed the call.
+ */
+bool oe_switchless_call_is_complete(const oe_switchless_call_t* call);
+
+/**
+ * Wait for an asynchronous switchless call to complete, get its outputs, and
+ * release its handle.
+ *
+ * @param call The handle returned by oe_switchless_call_host_function_async().
+ * @param output_buffer Optional enclave buffer that receives the outputs of
+ * the host function.
+ * @param output_buffer_size Size of the output buffer.
+ * @param output_bytes_written Optional number of bytes written in the output
+ * buffer.
+ *
+ * @return OE_OK the call was successful.
+ * @return OE_INVALID_PARAMETER a parameter is invalid.
+ * @return OE_BUFFER_TOO_SMALL the output buffer was smaller than the outputs.
+ * @return Any error that oe_switchless_call_host_function() can return.
+ */
+oe_result_t oe_switchless_call_wait(
+    oe_switchless_call_t* call,
+    void* output_buffer,
+    size_t output_buffer_size,
+    size_t* output_bytes_written);
+
 /**
  * Allocate a buffer of given size for doing an ocall.
  *
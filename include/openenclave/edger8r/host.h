@@ -76,6 +76,57 @@ oe_result_t oe_call_enclave_function(
     size_t output_buffer_size,
     size_t* output_bytes_written);
 
+/**
+ * A call submitted as part of a batch with oe_call_enclave_function_batch().
+ *
+ * The caller fills in the function and its marshaled buffers, which use the
+ * same layout as the buffers passed to oe_call_enclave_function().
+ */
+typedef struct _oe_enclave_function_call
+{
+    /** The global id of the enclave function (may be null). */
+    uint64_t* global_id;
+
+    /** The name of the enclave function. */
+    const char* name;
+
+    /** Buffer containing the input data and its size. */
+    const void* input_buffer;
+    size_t input_buffer_size;
+
+    /** Buffer where the outputs are written and its size. */
+    void* output_buffer;
+    size_t output_buffer_size;
+
+    /** Number of bytes written in the output buffer (set on return). */
+    size_t output_bytes_written;
+
+    /** The result of this call (set on return). */
+    oe_result_t result;
+} oe_enclave_function_call_t;
+
+/**
+ * Call a batch of enclave functions with a single enclave transition.
+ *
+ * The functions are called in order on the same enclave thread. The failure
+ * of one call does not stop the following calls; the outcome of each call is
+ * reported in its **result** field, which is only meaningful when this
+ * function returns OE_OK.
+ *
+ * @param enclave The enclave to call into.
+ * @param calls The calls to make.
+ * @param num_calls The number of elements in **calls**.
+ *
+ * @return OE_OK the batch was dispatched.
+ * @return OE_NOT_FOUND a function name does not correspond to a function.
+ * @return OE_INVALID_PARAMETER a parameter is invalid.
+ * @return OE_OUT_OF_MEMORY the batch could not be allocated.
+ */
+oe_result_t oe_call_enclave_function_batch(
+    oe_enclave_t* enclave,
+    oe_enclave_function_call_t* calls,
+    size_t num_calls);
+
 /**
  * Placeholder.
  */
@@ -113,12 +113,45 @@ typedef void (*oe_ocall_func_t)(
 typedef enum _oe_enclave_setting_type
 {
     OE_ENCLAVE_SETTING_CONTEXT_SWITCHLESS = 0xdc73a628,
+    OE_ENCLAVE_SETTING_TCS_ADMISSION = 0x5b0e41c7,
+    OE_ENCLAVE_SETTING_OCALL_BUFFER = 0x3e9f1d52,
+    OE_ENCLAVE_SETTING_WAKE_RING = 0x7a14c9e3,
+    OE_ENCLAVE_SETTING_THREAD_POOL = 0x2c58e0b6,
 #ifdef OE_WITH_EXPERIMENTAL_EEID
     OE_EXTENDED_ENCLAVE_INITIALIZATION_DATA = 0x976a8f66,
 #endif
     OE_SGX_ENCLAVE_CONFIG_DATA = 0x78b5b41d
 } oe_enclave_setting_type_t;
 
+/**
+ * Policies that control how long idle context-switchless workers spin
+ * before they park.
+ */
+typedef enum _oe_switchless_spin_policy
+{
+    /**
+     * Every worker spins a fixed number of iterations before it parks, and
+     * every worker stays active. This is the default.
+     */
+    OE_SWITCHLESS_SPIN_POLICY_FIXED = 0,
+    /**
+     * Each worker tunes its spin budget from the observed gaps between calls:
+     * it spins through short gaps and parks early when gaps are long. Workers
+     * that see little traffic retire, and are brought back only when every
+     * active worker is busy.
+     */
+    OE_SWITCHLESS_SPIN_POLICY_ADAPTIVE = 1,
+    /**
+     * Like OE_SWITCHLESS_SPIN_POLICY_ADAPTIVE, but a worker spends at most
+     * **cpu_budget_percent** of its idle time spinning.
+     */
+    OE_SWITCHLESS_SPIN_POLICY_CPU_BUDGET = 2,
+    /**
+     * Unused.
+     */
+    __OE_SWITCHLESS_SPIN_POLICY_MAX = OE_ENUM_MAX,
+} oe_switchless_spin_policy_t;
+
 /**
  * The setting for context-switchless calls.
  */
@@ -135,8 +168,135 @@ typedef struct _oe_enclave_setting_context_switchless
      * workers should be 0.
      */
     size_t max_enclave_workers;
+    /**
+     * The number of slots in the submission ring for context-switchless
+     * ocalls. When every host worker is busy, enclave threads queue their
+     * calls in the ring (which any host worker drains) instead of falling
+     * back to regular ocalls. The value is rounded up to a power of two and
+     * capped at 4096. The default value 0 disables the ring.
+     */
+    size_t ocall_ring_depth;
+    /**
+     * Optional array of logical CPUs to pin the host worker threads to. Host
+     * worker i is pinned to host_worker_cpus[i % num_host_worker_cpus].
+     */
+    const uint32_t* host_worker_cpus;
+    size_t num_host_worker_cpus;
+    /**
+     * Optional array of logical CPUs to pin the enclave worker threads to.
+     * Enclave worker i is pinned to
+     * enclave_worker_cpus[i % num_enclave_worker_cpus].
+     */
+    const uint32_t* enclave_worker_cpus;
+    size_t num_enclave_worker_cpus;
+    /**
+     * When true, the worker contexts are placed on the NUMA node given by
+     * **numa_node**, and workers without an explicit CPU list are pinned to
+     * the CPUs of that node.
+     */
+    bool pin_to_numa_node;
+    uint32_t numa_node;
+    /**
+     * How idle workers decide between spinning and parking. The default is
+     * OE_SWITCHLESS_SPIN_POLICY_FIXED.
+     */
+    oe_switchless_spin_policy_t spin_policy;
+    /**
+     * The share (1-100) of its idle time that a worker may spend spinning
+     * under OE_SWITCHLESS_SPIN_POLICY_CPU_BUDGET. Ignored by other policies.
+     */
+    uint32_t cpu_budget_percent;
 } oe_enclave_setting_context_switchless_t;
 
+/**
+ * The setting for admitting ecalls when every enclave thread (TCS) is busy.
+ */
+typedef struct _oe_enclave_setting_tcs_admission
+{
+    /**
+     * When true, an ecall that finds every TCS busy waits for one to be
+     * released instead of failing with OE_OUT_OF_THREADS. Waiting ecalls
+     * are admitted in the order in which they arrived.
+     */
+    bool wait_for_tcs;
+    /**
+     * The maximum time in milliseconds that an ecall waits for a TCS. An
+     * ecall that times out fails with OE_OUT_OF_THREADS. The default value 0
+     * waits indefinitely.
+     */
+    uint32_t timeout_ms;
+} oe_enclave_setting_tcs_admission_t;
+
+/**
+ * The setting for the per-thread buffers that hold the parameters of ocalls.
+ *
+ * Each enclave thread (TCS) has a buffer in host memory for the parameters of
+ * its ocalls. Ocalls whose parameters do not fit the buffer need memory
+ * allocated elsewhere. The buffer of a thread grows, from **initial_size** up
+ * to **max_size**, when such ocalls are frequent.
+ */
+typedef struct _oe_enclave_setting_ocall_buffer
+{
+    /**
+     * The initial size of the buffer of each enclave thread, in bytes.
+     * The default value 0 selects 16 KB.
+     */
+    size_t initial_size;
+    /**
+     * The size that the buffers may grow to, in bytes. It must not be
+     * smaller than **initial_size**, and is capped at 1 GB. Set it to
+     * **initial_size** to disable growth. The default value 0 selects the
+     * larger of 1 MB and **initial_size**.
+     */
+    size_t max_size;
+} oe_enclave_setting_ocall_buffer_t;
+
+/**
+ * The setting for waking enclave threads without leaving the enclave.
+ *
+ * An enclave thread that releases a mutex, signals a condition variable or
+ * releases a readers-writer lock that other threads are blocked on normally
+ * makes an ocall to wake them. With this setting, it instead posts the wake
+ * to a ring in host memory, which a host helper thread polls. The helper
+ * sleeps once it has been idle for **spin_count** polls, and is woken again
+ * when an enclave thread blocks. While it sleeps, or when the ring is full,
+ * wakes are made with ocalls.
+ */
+typedef struct _oe_enclave_setting_wake_ring
+{
+    /**
+     * The number of slots of the ring, a power of two no larger than 4096.
+     * The default value 0 selects 256.
+     */
+    uint32_t num_slots;
+    /**
+     * The number of times the idle helper thread polls the ring before it
+     * sleeps. The default value 0 selects 4096.
+     */
+    uint32_t spin_count;
+} oe_enclave_setting_wake_ring_t;
+
+/**
+ * The setting for the thread pool of the enclave.
+ *
+ * The host starts **num_threads** threads that enter the enclave on a TCS
+ * each, and stay there until the enclave is terminated. Unless the enclave
+ * registers pthread hooks, pthread_create() runs the new thread on a free
+ * thread of the pool, and fails with EAGAIN if there is none. The pool also
+ * runs the parallel loops of oe_thread_pool_parallel_for(). The threads
+ * created by pthread_create() on the same thread of the pool share its
+ * __thread and thread_local variables, which are not reset between them.
+ *
+ * The TCSs of the pool are not available to ecalls, so **num_threads** must
+ * be smaller than the NumTCS setting of the enclave. The threads created by
+ * the enclave must have returned by the time the enclave is terminated.
+ */
+typedef struct _oe_enclave_setting_thread_pool
+{
+    /** The number of threads of the pool. */
+    uint32_t num_threads;
+} oe_enclave_setting_thread_pool_t;
+
 /**
  * The setting for config_id/config_svn on Ice Lake platform.
  */
@@ -169,6 +329,10 @@ typedef struct _oe_enclave_setting
         oe_eeid_t* eeid;
 #endif
         const oe_sgx_enclave_setting_config_data* config_data;
+        const oe_enclave_setting_tcs_admission_t* tcs_admission_setting;
+        const oe_enclave_setting_ocall_buffer_t* ocall_buffer_setting;
+        const oe_enclave_setting_wake_ring_t* wake_ring_setting;
+        const oe_enclave_setting_thread_pool_t* thread_pool_setting;
         /* Add new setting types here. */
     } u;
 } oe_enclave_setting_t;
@@ -245,6 +409,140 @@ oe_result_t oe_create_enclave(
  */
 oe_result_t oe_terminate_enclave(oe_enclave_t* enclave);
 
+/**
+ * Counters of a context-switchless worker thread.
+ */
+typedef struct _oe_switchless_worker_statistics
+{
+    /** Number of calls handled by the worker. */
+    uint64_t num_calls;
+    /** Number of iterations the worker spun while waiting for calls. */
+    uint64_t spin_count;
+    /** Time spent handling calls, in nanoseconds. */
+    uint64_t busy_time;
+    /** Number of times the worker went to sleep. */
+    uint64_t num_sleeps;
+    /** Number of times the worker was woken up. */
+    uint64_t num_wakes;
+} oe_switchless_worker_statistics_t;
+
+/**
+ * Counters of context-switchless calls in one direction.
+ */
+typedef struct _oe_switchless_call_statistics
+{
+    /** Number of calls made switchlessly (hits plus fallbacks). */
+    uint64_t num_posts;
+    /** Number of calls handled by a worker. */
+    uint64_t num_hits;
+    /** Number of calls made as regular calls because no worker was free. */
+    uint64_t num_fallbacks;
+} oe_switchless_call_statistics_t;
+
+/**
+ * Call statistics of an enclave, as returned by
+ * **oe_get_enclave_call_statistics()**. The counters are cumulative since the
+ * creation of the enclave, and are sampled without stopping calls in flight.
+ */
+typedef struct _oe_enclave_call_statistics
+{
+    /** Number of regular ecalls (enclave entries), including internal ones. */
+    uint64_t num_ecalls;
+    /** Number of regular ocalls (enclave exits), including internal ones. */
+    uint64_t num_ocalls;
+    /** Context-switchless ecalls. */
+    oe_switchless_call_statistics_t switchless_ecalls;
+    /** Context-switchless ocalls. */
+    oe_switchless_call_statistics_t switchless_ocalls;
+    /** Number of ocalls made by the enclave to wake host workers. */
+    uint64_t num_wake_ocalls;
+    /** Number of ocalls made by enclave workers to sleep. */
+    uint64_t num_sleep_ocalls;
+    /** Number of ecalls that waited for a TCS, and those that timed out. */
+    uint64_t num_tcs_waits;
+    uint64_t num_tcs_wait_timeouts;
+    /** Total time spent waiting for a TCS, in nanoseconds. */
+    uint64_t tcs_wait_time;
+    /** Number of ecalls waiting for a TCS, and the highest such number. */
+    uint64_t tcs_queue_depth;
+    uint64_t max_tcs_queue_depth;
+    /**
+     * Number of regular ocalls whose parameters did not fit the ocall buffer
+     * of their enclave thread.
+     */
+    uint64_t num_ocall_buffer_misses;
+    /** Size of the largest ocall buffer of the enclave threads, in bytes. */
+    uint64_t max_ocall_buffer_size;
+    /**
+     * Number of thread wakes posted to the wake ring instead of being made
+     * with ocalls (see oe_enclave_setting_wake_ring_t).
+     */
+    uint64_t num_ring_wakes;
+    /** Counters of each host worker (NULL if there are none). */
+    oe_switchless_worker_statistics_t* host_workers;
+    size_t num_host_workers;
+    /** Counters of each enclave worker (NULL if there are none). */
+    oe_switchless_worker_statistics_t* enclave_workers;
+    size_t num_enclave_workers;
+} oe_enclave_call_statistics_t;
+
+/**
+ * Get the call statistics of an enclave.
+ *
+ * This function gets the number of regular and context-switchless calls made
+ * to and from the given enclave, and the counters of its context-switchless
+ * worker threads. It is supported for SGX enclaves only.
+ *
+ * @param[in] enclave The instance of the enclave.
+ * @param[out] statistics The statistics. The worker arrays must be released
+ * with **oe_free_enclave_call_statistics()**.
+ *
+ * @returns Returns OE_OK on success.
+ *
+ */
+oe_result_t oe_get_enclave_call_statistics(
+    oe_enclave_t* enclave,
+    oe_enclave_call_statistics_t* statistics);
+
+/**
+ * Free the worker arrays of statistics obtained with
+ * **oe_get_enclave_call_statistics()**.
+ *
+ * @param[in] statistics The statistics to free.
+ *
+ */
+void oe_free_enclave_call_statistics(oe_enclave_call_statistics_t* statistics);
+
+/**
+ * Get the deepest stack usage of each thread of an enclave.
+ *
+ * The loader fills the stacks of the enclave with a known pattern, and this
+ * function scans each stack for the part that was overwritten since the
+ * creation of the enclave. The result is a high watermark, which can be used
+ * to choose the NumStackPages setting of the enclave. It is supported for
+ * SGX debug enclaves only. When the host log level is OE_LOG_LEVEL_INFO or
+ * higher, **oe_terminate_enclave()** logs the same data.
+ *
+ * @param[in] enclave The instance of the enclave.
+ * @param[out] stack_usage The number of stack bytes used by each thread,
+ * indexed by TCS.
+ * @param[in,out] num_threads The number of entries of **stack_usage** on
+ * input, and the number of enclave threads on output.
+ * @param[out] stack_size The size of each stack in bytes (optional).
+ *
+ * @retval OE_OK The stack usage was written to **stack_usage**.
+ * @retval OE_BUFFER_TOO_SMALL **stack_usage** is too small; **num_threads**
+ * holds the required number of entries.
+ * @retval OE_UNSUPPORTED The enclave is not a debug enclave.
+ * @retval OE_INVALID_PARAMETER One or more parameters is invalid.
+ *
+ */
+oe_result_t oe_get_enclave_stack_usage(
+    oe_enclave_t* enclave,
+    uint64_t* stack_usage,
+    size_t* num_threads,
+    size_t* stack_size);
+
 #if (OE_API_VERSION < 2)
 #error "Only OE_API_VERSION of 2 is supported"
 #else
@@ -13,6 +13,7 @@ OE_EXTERNC_BEGIN
 #pragma intrinsic(_InterlockedOr64)
 #pragma intrinsic(_InterlockedIncrement64)
 #pragma intrinsic(_InterlockedDecrement64)
+#pragma intrinsic(_InterlockedExchangeAdd64)
 #pragma intrinsic(_InterlockedCompareExchange)
 #pragma intrinsic(_InterlockedCompareExchange64)
 #pragma intrinsic(_InterlockedCompareExchangePointer)
@@ -20,6 +21,7 @@ OE_EXTERNC_BEGIN
 __int64 _InterlockedOr64(__int64 volatile* value, __int64 mask);
 __int64 _InterlockedIncrement64(__int64* lpAddend);
 __int64 _InterlockedDecrement64(__int64* lpAddend);
+__int64 _InterlockedExchangeAdd64(__int64 volatile* lpAddend, __int64 value);
 long _InterlockedCompareExchange(long volatile* a, long b, long c);
 __int64 _InterlockedCompareExchange64(
     __int64 volatile* Dest,
@@ -68,6 +70,20 @@ OE_INLINE uint64_t oe_atomic_decrement(volatile uint64_t* x)
 #endif
 }
 
+/* Atomically add **value** to **x** and return the new value */
+OE_INLINE uint64_t oe_atomic_add(volatile uint64_t* x, uint64_t value)
+{
+#if defined(__GNUC__)
+    return __sync_add_and_fetch(x, value);
+#elif defined(_MSC_VER)
+    return (uint64_t)_InterlockedExchangeAdd64(
+               (volatile __int64*)x, (__int64)value) +
+           value;
+#else
+#error "unsupported"
+#endif
+}
+
 OE_INLINE
 bool oe_atomic_compare_and_swap(
     int64_t volatile* dest,
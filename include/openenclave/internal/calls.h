@@ -76,6 +76,12 @@ typedef enum _oe_func
     OE_ECALL_CALL_ENCLAVE_FUNCTION,
     OE_ECALL_VIRTUAL_EXCEPTION_HANDLER,
     OE_ECALL_CALL_AT_EXIT_FUNCTIONS,
+    OE_ECALL_CALL_ENCLAVE_FUNCTION_BATCH,
+    OE_ECALL_GET_STACK_USAGE,
+    OE_ECALL_INIT_WAKE_RING,
+    OE_ECALL_INIT_THREAD_POOL,
+    OE_ECALL_THREAD_POOL_WORKER,
+    OE_ECALL_STOP_THREAD_POOL,
     /* Caution: always add new ECALL function numbers here */
     OE_ECALL_MAX,
 
@@ -85,6 +91,8 @@ typedef enum _oe_func
     OE_OCALL_MALLOC,
     OE_OCALL_FREE,
     OE_OCALL_GET_TIME,
+    OE_OCALL_CALL_HOST_FUNCTION_BATCH,
+    OE_OCALL_GET_TIME_PAGE,
     /* Caution: always add new OCALL function numbers here */
     OE_OCALL_MAX, /* This value is never used */
 
@@ -193,6 +201,67 @@ typedef struct _oe_call_enclave_function_args
 
 OE_STATIC_ASSERT((sizeof(oe_call_enclave_function_args_t) % 8) == 0);
 
+/*
+**==============================================================================
+**
+** oe_call_enclave_function_batch_args_t
+**
+**     Argument of OE_ECALL_CALL_ENCLAVE_FUNCTION_BATCH. The enclave calls
+**     each function in order and reports the outcome of each call in its
+**     result field.
+**
+**==============================================================================
+*/
+
+typedef struct _oe_call_enclave_function_batch_args
+{
+    oe_call_enclave_function_args_t* calls;
+    uint64_t num_calls;
+} oe_call_enclave_function_batch_args_t;
+
+OE_STATIC_ASSERT((sizeof(oe_call_enclave_function_batch_args_t) % 8) == 0);
+
+/*
+**==============================================================================
+**
+** oe_get_stack_usage_args_t
+**
+**     Argument of OE_ECALL_GET_STACK_USAGE. The enclave writes the number of
+**     bytes of each thread stack that no longer hold the fill pattern of the
+**     loader into stack_usage, which has room for num_threads entries, and
+**     sets num_threads to the number of enclave threads.
+**
+**==============================================================================
+*/
+
+typedef struct _oe_get_stack_usage_args
+{
+    uint64_t* stack_usage;
+    uint64_t num_threads;
+    uint64_t stack_size;
+} oe_get_stack_usage_args_t;
+
+OE_STATIC_ASSERT((sizeof(oe_get_stack_usage_args_t) % 8) == 0);
+
+/*
+**==============================================================================
+**
+** oe_thread_pool_worker_args_t
+**
+**     Argument of OE_ECALL_THREAD_POOL_WORKER. The enclave sets started once
+**     the worker has entered, and returns when the pool is stopped with
+**     OE_ECALL_STOP_THREAD_POOL.
+**
+**==============================================================================
+*/
+
+typedef struct _oe_thread_pool_worker_args
+{
+    uint64_t started;
+} oe_thread_pool_worker_args_t;
+
+OE_STATIC_ASSERT((sizeof(oe_thread_pool_worker_args_t) % 8) == 0);
+
 /*
 **==============================================================================
 **
@@ -217,6 +286,31 @@ OE_STATIC_ASSERT(
     (OE_OFFSETOF(oe_call_host_function_args_t, output_bytes_written) % 8) == 0);
 OE_STATIC_ASSERT((OE_OFFSETOF(oe_call_host_function_args_t, result) % 8) == 0);
 
+/*
+**==============================================================================
+**
+** oe_call_host_function_batch_args_t
+**
+**     Argument of OE_OCALL_CALL_HOST_FUNCTION_BATCH. The host calls each
+**     function in order, and sets num_calls_completed to the number of calls
+**     it made (fewer than num_calls if the batch stopped at a failure).
+**
+**==============================================================================
+*/
+
+typedef struct _oe_call_host_function_batch_args
+{
+    oe_call_host_function_args_t* calls;
+    uint64_t num_calls;
+    uint64_t flags; /* OE_HOST_FUNCTION_BATCH_STOP_ON_FAILURE */
+    volatile uint64_t num_calls_completed;
+} oe_call_host_function_batch_args_t;
+
+OE_STATIC_ASSERT((sizeof(oe_call_host_function_batch_args_t) % 8) == 0);
+OE_STATIC_ASSERT(
+    (OE_OFFSETOF(oe_call_host_function_batch_args_t, num_calls_completed) %
+     8) == 0);
+
 /*
 **==============================================================================
 **
@@ -338,6 +432,21 @@ oe_result_t oe_ecall(
  */
 oe_result_t oe_ocall(uint16_t func, uint64_t arg_in, uint64_t* arg_out);
 
+/**
+ * Configure the per-thread ecall marshaling buffer cache (SGX enclaves only).
+ *
+ * Each enclave thread reuses a grow-only buffer for the marshaled inputs and
+ * outputs of its ecalls. Ecalls whose marshaled size exceeds **max_size** use
+ * a heap allocation for the duration of the call instead. The default limit
+ * is 64 KB and a limit of zero disables the cache.
+ *
+ * @param max_size The largest marshaled ecall size served from the cache.
+ *
+ * @retval OE_OK The limit was updated.
+ * @retval OE_INVALID_PARAMETER **max_size** is larger than 1 GB.
+ */
+oe_result_t oe_configure_ecall_buffer_cache(size_t max_size);
+
 OE_EXTERNC_END
 
 #endif /* _OE_CALLS_H */
@@ -18,9 +18,12 @@
 #define OE_CPUID_RDX 3
 #define OE_CPUID_REG_COUNT 4
 
-#define OE_CPUID_AESNI_FEATURE 0x02000000u  /* Leaf 1, subleaf 0, ECX */
-#define OE_CPUID_RDRAND_FEATURE 0x40000000u /* Leaf 1, subleaf 0, ECX */
-#define OE_CPUID_RDSEED_FEATURE 0x00040000u /* Leaf 7, subleaf 0, EBX */
+#define OE_CPUID_AESNI_FEATURE 0x02000000u   /* Leaf 1, subleaf 0, ECX */
+#define OE_CPUID_RDRAND_FEATURE 0x40000000u  /* Leaf 1, subleaf 0, ECX */
+#define OE_CPUID_OSXSAVE_FEATURE 0x08000000u /* Leaf 1, subleaf 0, ECX */
+#define OE_CPUID_AVX_FEATURE 0x10000000u     /* Leaf 1, subleaf 0, ECX */
+#define OE_CPUID_RDSEED_FEATURE 0x00040000u  /* Leaf 7, subleaf 0, EBX */
+#define OE_CPUID_AVX2_FEATURE 0x00000020u    /* Leaf 7, subleaf 0, EBX */
 
 extern const uint32_t supported_cpuid_leaves[OE_CPUID_LEAF_COUNT];
 
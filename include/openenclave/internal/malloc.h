@@ -43,6 +43,31 @@ oe_result_t oe_check_memory_leaks(void);
 //
 extern bool oe_disable_debug_malloc_check;
 
+/* True while the heap profiler samples allocations */
+extern bool oe_heap_profile_enabled;
+
+/* Called by the allocation functions while the heap profiler is enabled */
+void oe_heap_profile_record_malloc(void* ptr, size_t size);
+void oe_heap_profile_record_free(void* ptr);
+
+OE_INLINE void oe_heap_profile_malloc(void* ptr, size_t size)
+{
+    if (oe_heap_profile_enabled && ptr)
+        oe_heap_profile_record_malloc(ptr, size);
+}
+
+OE_INLINE void oe_heap_profile_free(void* ptr)
+{
+    if (oe_heap_profile_enabled && ptr)
+        oe_heap_profile_record_free(ptr);
+}
+
+/* Write a heap profile to the given host file (implemented per platform) */
+oe_result_t oe_heap_profile_write(
+    const char* path,
+    const void* profile,
+    size_t size);
+
 OE_EXTERNC_END
 
 #endif /* _OE_MALLOC_H */
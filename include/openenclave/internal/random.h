@@ -5,6 +5,7 @@
 #define _OE_RANDOM_INTERNAL_H
 
 #include <openenclave/bits/result.h>
+#include <openenclave/bits/types.h>
 
 OE_EXTERNC_BEGIN
 
@@ -22,6 +23,20 @@ OE_EXTERNC_BEGIN
  */
 oe_result_t oe_random_internal(void* data, size_t size);
 
+/**
+ * Get the number of times the random number generator of the calling thread
+ * was seeded from the entropy source (SGX enclaves only).
+ *
+ * @return The number of seeds and reseeds, zero if it was never used.
+ */
+uint64_t oe_random_get_num_reseeds(void);
+
+/**
+ * Wipe the random number generators of all threads (SGX enclaves only). This
+ * is called by the enclave destructor.
+ */
+void oe_random_teardown(void);
+
 OE_EXTERNC_END
 
 #endif /* _OE_RANDOM_INTERNAL_H */
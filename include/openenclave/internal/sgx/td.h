@@ -81,7 +81,7 @@ oe_thread_data_t* oe_get_thread_data(void);
  * Due to the inability to use OE_OFFSETOF on a struct while defining its
  * members, this value is computed and hard-coded.
  */
-#define OE_THREAD_SPECIFIC_DATA_SIZE (3632)
+#define OE_THREAD_SPECIFIC_DATA_SIZE (2168)
 
 typedef struct _oe_callsite oe_callsite_t;
 
@@ -103,18 +103,99 @@ typedef enum _oe_td_state
     OE_TD_STATE_ABORTED,
 } oe_td_state_t;
 
+/* Maximum number of chunks in the shared memory arena of a thread */
+#define OE_SHARED_MEMORY_ARENA_MAX_CHUNKS 8
+
+/* A contiguous block of shared memory in the arena of a thread. Objects are
+ * allocated from the bottom of the chunk and reservations are made from the
+ * top. */
+typedef struct _oe_shared_memory_arena_chunk
+{
+    uint8_t* buffer;
+    uint64_t capacity;
+    uint64_t used;
+    uint64_t reserved;
+} oe_shared_memory_arena_chunk_t;
+
+OE_CHECK_SIZE(sizeof(oe_shared_memory_arena_chunk_t), 32);
+
+/* Per-thread statistics of the shared memory arena */
+typedef struct _oe_shared_memory_arena_statistics
+{
+    /* Chunks allocated from and returned to the host */
+    uint64_t num_chunk_allocations;
+    uint64_t num_chunk_releases;
+
+    /* Requests that could not be served */
+    uint64_t num_failures;
+
+    /* Bytes of host memory currently held by the arena */
+    uint64_t capacity;
+
+    /* Most bytes in use at once during the current ECALL, and ever */
+    uint64_t high_watermark;
+    uint64_t max_high_watermark;
+} oe_shared_memory_arena_statistics_t;
+
+OE_CHECK_SIZE(sizeof(oe_shared_memory_arena_statistics_t), 48);
+
 /* This structure manages a pool of shared memory (memory visible to both
  * the enclave and the host). An instance of this structure is maintained
- * for each thread. This structure is used in enclave/core/arena.c.
+ * for each thread. The pool is a chain of chunks that are allocated from the
+ * host on first use and grow as needed; the newest chunk is the last one.
+ * This structure is used in enclave/core/sgx/arena.c.
  */
 typedef struct _oe_shared_memory_arena_t
 {
-    uint8_t* buffer;
-    uint64_t capacity;
-    uint64_t used;
+    oe_shared_memory_arena_chunk_t chunks[OE_SHARED_MEMORY_ARENA_MAX_CHUNKS];
+    uint64_t num_chunks;
+
+    /* Bytes allocated or reserved across the chunks */
+    uint64_t in_use;
+
+    /* Capacity of the first chunk, derived from the high watermark of
+     * earlier ECALLs (zero for the default) */
+    uint64_t preferred_capacity;
+
+    /* List of the arenas that hold host memory (see arena.c) */
+    struct _oe_shared_memory_arena_t* next_registered;
+    uint64_t registered;
+
+    /* List of asynchronous switchless ocalls whose buffers are reserved in
+     * the arena (see switchlesscalls.c) */
+    struct _oe_switchless_call* async_calls;
+
+    oe_shared_memory_arena_statistics_t statistics;
 } oe_shared_memory_arena_t;
 
-OE_CHECK_SIZE(sizeof(oe_shared_memory_arena_t), 24);
+OE_CHECK_SIZE(sizeof(oe_shared_memory_arena_t), 352);
+
+/* Size of the keystream buffer of the random number generator of a thread */
+#define OE_RANDOM_STATE_BUFFER_SIZE 1024
+
+/* The ChaCha20 random number generator of a thread (see
+ * enclave/core/sgx/random_internal.c). It is kept in the thread data rather
+ * than in thread-local storage, which is cleared at the end of every ECALL,
+ * so that it is only seeded once per TCS. */
+typedef struct _oe_random_state
+{
+    uint32_t key[8];
+    uint8_t buffer[OE_RANDOM_STATE_BUFFER_SIZE];
+
+    /* Offset of the first unused byte of buffer */
+    uint64_t offset;
+
+    /* Bytes generated since the last reseed, and number of reseeds */
+    uint64_t generated;
+    uint64_t num_reseeds;
+
+    /* List of the seeded states, which are wiped when the enclave is
+     * terminated (see random_internal.c) */
+    struct _oe_random_state* next_seeded;
+    uint64_t seeded;
+} oe_random_state_t;
+
+OE_CHECK_SIZE(sizeof(oe_random_state_t), 1096);
 
 OE_PACK_BEGIN
 typedef struct _td
@@ -224,6 +305,27 @@ typedef struct _td
     /* The error code for PF and GP exceptions. */
     uint32_t error_code;
 
+    /* Non-zero while the ecall marshaling buffer below is in use (nested
+     * ecalls on the same thread fall back to the heap) */
+    uint32_t ecall_buffer_in_use;
+
+    /* Whether the thread is spinning or parked while it waits on a mutex or
+     * condition variable (see enclave/core/sgx/thread.c) */
+    uint32_t wait_state;
+
+    /* Grow-only buffer reused by oe_handle_call_enclave_function() to hold
+     * the marshaled inputs and outputs of an ecall. Bytes at and beyond
+     * ecall_buffer_dirty are known to be zero (see enclave/core/sgx/calls.c)
+     */
+    uint8_t* ecall_buffer;
+    uint64_t ecall_buffer_size;
+    uint64_t ecall_buffer_dirty;
+    struct _td* ecall_buffer_next;
+
+    /* Random number generator of the thread (see
+     * enclave/core/sgx/random_internal.c) */
+    oe_random_state_t random_state;
+
     /* Reserved for thread specific data. */
     uint8_t thread_specific_data[OE_THREAD_SPECIFIC_DATA_SIZE];
 } oe_sgx_td_t;
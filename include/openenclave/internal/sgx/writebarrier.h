@@ -0,0 +1,29 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#ifndef _OE_INTERNAL_SGX_WRITEBARRIER_H
+#define _OE_INTERNAL_SGX_WRITEBARRIER_H
+
+#include <openenclave/bits/defs.h>
+#include <openenclave/bits/types.h>
+
+OE_EXTERNC_BEGIN
+
+/*
+ * Select the routines that oe_memcpy_with_barrier() and
+ * oe_memset_with_barrier() use for the 8-byte-aligned bulk of large writes,
+ * from the CPU features. Called once during enclave initialization, after the
+ * CPUID table is set up.
+ */
+void oe_initialize_write_barrier(void);
+
+/*
+ * Enable or disable the vector bulk paths (for tests and benchmarks). They
+ * can only be enabled if oe_initialize_write_barrier() found them supported.
+ * Returns whether the vector paths are in use.
+ */
+bool oe_set_write_barrier_vector_enabled(bool enabled);
+
+OE_EXTERNC_END
+
+#endif // _OE_INTERNAL_SGX_WRITEBARRIER_H
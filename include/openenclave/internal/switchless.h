@@ -10,23 +10,47 @@
 #include <openenclave/internal/calls.h>
 #include <openenclave/internal/thread.h>
 
+/**
+ * Version of the worker context layout. The host stamps every context with
+ * this value and the enclave refuses contexts with a different layout.
+ *
+ * Version 1: contexts are padded to one cache line each.
+ */
+#define OE_SWITCHLESS_CONTEXT_VERSION (2U)
+
+/**
+ * Alignment (and size) of a worker context.
+ */
+#define OE_SWITCHLESS_CONTEXT_ALIGNMENT (64U)
+
+/**
+ * Value that a retired worker keeps in its call_arg slot. Callers skip
+ * retired workers while any active worker is free, and revive a retired
+ * worker by swapping the marker for their call.
+ */
+#define OE_SWITCHLESS_WORKER_RETIRED ((void*)1)
+
 /**
  * oe_host_worker_context_t is used both by the host (windows/linux) and the
  * enclave (ELF). Lock down the layout.
  */
-OE_STATIC_ASSERT(sizeof(oe_host_worker_context_t) == 48);
+OE_STATIC_ASSERT(
+    sizeof(oe_host_worker_context_t) == OE_SWITCHLESS_CONTEXT_ALIGNMENT);
 OE_STATIC_ASSERT(OE_OFFSETOF(oe_host_worker_context_t, call_arg) == 0);
 OE_STATIC_ASSERT(OE_OFFSETOF(oe_host_worker_context_t, enc) == 8);
 OE_STATIC_ASSERT(OE_OFFSETOF(oe_host_worker_context_t, is_stopping) == 16);
 OE_STATIC_ASSERT(OE_OFFSETOF(oe_host_worker_context_t, event) == 24);
 OE_STATIC_ASSERT(OE_OFFSETOF(oe_host_worker_context_t, spin_count) == 32);
 OE_STATIC_ASSERT(OE_OFFSETOF(oe_host_worker_context_t, total_spin_count) == 40);
+OE_STATIC_ASSERT(OE_OFFSETOF(oe_host_worker_context_t, version) == 48);
+OE_STATIC_ASSERT(OE_OFFSETOF(oe_host_worker_context_t, is_sleeping) == 56);
 
 /**
  * oe_enclave_worker_context_t is used both by the host (windows/linux) and the
  * enclave (ELF). Lock down the layout.
  */
-OE_STATIC_ASSERT(sizeof(oe_enclave_worker_context_t) == 56);
+OE_STATIC_ASSERT(
+    sizeof(oe_enclave_worker_context_t) == OE_SWITCHLESS_CONTEXT_ALIGNMENT);
 OE_STATIC_ASSERT(OE_OFFSETOF(oe_enclave_worker_context_t, call_arg) == 0);
 OE_STATIC_ASSERT(OE_OFFSETOF(oe_enclave_worker_context_t, enc) == 8);
 OE_STATIC_ASSERT(OE_OFFSETOF(oe_enclave_worker_context_t, is_stopping) == 16);
@@ -36,6 +60,164 @@ OE_STATIC_ASSERT(
     OE_OFFSETOF(oe_enclave_worker_context_t, spin_count_threshold) == 40);
 OE_STATIC_ASSERT(
     OE_OFFSETOF(oe_enclave_worker_context_t, total_spin_count) == 48);
+OE_STATIC_ASSERT(OE_OFFSETOF(oe_enclave_worker_context_t, version) == 56);
+
+/**
+ * Maximum number of slots in the switchless ocall submission ring.
+ */
+#define OE_SWITCHLESS_OCALL_RING_MAX_DEPTH (4096U)
+
+/**
+ * Alignment of the switchless ocall submission ring. The producer and consumer
+ * indices are kept on separate cache lines.
+ */
+#define OE_SWITCHLESS_RING_ALIGNMENT (64U)
+
+/**
+ * A slot in the switchless ocall submission ring.
+ *
+ * The slot at position pos (modulo the capacity) is free for an enclave thread
+ * to claim when sequence == pos, and holds a posted call that a host worker
+ * can take when sequence == pos + 1. After taking the call, the host worker
+ * sets sequence to pos + capacity, which frees the slot for the next lap.
+ */
+typedef struct _oe_switchless_ring_slot
+{
+    volatile uint64_t sequence;
+    void* volatile call_arg;
+} oe_switchless_ring_slot_t;
+
+/**
+ * Bounded multi-producer/multi-consumer queue in host memory that enclave
+ * threads post switchless ocalls to when every host worker is busy. Any host
+ * worker can drain the ring. The slots immediately follow the header.
+ *
+ * The enclave never trusts the contents of the ring: it keeps its own copy of
+ * the capacity and masks every index into the slot array, so a misbehaving
+ * host can at worst cause calls to fall back to regular ocalls.
+ */
+typedef struct _oe_switchless_ring
+{
+    /* Next position to be claimed by an enclave thread. */
+    volatile uint64_t enqueue_pos;
+    uint8_t padding0[56];
+
+    /* Next position to be taken by a host worker. */
+    volatile uint64_t dequeue_pos;
+    uint8_t padding1[56];
+
+    /* Number of host workers that are parked (or about to park). Each of
+     * them also sets is_sleeping in its worker context. */
+    volatile uint64_t num_sleeping_workers;
+
+    /* Number of slots. Always a power of two. */
+    uint64_t capacity;
+    uint8_t padding2[48];
+} oe_switchless_ring_t;
+
+/**
+ * oe_switchless_ring_t is used both by the host (windows/linux) and the
+ * enclave (ELF). Lock down the layout.
+ */
+OE_STATIC_ASSERT(sizeof(oe_switchless_ring_slot_t) == 16);
+OE_STATIC_ASSERT(OE_OFFSETOF(oe_switchless_ring_slot_t, sequence) == 0);
+OE_STATIC_ASSERT(OE_OFFSETOF(oe_switchless_ring_slot_t, call_arg) == 8);
+OE_STATIC_ASSERT(sizeof(oe_switchless_ring_t) == 192);
+OE_STATIC_ASSERT(OE_OFFSETOF(oe_switchless_ring_t, enqueue_pos) == 0);
+OE_STATIC_ASSERT(OE_OFFSETOF(oe_switchless_ring_t, dequeue_pos) == 64);
+OE_STATIC_ASSERT(
+    OE_OFFSETOF(oe_switchless_ring_t, num_sleeping_workers) == 128);
+OE_STATIC_ASSERT(OE_OFFSETOF(oe_switchless_ring_t, capacity) == 136);
+
+/* Get the array of slots that follows the ring header. */
+OE_INLINE oe_switchless_ring_slot_t* oe_switchless_ring_slots(
+    oe_switchless_ring_t* ring)
+{
+    return (oe_switchless_ring_slot_t*)(ring + 1);
+}
+
+/* Get the total size of a ring (header and slots) of the given capacity. */
+OE_INLINE size_t oe_switchless_ring_size(uint64_t capacity)
+{
+    return sizeof(oe_switchless_ring_t) +
+           capacity * sizeof(oe_switchless_ring_slot_t);
+}
+
+/**
+ * Host-side state of the controller that picks the spin budget of a worker
+ * under the adaptive spin policies. Durations are in nanoseconds and gaps in
+ * spin iterations.
+ */
+typedef struct _oe_switchless_spin_controller
+{
+    /* Number of iterations to spin before parking. */
+    uint64_t budget;
+
+    /* Smoothed gap between consecutive calls. */
+    uint64_t gap;
+
+    /* Smoothed duration of one spin iteration, in 1/16 ns. */
+    uint64_t iteration_time;
+
+    /* Start of the current spin phase. */
+    uint64_t spin_start_time;
+
+    /* Time at which the worker parked. */
+    uint64_t park_time;
+
+    /* Total spin count of an enclave worker when it was last woken. */
+    uint64_t last_total_spin_count;
+
+    /* Number of calls posted to a spinning enclave worker since it last
+     * parked, and the gap seen by the latest one. Updated by the posting
+     * threads. */
+    volatile uint64_t num_posted_calls;
+    volatile uint64_t posted_gap;
+} oe_switchless_spin_controller_t;
+
+OE_STATIC_ASSERT(
+    sizeof(oe_switchless_spin_controller_t) ==
+    OE_SWITCHLESS_CONTEXT_ALIGNMENT);
+
+/**
+ * Host-side counters of a worker. Each worker's counters occupy a cache line
+ * of their own.
+ */
+typedef struct _oe_switchless_worker_counters
+{
+    /* Number of calls handled, and the time (in ns) spent on them. */
+    uint64_t num_calls;
+    uint64_t busy_time;
+
+    /* Number of times the worker went to sleep, and was woken up. */
+    uint64_t num_sleeps;
+    uint64_t num_wakes;
+    uint8_t padding[32];
+} oe_switchless_worker_counters_t;
+
+OE_STATIC_ASSERT(
+    sizeof(oe_switchless_worker_counters_t) ==
+    OE_SWITCHLESS_CONTEXT_ALIGNMENT);
+
+/**
+ * Counters in host memory that the enclave updates. The host only reads them.
+ */
+typedef struct _oe_switchless_statistics
+{
+    /* Number of switchless ocalls made as regular ocalls because no host
+     * worker (or ring slot) was available. */
+    volatile uint64_t num_ocall_fallbacks;
+    uint8_t padding[56];
+} oe_switchless_statistics_t;
+
+/**
+ * oe_switchless_statistics_t is used both by the host (windows/linux) and the
+ * enclave (ELF). Lock down the layout.
+ */
+OE_STATIC_ASSERT(
+    sizeof(oe_switchless_statistics_t) == OE_SWITCHLESS_CONTEXT_ALIGNMENT);
+OE_STATIC_ASSERT(
+    OE_OFFSETOF(oe_switchless_statistics_t, num_ocall_fallbacks) == 0);
 
 typedef struct _oe_switchless_call_manager
 {
@@ -43,18 +225,82 @@ typedef struct _oe_switchless_call_manager
     oe_thread_t* host_worker_threads;
     size_t num_host_workers;
 
+    /* Submission ring shared by all host workers (NULL if disabled) */
+    oe_switchless_ring_t* ocall_ring;
+
     oe_enclave_worker_context_t* enclave_worker_contexts;
     oe_thread_t* enclave_worker_threads;
     size_t num_enclave_workers;
+
+    /* oe_switchless_spin_policy_t, and the CPU budget for that policy */
+    uint32_t spin_policy;
+    uint32_t cpu_budget_percent;
+
+    /* Spin controllers of the workers (NULL under the fixed policy) */
+    oe_switchless_spin_controller_t* host_worker_controllers;
+    oe_switchless_spin_controller_t* enclave_worker_controllers;
+
+    /* Counters of the workers */
+    oe_switchless_worker_counters_t* host_worker_counters;
+    oe_switchless_worker_counters_t* enclave_worker_counters;
+
+    /* Counters updated by the enclave (NULL if not supported) */
+    oe_switchless_statistics_t* statistics;
+
+    /* Number of switchless ecalls made as regular ecalls */
+    volatile uint64_t num_ecall_fallbacks;
 } oe_switchless_call_manager_t;
 
+/* Defined in openenclave/host.h */
+struct _oe_enclave_setting_context_switchless;
+struct _oe_enclave_call_statistics;
+
 oe_result_t oe_start_switchless_manager(
     oe_enclave_t* enclave,
-    size_t num_host_workers,
-    size_t num_enclave_workers);
+    const struct _oe_enclave_setting_context_switchless* setting);
 
 oe_result_t oe_stop_switchless_manager(oe_enclave_t* enclave);
 
+/**
+ * Fill in the switchless counters (and allocate the worker arrays) of the
+ * given statistics. Does nothing if the enclave has no switchless manager.
+ */
+oe_result_t oe_get_switchless_call_statistics(
+    oe_enclave_t* enclave,
+    struct _oe_enclave_call_statistics* statistics);
+
+/**
+ * Get the logical CPUs that belong to the given NUMA node.
+ *
+ * @param[in] node The NUMA node.
+ * @param[out] cpus The array that receives the CPU numbers.
+ * @param[in] max_cpus The number of elements in **cpus**.
+ * @param[out] num_cpus The number of CPUs written to **cpus**.
+ *
+ * @returns OE_OK on success, OE_NOT_FOUND if the node does not exist.
+ */
+oe_result_t oe_switchless_get_numa_node_cpus(
+    uint32_t node,
+    uint32_t* cpus,
+    size_t max_cpus,
+    size_t* num_cpus);
+
+/**
+ * Allocate zero-filled, cache-line-aligned memory that is shared with the
+ * enclave, such as worker contexts and rings. If **numa_node** is not NULL,
+ * the pages are preferably placed on that node. The memory must be released
+ * with oe_switchless_free_shared().
+ */
+void* oe_switchless_alloc_shared(size_t size, const uint32_t* numa_node);
+
+void oe_switchless_free_shared(void* ptr);
+
+/**
+ * Get the value of a monotonic clock in nanoseconds. Used to measure how long
+ * workers spin and sleep.
+ */
+uint64_t oe_switchless_get_monotonic_time(void);
+
 void oe_host_worker_wait(oe_host_worker_context_t* context);
 
 void oe_host_worker_wake(oe_host_worker_context_t* context);
@@ -219,6 +219,7 @@ OE_DECLARE_SYSCALL3(SYS_lseek);
 #if defined(__x86_64__) || defined(_M_X64)
 OE_DECLARE_SYSCALL2(SYS_lstat);
 #endif
+OE_DECLARE_SYSCALL3(SYS_madvise);
 #if defined(__x86_64__) || defined(_M_X64)
 OE_DECLARE_SYSCALL2(SYS_mkdir);
 #endif
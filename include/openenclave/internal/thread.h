@@ -336,6 +336,22 @@ oe_result_t oe_mutex_unlock(oe_mutex_t* mutex);
  */
 oe_result_t oe_mutex_destroy(oe_mutex_t* mutex);
 
+/**
+ * Limit the spinning of threads that wait on a mutex or condition variable
+ * (SGX enclaves only).
+ *
+ * A thread that waits on a mutex or a condition variable polls for a wake-up
+ * before it asks the host to park it. The number of polls adapts to how long
+ * earlier waiters waited, up to **max_spins**. The default limit is 100, and
+ * a limit of zero makes waiting threads park right away.
+ *
+ * @param max_spins The largest number of polls made before parking.
+ *
+ * @retval OE_OK The limit was updated.
+ * @retval OE_INVALID_PARAMETER **max_spins** is larger than 100000.
+ */
+oe_result_t oe_configure_spinning(uint32_t max_spins);
+
 /**
  * Condition variable representation
  */
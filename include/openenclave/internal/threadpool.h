@@ -0,0 +1,72 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#ifndef _OE_INTERNAL_THREADPOOL_H
+#define _OE_INTERNAL_THREADPOOL_H
+
+#include <openenclave/bits/defs.h>
+#include <openenclave/bits/result.h>
+#include <openenclave/bits/types.h>
+
+OE_EXTERNC_BEGIN
+
+/**
+ * Run a function on a thread of the thread pool of the enclave (SGX enclaves
+ * only).
+ *
+ * The host creates the pool with the OE_ENCLAVE_SETTING_THREAD_POOL setting.
+ * Each of its threads stays in the enclave on a TCS of its own, and runs the
+ * functions passed to this function one at a time. The function keeps its
+ * thread until it returns, so it may block. This is how pthread_create() is
+ * implemented when no pthread hooks are registered.
+ *
+ * After the function returns, the thread runs the destructors of its
+ * thread-specific data (see oe_thread_key_create()). Its TLS variables,
+ * declared with __thread or thread_local, keep their values for the next
+ * functions that run on the same thread.
+ *
+ * @param function The function to run.
+ * @param arg The argument passed to **function**.
+ *
+ * @retval OE_OK The function will run on a thread of the pool.
+ * @retval OE_INVALID_PARAMETER **function** is NULL.
+ * @retval OE_UNSUPPORTED The enclave has no thread pool.
+ * @retval OE_OUT_OF_THREADS All the threads of the pool are taken.
+ * @retval OE_OUT_OF_MEMORY The function could not be queued.
+ */
+oe_result_t oe_thread_pool_run(void (*function)(void*), void* arg);
+
+/**
+ * Call a function for each index of a range, in parallel on the calling
+ * thread and the free threads of the thread pool (SGX enclaves only).
+ *
+ * The range is split between the threads by work stealing: each thread
+ * calls **function** for the indices of its own part of the range, and,
+ * once done, takes half of what is left of the part of another thread. The
+ * free threads of the pool join as they become available, so no call
+ * crosses the enclave boundary. Without a pool, or if all its threads are
+ * taken, the calling thread makes all the calls.
+ *
+ * @param count The number of indices, from 0 to **count** - 1.
+ * @param function The function to call, with an index and **arg**.
+ * @param arg The argument passed to **function**.
+ *
+ * @retval OE_OK **function** returned for every index.
+ * @retval OE_INVALID_PARAMETER **function** is NULL.
+ * @retval OE_OUT_OF_MEMORY The range could not be split.
+ */
+oe_result_t oe_thread_pool_parallel_for(
+    size_t count,
+    void (*function)(size_t index, void* arg),
+    void* arg);
+
+/**
+ * Get the number of threads of the thread pool of the enclave.
+ *
+ * @returns The number of threads, zero if the enclave has no thread pool.
+ */
+size_t oe_thread_pool_get_num_threads(void);
+
+OE_EXTERNC_END
+
+#endif /* _OE_INTERNAL_THREADPOOL_H */
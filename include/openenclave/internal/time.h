@@ -4,6 +4,7 @@
 #ifndef _OE_INCLUDE_TIME_H
 #define _OE_INCLUDE_TIME_H
 
+#include <openenclave/bits/result.h>
 #include <openenclave/bits/types.h>
 
 /*
@@ -36,6 +37,59 @@ OE_EXTERNC_BEGIN
 
 uint64_t oe_get_time(void);
 
+/*
+**==============================================================================
+**
+** oe_get_clock_time()
+**
+**     Get the time of the given clock in nanoseconds. CLOCK_REALTIME counts
+**     from the Epoch, and CLOCK_MONOTONIC and CLOCK_MONOTONIC_RAW from an
+**     unspecified point. The coarse variants return the same time as their
+**     precise counterparts.
+**
+**     Returns OE_UNSUPPORTED for other clocks.
+**
+**==============================================================================
+*/
+
+oe_result_t oe_get_clock_time(int clock_id, uint64_t* nanoseconds);
+
+/*
+**==============================================================================
+**
+** oe_time_page_t
+**
+**     The clocks of the host, which the host publishes in its own memory and
+**     the enclave reads without an OCALL (see OE_OCALL_GET_TIME_PAGE).
+**
+**     The host makes the sequence odd while it updates the other fields, so
+**     the enclave retries the read if the sequence was odd or changed. The
+**     enclave interpolates the clocks with the TSC:
+**
+**         time = clock + ((rdtsc() - tsc) * tsc_mult) >> 32
+**
+**     A tsc of zero means that the TSC of the host is not invariant, in which
+**     case the enclave refreshes the page with an OCALL on every read.
+**
+**==============================================================================
+*/
+
+#define OE_TIME_PAGE_MAGIC 0x4f4554494d455047 /* "OETIMEPG" */
+
+typedef struct _oe_time_page
+{
+    uint64_t magic;
+    volatile uint64_t sequence;
+    uint64_t tsc;
+    uint64_t tsc_mult;
+    uint64_t realtime;
+    uint64_t monotonic;
+    uint64_t monotonic_raw;
+    uint64_t reserved;
+} oe_time_page_t;
+
+OE_STATIC_ASSERT(sizeof(oe_time_page_t) == 64);
+
 #ifdef _WIN32
 /*
 **==============================================================================
@@ -0,0 +1,72 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#ifndef _OE_WAKERING_H
+#define _OE_WAKERING_H
+
+#include <openenclave/bits/defs.h>
+#include <openenclave/bits/types.h>
+
+OE_EXTERNC_BEGIN
+
+/*
+**==============================================================================
+**
+** oe_wake_ring_t
+**
+**     Ring in host memory through which enclave threads ask the host to wake
+**     other enclave threads, without leaving the enclave. Each request is the
+**     TCS of the thread to wake (see OE_OCALL_THREAD_WAKE).
+**
+**     An enclave thread claims a ticket by incrementing tail, and then reads
+**     the state of the helper thread of the host. If the helper is running,
+**     the thread writes the TCS to the slot of the ticket. Otherwise it
+**     writes OE_WAKE_RING_CANCELLED and wakes the thread with an OCALL. The
+**     helper consumes the slots in ticket order, clearing each slot before
+**     it advances head.
+**
+**     Before the helper sleeps (or stops), it sets its state and then checks
+**     that no ticket was claimed, so that either the helper sees the ticket
+**     or the enclave thread sees the state.
+**
+**==============================================================================
+*/
+
+/* The states of the helper thread */
+#define OE_WAKE_RING_RUNNING 0
+#define OE_WAKE_RING_SLEEPING 1
+#define OE_WAKE_RING_STOPPED 2
+
+/* The value of a slot whose request was made with an OCALL instead */
+#define OE_WAKE_RING_CANCELLED 1
+
+/* Bounds of the number of slots, which is a power of two */
+#define OE_WAKE_RING_DEFAULT_SLOTS 256
+#define OE_WAKE_RING_MAX_SLOTS 4096
+
+typedef struct _oe_wake_ring
+{
+    /* Number of slots, read once by the enclave */
+    uint64_t num_slots;
+
+    /* State of the helper thread (OE_WAKE_RING_RUNNING, ...) */
+    OE_ALIGNED(64) volatile uint64_t state;
+
+    /* Next ticket, incremented by the enclave threads */
+    OE_ALIGNED(64) volatile uint64_t tail;
+
+    /* Next ticket to consume, incremented by the helper thread */
+    OE_ALIGNED(64) volatile uint64_t head;
+
+    /* Slots, indexed by ticket modulo num_slots (0 if not yet written) */
+    OE_ALIGNED(64) volatile uint64_t slots[];
+} oe_wake_ring_t;
+
+OE_STATIC_ASSERT(sizeof(oe_wake_ring_t) == 256);
+
+#define OE_WAKE_RING_SIZE(NUM_SLOTS) \
+    (sizeof(oe_wake_ring_t) + (NUM_SLOTS) * sizeof(uint64_t))
+
+OE_EXTERNC_END
+
+#endif /* _OE_WAKERING_H */
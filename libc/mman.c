@@ -13,23 +13,292 @@
 #include "openenclave/bits/result.h"
 #include "syscall.h"
 
-static oe_mapping_t* _mappings;
+/*
+**==============================================================================
+**
+** Mappings:
+**
+**     Each mmap() that cannot be served from unmapped pages allocates a
+**     page-aligned block from the enclave heap. The pages of the blocks are
+**     described by extents, which are either mapped or unmapped (holes left by
+**     partial munmap()s). Adjacent extents of the same block in the same state
+**     are coalesced, and a block is returned to the heap as soon as none of its
+**     pages are mapped.
+**
+**     The extents never overlap, so they are kept in an AVL tree ordered by
+**     address, where each node also holds the size of the largest hole in its
+**     subtree. This finds the extents that overlap a range, and the lowest
+**     hole that fits a new mapping, in O(log n).
+**
+**     Enclave memory cannot be zero-filled on first touch, so new mappings are
+**     zeroed when they are handed out. Holes are not zeroed when they are
+**     unmapped, but when they are reused, which they may never be.
+**
+**==============================================================================
+*/
+
+typedef struct _block
+{
+    uint64_t start;
+    uint64_t end;
+    uint64_t num_mapped_pages;
+    struct _block* prev;
+    struct _block* next;
+} block_t;
+
+typedef struct _extent
+{
+    uint64_t start;
+    uint64_t end;
+    block_t* block;
+    bool mapped;
+
+    struct _extent* left;
+    struct _extent* right;
+    int height;
+
+    /* Size of the largest unmapped extent in this subtree */
+    uint64_t max_hole_size;
+} extent_t;
+
+static extent_t* _root;
+static block_t* _blocks;
 static oe_spinlock_t _lock;
 
+OE_INLINE int _height(const extent_t* e)
+{
+    return e ? e->height : 0;
+}
+
+OE_INLINE uint64_t _max_hole_size(const extent_t* e)
+{
+    return e ? e->max_hole_size : 0;
+}
+
+static void _update(extent_t* e)
+{
+    int lh = _height(e->left);
+    int rh = _height(e->right);
+    uint64_t max = e->mapped ? 0 : e->end - e->start;
+
+    if (_max_hole_size(e->left) > max)
+        max = _max_hole_size(e->left);
+
+    if (_max_hole_size(e->right) > max)
+        max = _max_hole_size(e->right);
+
+    e->height = (lh > rh ? lh : rh) + 1;
+    e->max_hole_size = max;
+}
+
+static extent_t* _rotate_right(extent_t* e)
+{
+    extent_t* l = e->left;
+    e->left = l->right;
+    l->right = e;
+    _update(e);
+    _update(l);
+    return l;
+}
+
+static extent_t* _rotate_left(extent_t* e)
+{
+    extent_t* r = e->right;
+    e->right = r->left;
+    r->left = e;
+    _update(e);
+    _update(r);
+    return r;
+}
+
+static extent_t* _balance(extent_t* e)
+{
+    int factor;
+
+    _update(e);
+    factor = _height(e->left) - _height(e->right);
+
+    if (factor > 1)
+    {
+        if (_height(e->left->left) < _height(e->left->right))
+            e->left = _rotate_left(e->left);
+        return _rotate_right(e);
+    }
+
+    if (factor < -1)
+    {
+        if (_height(e->right->right) < _height(e->right->left))
+            e->right = _rotate_right(e->right);
+        return _rotate_left(e);
+    }
+
+    return e;
+}
+
+static extent_t* _insert(extent_t* root, extent_t* e)
+{
+    if (!root)
+    {
+        e->left = NULL;
+        e->right = NULL;
+        _update(e);
+        return e;
+    }
+
+    if (e->start < root->start)
+        root->left = _insert(root->left, e);
+    else
+        root->right = _insert(root->right, e);
+
+    return _balance(root);
+}
+
+/* Detach the leftmost node of the subtree into *min */
+static extent_t* _remove_min(extent_t* root, extent_t** min)
+{
+    if (!root->left)
+    {
+        *min = root;
+        return root->right;
+    }
+
+    root->left = _remove_min(root->left, min);
+    return _balance(root);
+}
+
+static extent_t* _remove(extent_t* root, const extent_t* e)
+{
+    if (root == e)
+    {
+        extent_t* min = NULL;
+
+        if (!root->right)
+            return root->left;
+
+        root->right = _remove_min(root->right, &min);
+        min->left = root->left;
+        min->right = root->right;
+        return _balance(min);
+    }
+
+    if (e->start < root->start)
+        root->left = _remove(root->left, e);
+    else
+        root->right = _remove(root->right, e);
+
+    return _balance(root);
+}
+
+/* Find the lowest extent that ends after the given address */
+static extent_t* _find(uint64_t addr)
+{
+    extent_t* found = NULL;
+
+    for (extent_t* e = _root; e;)
+    {
+        if (e->end > addr)
+        {
+            found = e;
+            e = e->left;
+        }
+        else
+        {
+            e = e->right;
+        }
+    }
+
+    return found;
+}
+
+/* Find the lowest unmapped extent of at least the given size */
+static extent_t* _find_hole(uint64_t size)
+{
+    extent_t* e = _root;
+
+    if (_max_hole_size(e) < size)
+        return NULL;
+
+    for (;;)
+    {
+        if (_max_hole_size(e->left) >= size)
+            e = e->left;
+        else if (!e->mapped && e->end - e->start >= size)
+            return e;
+        else
+            e = e->right;
+    }
+}
+
+static void _add_extent(extent_t* e)
+{
+    _root = _insert(_root, e);
+}
+
+static void _remove_extent(extent_t* e)
+{
+    _root = _remove(_root, e);
+}
+
+static void _free_block(block_t* block)
+{
+    if (block->prev)
+        block->prev->next = block->next;
+    else
+        _blocks = block->next;
+
+    if (block->next)
+        block->next->prev = block->prev;
+
+    free((void*)block->start);
+    free(block);
+}
+
+/* Add an extent that is not in the tree, merging it with its neighbors of the
+ * same block and state. The block is freed if none of its pages are mapped
+ * any more. */
+static void _add_coalesced(extent_t* e)
+{
+    extent_t* prev = e->start > e->block->start ? _find(e->start - 1) : NULL;
+    extent_t* next = e->end < e->block->end ? _find(e->end) : NULL;
+
+    if (prev && prev->block == e->block && prev->end == e->start &&
+        prev->mapped == e->mapped)
+    {
+        _remove_extent(prev);
+        e->start = prev->start;
+        free(prev);
+    }
+
+    if (next && next->block == e->block && next->start == e->end &&
+        next->mapped == e->mapped)
+    {
+        _remove_extent(next);
+        e->end = next->end;
+        free(next);
+    }
+
+    if (!e->block->num_mapped_pages)
+    {
+        /* The extent now spans the whole block */
+        _free_block(e->block);
+        free(e);
+        return;
+    }
+
+    _add_extent(e);
+}
+
 static void _clear_mappings(void)
 {
-    oe_mapping_t* m = _mappings;
-    _mappings = 0;
-    while (m)
+    while (_root)
     {
-        oe_mapping_t* next = m->next;
-        free((void*)m->start);
-        m->start = 0;
-        free(m->status_vector);
-        m->status_vector = NULL;
-        free(m);
-        m = next;
+        extent_t* e = _root;
+        _remove_extent(e);
+        free(e);
     }
+
+    while (_blocks)
+        _free_block(_blocks);
 }
 
 static void _call_atexit(void)
@@ -163,6 +432,40 @@ done:
     return result;
 }
 
+/* Map pages from a hole of a block that is still in use */
+static bool _map_hole(uint64_t length, uint64_t* start, extent_t** spare)
+{
+    extent_t* hole = NULL;
+    extent_t* e = *spare;
+
+    if (!(hole = _find_hole(length)))
+        return false;
+
+    _remove_extent(hole);
+
+    *start = hole->start;
+    e->start = hole->start;
+    e->end = hole->start + length;
+    e->block = hole->block;
+    e->mapped = true;
+    e->block->num_mapped_pages += length / OE_PAGE_SIZE;
+    *spare = NULL;
+
+    if (hole->end > e->end)
+    {
+        hole->start = e->end;
+        _add_extent(hole);
+    }
+    else
+    {
+        free(hole);
+    }
+
+    _add_coalesced(e);
+
+    return true;
+}
+
 // See https://www.man7.org/linux/man-pages/man2/mmap.2.html for
 // semantics of mmap and munmap.
 void* oe_mmap(
@@ -175,9 +478,10 @@ void* oe_mmap(
 {
     oe_result_t result = OE_UNEXPECTED;
     void* ptr = NULL;
-    void* vector = NULL;
-    oe_mapping_t* m = NULL;
-    size_t vector_length = 0;
+    block_t* block = NULL;
+    extent_t* e = NULL;
+    uint64_t start = 0;
+    bool mapped = false;
     int ret = 0;
 
     OE_CHECK(_validate_mmap_parameters(addr, length, prot, flags, fd, offset));
@@ -186,144 +490,196 @@ void* oe_mmap(
 
     // length is rounded up to nearest page size.
     OE_CHECK(oe_safe_round_up_u64(length, OE_PAGE_SIZE, &length));
-    OE_CHECK(oe_safe_round_up_u64(length / 8, 8, &vector_length));
 
-    // Allocate objects.
-    vector = (uint8_t*)calloc(vector_length, 1);
-    m = (oe_mapping_t*)malloc(sizeof(*m));
-    if (!vector || !m)
+    if (!(e = (extent_t*)malloc(sizeof(*e))))
     {
         oe_errno = OE_ENOMEM;
         OE_RAISE(OE_OUT_OF_MEMORY);
     }
 
-    if (((ret = posix_memalign(&ptr, OE_PAGE_SIZE, length)) != 0) || !ptr)
-    {
-        // posix_memalign does not set errno (by spec).
-        // Set it ourselves.
-        oe_errno = ret;
-        OE_RAISE_MSG(
-            OE_OUT_OF_MEMORY, "posix_memalign failed with code %d", ret);
-    }
-
-    // Set up mapping.
-    m->start = (uint64_t)ptr;
-    OE_CHECK(oe_safe_add_u64((uint64_t)m->start, length, (uint64_t*)&m->end));
-    m->status_vector = vector;
-    memset(ptr, 0, length);
+    // Reuse the pages of a partially unmapped block if possible.
+    oe_spin_lock(&_lock);
+    mapped = _map_hole(length, &start, &e);
+    oe_spin_unlock(&_lock);
 
-    // Set relevant bits of status vector to 1.
+    if (!mapped)
     {
-        int bv_idx = 0;
-        uint8_t bit_mask = 0x01;
-        // Since m->end has been rounded to OE_PAGE_SIZE and been validated via
-        // oe_safe_add_u64, it is safe to add OE_PAGE_SIZE to `a` since it won't
-        // overflow.
-        for (uint64_t a = m->start; a < m->end; a += OE_PAGE_SIZE)
+        if (!(block = (block_t*)malloc(sizeof(*block))))
         {
-            m->status_vector[bv_idx] |= bit_mask;
-            bit_mask <<= 1;
-            if (!bit_mask)
-            {
-                // Move to next byte in status vector.
-                ++bv_idx;
-                bit_mask = 0x01;
-            }
+            oe_errno = OE_ENOMEM;
+            OE_RAISE(OE_OUT_OF_MEMORY);
         }
+
+        if (((ret = posix_memalign(&ptr, OE_PAGE_SIZE, length)) != 0) || !ptr)
+        {
+            // posix_memalign does not set errno (by spec).
+            // Set it ourselves.
+            oe_errno = ret;
+            OE_RAISE_MSG(
+                OE_OUT_OF_MEMORY, "posix_memalign failed with code %d", ret);
+        }
+
+        // Set up the block and its single extent.
+        block->start = (uint64_t)ptr;
+        OE_CHECK(oe_safe_add_u64(block->start, length, &block->end));
+        block->num_mapped_pages = length / OE_PAGE_SIZE;
+        block->prev = NULL;
+
+        e->start = block->start;
+        e->end = block->end;
+        e->block = block;
+        e->mapped = true;
+
+        oe_spin_lock(&_lock);
+        block->next = _blocks;
+        if (_blocks)
+            _blocks->prev = block;
+        _blocks = block;
+        _add_extent(e);
+        oe_spin_unlock(&_lock);
+
+        start = block->start;
+        block = NULL;
+        ptr = NULL;
+        e = NULL;
     }
 
-    // Update mappings list.
-    oe_spin_lock(&_lock);
-    m->next = _mappings;
-    _mappings = m;
-    oe_spin_unlock(&_lock);
+    // The pages now belong to the caller, so zero them outside of the lock.
+    memset((void*)start, 0, length);
 
     result = OE_OK;
 
 done:
+    free(e);
+    free(block);
+    free(ptr);
+
     if (result != OE_OK)
-    {
-        free(vector);
-        free(ptr);
-        free(m);
         return MAP_FAILED;
-    }
-    return ptr;
+
+    return (void*)start;
 }
 
-static void _munmap(
-    oe_mapping_t* prev,
-    oe_mapping_t* m,
+static extent_t* _take_spare(extent_t* spares[2])
+{
+    extent_t* e = spares[0] ? spares[0] : spares[1];
+
+    if (e == spares[0])
+        spares[0] = NULL;
+    else
+        spares[1] = NULL;
+
+    return e;
+}
+
+/* Unmap the pages of a mapped extent that lie in [start, end) */
+static void _unmap_extent(
+    extent_t* e,
     uint64_t start,
-    uint64_t end)
+    uint64_t end,
+    extent_t* spares[2])
 {
-    while (m)
+    extent_t* hole = e;
+
+    _remove_extent(e);
+
+    if (start > e->start)
     {
-        if (end <= m->start || start >= m->end)
-        {
-            // Specified address range does not intersect with current mapping.
-            prev = m;
-            m = m->next;
-            continue;
-        }
+        /* The pages before the range stay mapped */
+        hole = _take_spare(spares);
+        hole->start = start;
+        hole->end = e->end;
+        hole->block = e->block;
+        e->end = start;
+        _add_extent(e);
+    }
 
-        // Specified address range intersects with current mapping.
+    if (end < hole->end)
+    {
+        /* The pages after the range stay mapped */
+        extent_t* after = _take_spare(spares);
+        after->start = end;
+        after->end = hole->end;
+        after->block = hole->block;
+        after->mapped = true;
+        hole->end = end;
+        _add_extent(after);
+    }
 
-        // Unmap part of address range that lies to the left of current mapping.
-        if (start < m->start)
-            _munmap(m, m->next, start, m->start);
+    hole->mapped = false;
+    hole->block->num_mapped_pages -= (hole->end - hole->start) / OE_PAGE_SIZE;
+    _add_coalesced(hole);
+}
 
-        // Unmap part of address range that lies to the right of current
-        // mapping.
-        if (end > m->end)
-            _munmap(m, m->next, m->end, end);
+int oe_munmap(void* addr, uint64_t length)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    uint64_t start = (uint64_t)addr;
+    uint64_t end = 0;
+    extent_t* spares[2] = {NULL, NULL};
+    bool locked = false;
 
-        bool delete = true;
-        if (start > m->start || end < m->end)
-        {
-            // Partial unmapping.
-            uint8_t bit_mask = 1;
-            int bv_idx = 0;
+    OE_CHECK(oe_safe_add_u64(start, length, &end));
+    OE_CHECK(oe_safe_round_up_u64(end, OE_PAGE_SIZE, &end));
 
-            // Mark all pages in given address range as unmapped.
-            for (uint64_t a = m->start; a < m->end; a += OE_PAGE_SIZE)
-            {
-                // If pages lies in the specified range, unset its status.
-                if (start <= a && a < end)
-                    m->status_vector[bv_idx] &= ~bit_mask;
+    if ((start % OE_PAGE_SIZE) != 0)
+    {
+        oe_errno = OE_EINVAL;
+        goto done;
+    }
 
-                bit_mask <<= 1;
-                if (!bit_mask)
+    oe_spin_lock(&_lock);
+    locked = true;
+
+    for (extent_t* e = _find(start); e && e->start < end; e = _find(start))
+    {
+        uint64_t next = e->end;
+
+        if (e->mapped)
+        {
+            /* Splitting the extent takes up to two more. Allocate them first,
+             * so that a failure leaves the extent as it was. */
+            for (size_t i = 0; i < OE_COUNTOF(spares); i++)
+            {
+                if (!spares[i] &&
+                    !(spares[i] = (extent_t*)malloc(sizeof(extent_t))))
                 {
-                    // Retain the mapping if any bit in the vector is set.
-                    delete = delete &&!m->status_vector[bv_idx];
-                    bit_mask = 1;
-                    bv_idx++;
+                    oe_errno = OE_ENOMEM;
+                    OE_RAISE(OE_OUT_OF_MEMORY);
                 }
             }
-            delete = delete &&!m->status_vector[bv_idx];
-        }
 
-        if (delete)
-        {
-            if (prev)
-                prev->next = m->next;
-            else
-                _mappings = m->next;
-            free(m->status_vector);
-            free((void*)m->start);
-            free(m);
+            _unmap_extent(
+                e,
+                start > e->start ? start : e->start,
+                end < next ? end : next,
+                spares);
         }
 
-        break;
+        start = next;
     }
+
+    oe_errno = 0;
+    result = OE_OK;
+
+done:
+    if (locked)
+        oe_spin_unlock(&_lock);
+
+    free(spares[0]);
+    free(spares[1]);
+
+    return (result == OE_OK) ? 0 : -1;
 }
 
-int oe_munmap(void* addr, uint64_t length)
+int oe_madvise(void* addr, uint64_t length, int advice)
 {
     oe_result_t result = OE_UNEXPECTED;
     uint64_t start = (uint64_t)addr;
     uint64_t end = 0;
+    uint64_t a = start;
+    bool locked = false;
+
     OE_CHECK(oe_safe_add_u64(start, length, &end));
     OE_CHECK(oe_safe_round_up_u64(end, OE_PAGE_SIZE, &end));
 
@@ -333,12 +689,51 @@ int oe_munmap(void* addr, uint64_t length)
         goto done;
     }
 
+    switch (advice)
+    {
+        case MADV_NORMAL:
+        case MADV_RANDOM:
+        case MADV_SEQUENTIAL:
+        case MADV_WILLNEED:
+        case MADV_DONTNEED:
+        case MADV_FREE:
+            break;
+        default:
+            oe_errno = OE_EINVAL;
+            OE_RAISE_MSG(OE_UNSUPPORTED, "unsupported `advice` %d", advice);
+    }
+
+    // As on Linux, the whole range must be mapped.
     oe_spin_lock(&_lock);
-    _munmap(NULL, _mappings, start, end);
+    locked = true;
+
+    for (extent_t* e = _find(a); a < end; e = _find(a))
+    {
+        if (!e || !e->mapped || e->start > a)
+        {
+            oe_errno = OE_ENOMEM;
+            OE_RAISE_NO_TRACE(OE_NOT_FOUND);
+        }
+
+        a = e->end;
+    }
+
     oe_spin_unlock(&_lock);
+    locked = false;
+
+    // The pages of anonymous mappings read as zero after MADV_DONTNEED. They
+    // cannot be given back to the heap while they are mapped. MADV_FREE
+    // leaves them as they are, which is allowed until they are written.
+    if (advice == MADV_DONTNEED)
+        memset((void*)start, 0, end - start);
+
     oe_errno = 0;
     result = OE_OK;
+
 done:
+    if (locked)
+        oe_spin_unlock(&_lock);
+
     return (result == OE_OK) ? 0 : -1;
 }
 
@@ -352,13 +747,51 @@ int munmap(void* start, size_t len)
     return (int)syscall(SYS_munmap, start, len);
 }
 
+int madvise(void* addr, size_t len, int advice)
+{
+    return (int)syscall(SYS_madvise, addr, len, advice);
+}
+
 // Needed for MUSL
 OE_WEAK_ALIAS(mmap, __mmap);
 OE_WEAK_ALIAS(mmap, mmap64);
 OE_WEAK_ALIAS(munmap, __munmap);
+OE_WEAK_ALIAS(madvise, __madvise);
+
+// Utility functions for tests.
+size_t oe_test_get_num_mappings(void)
+{
+    size_t count = 0;
+
+    oe_spin_lock(&_lock);
+    for (extent_t* e = _find(0); e; e = _find(e->end))
+        count += e->mapped;
+    oe_spin_unlock(&_lock);
 
-// Utility function for tests.
-oe_mapping_t* oe_test_get_mappings(void)
+    return count;
+}
+
+size_t oe_test_get_num_blocks(void)
 {
-    return _mappings;
+    size_t count = 0;
+
+    oe_spin_lock(&_lock);
+    for (block_t* b = _blocks; b; b = b->next)
+        count++;
+    oe_spin_unlock(&_lock);
+
+    return count;
+}
+
+bool oe_test_is_mapped(const void* addr)
+{
+    extent_t* e = NULL;
+    bool mapped = false;
+
+    oe_spin_lock(&_lock);
+    e = _find((uint64_t)addr);
+    mapped = e && e->mapped && e->start <= (uint64_t)addr;
+    oe_spin_unlock(&_lock);
+
+    return mapped;
 }
@@ -14,12 +14,11 @@ void* oe_mmap(
 
 int oe_munmap(void* addr, uint64_t length);
 
-typedef struct _mapping
-{
-    uint64_t start;
-    uint64_t end;
-    uint8_t* status_vector;
-    struct _mapping* next;
-} oe_mapping_t;
+int oe_madvise(void* addr, uint64_t length, int advice);
 
-oe_mapping_t* oe_test_get_mappings(void);
+/* Utility functions for tests */
+size_t oe_test_get_num_mappings(void);
+
+size_t oe_test_get_num_blocks(void);
+
+bool oe_test_is_mapped(const void* addr);
@@ -10,7 +10,11 @@
 #include <openenclave/internal/pthreadhooks.h>
 #include <openenclave/internal/sgx/td.h>
 #include <openenclave/internal/thread.h>
+#include <openenclave/internal/threadpool.h>
+#include <errno.h>
+#include <limits.h>
 #include <pthread.h>
+#include <stdlib.h>
 
 #ifdef pthread_equal
 #undef pthread_equal
@@ -52,18 +56,311 @@ OE_STATIC_ASSERT(sizeof(pthread_rwlock_t) >= sizeof(oe_rwlock_t));
 
 static __thread struct __pthread _pthread_self = {.locale = C_LOCALE};
 
+/* The thread created with pthread_create() that the current thread of the
+ * thread pool runs, if any */
+static __thread pthread_t _pthread_current;
+
 pthread_t __get_tp()
 {
-    return &_pthread_self;
+    return _pthread_current ? _pthread_current : &_pthread_self;
 }
 
 pthread_t pthread_self()
 {
-    return &_pthread_self;
+    return _pthread_current ? _pthread_current : &_pthread_self;
 }
 
 static oe_pthread_hooks_t* _pthread_hooks;
 
+/*
+**==============================================================================
+**
+** Threads of the thread pool.
+**
+**     Unless pthread hooks are registered, pthread_create() runs the new
+**     thread on a thread of the thread pool of the enclave (see
+**     oe_thread_pool_run()), which the host creates with the
+**     OE_ENCLAVE_SETTING_THREAD_POOL setting. The thread keeps its thread of
+**     the pool, and thus a TCS, until it returns. A thread of the pool has
+**     the stack of its TCS, so the attributes may only set the detach state.
+**
+**     The thread pool runs the destructors of the keys of a thread when it
+**     returns (see pthread_key_create()), but its __thread and thread_local
+**     variables keep their values for the next thread that runs on the same
+**     thread of the pool.
+**
+**==============================================================================
+*/
+
+typedef enum _pool_thread_state
+{
+    POOL_THREAD_RUNNING,
+    POOL_THREAD_EXITED,
+    POOL_THREAD_DETACHED,
+} pool_thread_state_t;
+
+typedef struct _pool_thread
+{
+    /* What pthread_self() returns in the thread, so it must come first */
+    struct __pthread base;
+    struct _pool_thread* prev;
+    struct _pool_thread* next;
+    void* (*start_routine)(void*);
+    void* arg;
+    void* retval;
+    pool_thread_state_t state;
+} pool_thread_t;
+
+/* Guards the list of the pool threads that were not freed yet and their
+ * states, and their exits are broadcast on _pool_threads_cond */
+static oe_mutex_t _pool_threads_lock = OE_MUTEX_INITIALIZER;
+static oe_cond_t _pool_threads_cond = OE_COND_INITIALIZER;
+static pool_thread_t* _pool_threads;
+
+/* Add the thread to the list (under _pool_threads_lock) */
+static void _add_pool_thread(pool_thread_t* thread)
+{
+    thread->prev = NULL;
+    thread->next = _pool_threads;
+
+    if (_pool_threads)
+        _pool_threads->prev = thread;
+
+    _pool_threads = thread;
+}
+
+/* Remove the thread from the list (under _pool_threads_lock) */
+static void _remove_pool_thread(pool_thread_t* thread)
+{
+    if (thread->prev)
+        thread->prev->next = thread->next;
+    else
+        _pool_threads = thread->next;
+
+    if (thread->next)
+        thread->next->prev = thread->prev;
+}
+
+/* Find the pool thread of the handle, which may be any pthread_t
+ * (under _pool_threads_lock) */
+static pool_thread_t* _find_pool_thread(pthread_t thread)
+{
+    for (pool_thread_t* p = _pool_threads; p; p = p->next)
+    {
+        if (&p->base == thread)
+            return p;
+    }
+
+    return NULL;
+}
+
+static void _run_pool_thread(void* arg)
+{
+    pool_thread_t* thread = (pool_thread_t*)arg;
+    void* retval;
+    bool detached;
+
+    _pthread_current = &thread->base;
+    retval = thread->start_routine(thread->arg);
+    _pthread_current = NULL;
+
+    oe_mutex_lock(&_pool_threads_lock);
+    thread->retval = retval;
+    detached = thread->state == POOL_THREAD_DETACHED;
+    thread->state = POOL_THREAD_EXITED;
+
+    if (detached)
+        _remove_pool_thread(thread);
+    else
+        oe_cond_broadcast(&_pool_threads_cond);
+
+    oe_mutex_unlock(&_pool_threads_lock);
+
+    if (detached)
+        free(thread);
+}
+
+static int _create_pool_thread(
+    pthread_t* thread,
+    const pthread_attr_t* attr,
+    void* (*start_routine)(void*),
+    void* arg)
+{
+    pool_thread_t* pool_thread;
+    oe_result_t result;
+
+    if (!thread || !start_routine)
+        return EINVAL;
+
+    /* The thread has the stack of its thread of the pool */
+    if (attr && (attr->_a_stacksize || attr->_a_stackaddr))
+        return EINVAL;
+
+    if (!(pool_thread = (pool_thread_t*)calloc(1, sizeof(pool_thread_t))))
+        return EAGAIN;
+
+    pool_thread->base.locale = C_LOCALE;
+    pool_thread->start_routine = start_routine;
+    pool_thread->arg = arg;
+    pool_thread->state = attr && attr->_a_detach ? POOL_THREAD_DETACHED
+                                                 : POOL_THREAD_RUNNING;
+
+    /* Set the thread before it can run, as it may read it */
+    *thread = &pool_thread->base;
+
+    oe_mutex_lock(&_pool_threads_lock);
+    _add_pool_thread(pool_thread);
+    oe_mutex_unlock(&_pool_threads_lock);
+
+    if ((result = oe_thread_pool_run(_run_pool_thread, pool_thread)) != OE_OK)
+    {
+        oe_mutex_lock(&_pool_threads_lock);
+        _remove_pool_thread(pool_thread);
+        oe_mutex_unlock(&_pool_threads_lock);
+
+        free(pool_thread);
+        return result == OE_INVALID_PARAMETER ? EINVAL : EAGAIN;
+    }
+
+    return 0;
+}
+
+static int _join_pool_thread(pthread_t thread, void** retval)
+{
+    pool_thread_t* pool_thread;
+    int ret = 0;
+
+    oe_mutex_lock(&_pool_threads_lock);
+
+    if (!(pool_thread = _find_pool_thread(thread)))
+    {
+        ret = ESRCH;
+    }
+    else if (thread == pthread_self())
+    {
+        ret = EDEADLK;
+    }
+    else if (pool_thread->state == POOL_THREAD_DETACHED)
+    {
+        ret = EINVAL;
+    }
+    else
+    {
+        while (pool_thread->state != POOL_THREAD_EXITED)
+            oe_cond_wait(&_pool_threads_cond, &_pool_threads_lock);
+
+        _remove_pool_thread(pool_thread);
+    }
+
+    oe_mutex_unlock(&_pool_threads_lock);
+
+    if (ret == 0)
+    {
+        if (retval)
+            *retval = pool_thread->retval;
+
+        free(pool_thread);
+    }
+
+    return ret;
+}
+
+static int _detach_pool_thread(pthread_t thread)
+{
+    pool_thread_t* pool_thread;
+    bool exited = false;
+    int ret = 0;
+
+    oe_mutex_lock(&_pool_threads_lock);
+
+    if (!(pool_thread = _find_pool_thread(thread)))
+    {
+        ret = ESRCH;
+    }
+    else if (pool_thread->state == POOL_THREAD_DETACHED)
+    {
+        ret = EINVAL;
+    }
+    else if (pool_thread->state == POOL_THREAD_EXITED)
+    {
+        _remove_pool_thread(pool_thread);
+        exited = true;
+    }
+    else
+    {
+        pool_thread->state = POOL_THREAD_DETACHED;
+    }
+
+    oe_mutex_unlock(&_pool_threads_lock);
+
+    if (exited)
+        free(pool_thread);
+
+    return ret;
+}
+
+/*
+**==============================================================================
+**
+** pthread_attr_t
+**
+**     musl's pthread_attr functions are not part of oelibc, so these set the
+**     fields of the attributes that _create_pool_thread() reads.
+**
+**==============================================================================
+*/
+
+int pthread_attr_init(pthread_attr_t* attr)
+{
+    if (!attr)
+        return EINVAL;
+
+    *attr = (pthread_attr_t){0};
+    return 0;
+}
+
+int pthread_attr_destroy(pthread_attr_t* attr)
+{
+    OE_UNUSED(attr);
+    return 0;
+}
+
+int pthread_attr_setdetachstate(pthread_attr_t* attr, int state)
+{
+    if (!attr || (unsigned)state > 1U)
+        return EINVAL;
+
+    attr->_a_detach = state;
+    return 0;
+}
+
+int pthread_attr_getdetachstate(const pthread_attr_t* attr, int* state)
+{
+    if (!attr || !state)
+        return EINVAL;
+
+    *state = attr->_a_detach;
+    return 0;
+}
+
+int pthread_attr_setstacksize(pthread_attr_t* attr, size_t size)
+{
+    if (!attr || size < PTHREAD_STACK_MIN)
+        return EINVAL;
+
+    attr->_a_stacksize = size;
+    return 0;
+}
+
+int pthread_attr_getstacksize(const pthread_attr_t* attr, size_t* size)
+{
+    if (!attr || !size)
+        return EINVAL;
+
+    *size = attr->_a_stacksize;
+    return 0;
+}
+
 void oe_register_pthread_hooks(oe_pthread_hooks_t* pthread_hooks)
 {
     _pthread_hooks = pthread_hooks;
@@ -76,10 +373,7 @@ int pthread_create(
     void* arg)
 {
     if (!_pthread_hooks || !_pthread_hooks->create)
-    {
-        oe_assert("pthread_create(): panic" == NULL);
-        return -1;
-    }
+        return _create_pool_thread(thread, attr, start_routine, arg);
 
     return _pthread_hooks->create(thread, attr, start_routine, arg);
 }
@@ -87,10 +381,7 @@ int pthread_create(
 int pthread_join(pthread_t thread, void** retval)
 {
     if (!_pthread_hooks || !_pthread_hooks->join)
-    {
-        oe_assert("pthread_join(): panic" == NULL);
-        return -1;
-    }
+        return _join_pool_thread(thread, retval);
 
     return _pthread_hooks->join(thread, retval);
 }
@@ -98,10 +389,7 @@ int pthread_join(pthread_t thread, void** retval)
 int pthread_detach(pthread_t thread)
 {
     if (!_pthread_hooks || !_pthread_hooks->detach)
-    {
-        oe_assert("pthread_detach(): panic" == NULL);
-        return -1;
-    }
+        return _detach_pool_thread(thread);
 
     return _pthread_hooks->detach(thread);
 }
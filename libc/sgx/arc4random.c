@@ -3,6 +3,7 @@
 
 /* Ignore unused-variable warning in system header */
 #pragma GCC diagnostic ignored "-Wunused-variable"
+#include <openenclave/internal/random.h>
 #include <openenclave/internal/rdrand.h>
 #include <stdlib.h>
 /*
@@ -13,6 +14,10 @@
 unsigned int arc4random(void)
 {
     unsigned int r;
-    r = (unsigned int)oe_rdrand();
+
+    /* Fall back to the hardware if the DRBG cannot be seeded */
+    if (oe_random_internal(&r, sizeof(r)) != OE_OK)
+        r = (unsigned int)oe_rdrand();
+
     return r;
 }
@@ -28,9 +28,8 @@
 static oe_syscall_hook_t _hook;
 static oe_spinlock_t _lock;
 
-static const uint64_t _SEC_TO_MSEC = 1000UL;
-static const uint64_t _MSEC_TO_USEC = 1000UL;
-static const uint64_t _MSEC_TO_NSEC = 1000000UL;
+static const uint64_t _SEC_TO_NSEC = 1000000000UL;
+static const uint64_t _USEC_TO_NSEC = 1000UL;
 
 OE_WEAK OE_DEFINE_SYSCALL6(SYS_mmap)
 {
@@ -50,28 +49,36 @@ OE_WEAK OE_DEFINE_SYSCALL2(SYS_munmap)
     return (long)oe_munmap(addr, length);
 }
 
+OE_WEAK OE_DEFINE_SYSCALL3(SYS_madvise)
+{
+    void* addr = (void*)arg1;
+    size_t length = (size_t)arg2;
+    int advice = (int)arg3;
+    return (long)oe_madvise(addr, length, advice);
+}
+
 OE_WEAK OE_DEFINE_SYSCALL2(SYS_clock_gettime)
 {
     clockid_t clock_id = (clockid_t)arg1;
     struct timespec* tp = (struct timespec*)arg2;
     int ret = -1;
-    uint64_t msec;
+    uint64_t nsec;
+    oe_result_t result;
 
     if (!tp)
-        goto done;
-
-    if (clock_id != CLOCK_REALTIME)
     {
-        /* Only supporting CLOCK_REALTIME */
-        oe_assert("clock_gettime(): panic" == NULL);
+        errno = EFAULT;
         goto done;
     }
 
-    if ((msec = oe_get_time()) == (uint64_t)-1)
+    if ((result = oe_get_clock_time(clock_id, &nsec)) != OE_OK)
+    {
+        errno = result == OE_UNSUPPORTED ? EINVAL : EIO;
         goto done;
+    }
 
-    tp->tv_sec = msec / _SEC_TO_MSEC;
-    tp->tv_nsec = (msec % _SEC_TO_MSEC) * _MSEC_TO_NSEC;
+    tp->tv_sec = (time_t)(nsec / _SEC_TO_NSEC);
+    tp->tv_nsec = (long)(nsec % _SEC_TO_NSEC);
 
     ret = 0;
 
@@ -85,7 +92,7 @@ OE_WEAK OE_DEFINE_SYSCALL2(SYS_gettimeofday)
     struct timeval* tv = (struct timeval*)arg1;
     void* tz = (void*)arg2;
     int ret = -1;
-    uint64_t msec;
+    uint64_t nsec;
 
     if (tv)
         memset(tv, 0, sizeof(struct timeval));
@@ -96,11 +103,11 @@ OE_WEAK OE_DEFINE_SYSCALL2(SYS_gettimeofday)
     if (!tv)
         goto done;
 
-    if ((msec = oe_get_time()) == (uint64_t)-1)
+    if (oe_get_clock_time(CLOCK_REALTIME, &nsec) != OE_OK)
         goto done;
 
-    tv->tv_sec = msec / _SEC_TO_MSEC;
-    tv->tv_usec = msec % _MSEC_TO_USEC;
+    tv->tv_sec = (time_t)(nsec / _SEC_TO_NSEC);
+    tv->tv_usec = (suseconds_t)(nsec % _SEC_TO_NSEC / _USEC_TO_NSEC);
 
     ret = 0;
 
@@ -224,6 +231,8 @@ long __syscall(long n, long x1, long x2, long x3, long x4, long x5, long x6)
         OE_SYSCALL_DISPATCH(SYS_clock_gettime, x1, x2);
         OE_SYSCALL_DISPATCH(SYS_gettimeofday, x1, x2);
         OE_SYSCALL_DISPATCH(SYS_mmap, x1, x2, x3, x4, x5, x6);
+        OE_SYSCALL_DISPATCH(SYS_munmap, x1, x2);
+        OE_SYSCALL_DISPATCH(SYS_madvise, x1, x2, x3);
 
         default:
             /* Drop through and let the code below handle the syscall. */
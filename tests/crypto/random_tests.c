@@ -50,6 +50,36 @@ static void _test_random(size_t seq_length)
     printf("=== passed %s()\n", __FUNCTION__);
 }
 
+/* Generate a sequence spanning many refills of the enclave DRBG and check
+ * that its blocks do not repeat */
+static void _test_random_large(void)
+{
+    const size_t block_size = 1024;
+    const size_t num_blocks = 256;
+    uint8_t* buf;
+
+    printf("=== begin %s()\n", __FUNCTION__);
+
+    buf = (uint8_t*)malloc(block_size * num_blocks);
+    OE_TEST(buf != NULL);
+
+    /* Start at an odd offset so that the blocks straddle the refills */
+    OE_TEST(oe_random_internal(buf, 13) == OE_OK);
+    OE_TEST(oe_random_internal(buf, block_size * num_blocks) == OE_OK);
+
+    for (size_t i = 1; i < num_blocks; i++)
+    {
+        const uint8_t* block = buf + i * block_size;
+
+        OE_TEST(memcmp(buf, block, block_size) != 0);
+        OE_TEST(memcmp(block - block_size, block, block_size) != 0);
+    }
+
+    free(buf);
+
+    printf("=== passed %s()\n", __FUNCTION__);
+}
+
 void TestRandom(void)
 {
     _test_random(19);
@@ -60,4 +90,5 @@ void TestRandom(void)
     _test_random(2048);
     _test_random(2049);
     OE_STATIC_ASSERT(SEQ_LENGTH_MAX == 2049);
+    _test_random_large();
 }
@@ -2,9 +2,12 @@
 // Licensed under the MIT License.
 
 #include <openenclave/corelibc/string.h>
+#include <openenclave/debugmalloc.h>
 #include <openenclave/enclave.h>
 #include <openenclave/internal/print.h>
+#include <openenclave/internal/tests.h>
 #include <stdlib.h>
+#include <string.h>
 #include "debug_malloc_t.h"
 
 void* ptr;
@@ -22,10 +25,62 @@ void enc_cleanup_memory()
     free(ptr);
 }
 
+#define BATCH_SIZE 32
+
+void enc_churn(size_t count)
+{
+    void* ptrs[BATCH_SIZE];
+
+    // Called from several threads at once to exercise the in-use lists.
+    for (size_t n = 0; n < count; n += BATCH_SIZE)
+    {
+        for (size_t i = 0; i < BATCH_SIZE; i++)
+        {
+            ptrs[i] = malloc(16 + (n + i) % 512);
+            OE_TEST(ptrs[i] != NULL);
+        }
+
+        for (size_t i = 0; i < BATCH_SIZE; i++)
+            free(ptrs[i]);
+    }
+}
+
+void enc_tracking_report(size_t count)
+{
+    void** ptrs = NULL;
+    uint64_t object_count = 0;
+    char* report = NULL;
+
+    ptrs = (void**)calloc(count, sizeof(void*));
+    OE_TEST(ptrs != NULL);
+
+    OE_TEST(oe_debug_malloc_tracking_start() == OE_OK);
+
+    // The blocks are spread over all the in-use lists.
+    for (size_t i = 0; i < count; i++)
+    {
+        ptrs[i] = malloc(64);
+        OE_TEST(ptrs[i] != NULL);
+    }
+
+    OE_TEST(oe_debug_malloc_tracking_report(&object_count, &report) == OE_OK);
+    OE_TEST(object_count == count);
+    OE_TEST(report != NULL && strlen(report) > 0);
+
+    free(report);
+
+    for (size_t i = 0; i < count; i++)
+        free(ptrs[i]);
+
+    OE_TEST(oe_debug_malloc_tracking_stop() == OE_OK);
+
+    free(ptrs);
+}
+
 OE_SET_ENCLAVE_SGX(
     1,    /* ProductID */
     1,    /* SecurityVersion */
     true, /* Debug */
     1024, /* NumHeapPages */
     64,   /* NumStackPages */
-    1);   /* NumTCS */
+    4);   /* NumTCS */
@@ -7,8 +7,12 @@
 #include <openenclave/internal/tests.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <thread>
+#include <vector>
 #include "debug_malloc_u.h"
 
+#define NUM_THREADS 4
+
 int main(int argc, const char* argv[])
 {
     oe_result_t result;
@@ -47,6 +51,29 @@ int main(int argc, const char* argv[])
         // No leaks will be reported.
         OE_TEST(oe_terminate_enclave(enclave) == OE_OK);
     }
+    {
+        // Allocate and free from several threads, then leak from one.
+        if ((result = oe_create_debug_malloc_enclave(
+                 argv[1], OE_ENCLAVE_TYPE_SGX, flags, NULL, 0, &enclave)) !=
+            OE_OK)
+            oe_put_err("oe_create_enclave(): result=%u", result);
+
+        std::vector<std::thread> threads;
+
+        for (size_t i = 0; i < NUM_THREADS; i++)
+            threads.push_back(std::thread([enclave]() {
+                OE_TEST(enc_churn(enclave, 64 * 1024) == OE_OK);
+            }));
+
+        for (auto& thread : threads)
+            thread.join();
+
+        OE_TEST(enc_tracking_report(enclave, 256) == OE_OK);
+        OE_TEST(enc_allocate_memory(enclave) == OE_OK);
+
+        // The leak is found whichever in-use list holds the block.
+        OE_TEST(oe_terminate_enclave(enclave) == OE_MEMORY_LEAK);
+    }
     printf("=== passed all tests (debug_malloc)\n");
 
     return 0;
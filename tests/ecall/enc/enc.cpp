@@ -151,6 +151,49 @@ void enc_test(test_args* args)
     }
 }
 
+bool enc_test_ecall_buffer(
+    const void* in,
+    size_t in_size,
+    void* out,
+    size_t out_size)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(in);
+    uint8_t* q = static_cast<uint8_t*>(out);
+    bool zeroed = true;
+
+    OE_TEST(oe_is_within_enclave(in, in_size));
+    OE_TEST(oe_is_within_enclave(out, out_size));
+
+    for (size_t i = 0; i < in_size; i++)
+        OE_TEST(p[i] == 0x5A);
+
+    /* The output region must be zero even if an earlier ecall left data in
+     * the reused marshaling buffer */
+    for (size_t i = 0; i < out_size; i++)
+    {
+        if (q[i] != 0)
+            zeroed = false;
+    }
+
+    memset(out, 0xAA, out_size);
+    return zeroed;
+}
+
+uint64_t enc_get_ecall_buffer_size()
+{
+    return oe_sgx_get_td()->ecall_buffer_size;
+}
+
+oe_result_t enc_configure_ecall_buffer_cache(size_t max_size)
+{
+    return oe_configure_ecall_buffer_cache(max_size);
+}
+
+uint64_t enc_batch_add(uint64_t a, uint64_t b)
+{
+    return a + b;
+}
+
 OE_SET_ENCLAVE_SGX(
     1,    /* ProductID */
     1,    /* SecurityVersion */
@@ -9,6 +9,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 #include "ecall_u.h"
 
 #if 0
@@ -59,6 +60,144 @@ void TestECall(oe_enclave_t* enclave)
     prev = args.thread_data.last_sp;
 }
 
+static bool _call_with_sizes(
+    oe_enclave_t* enclave,
+    size_t in_size,
+    size_t out_size)
+{
+    std::vector<uint8_t> in(in_size, 0x5A);
+    std::vector<uint8_t> out(out_size, 0);
+    bool zeroed = false;
+
+    OE_TEST(
+        enc_test_ecall_buffer(
+            enclave, &zeroed, in.data(), in_size, out.data(), out_size) ==
+        OE_OK);
+
+    for (size_t i = 0; i < out_size; i++)
+        OE_TEST(out[i] == 0xAA);
+
+    return zeroed;
+}
+
+void TestECallBuffer(oe_enclave_t* enclave)
+{
+    uint64_t size = 0;
+    oe_result_t result;
+
+    /* Grow the cached buffer, then shrink the input so that the output
+     * region overlaps bytes written by the previous calls */
+    OE_TEST(_call_with_sizes(enclave, 4096, 4096));
+    OE_TEST(_call_with_sizes(enclave, 16, 8000));
+    OE_TEST(_call_with_sizes(enclave, 16, 8000));
+    OE_TEST(_call_with_sizes(enclave, 8, 8));
+
+    OE_TEST(enc_get_ecall_buffer_size(enclave, &size) == OE_OK);
+    OE_TEST(size >= 8192);
+
+    /* Calls above the limit use the heap */
+    OE_TEST(
+        enc_configure_ecall_buffer_cache(enclave, &result, 4096) == OE_OK);
+    OE_TEST(result == OE_OK);
+    OE_TEST(_call_with_sizes(enclave, 16, 65536));
+    OE_TEST(_call_with_sizes(enclave, 16, 1024));
+
+    OE_TEST(enc_configure_ecall_buffer_cache(enclave, &result, 0) == OE_OK);
+    OE_TEST(result == OE_OK);
+    OE_TEST(_call_with_sizes(enclave, 16, 1024));
+
+    OE_TEST(
+        enc_configure_ecall_buffer_cache(
+            enclave, &result, ((size_t)1 << 30) + 1) == OE_OK);
+    OE_TEST(result == OE_INVALID_PARAMETER);
+
+    OE_TEST(
+        enc_configure_ecall_buffer_cache(enclave, &result, 64 * 1024) ==
+        OE_OK);
+    OE_TEST(result == OE_OK);
+}
+
+/* The marshaling struct of enc_batch_add is defined in ecall_args.h, must be
+ * kept in sync */
+typedef struct _batch_add_args
+{
+    oe_result_t _result;
+    void* deepcopy_out_buffer;
+    size_t deepcopy_out_buffer_size;
+    uint64_t _retval;
+    uint64_t a;
+    uint64_t b;
+} batch_add_args_t;
+
+static uint64_t _get_num_ecalls(oe_enclave_t* enclave)
+{
+    oe_enclave_call_statistics_t statistics;
+    OE_TEST(oe_get_enclave_call_statistics(enclave, &statistics) == OE_OK);
+    uint64_t num_ecalls = statistics.num_ecalls;
+    oe_free_enclave_call_statistics(&statistics);
+    return num_ecalls;
+}
+
+void TestECallBatch(oe_enclave_t* enclave)
+{
+    const size_t num_calls = 64;
+    const size_t bad_call = 17;
+    static uint64_t global_id = OE_GLOBAL_ECALL_ID_NULL;
+    std::vector<batch_add_args_t> in(num_calls);
+    std::vector<batch_add_args_t> out(num_calls);
+    std::vector<oe_enclave_function_call_t> calls(num_calls);
+
+    for (size_t i = 0; i < num_calls; i++)
+    {
+        memset(&in[i], 0, sizeof(batch_add_args_t));
+        in[i].a = i;
+        in[i].b = 1000;
+
+        calls[i].global_id = &global_id;
+        calls[i].name = "enc_batch_add";
+        calls[i].input_buffer = &in[i];
+        calls[i].input_buffer_size = sizeof(batch_add_args_t);
+        calls[i].output_buffer = &out[i];
+        calls[i].output_buffer_size = sizeof(batch_add_args_t);
+    }
+
+    /* A malformed call fails on its own without affecting the others */
+    calls[bad_call].input_buffer_size = 16;
+
+    uint64_t num_ecalls = _get_num_ecalls(enclave);
+    OE_TEST(
+        oe_call_enclave_function_batch(enclave, calls.data(), num_calls) ==
+        OE_OK);
+
+    /* The whole batch took a single enclave transition */
+    OE_TEST(_get_num_ecalls(enclave) == num_ecalls + 1);
+
+    for (size_t i = 0; i < num_calls; i++)
+    {
+        if (i == bad_call)
+        {
+            OE_TEST(calls[i].result == OE_INVALID_PARAMETER);
+            OE_TEST(calls[i].output_bytes_written == 0);
+            continue;
+        }
+
+        OE_TEST(calls[i].result == OE_OK);
+        OE_TEST(calls[i].output_bytes_written == sizeof(batch_add_args_t));
+        OE_TEST(out[i]._result == OE_OK);
+        OE_TEST(out[i]._retval == i + 1000);
+    }
+
+    OE_TEST(
+        oe_call_enclave_function_batch(enclave, calls.data(), 0) ==
+        OE_INVALID_PARAMETER);
+
+    calls[0].global_id = NULL;
+    calls[0].name = "enc_no_such_function";
+    OE_TEST(
+        oe_call_enclave_function_batch(enclave, calls.data(), num_calls) !=
+        OE_OK);
+}
+
 int main(int argc, const char* argv[])
 {
     oe_result_t result;
@@ -87,6 +226,12 @@ int main(int argc, const char* argv[])
         TestECall(enclave);
     }
 
+    printf("=== TestECallBuffer()\n");
+    TestECallBuffer(enclave);
+
+    printf("=== TestECallBatch()\n");
+    TestECallBatch(enclave);
+
     if ((result = oe_terminate_enclave(enclave)) != OE_OK)
     {
         oe_put_err("oe_terminate_enclave(): result=%u", result);
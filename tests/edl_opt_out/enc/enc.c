@@ -47,6 +47,9 @@ void enc_edl_opt_out()
     OE_TEST(
         oe_sgx_backtrace_symbols_ocall(NULL, NULL, NULL, 0, NULL, 0, NULL) ==
         OE_UNSUPPORTED);
+    OE_TEST(
+        oe_sgx_write_heap_profile_ocall(NULL, NULL, NULL, NULL, 0) ==
+        OE_UNSUPPORTED);
 
     /* sgx/switchless.edl */
     OE_TEST(oe_sgx_sleep_switchless_worker_ocall(NULL) == OE_UNSUPPORTED);
@@ -0,0 +1,272 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/advanced/mallinfo.h>
+#include <openenclave/enclave.h>
+#include <openenclave/internal/globals.h>
+#include <openenclave/internal/tests.h>
+
+#include <malloc.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "malloc_benchmark_t.h"
+
+#ifdef OE_USE_DEBUG_MALLOC
+#define ALLOCATOR_NAME MALLOC_BENCHMARK_ALLOCATOR "+debugmalloc"
+#else
+#define ALLOCATOR_NAME MALLOC_BENCHMARK_ALLOCATOR
+#endif
+
+/* Blocks allocated by each thread before it frees them */
+#define BATCH_SIZE 64
+
+#define MAX_RINGS 8
+#define RING_SIZE 1024
+
+typedef struct _ring
+{
+    void* slots[RING_SIZE];
+    /* Written by the producer and by the consumer respectively */
+    OE_ALIGNED(64) uint64_t head;
+    OE_ALIGNED(64) uint64_t tail;
+} ring_t;
+
+static ring_t _rings[MAX_RINGS];
+
+void enc_get_allocator_name(char* name, size_t size)
+{
+    OE_TEST(size > strlen(ALLOCATOR_NAME));
+    strcpy(name, ALLOCATOR_NAME);
+}
+
+static void _touch(void* ptr, size_t size)
+{
+    /* Keep the compiler from eliding the allocation */
+    if (size)
+        *(volatile uint8_t*)ptr = (uint8_t)size;
+}
+
+void enc_throughput(size_t size, uint64_t count)
+{
+    void* ptrs[BATCH_SIZE];
+
+    for (uint64_t n = 0; n < count; n += BATCH_SIZE)
+    {
+        for (size_t i = 0; i < BATCH_SIZE; i++)
+        {
+            ptrs[i] = malloc(size);
+            OE_TEST(ptrs[i] != NULL);
+            _touch(ptrs[i], size);
+        }
+
+        for (size_t i = 0; i < BATCH_SIZE; i++)
+            free(ptrs[i]);
+    }
+}
+
+void enc_reset_rings(void)
+{
+    memset(_rings, 0, sizeof(_rings));
+}
+
+void enc_produce(size_t ring, size_t size, uint64_t count)
+{
+    ring_t* r = NULL;
+
+    OE_TEST(ring < MAX_RINGS);
+    r = &_rings[ring];
+
+    for (uint64_t head = 0; head < count; head++)
+    {
+        void* ptr = malloc(size);
+        OE_TEST(ptr != NULL);
+        _touch(ptr, size);
+
+        while (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >=
+               RING_SIZE)
+            asm volatile("pause");
+
+        r->slots[head % RING_SIZE] = ptr;
+        __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    }
+}
+
+void enc_consume(size_t ring, uint64_t count)
+{
+    ring_t* r = NULL;
+
+    OE_TEST(ring < MAX_RINGS);
+    r = &_rings[ring];
+
+    for (uint64_t tail = 0; tail < count; tail++)
+    {
+        while (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == tail)
+            asm volatile("pause");
+
+        free(r->slots[tail % RING_SIZE]);
+        __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    }
+}
+
+static uint32_t _next_random(uint32_t* state)
+{
+    /* xorshift32, so that every allocator sees the same sequence */
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/* Sizes are spread evenly over the powers of two from 16 to max_size, as
+ * small blocks are much more frequent than large ones in practice */
+static size_t _random_size(uint32_t* state, size_t max_size)
+{
+    uint32_t shift = 4;
+    uint32_t max_shift = 4;
+    size_t size = 0;
+
+    while (((size_t)1 << (max_shift + 1)) <= max_size)
+        max_shift++;
+
+    shift += _next_random(state) % (max_shift - 4 + 1);
+    size = (size_t)1 << shift;
+
+    return size + _next_random(state) % size;
+}
+
+static bool _get_allocated(size_t* allocated, size_t* peak)
+{
+    oe_mallinfo_t info;
+
+    if (oe_allocator_mallinfo(&info) != OE_OK)
+        return false;
+
+    *allocated = info.current_allocated_heap_size;
+    if (peak)
+        *peak = info.peak_allocated_heap_size;
+
+    return true;
+}
+
+void enc_churn(
+    uint32_t seed,
+    size_t num_slots,
+    size_t max_size,
+    uint64_t count,
+    churn_result_t* result)
+{
+    const uint8_t* heap_base = (const uint8_t*)__oe_get_heap_base();
+    void** ptrs = NULL;
+    size_t* sizes = NULL;
+    uint32_t state = seed ? seed : 1;
+    uint64_t live_bytes = 0;
+    size_t allocated_before = 0;
+    size_t allocated_after = 0;
+    size_t peak = 0;
+
+    memset(result, 0, sizeof(*result));
+    result->mallinfo_supported = _get_allocated(&allocated_before, NULL);
+
+    ptrs = (void**)calloc(num_slots, sizeof(void*));
+    sizes = (size_t*)calloc(num_slots, sizeof(size_t));
+    OE_TEST(ptrs != NULL && sizes != NULL);
+
+    for (uint64_t n = 0; n < count; n++)
+    {
+        size_t slot = _next_random(&state) % num_slots;
+        size_t size = _random_size(&state, max_size);
+        const uint8_t* end = NULL;
+
+        if (ptrs[slot])
+        {
+            free(ptrs[slot]);
+            live_bytes -= sizes[slot];
+        }
+
+        ptrs[slot] = malloc(size);
+        OE_TEST(ptrs[slot] != NULL);
+        _touch(ptrs[slot], size);
+        sizes[slot] = size;
+        live_bytes += size;
+
+        if (live_bytes > result->peak_live_bytes)
+            result->peak_live_bytes = live_bytes;
+
+        /* The part of the heap that the allocator has touched so far, i.e.
+         * the pages that must be resident */
+        end = (const uint8_t*)ptrs[slot] + size;
+        if ((uint64_t)(end - heap_base) > result->peak_footprint)
+            result->peak_footprint = (uint64_t)(end - heap_base);
+    }
+
+    if (result->mallinfo_supported)
+    {
+        OE_TEST(_get_allocated(&allocated_after, &peak));
+        result->peak_allocated = peak;
+    }
+
+    for (size_t i = 0; i < num_slots; i++)
+        free(ptrs[i]);
+
+    free(ptrs);
+    free(sizes);
+
+    if (result->mallinfo_supported)
+    {
+        OE_TEST(_get_allocated(&allocated_after, NULL));
+        result->residual =
+            (int64_t)allocated_after - (int64_t)allocated_before;
+    }
+}
+
+void enc_mallinfo_accuracy(
+    size_t size,
+    size_t count,
+    mallinfo_result_t* result)
+{
+    void** ptrs = NULL;
+    size_t before = 0;
+    size_t during = 0;
+    size_t after = 0;
+    size_t peak = 0;
+
+    memset(result, 0, sizeof(*result));
+
+    ptrs = (void**)calloc(count, sizeof(void*));
+    OE_TEST(ptrs != NULL);
+
+    if (!(result->supported = _get_allocated(&before, NULL)))
+        goto done;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ptrs[i] = malloc(size);
+        OE_TEST(ptrs[i] != NULL);
+        result->requested += size;
+        result->usable += malloc_usable_size(ptrs[i]);
+    }
+
+    OE_TEST(_get_allocated(&during, &peak));
+    result->allocated_delta = (int64_t)during - (int64_t)before;
+    result->peak_consistent = peak >= during;
+
+    for (size_t i = 0; i < count; i++)
+        free(ptrs[i]);
+
+    OE_TEST(_get_allocated(&after, NULL));
+    result->residual = (int64_t)after - (int64_t)before;
+
+done:
+    free(ptrs);
+}
+
+OE_SET_ENCLAVE_SGX(
+    1,     /* ProductID */
+    1,     /* SecurityVersion */
+    true,  /* Debug */
+    16384, /* NumHeapPages */
+    64,    /* NumStackPages */
+    16);   /* NumTCS */
@@ -0,0 +1,291 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/host.h>
+#include <openenclave/internal/error.h>
+#include <openenclave/internal/tests.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "malloc_benchmark_u.h"
+
+// Must not exceed the number of rings of the enclave, and half of its TCSs.
+#define MAX_THREADS 8
+
+// Divides the number of operations with --quick.
+#define QUICK_DIVISOR 16
+
+static const size_t _sizes[] = {16, 64, 256, 1024, 4096, 16384};
+
+static oe_enclave_t* _enclave;
+static char _allocator[64];
+static FILE* _out;
+
+// Run the given calls on threads of their own, and return the time it took
+// from the moment all the threads were started.
+static double _run_threads(std::vector<std::function<void()>>& calls)
+{
+    std::atomic<size_t> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point start;
+
+    for (auto& call : calls)
+    {
+        threads.push_back(std::thread([&ready, &go, &call]() {
+            ready++;
+            while (!go)
+                std::this_thread::yield();
+            call();
+        }));
+    }
+
+    while (ready < calls.size())
+        std::this_thread::yield();
+
+    start = std::chrono::steady_clock::now();
+    go = true;
+
+    for (auto& thread : threads)
+        thread.join();
+
+    return std::chrono::duration<double>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+static void _print_header(const char* benchmark)
+{
+    fprintf(
+        _out,
+        "{\"benchmark\": \"%s\", \"allocator\": \"%s\", \"sdk\": \"%s\"",
+        benchmark,
+        _allocator,
+        OE_SDK_VERSION);
+}
+
+static void _print_rate(uint64_t operations, double seconds)
+{
+    fprintf(
+        _out,
+        ", \"operations\": %llu, \"seconds\": %.6f"
+        ", \"mops_per_second\": %.3f}\n",
+        (unsigned long long)operations,
+        seconds,
+        seconds > 0 ? (double)operations / seconds / 1e6 : 0.0);
+}
+
+// malloc/free pairs per second, by block size and number of threads.
+static void _benchmark_throughput(size_t max_threads, uint64_t count)
+{
+    for (size_t num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+    {
+        for (size_t size : _sizes)
+        {
+            std::vector<std::function<void()>> calls;
+
+            for (size_t i = 0; i < num_threads; i++)
+                calls.push_back([size, count]() {
+                    OE_TEST(enc_throughput(_enclave, size, count) == OE_OK);
+                });
+
+            double seconds = _run_threads(calls);
+
+            _print_header("throughput");
+            fprintf(
+                _out, ", \"threads\": %zu, \"size\": %zu", num_threads, size);
+            _print_rate(num_threads * count, seconds);
+        }
+    }
+}
+
+// Blocks allocated by producer threads and freed by consumer threads.
+static void _benchmark_cross_thread(size_t max_threads, uint64_t count)
+{
+    // A single thread still gets a producer and a consumer.
+    size_t max_pairs = max_threads > 1 ? max_threads / 2 : 1;
+
+    for (size_t num_pairs = 1; num_pairs <= max_pairs; num_pairs *= 2)
+    {
+        for (size_t size : {64, 1024})
+        {
+            std::vector<std::function<void()>> calls;
+
+            OE_TEST(enc_reset_rings(_enclave) == OE_OK);
+
+            for (size_t i = 0; i < num_pairs; i++)
+            {
+                calls.push_back([i, size, count]() {
+                    OE_TEST(enc_produce(_enclave, i, size, count) == OE_OK);
+                });
+                calls.push_back([i, count]() {
+                    OE_TEST(enc_consume(_enclave, i, count) == OE_OK);
+                });
+            }
+
+            double seconds = _run_threads(calls);
+
+            _print_header("cross_thread");
+            fprintf(_out, ", \"pairs\": %zu, \"size\": %zu", num_pairs, size);
+            _print_rate(num_pairs * count, seconds);
+        }
+    }
+}
+
+// Heap footprint of a live set of random blocks under churn.
+static void _benchmark_churn(uint64_t count)
+{
+    const size_t num_slots = 4096;
+    const size_t max_size = 32 * 1024;
+    churn_result_t result;
+
+    OE_TEST(
+        enc_churn(_enclave, 1, num_slots, max_size, count, &result) == OE_OK);
+    OE_TEST(result.peak_footprint >= result.peak_live_bytes);
+
+    _print_header("churn");
+    fprintf(
+        _out,
+        ", \"slots\": %zu, \"max_size\": %zu, \"operations\": %llu"
+        ", \"peak_live_bytes\": %llu, \"peak_footprint_bytes\": %llu"
+        ", \"fragmentation\": %.4f",
+        num_slots,
+        max_size,
+        (unsigned long long)count,
+        (unsigned long long)result.peak_live_bytes,
+        (unsigned long long)result.peak_footprint,
+        1.0 - (double)result.peak_live_bytes / (double)result.peak_footprint);
+
+    if (result.mallinfo_supported)
+        fprintf(
+            _out,
+            ", \"peak_allocated_bytes\": %llu, \"residual_bytes\": %lld}\n",
+            (unsigned long long)result.peak_allocated,
+            (long long)result.residual);
+    else
+        fprintf(_out, ", \"peak_allocated_bytes\": null}\n");
+}
+
+// How closely oe_allocator_mallinfo() follows the blocks allocated.
+static void _benchmark_mallinfo(void)
+{
+    const size_t count = 256;
+
+    for (size_t size : {16, 256, 4096, 65536})
+    {
+        mallinfo_result_t result;
+
+        OE_TEST(
+            enc_mallinfo_accuracy(_enclave, size, count, &result) == OE_OK);
+
+        _print_header("mallinfo");
+        fprintf(_out, ", \"size\": %zu, \"count\": %zu", size, count);
+
+        if (!result.supported)
+        {
+            fprintf(_out, ", \"supported\": false}\n");
+            continue;
+        }
+
+        OE_TEST(result.peak_consistent);
+
+        fprintf(
+            _out,
+            ", \"supported\": true, \"requested_bytes\": %llu"
+            ", \"usable_bytes\": %llu, \"allocated_delta_bytes\": %lld"
+            ", \"overhead\": %.4f, \"residual_bytes\": %lld}\n",
+            (unsigned long long)result.requested,
+            (unsigned long long)result.usable,
+            (long long)result.allocated_delta,
+            (double)result.allocated_delta / (double)result.requested - 1.0,
+            (long long)result.residual);
+    }
+}
+
+static void _usage(const char* program)
+{
+    fprintf(
+        stderr,
+        "Usage: %s ENCLAVE [--threads N] [--scale N] [--quick] "
+        "[--output FILE]\n"
+        "  --threads N    largest number of threads (1..%d, default 4)\n"
+        "  --scale N      multiply the number of operations by N (default 1)\n"
+        "  --quick        divide the number of operations by %d\n"
+        "  --output FILE  write the results to FILE instead of stdout\n",
+        program,
+        MAX_THREADS,
+        QUICK_DIVISOR);
+    exit(1);
+}
+
+int main(int argc, const char* argv[])
+{
+    oe_result_t result;
+    size_t max_threads = 4;
+    uint64_t scale = 1;
+    uint64_t divisor = 1;
+    const char* output = NULL;
+
+    if (argc < 2)
+        _usage(argv[0]);
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            max_threads = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+            scale = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--quick") == 0)
+            divisor = QUICK_DIVISOR;
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else
+            _usage(argv[0]);
+    }
+
+    if (max_threads < 1 || max_threads > MAX_THREADS || scale < 1)
+        _usage(argv[0]);
+
+    // Set OE_SIMULATION=1 to run in simulation mode.
+    const uint32_t flags = oe_get_create_flags();
+
+    if ((result = oe_create_malloc_benchmark_enclave(
+             argv[1], OE_ENCLAVE_TYPE_SGX, flags, NULL, 0, &_enclave)) !=
+        OE_OK)
+        oe_put_err("oe_create_enclave(): result=%u", result);
+
+    if (output)
+    {
+        if (!(_out = fopen(output, "w")))
+            oe_put_err("cannot open %s", output);
+    }
+    else
+    {
+        _out = stdout;
+    }
+
+    OE_TEST(
+        enc_get_allocator_name(_enclave, _allocator, sizeof(_allocator)) ==
+        OE_OK);
+
+    // One JSON object per line.
+    _benchmark_throughput(max_threads, 64 * 1024 * scale / divisor);
+    _benchmark_cross_thread(max_threads, 64 * 1024 * scale / divisor);
+    _benchmark_churn(256 * 1024 * scale / divisor);
+    _benchmark_mallinfo();
+
+    if (_out != stdout)
+        fclose(_out);
+
+    result = oe_terminate_enclave(_enclave);
+    OE_TEST(result == OE_OK);
+
+    printf("=== passed all tests (malloc_benchmark)\n");
+
+    return 0;
+}
@@ -1,6 +1,7 @@
 // Copyright (c) Open Enclave SDK contributors.
 // Licensed under the MIT License.
 
+#include <openenclave/advanced/mallinfo.h>
 #include <openenclave/enclave.h>
 #include <openenclave/internal/globals.h>
 #include <openenclave/internal/tests.h>
@@ -9,6 +10,7 @@
 #include <malloc.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "memory_t.h"
 
@@ -229,3 +231,49 @@ void test_malloc_usable_size(void)
     free(p1);
     free(p2);
 }
+
+static size_t _get_allocated_heap_size(void)
+{
+    oe_mallinfo_t info;
+    OE_TEST(oe_allocator_mallinfo(&info) == OE_OK);
+    return info.current_allocated_heap_size;
+}
+
+void test_malloc_thread_cache(void)
+{
+    static void* ptrs[1024];
+    const size_t n = OE_COUNTOF(ptrs);
+    size_t heap_size = _get_allocated_heap_size();
+
+    /* Small blocks of many sizes, freed in a different order. */
+    for (size_t i = 0; i < n; i++)
+    {
+        ptrs[i] = malloc(i % 600);
+        OE_TEST(ptrs[i] != NULL);
+        memset(ptrs[i], 0xab, i % 600);
+    }
+
+    for (size_t i = 0; i < n; i += 2)
+        free(ptrs[i]);
+
+    for (size_t i = 1; i < n; i += 2)
+        free(ptrs[i]);
+
+    /* Blocks held for reuse do not count as allocated. */
+    OE_TEST(_get_allocated_heap_size() == heap_size);
+
+    /* Reused blocks are zeroed by calloc. */
+    for (size_t i = 0; i < n; i++)
+    {
+        unsigned char* ptr = (unsigned char*)calloc(1, i % 600);
+        OE_TEST(ptr != NULL);
+        for (size_t j = 0; j < i % 600; j++)
+            OE_TEST(ptr[j] == 0);
+        ptrs[i] = ptr;
+    }
+
+    for (size_t i = 0; i < n; i++)
+        free(ptrs[i]);
+
+    OE_TEST(_get_allocated_heap_size() == heap_size);
+}
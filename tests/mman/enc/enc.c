@@ -5,6 +5,7 @@
 #include <openenclave/internal/tests.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/mman.h>
 #include "../../../libc/mman.h"
 #include "mman_t.h"
@@ -31,7 +32,8 @@ static void _test_basic()
 
     OE_TEST(munmap(ptr, chunk_size) == 0);
     OE_TEST(errno == 0);
-    OE_TEST(oe_test_get_mappings() == NULL);
+    OE_TEST(oe_test_get_num_mappings() == 0);
+    OE_TEST(oe_test_get_num_blocks() == 0);
 }
 
 static void _test_partial_unmapping(void)
@@ -46,9 +48,9 @@ static void _test_partial_unmapping(void)
         0);
     uint64_t p1_end = p1_start + p1_length;
 
-    oe_mapping_t* m = oe_test_get_mappings();
-    OE_TEST(m->start == p1_start);
-    OE_TEST(m->end == p1_end);
+    OE_TEST(oe_test_is_mapped((void*)p1_start));
+    OE_TEST(oe_test_is_mapped((void*)(p1_end - 1)));
+    OE_TEST(!oe_test_is_mapped((void*)p1_end));
 
     uint64_t p2_length = 3 * OE_PAGE_SIZE;
     uint64_t p2_start = (uint64_t)mmap(
@@ -59,12 +61,10 @@ static void _test_partial_unmapping(void)
         -1,
         0);
     uint64_t p2_end = p2_start + p2_length;
-    m = oe_test_get_mappings();
-    OE_TEST(m->start == p2_start);
-    OE_TEST(m->end == p2_end);
+    OE_TEST(oe_test_get_num_mappings() == 2);
+    OE_TEST(oe_test_get_num_blocks() == 2);
 
     // Swap p1 and p2 if p2 lies before p1.
-    bool swapped = false;
     if (p2_start < p1_start)
     {
         uint64_t t = p1_start;
@@ -74,7 +74,6 @@ static void _test_partial_unmapping(void)
         t = p1_end;
         p1_end = p2_end;
         p2_end = t;
-        swapped = true;
     }
 
     // Do an unmap that starts within p1 and ends within p2.
@@ -83,53 +82,40 @@ static void _test_partial_unmapping(void)
     OE_TEST(munmap((void*)start, end - start) == 0);
     OE_TEST(errno == 0);
 
-    // Partial unmapping only changes the status vectors and not the bounds.
-    m = oe_test_get_mappings();
-    if (swapped)
-    {
-        OE_TEST(m->start == p1_start);
-        OE_TEST(m->end == p1_end);
-        m = m->next;
-        OE_TEST(m->start == p2_start);
-        OE_TEST(m->end == p2_end);
-    }
-    else
-    {
-        OE_TEST(m->start == p2_start);
-        OE_TEST(m->end == p2_end);
-        m = m->next;
-        OE_TEST(m->start == p1_start);
-        OE_TEST(m->end == p1_end);
-    }
+    // Both mappings shrink, and their blocks stay allocated.
+    OE_TEST(oe_test_get_num_mappings() == 2);
+    OE_TEST(oe_test_get_num_blocks() == 2);
+    OE_TEST(oe_test_is_mapped((void*)(start - 1)));
+    OE_TEST(!oe_test_is_mapped((void*)start));
+    OE_TEST(!oe_test_is_mapped((void*)p2_start));
+    OE_TEST(!oe_test_is_mapped((void*)(end - 1)));
+    OE_TEST(oe_test_is_mapped((void*)end));
+
+    // A new mapping reuses the lowest hole that fits, zeroed.
+    memset((void*)p1_start, 0xab, start - p1_start);
+    uint8_t* ptr = (uint8_t*)mmap(
+        NULL, OE_PAGE_SIZE, PROT_READ, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    OE_TEST((uint64_t)ptr == start);
+    for (uint64_t i = 0; i < OE_PAGE_SIZE; ++i)
+        OE_TEST(ptr[i] == 0);
+    OE_TEST(oe_test_get_num_mappings() == 2);
+    OE_TEST(oe_test_get_num_blocks() == 2);
 
-    // Do another partial unmap.
-    start -= OE_PAGE_SIZE;
-    OE_TEST(munmap((void*)start, end - start) == 0);
+    // Unmapping the middle of a mapping splits it.
+    start = p1_start + OE_PAGE_SIZE;
+    OE_TEST(munmap((void*)start, OE_PAGE_SIZE) == 0);
     OE_TEST(errno == 0);
-    m = oe_test_get_mappings();
-    if (swapped)
-    {
-        OE_TEST(m->start == p1_start);
-        OE_TEST(m->end == p1_end);
-        m = m->next;
-        OE_TEST(m->start == p2_start);
-        OE_TEST(m->end == p2_end);
-    }
-    else
-    {
-        OE_TEST(m->start == p2_start);
-        OE_TEST(m->end == p2_end);
-        m = m->next;
-        OE_TEST(m->start == p1_start);
-        OE_TEST(m->end == p1_end);
-    }
+    OE_TEST(oe_test_get_num_mappings() == 3);
+    OE_TEST(oe_test_is_mapped((void*)p1_start));
+    OE_TEST(!oe_test_is_mapped((void*)start));
+    OE_TEST(oe_test_is_mapped((void*)(start + OE_PAGE_SIZE)));
 
     // Do an unmap till the start.
-    // This ought to delete one mapping completely.
-    OE_TEST(munmap((void*)OE_PAGE_SIZE, start - OE_PAGE_SIZE) == 0);
+    // This ought to delete the first block completely.
+    OE_TEST(munmap((void*)OE_PAGE_SIZE, p1_end - OE_PAGE_SIZE) == 0);
     OE_TEST(errno == 0);
-    m = oe_test_get_mappings();
-    OE_TEST(m->next == NULL);
+    OE_TEST(oe_test_get_num_mappings() == 1);
+    OE_TEST(oe_test_get_num_blocks() == 1);
 
     // Do another unmapping that spans entire enclave memory.
     // This ought to get rid of all mappings.
@@ -142,19 +128,102 @@ static void _test_partial_unmapping(void)
     }
     OE_TEST(munmap(0, (1L << 62)) == 0);
     OE_TEST(errno == 0);
-    OE_TEST(oe_test_get_mappings() == NULL);
+    OE_TEST(oe_test_get_num_mappings() == 0);
+    OE_TEST(oe_test_get_num_blocks() == 0);
 
     // Test unmapping a mapping in small chunks.
     start = (uint64_t)mmap(
         NULL, 3 * OE_PAGE_SIZE, PROT_READ, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    OE_TEST(oe_test_get_mappings() != NULL);
+    OE_TEST(oe_test_get_num_blocks() == 1);
 
     OE_TEST(munmap((void*)(start + OE_PAGE_SIZE), 1) == 0);
-    OE_TEST(oe_test_get_mappings() != NULL);
+    OE_TEST(oe_test_get_num_mappings() == 2);
     OE_TEST(munmap((void*)(start + 2 * OE_PAGE_SIZE), 1) == 0);
-    OE_TEST(oe_test_get_mappings() != NULL);
+    OE_TEST(oe_test_get_num_mappings() == 1);
+    OE_TEST(oe_test_get_num_blocks() == 1);
     OE_TEST(munmap((void*)start, 1) == 0);
-    OE_TEST(oe_test_get_mappings() == NULL);
+    OE_TEST(oe_test_get_num_mappings() == 0);
+    OE_TEST(oe_test_get_num_blocks() == 0);
+}
+
+static void _test_many_mappings(void)
+{
+    // Each mapping takes a block of its own from the 4 MB heap.
+    const size_t count = 128;
+    static uint8_t* ptrs[128];
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        ptrs[i] = (uint8_t*)mmap(
+            NULL,
+            OE_PAGE_SIZE,
+            PROT_READ | PROT_WRITE,
+            MAP_ANONYMOUS | MAP_PRIVATE,
+            -1,
+            0);
+        OE_TEST(ptrs[i] != MAP_FAILED);
+        ptrs[i][0] = 1;
+    }
+    OE_TEST(oe_test_get_num_mappings() == count);
+
+    // Unmap every other mapping, in reverse order.
+    for (size_t i = count; i > 0; i -= 2)
+        OE_TEST(munmap(ptrs[i - 1], OE_PAGE_SIZE) == 0);
+    OE_TEST(oe_test_get_num_mappings() == count / 2);
+    OE_TEST(oe_test_get_num_blocks() == count / 2);
+
+    for (size_t i = 0; i < count; i += 2)
+    {
+        OE_TEST(oe_test_is_mapped(ptrs[i]));
+        OE_TEST(!oe_test_is_mapped(ptrs[i + 1]));
+        OE_TEST(munmap(ptrs[i], OE_PAGE_SIZE) == 0);
+    }
+    OE_TEST(oe_test_get_num_mappings() == 0);
+    OE_TEST(oe_test_get_num_blocks() == 0);
+}
+
+static void _test_madvise(void)
+{
+    uint8_t* ptr = (uint8_t*)mmap(
+        NULL,
+        4 * OE_PAGE_SIZE,
+        PROT_READ | PROT_WRITE,
+        MAP_ANONYMOUS | MAP_PRIVATE,
+        -1,
+        0);
+    OE_TEST(ptr != MAP_FAILED);
+    memset(ptr, 0xab, 4 * OE_PAGE_SIZE);
+
+    // MADV_DONTNEED zeroes the pages, which stay mapped.
+    OE_TEST(madvise(ptr + OE_PAGE_SIZE, 2 * OE_PAGE_SIZE, MADV_DONTNEED) == 0);
+    OE_TEST(errno == 0);
+    for (uint64_t i = 0; i < 4 * OE_PAGE_SIZE; ++i)
+    {
+        bool zeroed = i >= OE_PAGE_SIZE && i < 3 * OE_PAGE_SIZE;
+        OE_TEST(ptr[i] == (zeroed ? 0 : 0xab));
+    }
+    OE_TEST(oe_test_is_mapped(ptr + OE_PAGE_SIZE));
+
+    // Other advice leaves the pages as they are.
+    OE_TEST(madvise(ptr, 4 * OE_PAGE_SIZE, MADV_WILLNEED) == 0);
+    OE_TEST(ptr[0] == 0xab);
+
+    // The address must be page-aligned.
+    OE_TEST(madvise(ptr + 1, OE_PAGE_SIZE, MADV_DONTNEED) != 0);
+    OE_TEST(errno == EINVAL);
+
+    // Unsupported advice.
+    OE_TEST(madvise(ptr, OE_PAGE_SIZE, MADV_HUGEPAGE) != 0);
+    OE_TEST(errno == EINVAL);
+
+    // The whole range must be mapped.
+    OE_TEST(munmap(ptr + 2 * OE_PAGE_SIZE, OE_PAGE_SIZE) == 0);
+    OE_TEST(madvise(ptr, 4 * OE_PAGE_SIZE, MADV_DONTNEED) != 0);
+    OE_TEST(errno == ENOMEM);
+    OE_TEST(ptr[0] == 0xab);
+
+    OE_TEST(munmap(ptr, 4 * OE_PAGE_SIZE) == 0);
+    OE_TEST(oe_test_get_num_blocks() == 0);
 }
 
 static void _test_mmap_params(void)
@@ -368,6 +437,8 @@ int enc_main()
 {
     _test_basic();
     _test_partial_unmapping();
+    _test_many_mappings();
+    _test_madvise();
     _test_mmap_params();
     _test_unmap_params();
     return 0;
@@ -0,0 +1,94 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/enclave.h>
+#include <openenclave/internal/tests.h>
+#include <openenclave/internal/thread.h>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "mutex_benchmark_t.h"
+
+/* Must be no more than the number of TCSs */
+#define MAX_THREADS 64
+
+static pthread_mutex_t _mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Protected by _mutex */
+static uint64_t _count;
+
+/* The token is held by the thread of the same index */
+static pthread_mutex_t _token_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _token_conds[MAX_THREADS];
+static size_t _token;
+static size_t _num_threads;
+
+oe_result_t enc_configure_spinning(uint32_t max_spins)
+{
+    return oe_configure_spinning(max_spins);
+}
+
+static void _work(uint32_t n)
+{
+    for (volatile uint32_t i = 0; i < n; i++)
+        ;
+}
+
+void enc_lock(uint64_t count, uint32_t inside, uint32_t outside)
+{
+    for (uint64_t i = 0; i < count; i++)
+    {
+        _work(outside);
+
+        OE_TEST(pthread_mutex_lock(&_mutex) == 0);
+        _count++;
+        _work(inside);
+        OE_TEST(pthread_mutex_unlock(&_mutex) == 0);
+    }
+}
+
+void enc_pass_token(size_t index, uint64_t count)
+{
+    OE_TEST(index < _num_threads);
+
+    OE_TEST(pthread_mutex_lock(&_token_mutex) == 0);
+
+    for (uint64_t i = 0; i < count; i++)
+    {
+        while (_token != index)
+            OE_TEST(
+                pthread_cond_wait(&_token_conds[index], &_token_mutex) == 0);
+
+        _token = (index + 1) % _num_threads;
+        _count++;
+        OE_TEST(pthread_cond_signal(&_token_conds[_token]) == 0);
+    }
+
+    OE_TEST(pthread_mutex_unlock(&_token_mutex) == 0);
+}
+
+void enc_reset(size_t num_threads)
+{
+    OE_TEST(num_threads >= 1 && num_threads <= MAX_THREADS);
+
+    for (size_t i = 0; i < MAX_THREADS; i++)
+        OE_TEST(pthread_cond_init(&_token_conds[i], NULL) == 0);
+
+    _token = 0;
+    _num_threads = num_threads;
+    _count = 0;
+}
+
+uint64_t enc_get_count(void)
+{
+    return _count;
+}
+
+OE_SET_ENCLAVE_SGX(
+    1,    /* ProductID */
+    1,    /* SecurityVersion */
+    true, /* Debug */
+    256,  /* NumHeapPages */
+    16,   /* NumStackPages */
+    64);  /* NumTCS */
@@ -0,0 +1,274 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/host.h>
+#include <openenclave/internal/error.h>
+#include <openenclave/internal/tests.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "mutex_benchmark_u.h"
+
+// Must not exceed the number of TCSs of the enclave.
+#define MAX_THREADS 64
+
+// The modes compared: parking right away, the default spinning limit, and
+// parking right away with the wakes posted to the wake ring instead of made
+// with ocalls.
+static const struct
+{
+    const char* name;
+    uint32_t max_spins;
+    bool wake_ring;
+} _modes[] = {{"park", 0, false},
+              {"adaptive", 100, false},
+              {"ring", 0, true}};
+
+// Loop iterations inside and outside of the critical sections.
+static const struct
+{
+    const char* name;
+    uint32_t inside;
+    uint32_t outside;
+} _sections[] = {{"short", 10, 100}, {"long", 1000, 1000}};
+
+static oe_enclave_t* _enclave;
+static FILE* _out;
+
+// Wakes made through the wake ring in the current mode.
+static uint64_t _num_ring_wakes;
+
+// Run the given calls on threads of their own, and return the time it took
+// from the moment all the threads were started.
+static double _run_threads(std::vector<std::function<void()>>& calls)
+{
+    std::atomic<size_t> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point start;
+
+    for (auto& call : calls)
+    {
+        threads.push_back(std::thread([&ready, &go, &call]() {
+            ready++;
+            while (!go)
+                std::this_thread::yield();
+            call();
+        }));
+    }
+
+    while (ready < calls.size())
+        std::this_thread::yield();
+
+    start = std::chrono::steady_clock::now();
+    go = true;
+
+    for (auto& thread : threads)
+        thread.join();
+
+    return std::chrono::duration<double>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+static void _get_counters(uint64_t* num_ocalls, uint64_t* num_ring_wakes)
+{
+    oe_enclave_call_statistics_t statistics;
+
+    OE_TEST(oe_get_enclave_call_statistics(_enclave, &statistics) == OE_OK);
+    *num_ocalls = statistics.num_ocalls;
+    *num_ring_wakes = statistics.num_ring_wakes;
+    oe_free_enclave_call_statistics(&statistics);
+}
+
+// Run the calls and check that the enclave counted the expected number of
+// operations.
+static void _run(
+    const char* benchmark,
+    const char* mode,
+    size_t num_threads,
+    uint64_t operations,
+    std::vector<std::function<void()>>& calls)
+{
+    uint64_t num_ocalls;
+    uint64_t num_ring_wakes;
+    uint64_t ocalls_after;
+    uint64_t ring_wakes_after;
+    double seconds;
+    uint64_t count = 0;
+
+    _get_counters(&num_ocalls, &num_ring_wakes);
+    seconds = _run_threads(calls);
+    _get_counters(&ocalls_after, &ring_wakes_after);
+    num_ocalls = ocalls_after - num_ocalls;
+    num_ring_wakes = ring_wakes_after - num_ring_wakes;
+    _num_ring_wakes += num_ring_wakes;
+
+    OE_TEST(enc_get_count(_enclave, &count) == OE_OK);
+    OE_TEST(count == operations);
+
+    fprintf(
+        _out,
+        "{\"benchmark\": \"%s\", \"mode\": \"%s\", \"sdk\": \"%s\""
+        ", \"threads\": %zu, \"operations\": %llu, \"seconds\": %.6f"
+        ", \"mops_per_second\": %.3f, \"ocalls_per_operation\": %.4f"
+        ", \"ring_wakes_per_operation\": %.4f",
+        benchmark,
+        mode,
+        OE_SDK_VERSION,
+        num_threads,
+        (unsigned long long)operations,
+        seconds,
+        seconds > 0 ? (double)operations / seconds / 1e6 : 0.0,
+        (double)num_ocalls / (double)operations,
+        (double)num_ring_wakes / (double)operations);
+}
+
+// Critical sections per second on a single mutex, by number of threads.
+static void _benchmark_mutex(
+    const char* mode,
+    size_t num_threads,
+    uint64_t count)
+{
+    for (auto& section : _sections)
+    {
+        std::vector<std::function<void()>> calls;
+        uint32_t inside = section.inside;
+        uint32_t outside = section.outside;
+
+        OE_TEST(enc_reset(_enclave, num_threads) == OE_OK);
+
+        for (size_t i = 0; i < num_threads; i++)
+            calls.push_back([count, inside, outside]() {
+                OE_TEST(enc_lock(_enclave, count, inside, outside) == OE_OK);
+            });
+
+        _run("mutex", mode, num_threads, num_threads * count, calls);
+        fprintf(_out, ", \"section\": \"%s\"}\n", section.name);
+    }
+}
+
+// Handoffs per second of a token passed around the threads with condition
+// variables.
+static void _benchmark_cond(
+    const char* mode,
+    size_t num_threads,
+    uint64_t count)
+{
+    std::vector<std::function<void()>> calls;
+
+    OE_TEST(enc_reset(_enclave, num_threads) == OE_OK);
+
+    for (size_t i = 0; i < num_threads; i++)
+        calls.push_back([i, count]() {
+            OE_TEST(enc_pass_token(_enclave, i, count) == OE_OK);
+        });
+
+    _run("cond", mode, num_threads, num_threads * count, calls);
+    fprintf(_out, "}\n");
+}
+
+static void _usage(const char* program)
+{
+    fprintf(
+        stderr,
+        "Usage: %s ENCLAVE [--threads N] [--scale N] [--output FILE]\n"
+        "  --threads N    largest number of threads (2..%d, default %d)\n"
+        "  --scale N      multiply the number of operations by N (default 1)\n"
+        "  --output FILE  write the results to FILE instead of stdout\n",
+        program,
+        MAX_THREADS,
+        MAX_THREADS);
+    exit(1);
+}
+
+int main(int argc, const char* argv[])
+{
+    oe_result_t result;
+    size_t max_threads = MAX_THREADS;
+    uint64_t scale = 1;
+    const char* output = NULL;
+
+    if (argc < 2)
+        _usage(argv[0]);
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            max_threads = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+            scale = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else
+            _usage(argv[0]);
+    }
+
+    if (max_threads < 2 || max_threads > MAX_THREADS || scale < 1)
+        _usage(argv[0]);
+
+    if (output)
+    {
+        if (!(_out = fopen(output, "w")))
+            oe_put_err("cannot open %s", output);
+    }
+    else
+    {
+        _out = stdout;
+    }
+
+    // Set OE_SIMULATION=1 to run in simulation mode.
+    const uint32_t flags = oe_get_create_flags();
+    oe_enclave_setting_wake_ring_t wake_ring_setting = {0, 0};
+    oe_enclave_setting_t setting;
+
+    setting.setting_type = OE_ENCLAVE_SETTING_WAKE_RING;
+    setting.u.wake_ring_setting = &wake_ring_setting;
+
+    // One JSON object per line.
+    for (auto& mode : _modes)
+    {
+        oe_result_t ret = OE_FAILURE;
+
+        if ((result = oe_create_mutex_benchmark_enclave(
+                 argv[1],
+                 OE_ENCLAVE_TYPE_SGX,
+                 flags,
+                 mode.wake_ring ? &setting : NULL,
+                 mode.wake_ring ? 1 : 0,
+                 &_enclave)) != OE_OK)
+            oe_put_err("oe_create_enclave(): result=%u", result);
+
+        _num_ring_wakes = 0;
+
+        OE_TEST(
+            enc_configure_spinning(_enclave, &ret, mode.max_spins) == OE_OK);
+        OE_TEST(ret == OE_OK);
+
+        for (size_t num_threads = 2; num_threads <= max_threads;
+             num_threads *= 2)
+        {
+            _benchmark_mutex(mode.name, num_threads, 2000 * scale);
+            _benchmark_cond(mode.name, num_threads, 200 * scale);
+        }
+
+        // Threads were parked, so some of them must have been woken through
+        // the ring, and none otherwise.
+        OE_TEST(mode.wake_ring ? _num_ring_wakes > 0 : _num_ring_wakes == 0);
+
+        result = oe_terminate_enclave(_enclave);
+        OE_TEST(result == OE_OK);
+    }
+
+    if (_out != stdout)
+        fclose(_out);
+
+    printf("=== passed all tests (mutex_benchmark)\n");
+
+    return 0;
+}
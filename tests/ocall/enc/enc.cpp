@@ -96,6 +96,103 @@ void enc_test_reentrancy()
     OE_TEST(OE_OK == result);
 }
 
+/* host_my_ocall_fcn_id and the marshaling struct are defined in ocall_t.c,
+ * must be kept in sync. The struct is padded to OE_EDGER8R_BUFFER_ALIGNMENT
+ * as the generated code does. */
+static const size_t host_my_ocall_fcn_id = 0;
+
+typedef struct _my_ocall_batch_args
+{
+    oe_result_t _result;
+    void* deepcopy_out_buffer;
+    size_t deepcopy_out_buffer_size;
+    uint64_t _retval;
+    uint64_t val;
+    uint64_t _padding;
+} my_ocall_batch_args_t;
+
+static void _test_ocall_batch(uint32_t flags)
+{
+    const size_t num_calls = 8;
+    const size_t bad_call = 3;
+    my_ocall_batch_args_t in[num_calls];
+    my_ocall_batch_args_t out[num_calls];
+    oe_host_function_call_t calls[num_calls];
+
+    for (size_t i = 0; i < num_calls; i++)
+    {
+        memset(&in[i], 0, sizeof(in[i]));
+        memset(&out[i], 0, sizeof(out[i]));
+        in[i].val = i;
+
+        calls[i].function_id = host_my_ocall_fcn_id;
+        calls[i].input_buffer = &in[i];
+        calls[i].input_buffer_size = sizeof(in[i]);
+        calls[i].output_buffer = &out[i];
+        calls[i].output_buffer_size = sizeof(out[i]);
+    }
+
+    calls[bad_call].function_id = 0xffff;
+
+    OE_TEST(oe_call_host_function_batch(calls, num_calls, flags) == OE_OK);
+
+    for (size_t i = 0; i < num_calls; i++)
+    {
+        if (i == bad_call)
+        {
+            OE_TEST(calls[i].result == OE_NOT_FOUND);
+        }
+        else if (
+            i > bad_call && (flags & OE_HOST_FUNCTION_BATCH_STOP_ON_FAILURE))
+        {
+            /* Not made by the host */
+            OE_TEST(calls[i].result == OE_UNEXPECTED);
+            OE_TEST(calls[i].output_bytes_written == 0);
+        }
+        else
+        {
+            OE_TEST(calls[i].result == OE_OK);
+            OE_TEST(calls[i].output_bytes_written >= sizeof(uint64_t) * 4);
+            OE_TEST(out[i]._result == OE_OK);
+            OE_TEST(out[i]._retval == i * MY_OCALL_MULTIPLIER);
+        }
+    }
+}
+
+void enc_test_ocall_batch()
+{
+    _test_ocall_batch(0);
+    _test_ocall_batch(OE_HOST_FUNCTION_BATCH_STOP_ON_FAILURE);
+
+    {
+        oe_host_function_call_t call = {0};
+        OE_TEST(
+            oe_call_host_function_batch(&call, 0, 0) == OE_INVALID_PARAMETER);
+        OE_TEST(
+            oe_call_host_function_batch(&call, 1, 0) == OE_INVALID_PARAMETER);
+        OE_TEST(
+            oe_call_host_function_batch(&call, 1, 0x2) == OE_INVALID_PARAMETER);
+    }
+}
+
+/* Larger than the per-thread ocall buffer, so that the marshaling buffer is
+ * allocated from the host memory pool */
+#define LARGE_OCALL_SIZE (32 * 1024)
+
+void enc_test_large_ocalls(size_t count)
+{
+    static unsigned char data[LARGE_OCALL_SIZE];
+
+    memset(data, 1, sizeof(data));
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t sum = 0;
+        OE_TEST(host_sum_bytes(&sum, data, sizeof(data)) == OE_OK);
+        OE_TEST(sum == sizeof(data));
+    }
+}
+
 OE_SET_ENCLAVE_SGX(
     1,    /* ProductID */
     1,    /* SecurityVersion */
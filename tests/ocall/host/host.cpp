@@ -22,6 +22,60 @@ void host_func2(const unsigned char*)
     g_func2_ok = true;
 }
 
+uint64_t host_sum_bytes(const unsigned char* data, size_t size)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < size; i++)
+        sum += data[i];
+    return sum;
+}
+
+static uint64_t _get_num_ocalls(oe_enclave_t* enclave)
+{
+    oe_enclave_call_statistics_t statistics;
+    OE_TEST(oe_get_enclave_call_statistics(enclave, &statistics) == OE_OK);
+    uint64_t num_ocalls = statistics.num_ocalls;
+    oe_free_enclave_call_statistics(&statistics);
+    return num_ocalls;
+}
+
+static void _get_ocall_buffer_statistics(
+    oe_enclave_t* enclave,
+    uint64_t* num_misses,
+    uint64_t* max_size)
+{
+    oe_enclave_call_statistics_t statistics;
+    OE_TEST(oe_get_enclave_call_statistics(enclave, &statistics) == OE_OK);
+    *num_misses = statistics.num_ocall_buffer_misses;
+    *max_size = statistics.max_ocall_buffer_size;
+    oe_free_enclave_call_statistics(&statistics);
+}
+
+static void _test_presized_ocall_buffer(const char* path, uint32_t flags)
+{
+    const size_t size = 64 * 1024;
+    oe_enclave_setting_ocall_buffer_t setting = {size, size};
+    oe_enclave_setting_t settings[1];
+    oe_enclave_t* enclave = NULL;
+    uint64_t num_misses = 0;
+    uint64_t max_size = 0;
+
+    settings[0].setting_type = OE_ENCLAVE_SETTING_OCALL_BUFFER;
+    settings[0].u.ocall_buffer_setting = &setting;
+
+    OE_TEST(
+        oe_create_ocall_enclave(
+            path, OE_ENCLAVE_TYPE_SGX, flags, settings, 1, &enclave) == OE_OK);
+
+    // Large ocalls fit the buffer from the first one on.
+    OE_TEST(enc_test_large_ocalls(enclave, 10) == OE_OK);
+    _get_ocall_buffer_statistics(enclave, &num_misses, &max_size);
+    OE_TEST(num_misses == 0);
+    OE_TEST(max_size == size);
+
+    OE_TEST(oe_terminate_enclave(enclave) == OE_OK);
+}
+
 static oe_enclave_t* g_enclave = NULL;
 static bool g_reentrancy_tested = false;
 void host_test_reentrancy()
@@ -107,6 +161,45 @@ int main(int argc, const char* argv[])
         OE_TEST(MY_OCALL_SEED * MY_OCALL_MULTIPLIER == ret_val);
     }
 
+    /* Call enc_test_ocall_batch */
+    {
+        result = enc_test_ocall_batch(enclave);
+        OE_TEST(OE_OK == result);
+    }
+
+    /* Call enc_test_large_ocalls */
+    {
+        const size_t count = 100;
+        uint64_t num_ocalls = _get_num_ocalls(enclave);
+
+        result = enc_test_large_ocalls(enclave, count);
+        OE_TEST(OE_OK == result);
+
+        /* The marshaling buffers come from the host memory pool, so most
+         * calls do not need extra OCALLs to allocate and free them */
+        num_ocalls = _get_num_ocalls(enclave) - num_ocalls;
+        OE_TEST(num_ocalls >= count);
+        OE_TEST(num_ocalls < 2 * count);
+    }
+
+    /* The ocall buffer grew to fit the large ocalls, from the next ecall on */
+    {
+        const size_t count = 100;
+        uint64_t num_misses = 0;
+        uint64_t num_misses_before = 0;
+        uint64_t max_size = 0;
+
+        _get_ocall_buffer_statistics(enclave, &num_misses_before, &max_size);
+        OE_TEST(num_misses_before >= count);
+
+        result = enc_test_large_ocalls(enclave, count);
+        OE_TEST(OE_OK == result);
+
+        _get_ocall_buffer_statistics(enclave, &num_misses, &max_size);
+        OE_TEST(num_misses == num_misses_before);
+        OE_TEST(max_size > 16 * 1024);
+    }
+
     /* Call enc_test_reentrancy */
     {
         g_enclave = enclave;
@@ -118,6 +211,8 @@ int main(int argc, const char* argv[])
 
     oe_terminate_enclave(enclave);
 
+    _test_presized_ocall_buffer(argv[1], flags);
+
     printf("=== passed all tests (%s)\n", argv[0]);
 
     return 0;
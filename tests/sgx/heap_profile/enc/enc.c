@@ -0,0 +1,62 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/advanced/heapprofile.h>
+#include <openenclave/enclave.h>
+#include <openenclave/internal/tests.h>
+#include <stdlib.h>
+#include <string.h>
+#include "heap_profile_t.h"
+
+static void** _blocks;
+static size_t _num_blocks;
+
+oe_result_t enc_start(size_t sample_interval)
+{
+    return oe_heap_profile_start(sample_interval);
+}
+
+oe_result_t enc_stop(void)
+{
+    return oe_heap_profile_stop();
+}
+
+oe_result_t enc_dump(const char* path)
+{
+    return oe_heap_profile_dump(path);
+}
+
+void enc_allocate(size_t count, size_t size)
+{
+    OE_TEST(_blocks == NULL);
+
+    _blocks = (void**)calloc(count, sizeof(void*));
+    OE_TEST(_blocks != NULL);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        _blocks[i] = malloc(size);
+        OE_TEST(_blocks[i] != NULL);
+        memset(_blocks[i], 0xab, size);
+    }
+
+    _num_blocks = count;
+}
+
+void enc_free(void)
+{
+    for (size_t i = 0; i < _num_blocks; i++)
+        free(_blocks[i]);
+
+    free(_blocks);
+    _blocks = NULL;
+    _num_blocks = 0;
+}
+
+OE_SET_ENCLAVE_SGX(
+    1,    /* ProductID */
+    1,    /* SecurityVersion */
+    true, /* Debug */
+    1024, /* NumHeapPages */
+    64,   /* NumStackPages */
+    1);   /* NumTCS */
@@ -0,0 +1,133 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/advanced/heapprofile.h>
+#include <openenclave/host.h>
+#include <openenclave/internal/tests.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "heap_profile_u.h"
+
+#define PROFILE_PATH "sgx_heap_profile.prof"
+#define NUM_BLOCKS 500
+#define BLOCK_SIZE 1024
+
+typedef struct _header
+{
+    unsigned long long live_count;
+    unsigned long long live_bytes;
+    unsigned long long alloc_count;
+    unsigned long long alloc_bytes;
+    unsigned long long sample_interval;
+} header_t;
+
+static char* _read_file(const char* path)
+{
+    FILE* stream = fopen(path, "r");
+    char* data = NULL;
+    long size = 0;
+
+    OE_TEST(stream != NULL);
+    OE_TEST(fseek(stream, 0, SEEK_END) == 0);
+    OE_TEST((size = ftell(stream)) > 0);
+    OE_TEST(fseek(stream, 0, SEEK_SET) == 0);
+
+    data = (char*)malloc((size_t)size + 1);
+    OE_TEST(data != NULL);
+    OE_TEST(fread(data, 1, (size_t)size, stream) == (size_t)size);
+    data[size] = '\0';
+
+    fclose(stream);
+    return data;
+}
+
+static void _dump(oe_enclave_t* enclave, header_t* header)
+{
+    oe_result_t result = OE_UNEXPECTED;
+    char* profile = NULL;
+
+    OE_TEST(enc_dump(enclave, &result, PROFILE_PATH) == OE_OK);
+    OE_TEST(result == OE_OK);
+
+    profile = _read_file(PROFILE_PATH);
+
+    OE_TEST(
+        sscanf(
+            profile,
+            "heap profile: %llu: %llu [%llu: %llu] @ heap_v2/%llu",
+            &header->live_count,
+            &header->live_bytes,
+            &header->alloc_count,
+            &header->alloc_bytes,
+            &header->sample_interval) == 5);
+
+    /* At least one site with a backtrace, and the enclave mapping */
+    OE_TEST(strstr(profile, "] @ 0x") != NULL);
+    OE_TEST(strstr(profile, "\nMAPPED_LIBRARIES:\n") != NULL);
+
+    free(profile);
+}
+
+int main(int argc, const char* argv[])
+{
+    oe_result_t result;
+    oe_result_t retval;
+    oe_enclave_t* enclave = NULL;
+    header_t before;
+    header_t after;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s ENCLAVE_PATH\n", argv[0]);
+        return 1;
+    }
+
+    const uint32_t flags = oe_get_create_flags();
+
+    result = oe_create_heap_profile_enclave(
+        argv[1], OE_ENCLAVE_TYPE_SGX, flags, NULL, 0, &enclave);
+    OE_TEST(result == OE_OK);
+
+    /* Not running yet */
+    OE_TEST(enc_dump(enclave, &retval, PROFILE_PATH) == OE_OK);
+    OE_TEST(retval == OE_UNEXPECTED);
+    OE_TEST(enc_stop(enclave, &retval) == OE_OK);
+    OE_TEST(retval == OE_UNEXPECTED);
+
+    /* Sample every allocation */
+    OE_TEST(enc_start(enclave, &retval, 1) == OE_OK);
+    OE_TEST(retval == OE_OK);
+    OE_TEST(enc_start(enclave, &retval, 1) == OE_OK);
+    OE_TEST(retval == OE_UNEXPECTED);
+    OE_TEST(enc_start(enclave, &retval, (size_t)1 << 31) == OE_OK);
+    OE_TEST(retval == OE_INVALID_PARAMETER);
+
+    OE_TEST(enc_allocate(enclave, NUM_BLOCKS, BLOCK_SIZE) == OE_OK);
+    _dump(enclave, &before);
+
+    OE_TEST(before.sample_interval == 1);
+    OE_TEST(before.live_count >= NUM_BLOCKS);
+    OE_TEST(before.live_bytes >= NUM_BLOCKS * BLOCK_SIZE);
+    OE_TEST(before.alloc_count >= before.live_count);
+    OE_TEST(before.alloc_bytes >= before.live_bytes);
+
+    OE_TEST(enc_free(enclave) == OE_OK);
+    _dump(enclave, &after);
+
+    OE_TEST(after.live_count + NUM_BLOCKS <= before.live_count);
+    OE_TEST(after.live_bytes + NUM_BLOCKS * BLOCK_SIZE <= before.live_bytes);
+    OE_TEST(after.alloc_count >= before.alloc_count);
+
+    OE_TEST(enc_stop(enclave, &retval) == OE_OK);
+    OE_TEST(retval == OE_OK);
+
+    remove(PROFILE_PATH);
+
+    result = oe_terminate_enclave(enclave);
+    OE_TEST(result == OE_OK);
+
+    printf("=== passed all tests (heap_profile)\n");
+
+    return 0;
+}
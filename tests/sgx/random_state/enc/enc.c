@@ -0,0 +1,31 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/enclave.h>
+#include <openenclave/internal/random.h>
+#include <openenclave/internal/tests.h>
+#include <stdlib.h>
+#include <string.h>
+#include "random_state_t.h"
+
+uint64_t enc_draw(size_t size)
+{
+    uint8_t* buffer = (uint8_t*)malloc(size);
+    uint8_t zeros[16] = {0};
+
+    OE_TEST(buffer != NULL);
+    OE_TEST(oe_random(buffer, size) == OE_OK);
+    if (size >= sizeof(zeros))
+        OE_TEST(memcmp(buffer, zeros, sizeof(zeros)) != 0);
+    free(buffer);
+
+    return oe_random_get_num_reseeds();
+}
+
+OE_SET_ENCLAVE_SGX(
+    1,    /* ProductID */
+    1,    /* SecurityVersion */
+    true, /* Debug */
+    2048, /* NumHeapPages */
+    64,   /* NumStackPages */
+    1);   /* NumTCS */
@@ -0,0 +1,58 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/host.h>
+#include <openenclave/internal/tests.h>
+#include <cstdio>
+#include "random_state_u.h"
+
+#define NUM_ECALLS 100
+
+/* Larger than the reseed interval of the random number generator (1 MB) */
+#define LARGE_DRAW (3 * 1024 * 1024)
+
+static uint64_t _draw(oe_enclave_t* enclave, size_t size)
+{
+    uint64_t num_reseeds = 0;
+
+    OE_TEST(enc_draw(enclave, &num_reseeds, size) == OE_OK);
+
+    return num_reseeds;
+}
+
+int main(int argc, const char* argv[])
+{
+    oe_result_t result;
+    oe_enclave_t* enclave = NULL;
+    uint64_t num_reseeds;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s ENCLAVE_PATH\n", argv[0]);
+        return 1;
+    }
+
+    const uint32_t flags = oe_get_create_flags();
+
+    result = oe_create_random_state_enclave(
+        argv[1], OE_ENCLAVE_TYPE_SGX, flags, NULL, 0, &enclave);
+    OE_TEST(result == OE_OK);
+
+    // The enclave has a single TCS, so every ecall runs on the same one.
+    // Its generator is seeded once, and then outlives the ecalls.
+    num_reseeds = _draw(enclave, 16);
+    OE_TEST(num_reseeds >= 1);
+
+    for (size_t i = 0; i < NUM_ECALLS; i++)
+        OE_TEST(_draw(enclave, 16) == num_reseeds);
+
+    // Long draws are still reseeded.
+    OE_TEST(_draw(enclave, LARGE_DRAW) > num_reseeds);
+
+    result = oe_terminate_enclave(enclave);
+    OE_TEST(result == OE_OK);
+
+    printf("=== passed all tests (random_state)\n");
+
+    return 0;
+}
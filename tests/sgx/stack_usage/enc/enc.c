@@ -0,0 +1,33 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/enclave.h>
+#include <string.h>
+#include "stack_usage_t.h"
+
+/* Recurse with a kilobyte frame per level, which the compiler cannot elide
+ * since the frames are volatile. */
+static OE_NEVER_INLINE int _recurse(size_t depth)
+{
+    volatile unsigned char frame[1024];
+
+    memset((void*)frame, (int)depth, sizeof(frame));
+
+    if (depth <= 1)
+        return frame[0];
+
+    return _recurse(depth - 1) + frame[sizeof(frame) - 1];
+}
+
+int enc_use_stack(size_t kilobytes)
+{
+    return _recurse(kilobytes);
+}
+
+OE_SET_ENCLAVE_SGX(
+    1,    /* ProductID */
+    1,    /* SecurityVersion */
+    true, /* Debug */
+    1024, /* NumHeapPages */
+    32,   /* NumStackPages */
+    2);   /* NumTCS */
@@ -0,0 +1,100 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/host.h>
+#include <openenclave/internal/tests.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "stack_usage_u.h"
+
+/* Must match the enclave configuration */
+#define NUM_TCS 2
+#define STACK_SIZE (32 * 4096)
+
+/* Depth of the recursion of enc_use_stack() in kilobytes */
+#define DEPTH 64
+
+static uint64_t _get_max_usage(oe_enclave_t* enclave)
+{
+    uint64_t stack_usage[NUM_TCS];
+    size_t num_threads = NUM_TCS;
+    size_t stack_size = 0;
+    uint64_t max_usage = 0;
+
+    OE_TEST(
+        oe_get_enclave_stack_usage(
+            enclave, stack_usage, &num_threads, &stack_size) == OE_OK);
+    OE_TEST(num_threads == NUM_TCS);
+    OE_TEST(stack_size == STACK_SIZE);
+
+    for (size_t i = 0; i < num_threads; i++)
+    {
+        OE_TEST(stack_usage[i] <= stack_size);
+        if (stack_usage[i] > max_usage)
+            max_usage = stack_usage[i];
+    }
+
+    return max_usage;
+}
+
+int main(int argc, const char* argv[])
+{
+    oe_result_t result;
+    oe_enclave_t* enclave = NULL;
+    size_t num_threads = 0;
+    size_t stack_size = 0;
+    uint64_t before;
+    uint64_t after;
+    int retval;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s ENCLAVE_PATH\n", argv[0]);
+        return 1;
+    }
+
+    const uint32_t flags = oe_get_create_flags();
+
+    result = oe_create_stack_usage_enclave(
+        argv[1], OE_ENCLAVE_TYPE_SGX, flags, NULL, 0, &enclave);
+    OE_TEST(result == OE_OK);
+
+    OE_TEST(
+        oe_get_enclave_stack_usage(NULL, NULL, &num_threads, NULL) ==
+        OE_INVALID_PARAMETER);
+    OE_TEST(
+        oe_get_enclave_stack_usage(enclave, NULL, NULL, NULL) ==
+        OE_INVALID_PARAMETER);
+
+    /* An empty buffer gets the number of threads */
+    OE_TEST(
+        oe_get_enclave_stack_usage(enclave, NULL, &num_threads, &stack_size) ==
+        OE_BUFFER_TOO_SMALL);
+    OE_TEST(num_threads == NUM_TCS);
+    OE_TEST(stack_size == STACK_SIZE);
+
+    /* Initialization already used some stack, but less than the recursion */
+    before = _get_max_usage(enclave);
+    OE_TEST(before > 0);
+    OE_TEST(before < DEPTH * 1024);
+
+    OE_TEST(enc_use_stack(enclave, &retval, DEPTH) == OE_OK);
+    after = _get_max_usage(enclave);
+    OE_TEST(after >= DEPTH * 1024);
+
+    /* The usage is a high watermark */
+    OE_TEST(enc_use_stack(enclave, &retval, 1) == OE_OK);
+    OE_TEST(_get_max_usage(enclave) == after);
+
+    printf(
+        "stack usage: %llu bytes before, %llu bytes after\n",
+        (unsigned long long)before,
+        (unsigned long long)after);
+
+    result = oe_terminate_enclave(enclave);
+    OE_TEST(result == OE_OK);
+
+    printf("=== passed all tests (stack_usage)\n");
+
+    return 0;
+}
@@ -0,0 +1,241 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <errno.h>
+#include <openenclave/enclave.h>
+#include <openenclave/internal/tests.h>
+#include <openenclave/internal/threadpool.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "thread_pool_t.h"
+
+#define MAX_THREADS 16
+
+/* Number of loop iterations of each call, so that a call takes long enough
+ * for other threads to steal work */
+#define WORK_PER_CALL 1000
+
+static pthread_mutex_t _mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _cond = PTHREAD_COND_INITIALIZER;
+static size_t _num_started;
+static bool _open;
+
+static pthread_t _selves[MAX_THREADS];
+
+/* Record the thread, and wait until the gate opens */
+static void* _wait_for_gate(void* arg)
+{
+    size_t index = (size_t)arg;
+
+    _selves[index] = pthread_self();
+
+    pthread_mutex_lock(&_mutex);
+    _num_started++;
+    pthread_cond_broadcast(&_cond);
+    while (!_open)
+        pthread_cond_wait(&_cond, &_mutex);
+    pthread_mutex_unlock(&_mutex);
+
+    return (void*)(index * 2 + 1);
+}
+
+static void* _set_flag(void* arg)
+{
+    __atomic_store_n((bool*)arg, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void* _return_arg(void* arg)
+{
+    return arg;
+}
+
+static pthread_key_t _key;
+static bool _destructed;
+
+static void _destruct(void* value)
+{
+    __atomic_store_n((bool*)value, true, __ATOMIC_RELEASE);
+}
+
+static void* _set_specific(void* arg)
+{
+    OE_TEST(pthread_getspecific(_key) == NULL);
+    OE_TEST(pthread_setspecific(_key, arg) == 0);
+    return NULL;
+}
+
+void enc_test_pthreads(size_t num_threads)
+{
+    pthread_t threads[MAX_THREADS];
+    pthread_t extra;
+    pthread_attr_t attr;
+    void* retval = NULL;
+    bool flag = false;
+
+    OE_TEST(num_threads <= MAX_THREADS);
+    OE_TEST(oe_thread_pool_get_num_threads() == num_threads);
+
+    /* Take every thread of the pool */
+    for (size_t i = 0; i < num_threads; i++)
+        OE_TEST(
+            pthread_create(&threads[i], NULL, _wait_for_gate, (void*)i) == 0);
+
+    pthread_mutex_lock(&_mutex);
+    while (_num_started < num_threads)
+        pthread_cond_wait(&_cond, &_mutex);
+    pthread_mutex_unlock(&_mutex);
+
+    /* The pool has no thread left */
+    OE_TEST(pthread_create(&extra, NULL, _return_arg, NULL) == EAGAIN);
+
+    pthread_mutex_lock(&_mutex);
+    _open = true;
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_mutex);
+
+    for (size_t i = 0; i < num_threads; i++)
+    {
+        OE_TEST(pthread_join(threads[i], &retval) == 0);
+        OE_TEST(retval == (void*)(i * 2 + 1));
+
+        /* The thread saw the identifier returned by pthread_create() */
+        OE_TEST(pthread_equal(_selves[i], threads[i]));
+    }
+
+    /* A detached thread frees itself */
+    OE_TEST(pthread_create(&extra, NULL, _set_flag, &flag) == 0);
+    OE_TEST(pthread_detach(extra) == 0);
+    while (!__atomic_load_n(&flag, __ATOMIC_ACQUIRE))
+        sched_yield();
+
+    /* A thread created detached frees itself too */
+    flag = false;
+    OE_TEST(pthread_attr_init(&attr) == 0);
+    OE_TEST(pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED) == 0);
+    OE_TEST(pthread_create(&extra, &attr, _set_flag, &flag) == 0);
+    while (!__atomic_load_n(&flag, __ATOMIC_ACQUIRE))
+        sched_yield();
+
+    /* The threads of the pool have the stacks of their TCSs */
+    OE_TEST(pthread_attr_setstacksize(&attr, 1024 * 1024) == 0);
+    OE_TEST(pthread_create(&extra, &attr, _return_arg, NULL) == EINVAL);
+    OE_TEST(pthread_attr_destroy(&attr) == 0);
+
+    /* The destructors of the keys run when the thread returns, and the next
+     * threads on the same thread of the pool start without the values */
+    OE_TEST(pthread_key_create(&_key, _destruct) == 0);
+    for (size_t i = 0; i < 2 * num_threads; i++)
+    {
+        _destructed = false;
+        OE_TEST(pthread_create(&extra, NULL, _set_specific, &_destructed) == 0);
+        OE_TEST(pthread_join(extra, NULL) == 0);
+        while (!__atomic_load_n(&_destructed, __ATOMIC_ACQUIRE))
+            sched_yield();
+    }
+    OE_TEST(pthread_key_delete(_key) == 0);
+
+    /* The threads of the pool are reused */
+    for (size_t i = 0; i < 4 * num_threads; i++)
+    {
+        OE_TEST(pthread_create(&extra, NULL, _return_arg, (void*)i) == 0);
+        OE_TEST(pthread_join(extra, &retval) == 0);
+        OE_TEST(retval == (void*)i);
+    }
+
+    /* The thread of the ecall was not created by pthread_create() */
+    OE_TEST(pthread_join(pthread_self(), NULL) == ESRCH);
+}
+
+typedef struct _loop_args
+{
+    uint32_t* hits;
+    uint64_t generation;
+    size_t num_callers;
+} loop_args_t;
+
+static uint64_t _generation;
+static __thread uint64_t _seen_generation;
+
+static void _hit(size_t index, void* arg)
+{
+    loop_args_t* args = (loop_args_t*)arg;
+    volatile uint64_t sum = 0;
+
+    /* Count the threads that made calls in this loop */
+    if (_seen_generation != args->generation)
+    {
+        _seen_generation = args->generation;
+        __atomic_add_fetch(&args->num_callers, 1, __ATOMIC_RELAXED);
+    }
+
+    for (size_t i = 0; i < WORK_PER_CALL; i++)
+        sum += i;
+
+    __atomic_add_fetch(&args->hits[index], 1, __ATOMIC_RELAXED);
+}
+
+/* Call _hit() for each index, and check that each was hit once */
+static size_t _run_loop(size_t count)
+{
+    loop_args_t args;
+
+    args.hits = (uint32_t*)calloc(count, sizeof(uint32_t));
+    args.generation = __atomic_add_fetch(&_generation, 1, __ATOMIC_RELAXED);
+    args.num_callers = 0;
+    OE_TEST(args.hits != NULL);
+
+    OE_TEST(oe_thread_pool_parallel_for(count, _hit, &args) == OE_OK);
+
+    for (size_t i = 0; i < count; i++)
+        OE_TEST(args.hits[i] == 1);
+
+    free(args.hits);
+
+    return args.num_callers;
+}
+
+size_t enc_test_parallel_for(size_t count)
+{
+    OE_TEST(oe_thread_pool_parallel_for(count, NULL, NULL) != OE_OK);
+    OE_TEST(oe_thread_pool_parallel_for(0, _hit, NULL) == OE_OK);
+
+    return _run_loop(count);
+}
+
+static void* _run_loop_thread(void* arg)
+{
+    _run_loop((size_t)arg);
+    return NULL;
+}
+
+void enc_test_nested_parallel_for(size_t count)
+{
+    pthread_t thread;
+
+    /* Two loops at once, one of them from a thread of the pool */
+    OE_TEST(pthread_create(&thread, NULL, _run_loop_thread, (void*)count) == 0);
+    _run_loop(count);
+    OE_TEST(pthread_join(thread, NULL) == 0);
+}
+
+void enc_test_no_pool(void)
+{
+    pthread_t thread;
+
+    OE_TEST(oe_thread_pool_get_num_threads() == 0);
+    OE_TEST(pthread_create(&thread, NULL, _return_arg, NULL) == EAGAIN);
+
+    /* The calling thread makes all the calls */
+    OE_TEST(_run_loop(100) == 1);
+}
+
+OE_SET_ENCLAVE_SGX(
+    1,    /* ProductID */
+    1,    /* SecurityVersion */
+    true, /* Debug */
+    1024, /* NumHeapPages */
+    64,   /* NumStackPages */
+    8);   /* NumTCS */
@@ -0,0 +1,96 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/host.h>
+#include <openenclave/internal/tests.h>
+#include <cstdio>
+#include "thread_pool_u.h"
+
+// The enclave has 8 TCSs, one of which the pool leaves to the ecalls.
+#define NUM_THREADS 4
+#define NUM_TCS 8
+
+#define LOOP_COUNT 100000
+
+static uint64_t _get_num_ecalls(oe_enclave_t* enclave)
+{
+    oe_enclave_call_statistics_t statistics;
+    uint64_t num_ecalls;
+
+    OE_TEST(oe_get_enclave_call_statistics(enclave, &statistics) == OE_OK);
+    num_ecalls = statistics.num_ecalls;
+    oe_free_enclave_call_statistics(&statistics);
+
+    return num_ecalls;
+}
+
+static oe_result_t _create_enclave(
+    const char* path,
+    uint32_t num_threads,
+    oe_enclave_t** enclave)
+{
+    oe_enclave_setting_thread_pool_t thread_pool_setting = {num_threads};
+    oe_enclave_setting_t setting;
+
+    setting.setting_type = OE_ENCLAVE_SETTING_THREAD_POOL;
+    setting.u.thread_pool_setting = &thread_pool_setting;
+
+    return oe_create_thread_pool_enclave(
+        path,
+        OE_ENCLAVE_TYPE_SGX,
+        oe_get_create_flags(),
+        num_threads ? &setting : NULL,
+        num_threads ? 1 : 0,
+        enclave);
+}
+
+int main(int argc, const char* argv[])
+{
+    oe_result_t result;
+    oe_enclave_t* enclave = NULL;
+    uint64_t num_ecalls;
+    size_t num_callers = 0;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s ENCLAVE_PATH\n", argv[0]);
+        return 1;
+    }
+
+    result = _create_enclave(argv[1], NUM_THREADS, &enclave);
+    OE_TEST(result == OE_OK);
+
+    OE_TEST(enc_test_pthreads(enclave, NUM_THREADS) == OE_OK);
+
+    // The loop runs on the threads of the pool without further ecalls.
+    num_ecalls = _get_num_ecalls(enclave);
+    OE_TEST(enc_test_parallel_for(enclave, &num_callers, LOOP_COUNT) == OE_OK);
+    num_ecalls = _get_num_ecalls(enclave) - num_ecalls;
+
+    printf(
+        "%zu of %d threads made the calls of the loop\n",
+        num_callers,
+        NUM_THREADS + 1);
+    OE_TEST(num_ecalls == 1);
+    OE_TEST(num_callers >= 1 && num_callers <= NUM_THREADS + 1);
+
+    OE_TEST(enc_test_nested_parallel_for(enclave, LOOP_COUNT) == OE_OK);
+
+    result = oe_terminate_enclave(enclave);
+    OE_TEST(result == OE_OK);
+
+    // Without the setting, pthread_create() fails instead of aborting.
+    result = _create_enclave(argv[1], 0, &enclave);
+    OE_TEST(result == OE_OK);
+    OE_TEST(enc_test_no_pool(enclave) == OE_OK);
+    result = oe_terminate_enclave(enclave);
+    OE_TEST(result == OE_OK);
+
+    // The pool cannot take every TCS.
+    result = _create_enclave(argv[1], NUM_TCS, &enclave);
+    OE_TEST(result == OE_INVALID_PARAMETER);
+
+    printf("=== passed all tests (thread_pool)\n");
+
+    return 0;
+}
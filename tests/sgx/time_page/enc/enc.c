@@ -0,0 +1,81 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <errno.h>
+#include <openenclave/enclave.h>
+#include <openenclave/internal/tests.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <time.h>
+#include "time_page_t.h"
+
+#define NSEC_PER_SEC 1000000000ULL
+#define NSEC_PER_MSEC 1000000ULL
+
+/* Largest difference accepted between the host and enclave clocks */
+#define MAX_SKEW (5 * NSEC_PER_SEC)
+
+uint64_t enc_get_clock(int clock_id)
+{
+    struct timespec ts;
+
+    OE_TEST(clock_gettime(clock_id, &ts) == 0);
+    OE_TEST(ts.tv_nsec >= 0 && (uint64_t)ts.tv_nsec < NSEC_PER_SEC);
+
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+/* Check that the clock never goes backwards, and return the smallest step
+ * between two different reads */
+static uint64_t _test_monotonic(int clock_id, size_t count)
+{
+    uint64_t previous = enc_get_clock(clock_id);
+    uint64_t min_step = UINT64_MAX;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t now = enc_get_clock(clock_id);
+
+        OE_TEST(now >= previous);
+        if (now > previous && now - previous < min_step)
+            min_step = now - previous;
+
+        previous = now;
+    }
+
+    return min_step;
+}
+
+void enc_test_clocks(uint64_t host_realtime, size_t count)
+{
+    uint64_t realtime = enc_get_clock(CLOCK_REALTIME);
+    struct timeval tv;
+    struct timespec ts;
+
+    OE_TEST(realtime + MAX_SKEW > host_realtime);
+    OE_TEST(realtime < host_realtime + MAX_SKEW);
+
+    OE_TEST(gettimeofday(&tv, NULL) == 0);
+    OE_TEST((uint64_t)tv.tv_sec * NSEC_PER_SEC + MAX_SKEW > realtime);
+    OE_TEST(time(NULL) + 5 > (time_t)(realtime / NSEC_PER_SEC));
+
+    /* The clocks have a finer resolution than milliseconds */
+    OE_TEST(_test_monotonic(CLOCK_MONOTONIC, count) < NSEC_PER_MSEC);
+    OE_TEST(_test_monotonic(CLOCK_MONOTONIC_RAW, count) < NSEC_PER_MSEC);
+    _test_monotonic(CLOCK_MONOTONIC_COARSE, count);
+    OE_TEST(
+        enc_get_clock(CLOCK_REALTIME_COARSE) + MAX_SKEW > host_realtime);
+
+    /* Other clocks fail instead of aborting the enclave */
+    errno = 0;
+    OE_TEST(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) == -1);
+    OE_TEST(errno == EINVAL);
+}
+
+OE_SET_ENCLAVE_SGX(
+    1,    /* ProductID */
+    1,    /* SecurityVersion */
+    true, /* Debug */
+    1024, /* NumHeapPages */
+    64,   /* NumStackPages */
+    2);   /* NumTCS */
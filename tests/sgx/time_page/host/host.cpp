@@ -0,0 +1,115 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include <openenclave/host.h>
+#include <openenclave/internal/tests.h>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+#if defined(__GNUC__)
+#include <cpuid.h>
+#endif
+#include "time_page_u.h"
+
+#define NUM_READS 10000
+
+/* The clock ids of the enclave libc */
+#define CLOCK_REALTIME 0
+#define CLOCK_MONOTONIC 1
+#define CLOCK_MONOTONIC_RAW 4
+
+static bool _is_tsc_invariant(void)
+{
+#if defined(__GNUC__)
+    unsigned int eax = 0;
+    unsigned int ebx = 0;
+    unsigned int ecx = 0;
+    unsigned int edx = 0;
+
+    return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) &&
+           (edx & 0x100) != 0;
+#else
+    return false;
+#endif
+}
+
+static uint64_t _get_clock(oe_enclave_t* enclave, int clock_id)
+{
+    uint64_t time = 0;
+
+    OE_TEST(enc_get_clock(enclave, &time, clock_id) == OE_OK);
+
+    return time;
+}
+
+static uint64_t _get_num_ocalls(oe_enclave_t* enclave)
+{
+    oe_enclave_call_statistics_t statistics;
+    uint64_t num_ocalls;
+
+    OE_TEST(oe_get_enclave_call_statistics(enclave, &statistics) == OE_OK);
+    num_ocalls = statistics.num_ocalls;
+    oe_free_enclave_call_statistics(&statistics);
+
+    return num_ocalls;
+}
+
+int main(int argc, const char* argv[])
+{
+    oe_result_t result;
+    oe_enclave_t* enclave = NULL;
+    struct timespec ts;
+    uint64_t num_ocalls;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "Usage: %s ENCLAVE_PATH\n", argv[0]);
+        return 1;
+    }
+
+    const uint32_t flags = oe_get_create_flags();
+
+    result = oe_create_time_page_enclave(
+        argv[1], OE_ENCLAVE_TYPE_SGX, flags, NULL, 0, &enclave);
+    OE_TEST(result == OE_OK);
+
+    OE_TEST(timespec_get(&ts, TIME_UTC) == TIME_UTC);
+
+    num_ocalls = _get_num_ocalls(enclave);
+    OE_TEST(
+        enc_test_clocks(
+            enclave,
+            (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec,
+            NUM_READS) == OE_OK);
+    num_ocalls = _get_num_ocalls(enclave) - num_ocalls;
+
+    printf(
+        "%llu ocalls for %d reads of each clock\n",
+        (unsigned long long)num_ocalls,
+        4 * NUM_READS);
+
+    /* RDTSC is always legal in simulation mode, so the enclave should only
+     * leave to update the time page */
+    if ((flags & OE_ENCLAVE_FLAG_SIMULATE) && _is_tsc_invariant())
+        OE_TEST(num_ocalls < NUM_READS);
+
+    /* The monotonic clocks follow the host across updates of the page */
+    const int monotonic_clocks[] = {CLOCK_MONOTONIC, CLOCK_MONOTONIC_RAW};
+    for (int clock_id : monotonic_clocks)
+    {
+        uint64_t start = _get_clock(enclave, clock_id);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+        uint64_t elapsed = _get_clock(enclave, clock_id) - start;
+
+        OE_TEST(elapsed >= 1400000000ULL);
+        OE_TEST(elapsed < 60000000000ULL);
+    }
+
+    result = oe_terminate_enclave(enclave);
+    OE_TEST(result == OE_OK);
+
+    printf("=== passed all tests (time_page)\n");
+
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <openenclave/corelibc/string.h>
 #include <openenclave/enclave.h>
 #include <openenclave/internal/print.h>
+#include <openenclave/internal/sgx/writebarrier.h>
 #include <openenclave/internal/tests.h>
 #include "write_with_barrier_t.h"
 
@@ -523,6 +524,99 @@ void enc_write_with_barrier()
     }
 }
 
+#define VECTOR_TEST_SIZE (64 * 1024)
+#define BENCHMARK_MAX_SIZE (4 * 1024 * 1024)
+
+static uint8_t _vector_src[VECTOR_TEST_SIZE + 64];
+static uint8_t _vector_dest[VECTOR_TEST_SIZE + 128]
+    __attribute__((aligned(64)));
+static uint8_t _vector_expected[sizeof(_vector_dest)];
+static uint8_t _benchmark_src[BENCHMARK_MAX_SIZE];
+
+static void _test_vector_writes(void)
+{
+    static const size_t sizes[] = {
+        256, 264, 384, 1000, 4096, 4104, 12345, VECTOR_TEST_SIZE};
+
+    for (size_t i = 0; i < sizeof(_vector_src); i++)
+        _vector_src[i] = (uint8_t)(i * 131 + 7);
+
+    for (size_t s = 0; s < OE_COUNTOF(sizes); s++)
+    {
+        for (size_t dest_offset = 0; dest_offset < 40; dest_offset++)
+        {
+            const size_t src_offset = dest_offset % 13;
+            uint8_t* dest = _vector_dest + dest_offset;
+
+            /* Only the bytes in [dest, dest + size) must change */
+            memset(_vector_dest, 'x', sizeof(_vector_dest));
+            memset(_vector_expected, 'x', sizeof(_vector_expected));
+            memcpy(
+                _vector_expected + dest_offset,
+                _vector_src + src_offset,
+                sizes[s]);
+
+            OE_TEST(
+                oe_memcpy_with_barrier(
+                    dest, _vector_src + src_offset, sizes[s]) == dest);
+            OE_TEST(
+                memcmp(
+                    _vector_dest,
+                    _vector_expected,
+                    sizeof(_vector_dest)) == 0);
+
+            memset(_vector_expected + dest_offset, 'a', sizes[s]);
+
+            OE_TEST(oe_memset_with_barrier(dest, 'a', sizes[s]) == dest);
+            OE_TEST(
+                memcmp(
+                    _vector_dest,
+                    _vector_expected,
+                    sizeof(_vector_dest)) == 0);
+        }
+    }
+}
+
+bool enc_write_with_barrier_vector()
+{
+    /* The scalar paths, then the vector paths if the CPU supports them */
+    oe_set_write_barrier_vector_enabled(false);
+    _test_vector_writes();
+
+    bool supported = oe_set_write_barrier_vector_enabled(true);
+    if (supported)
+        _test_vector_writes();
+
+    return supported;
+}
+
+void enc_benchmark_write_with_barrier(
+    void* host_buffer,
+    size_t size,
+    size_t offset,
+    size_t iterations,
+    bool fill,
+    bool vector)
+{
+    uint8_t* dest = (uint8_t*)host_buffer + offset;
+
+    OE_TEST(oe_is_outside_enclave(dest, size));
+    OE_TEST(size <= sizeof(_benchmark_src));
+
+    oe_set_write_barrier_vector_enabled(vector);
+
+    for (size_t i = 0; i < iterations; i++)
+    {
+        if (fill)
+            oe_memset_with_barrier(dest, (int)i, size);
+        else
+            oe_memcpy_with_barrier(dest, _benchmark_src, size);
+    }
+
+    /* Back to the default */
+    oe_set_write_barrier_vector_enabled(true);
+}
+
 OE_SET_ENCLAVE_SGX(
     1,    /* ProductID */
     1,    /* SecurityVersion */
@@ -2,8 +2,10 @@
 // Licensed under the MIT License.
 
 #include <openenclave/corelibc/string.h>
+#include <openenclave/edger8r/enclave.h>
 #include <openenclave/enclave.h>
 #include <openenclave/internal/print.h>
+#include <openenclave/internal/sgx/td.h>
 #include <openenclave/internal/tests.h>
 #include <string.h>
 #include "switchless_test_t.h"
@@ -127,3 +129,141 @@ OE_SET_ENCLAVE_SGX(
     OE_TEST_MT_HEAP_SIZE(NUM_TCS), /* NumHeapPages */
     64,                            /* NumStackPages */
     NUM_TCS);                      /* NumTCS */
+
+/* host_add_switchless_fcn_id and the marshaling struct are defined in
+ * switchless_test_t.c, must be kept in sync */
+static const size_t host_add_switchless_fcn_id = 3;
+
+typedef struct _add_switchless_async_args
+{
+    oe_result_t _result;
+    void* deepcopy_out_buffer;
+    size_t deepcopy_out_buffer_size;
+    uint64_t _retval;
+    uint64_t value;
+} add_switchless_async_args_t;
+
+void enc_test_async_switchless_ocalls(uint64_t count)
+{
+    add_switchless_async_args_t args = {0};
+    add_switchless_async_args_t out = {0};
+    oe_switchless_call_t* call = NULL;
+    size_t out_size = 0;
+
+    args.value = 1;
+
+    // Fire and forget. The ECALL waits for these calls before it returns.
+    for (uint64_t i = 0; i < count; i++)
+        OE_TEST(
+            oe_switchless_call_host_function_async(
+                host_add_switchless_fcn_id,
+                &args,
+                sizeof(args),
+                sizeof(args),
+                NULL) == OE_OK);
+
+    // Keep the handle of one call, and wait for its result.
+    OE_TEST(
+        oe_switchless_call_host_function_async(
+            host_add_switchless_fcn_id,
+            &args,
+            sizeof(args),
+            sizeof(args),
+            &call) == OE_OK);
+    OE_TEST(call != NULL);
+
+    while (!oe_switchless_call_is_complete(call))
+        ;
+
+    OE_TEST(
+        oe_switchless_call_wait(call, &out, sizeof(out), &out_size) == OE_OK);
+    OE_TEST(out_size == sizeof(out));
+    OE_TEST(out._result == OE_OK);
+    OE_TEST(out._retval >= 1 && out._retval <= count + 1);
+
+    // The outputs must fit in the given buffer.
+    OE_TEST(
+        oe_switchless_call_host_function_async(
+            host_add_switchless_fcn_id,
+            &args,
+            sizeof(args),
+            sizeof(args),
+            &call) == OE_OK);
+    OE_TEST(
+        oe_switchless_call_wait(call, &out, sizeof(uint64_t), NULL) ==
+        OE_BUFFER_TOO_SMALL);
+
+    oe_host_printf("async_switchless_ocalls passed.\n");
+}
+
+#define NUM_ARENA_CALLS 8
+#define ARENA_CALL_OUTPUT_SIZE (64 * 1024)
+#define ARENA_MIN_CHUNK_SIZE (64 * 1024)
+
+static void _make_arena_calls(size_t num_calls, size_t output_size)
+{
+    add_switchless_async_args_t args = {0};
+    oe_switchless_call_t* calls[NUM_ARENA_CALLS];
+
+    args.value = 1;
+
+    // Keep all the handles, so that all the reservations are live at once.
+    for (size_t i = 0; i < num_calls; i++)
+        OE_TEST(
+            oe_switchless_call_host_function_async(
+                host_add_switchless_fcn_id,
+                &args,
+                sizeof(args),
+                output_size,
+                &calls[i]) == OE_OK);
+
+    for (size_t i = num_calls; i > 0; i--)
+        OE_TEST(oe_switchless_call_wait(calls[i - 1], NULL, 0, NULL) == OE_OK);
+}
+
+void enc_test_arena_trim(uint64_t step)
+{
+    oe_shared_memory_arena_t* arena = &oe_sgx_get_td()->arena;
+
+    switch (step)
+    {
+        case 0:
+            // The arena grows by chaining chunks.
+            _make_arena_calls(NUM_ARENA_CALLS, ARENA_CALL_OUTPUT_SIZE);
+            OE_TEST(arena->num_chunks > 1);
+            OE_TEST(
+                arena->statistics.high_watermark >=
+                NUM_ARENA_CALLS * ARENA_CALL_OUTPUT_SIZE);
+            OE_TEST(arena->statistics.capacity >= arena->in_use);
+            break;
+
+        case 1:
+            // The chunks were coalesced into a single chunk for this ECALL.
+            OE_TEST(arena->num_chunks == 0);
+            OE_TEST(
+                arena->preferred_capacity >=
+                NUM_ARENA_CALLS * ARENA_CALL_OUTPUT_SIZE);
+            _make_arena_calls(1, sizeof(add_switchless_async_args_t));
+            OE_TEST(arena->num_chunks == 1);
+            OE_TEST(arena->chunks[0].capacity == arena->preferred_capacity);
+            break;
+
+        case 2:
+            // That chunk was too large for the last ECALL, and was released.
+            OE_TEST(arena->num_chunks == 0);
+            OE_TEST(arena->preferred_capacity == ARENA_MIN_CHUNK_SIZE);
+            _make_arena_calls(1, sizeof(add_switchless_async_args_t));
+            break;
+
+        case 3:
+            // The right-sized chunk is kept across ECALLs.
+            OE_TEST(arena->num_chunks == 1);
+            OE_TEST(arena->chunks[0].capacity == ARENA_MIN_CHUNK_SIZE);
+            OE_TEST(arena->in_use == 0);
+            _make_arena_calls(1, sizeof(add_switchless_async_args_t));
+            OE_TEST(arena->statistics.num_failures == 0);
+            break;
+    }
+
+    oe_host_printf("arena_trim step %d passed.\n", (int)step);
+}
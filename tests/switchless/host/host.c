@@ -76,6 +76,82 @@ int host_echo_regular(
     return 0;
 }
 
+static uint64_t _host_add_total;
+
+uint64_t host_add_switchless(uint64_t value)
+{
+    OE_TEST(value == 1);
+    return oe_atomic_increment(&_host_add_total);
+}
+
+#define NUM_ASYNC_OCALLS (1000)
+
+static void test_async_switchless_ocalls(oe_enclave_t* enclave)
+{
+    _host_add_total = 0;
+
+    // Every call, including the fire-and-forget ones, has completed by the
+    // time the ECALL returns.
+    OE_TEST(
+        enc_test_async_switchless_ocalls(enclave, NUM_ASYNC_OCALLS) == OE_OK);
+    OE_TEST(oe_atomic_load(&_host_add_total) == NUM_ASYNC_OCALLS + 2);
+}
+
+static void test_arena_trim(oe_enclave_t* enclave)
+{
+    // Each step checks what the previous ECALL left in the arena of the
+    // thread, which is bound to the same TCS across the steps.
+    for (uint64_t step = 0; step < 4; step++)
+        OE_TEST(enc_test_arena_trim(enclave, step) == OE_OK);
+}
+
+static void test_call_statistics(
+    oe_enclave_t* enclave,
+    uint64_t num_switchless_ecalls,
+    uint64_t num_switchless_ocalls)
+{
+    oe_enclave_call_statistics_t stats;
+    uint64_t num_calls = 0;
+
+    OE_TEST(oe_get_enclave_call_statistics(enclave, &stats) == OE_OK);
+
+    printf(
+        "ecalls: %" PRIu64 ", ocalls: %" PRIu64
+        ", switchless ecalls: %" PRIu64 " (%" PRIu64 " fallbacks)"
+        ", switchless ocalls: %" PRIu64 " (%" PRIu64 " fallbacks)\n",
+        stats.num_ecalls,
+        stats.num_ocalls,
+        stats.switchless_ecalls.num_posts,
+        stats.switchless_ecalls.num_fallbacks,
+        stats.switchless_ocalls.num_posts,
+        stats.switchless_ocalls.num_fallbacks);
+
+    OE_TEST(stats.num_ecalls > 0);
+    OE_TEST(stats.switchless_ecalls.num_posts == num_switchless_ecalls);
+    OE_TEST(stats.switchless_ocalls.num_posts >= num_switchless_ocalls);
+    OE_TEST(
+        stats.switchless_ecalls.num_posts ==
+        stats.switchless_ecalls.num_hits +
+            stats.switchless_ecalls.num_fallbacks);
+    OE_TEST(
+        stats.switchless_ocalls.num_posts ==
+        stats.switchless_ocalls.num_hits +
+            stats.switchless_ocalls.num_fallbacks);
+
+    // The hits are the calls handled by the workers.
+    for (size_t i = 0; i < stats.num_host_workers; i++)
+        num_calls += stats.host_workers[i].num_calls;
+    OE_TEST(num_calls == stats.switchless_ocalls.num_hits);
+
+    num_calls = 0;
+    for (size_t i = 0; i < stats.num_enclave_workers; i++)
+        num_calls += stats.enclave_workers[i].num_calls;
+    OE_TEST(num_calls == stats.switchless_ecalls.num_hits);
+
+    oe_free_enclave_call_statistics(&stats);
+    OE_TEST(stats.host_workers == NULL && stats.enclave_workers == NULL);
+}
+
 double make_repeated_switchless_ocalls(oe_enclave_t* enclave)
 {
     char out[STRING_LEN];
@@ -511,6 +587,26 @@ int main(int argc, const char* argv[])
 
     OE_TEST(enc_test_large_switchless_ocall(enclave_switchless) == OE_OK);
 
+    // Without host workers, asynchronous calls are made synchronously.
+    test_async_switchless_ocalls(enclave_switchless);
+    test_async_switchless_ocalls(enclave_normal);
+    test_arena_trim(enclave_normal);
+
+    // Every switchless call made to or from the enclave without switchless
+    // settings is a regular call.
+    if (test_ecalls)
+    {
+        test_call_statistics(
+            enclave_switchless, num_host_threads * NUM_ECALLS, 0);
+        test_call_statistics(enclave_normal, 0, 0);
+    }
+    else
+    {
+        test_call_statistics(
+            enclave_switchless, 0, num_enclave_threads * NUM_OCALLS);
+        test_call_statistics(enclave_normal, 0, 0);
+    }
+
     result = oe_terminate_enclave(enclave_switchless);
     OE_TEST(result == OE_OK);
 
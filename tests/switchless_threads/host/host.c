@@ -1,11 +1,20 @@
 // Copyright (c) Open Enclave SDK contributors.
 // Licensed under the MIT License.
 
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
 #include <openenclave/host.h>
+#include <openenclave/internal/atomic.h>
 #include <openenclave/internal/error.h>
+#include <openenclave/internal/switchless.h>
 #include <openenclave/internal/tests.h>
 #include <openenclave/internal/thread.h>
 
+#if defined(__linux__)
+#include <sched.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,12 +32,55 @@
 #define STRING_HELLO "Hello World"
 #define HOST_PARAM_STRING "host string parameter"
 #define HOST_STACK_STRING "host string on stack"
+#define MAX_WORKER_CPUS 256
+
+// Marks the threads that make ECALLs. Switchless OCALLs that run on any other
+// thread are handled by a host worker.
+static oe_thread_key _caller_key;
+
+// The CPUs that the host workers must be pinned to (none if not pinned).
+static uint32_t _worker_cpus[MAX_WORKER_CPUS];
+static size_t _num_worker_cpus;
+static volatile uint64_t _num_worker_calls;
+
+// Check that the calling host worker may run on exactly the expected CPUs.
+static void _check_worker_affinity(void)
+{
+#if defined(__linux__)
+    cpu_set_t expected;
+    cpu_set_t actual;
+
+    CPU_ZERO(&expected);
+    for (size_t i = 0; i < _num_worker_cpus; i++)
+        CPU_SET(_worker_cpus[i], &expected);
+
+    OE_TEST(sched_getaffinity(0, sizeof(actual), &actual) == 0);
+    OE_TEST(CPU_EQUAL(&expected, &actual));
+#elif _MSC_VER
+    // A pinned thread always runs on one of its CPUs.
+    DWORD cpu = GetCurrentProcessorNumber();
+    bool found = false;
+
+    for (size_t i = 0; i < _num_worker_cpus; i++)
+    {
+        if (_worker_cpus[i] == cpu)
+            found = true;
+    }
+    OE_TEST(found);
+#endif
+}
 
 int host_echo_switchless(char* in, char* out, char* str1, char str2[STRING_LEN])
 {
     OE_TEST(strcmp(str1, HOST_PARAM_STRING) == 0);
     OE_TEST(strcmp(str2, HOST_STACK_STRING) == 0);
 
+    if (_num_worker_cpus && !oe_thread_getspecific(_caller_key))
+    {
+        _check_worker_affinity();
+        oe_atomic_increment(&_num_worker_calls);
+    }
+
     strcpy_s(out, STRING_LEN, in);
 
     return 0;
@@ -50,6 +102,7 @@ void* thread_func(void* arg)
     int return_val;
 
     oe_enclave_t* enclave = (oe_enclave_t*)arg;
+    OE_TEST(oe_thread_setspecific(_caller_key, &_caller_key) == 0);
     oe_result_t result =
         enc_echo_single(enclave, &return_val, "Hello World", out);
 
@@ -65,21 +118,89 @@ void* thread_func(void* arg)
     return NULL;
 }
 
+// Get the first CPU that the process may run on.
+static uint32_t _get_first_cpu(void)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+
+    OE_TEST(sched_getaffinity(0, sizeof(set), &set) == 0);
+    for (uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &set))
+            return cpu;
+    }
+#elif _MSC_VER
+    DWORD_PTR process_mask;
+    DWORD_PTR system_mask;
+
+    OE_TEST(GetProcessAffinityMask(
+        GetCurrentProcess(), &process_mask, &system_mask));
+    for (uint32_t cpu = 0; cpu < sizeof(process_mask) * 8; cpu++)
+    {
+        if (process_mask & ((DWORD_PTR)1 << cpu))
+            return cpu;
+    }
+#endif
+
+    return 0;
+}
+
 int main(int argc, const char* argv[])
 {
     oe_enclave_t* enclave = NULL;
     oe_result_t result;
 
-    if (argc != 2)
+    if (argc < 2)
     {
-        fprintf(stderr, "Usage: %s ENCLAVE_PATH\n", argv[0]);
+        fprintf(
+            stderr,
+            "Usage: %s ENCLAVE_PATH [--ocall-ring] [--pin-workers] "
+            "[--numa-node]\n",
+            argv[0]);
         return 1;
     }
 
     const uint32_t flags = oe_get_create_flags();
 
-    // Enable switchless and configure host worker number
-    oe_enclave_setting_context_switchless_t switchless_setting = {2, 0};
+    OE_TEST(oe_thread_key_create(&_caller_key) == 0);
+    OE_TEST(oe_thread_setspecific(_caller_key, &_caller_key) == 0);
+
+    // Enable switchless and configure host worker number. With the ocall
+    // ring enabled, calls that find both workers busy are queued instead of
+    // falling back to regular ocalls.
+    oe_enclave_setting_context_switchless_t switchless_setting = {2, 0, 0};
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--ocall-ring") == 0)
+        {
+            switchless_setting.ocall_ring_depth = 16;
+        }
+        else if (strcmp(argv[i], "--pin-workers") == 0)
+        {
+            // The process may not be allowed to run on CPU 0.
+            _worker_cpus[0] = _get_first_cpu();
+            _num_worker_cpus = 1;
+            switchless_setting.host_worker_cpus = _worker_cpus;
+            switchless_setting.num_host_worker_cpus = _num_worker_cpus;
+        }
+        else if (strcmp(argv[i], "--numa-node") == 0)
+        {
+            // Node 0 exists on every machine, including single-node ones.
+            // The workers are pinned to all of its CPUs.
+            switchless_setting.pin_to_numa_node = true;
+            switchless_setting.numa_node = 0;
+            OE_TEST(
+                oe_switchless_get_numa_node_cpus(
+                    0, _worker_cpus, MAX_WORKER_CPUS, &_num_worker_cpus) ==
+                OE_OK);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        }
+    }
     oe_enclave_setting_t settings[] = {
         {.setting_type = OE_ENCLAVE_SETTING_CONTEXT_SWITCHLESS,
          .u.context_switchless_setting = &switchless_setting}};
@@ -121,9 +242,16 @@ int main(int argc, const char* argv[])
         oe_thread_join(threads[i]);
     }
 
+    // At least one switchless OCALL must have been handled by a worker for
+    // the affinity check to have run.
+    if (_num_worker_cpus)
+        OE_TEST(oe_atomic_load(&_num_worker_calls) > 0);
+
     result = oe_terminate_enclave(enclave);
     OE_TEST(result == OE_OK);
 
+    oe_thread_key_delete(_caller_key);
+
     printf("=== passed all tests (switchless_threads)\n");
 
     return 0;
@@ -10,6 +10,7 @@
 #include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <thread>
 #include <vector>
 #include "../../../host/hostthread.h"
@@ -91,12 +92,31 @@ int main(int argc, const char* argv[])
     oe_enclave_t* enclave = NULL;
     oe_result_t result;
 
-    if (argc != 2)
+    if (argc < 2)
     {
-        fprintf(stderr, "Usage: %s ENCLAVE\n", argv[0]);
+        fprintf(
+            stderr,
+            "Usage: %s ENCLAVE [--adaptive-spin] [--cpu-budget]\n",
+            argv[0]);
         exit(1);
     }
 
+    // The sleep between the rounds of calls lets adaptive workers retire,
+    // and the second round has to revive them.
+    oe_switchless_spin_policy_t spin_policy = OE_SWITCHLESS_SPIN_POLICY_FIXED;
+    for (int arg = 2; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--adaptive-spin") == 0)
+            spin_policy = OE_SWITCHLESS_SPIN_POLICY_ADAPTIVE;
+        else if (strcmp(argv[arg], "--cpu-budget") == 0)
+            spin_policy = OE_SWITCHLESS_SPIN_POLICY_CPU_BUDGET;
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", argv[arg]);
+            exit(1);
+        }
+    }
+
     printf("Run Sleep-Wake test.\n");
 
     // check number of cores, need at least 4
@@ -123,6 +143,8 @@ int main(int argc, const char* argv[])
 
     oe_enclave_setting_context_switchless_t switchless_setting = {
         workers, workers};
+    switchless_setting.spin_policy = spin_policy;
+    switchless_setting.cpu_budget_percent = 50;
     oe_enclave_setting_t setting;
     setting.setting_type = OE_ENCLAVE_SETTING_CONTEXT_SWITCHLESS;
     setting.u.context_switchless_setting = &switchless_setting;
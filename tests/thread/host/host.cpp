@@ -7,6 +7,7 @@
 #include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cinttypes>
 #include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
@@ -300,6 +301,95 @@ void test_tcs_exhaustion(oe_enclave_t* enclave)
     // Assert that expected thread exhaustion failures have been reached.
     OE_TEST(g_tcs_out_thread_count == expected_out_of_threads);
     OE_TEST(tcs_used_thread_count <= enclave->num_bindings);
+
+    // Every binding is back on the free stack, exactly once.
+    std::vector<bool> is_free(enclave->num_bindings, false);
+    uint32_t next = (uint32_t)enclave->free_bindings;
+    size_t num_free = 0;
+    while (next != 0)
+    {
+        OE_TEST(next <= enclave->num_bindings && !is_free[next - 1]);
+        is_free[next - 1] = true;
+        OE_TEST(!(enclave->bindings[next - 1].flags & _OE_THREAD_BUSY));
+        next = enclave->bindings[next - 1].next_free;
+        num_free++;
+    }
+    OE_TEST(num_free == enclave->num_bindings);
+
+    // The TCSs are evenly spaced, so they are found without a scan.
+    if (enclave->num_bindings > 1)
+        OE_TEST(enclave->tcs_stride != 0);
+}
+
+// this test that, with TCS admission enabled, ecalls beyond the number of TCSs
+// wait for a TCS instead of failing with OE_OUT_OF_THREADS
+//   - the first num_bindings ecalls take every TCS and wait in the host
+//   - the remaining ecalls queue up until the first ones are released
+void test_tcs_admission(const char* path, uint32_t flags)
+{
+    oe_enclave_t* enclave = NULL;
+    oe_enclave_setting_tcs_admission_t admission = {true, 0};
+    oe_enclave_setting_t settings[] = {
+        {OE_ENCLAVE_SETTING_TCS_ADMISSION, {nullptr}}};
+    oe_enclave_call_statistics_t stats;
+    std::vector<std::thread> threads;
+
+    settings[0].u.tcs_admission_setting = &admission;
+    OE_TEST(
+        oe_create_thread_enclave(
+            path, OE_ENCLAVE_TYPE_SGX, flags, settings, 1, &enclave) == OE_OK);
+
+    {
+        std::unique_lock<std::mutex> lock(g_tcs_mutex);
+        g_notify_called = false;
+    }
+
+    const size_t num_threads = enclave->num_bindings * 2;
+    for (size_t i = 0; i < num_threads; i++)
+    {
+        threads.push_back(std::thread([enclave]() {
+            OE_TEST(enc_test_tcs_exhaustion(enclave) == OE_OK);
+        }));
+    }
+
+    // Wait until the ecalls without a TCS have queued up.
+    do
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        OE_TEST(oe_get_enclave_call_statistics(enclave, &stats) == OE_OK);
+        oe_free_enclave_call_statistics(&stats);
+    } while (stats.tcs_queue_depth < enclave->num_bindings);
+
+    {
+        std::unique_lock<std::mutex> lock(g_tcs_mutex);
+        g_tcs_cv.notify_all();
+        g_notify_called = true;
+    }
+
+    for (size_t i = 0; i < num_threads; i++)
+    {
+        threads[i].join();
+    }
+
+    size_t tcs_used_thread_count = 0;
+    OE_TEST(
+        enc_tcs_used_thread_count(enclave, &tcs_used_thread_count) == OE_OK);
+    OE_TEST(tcs_used_thread_count == num_threads);
+
+    OE_TEST(oe_get_enclave_call_statistics(enclave, &stats) == OE_OK);
+    printf(
+        "test_tcs_admission: waits=%" PRIu64 "; max_queue_depth=%" PRIu64
+        "; wait_time=%" PRIu64 " ns\n",
+        stats.num_tcs_waits,
+        stats.max_tcs_queue_depth,
+        stats.tcs_wait_time);
+    OE_TEST(stats.num_tcs_waits == enclave->num_bindings);
+    OE_TEST(stats.max_tcs_queue_depth == enclave->num_bindings);
+    OE_TEST(stats.num_tcs_wait_timeouts == 0);
+    OE_TEST(stats.tcs_queue_depth == 0);
+    oe_free_enclave_call_statistics(&stats);
+
+    OE_TEST(oe_terminate_enclave(enclave) == OE_OK);
 }
 
 void host_wait()
@@ -347,6 +437,8 @@ int main(int argc, const char* argv[])
 
     test_tcs_exhaustion(enclave);
 
+    test_tcs_admission(argv[1], flags);
+
     /*
     test_errno_multi_threads_sameenclave(enclave);
 
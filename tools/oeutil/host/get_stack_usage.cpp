@@ -0,0 +1,225 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#include "get_stack_usage.h"
+#include <openenclave/host.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parse_args_helper.h"
+
+#define INPUT_PARAM_OPTION_ENCLAVE "--enclave"
+#define INPUT_PARAM_OPTION_SIMULATION "--simulation"
+#define INPUT_PARAM_OPTION_HELP "--help"
+#define SHORT_INPUT_PARAM_OPTION_ENCLAVE "-e"
+#define SHORT_INPUT_PARAM_OPTION_SIMULATION "-s"
+#define SHORT_INPUT_PARAM_OPTION_HELP "-h"
+
+#define PAGE_SIZE 4096
+
+typedef struct _get_stack_usage_parameters
+{
+    const char* enclave_filename;
+    bool simulation;
+} get_stack_usage_parameters_t;
+
+static get_stack_usage_parameters_t _parameters;
+
+static void _display_help(const char* command)
+{
+    printf("Stack-usage Usage: %s stack-usage <options>\n", command);
+    printf("options:\n");
+    printf(
+        "\t%s, %s <filename>: signed debug enclave to load.\n",
+        SHORT_INPUT_PARAM_OPTION_ENCLAVE,
+        INPUT_PARAM_OPTION_ENCLAVE);
+    printf(
+        "\t%s, %s: load the enclave in simulation mode.\n",
+        SHORT_INPUT_PARAM_OPTION_SIMULATION,
+        INPUT_PARAM_OPTION_SIMULATION);
+    printf(
+        "\t%s, %s: show this help message.\n",
+        SHORT_INPUT_PARAM_OPTION_HELP,
+        INPUT_PARAM_OPTION_HELP);
+    printf("Example:\n");
+    printf("\toeutil stack-usage --enclave enclave.signed\n");
+}
+
+static int _parse_args(int argc, const char* argv[])
+{
+    // Clear parameters memory
+    memset(&_parameters, 0, sizeof(_parameters));
+
+    _parameters.enclave_filename = nullptr;
+
+    int i = 2; // Start from the third argument (after command name)
+
+    if (argc == 3 && (strcasecmp(INPUT_PARAM_OPTION_HELP, argv[i]) == 0 ||
+                      strcasecmp(SHORT_INPUT_PARAM_OPTION_HELP, argv[i]) == 0))
+    {
+        _display_help(argv[0]);
+        return 2; // Special return value for help
+    }
+
+    while (i < argc)
+    {
+        if (strcasecmp(INPUT_PARAM_OPTION_ENCLAVE, argv[i]) == 0 ||
+            strcasecmp(SHORT_INPUT_PARAM_OPTION_ENCLAVE, argv[i]) == 0)
+        {
+            if (argc < i + 2)
+                break;
+
+            _parameters.enclave_filename = argv[i + 1];
+            i += 2;
+        }
+        else if (
+            strcasecmp(INPUT_PARAM_OPTION_SIMULATION, argv[i]) == 0 ||
+            strcasecmp(SHORT_INPUT_PARAM_OPTION_SIMULATION, argv[i]) == 0)
+        {
+            _parameters.simulation = true;
+            i++;
+        }
+        else
+        {
+            printf("Invalid option: %s\n\n", argv[i]);
+            _display_help(argv[0]);
+            return 1;
+        }
+    }
+
+    if (i < argc)
+    {
+        printf("%s has invalid number of parameters.\n\n", argv[i]);
+        _display_help(argv[0]);
+        return 1;
+    }
+
+    if (!_parameters.enclave_filename)
+    {
+        printf("Enclave file is required.\n\n");
+        _display_help(argv[0]);
+        return 1;
+    }
+
+    return 0;
+}
+
+// Print the stack usage of each thread of the enclave, and the number of
+// stack pages that the deepest thread needed.
+static int _print_stack_usage(oe_enclave_t* enclave)
+{
+    uint64_t* stack_usage = nullptr;
+    size_t num_threads = 0;
+    size_t stack_size = 0;
+    uint64_t max_usage = 0;
+    oe_result_t result;
+    int ret = 1;
+
+    // Get the number of threads first.
+    result = oe_get_enclave_stack_usage(
+        enclave, nullptr, &num_threads, &stack_size);
+    if (result != OE_BUFFER_TOO_SMALL)
+    {
+        printf(
+            "Failed to get the stack usage. Error: %u (%s)\n",
+            result,
+            oe_result_str(result));
+        goto done;
+    }
+
+    stack_usage = (uint64_t*)calloc(num_threads, sizeof(uint64_t));
+    if (stack_usage == nullptr)
+    {
+        printf("Failed to allocate memory for %zu threads\n", num_threads);
+        goto done;
+    }
+
+    result = oe_get_enclave_stack_usage(
+        enclave, stack_usage, &num_threads, &stack_size);
+    if (result != OE_OK)
+    {
+        printf(
+            "Failed to get the stack usage. Error: %u (%s)\n",
+            result,
+            oe_result_str(result));
+        goto done;
+    }
+
+    printf("Thread  Used bytes  Stack bytes\n");
+    for (size_t i = 0; i < num_threads; i++)
+    {
+        printf(
+            "%6zu  %10llu  %11zu\n",
+            i,
+            (unsigned long long)stack_usage[i],
+            stack_size);
+
+        if (stack_usage[i] > max_usage)
+            max_usage = stack_usage[i];
+    }
+
+    printf(
+        "\nDeepest stack usage: %llu bytes (%llu of %zu stack pages)\n",
+        (unsigned long long)max_usage,
+        (unsigned long long)((max_usage + PAGE_SIZE - 1) / PAGE_SIZE),
+        stack_size / PAGE_SIZE);
+
+    ret = 0;
+
+done:
+    free(stack_usage);
+    return ret;
+}
+
+int oeutil_get_stack_usage(int argc, const char* argv[])
+{
+    int ret = 0;
+    oe_enclave_t* enclave = nullptr;
+    uint32_t flags = OE_ENCLAVE_FLAG_DEBUG;
+    oe_result_t result = OE_OK;
+
+    // Parse command line arguments first to handle help
+    ret = _parse_args(argc, argv);
+    if (ret == 2) // Help was displayed
+        return 0;
+    if (ret != 0)
+        return ret;
+
+    if (_parameters.simulation)
+        flags |= OE_ENCLAVE_FLAG_SIMULATE;
+
+    // The enclave runs its initialization and global constructors only, so
+    // the usage reported is the floor for any workload. The usage of a real
+    // workload is logged at oe_terminate_enclave() by the host of the
+    // application when OE_LOG_LEVEL is INFO or higher.
+    result = oe_create_enclave(
+        _parameters.enclave_filename,
+        OE_ENCLAVE_TYPE_SGX,
+        flags,
+        nullptr,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        0,
+        &enclave);
+    if (result != OE_OK)
+    {
+        printf(
+            "Failed to create enclave %s. Error: %u (%s)\n",
+            _parameters.enclave_filename,
+            result,
+            oe_result_str(result));
+        return 1;
+    }
+
+    printf(
+        "Stack usage of enclave %s after initialization:\n\n",
+        _parameters.enclave_filename);
+
+    ret = _print_stack_usage(enclave);
+
+    oe_terminate_enclave(enclave);
+
+    return ret;
+}
@@ -0,0 +1,9 @@
+// Copyright (c) Open Enclave SDK contributors.
+// Licensed under the MIT License.
+
+#ifndef _OE_UTIL_GET_STACK_USAGE_H
+#define _OE_UTIL_GET_STACK_USAGE_H
+
+int oeutil_get_stack_usage(int argc, const char* argv[]);
+
+#endif // _OE_UTIL_GET_STACK_USAGE_H
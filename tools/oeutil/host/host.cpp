@@ -9,6 +9,7 @@
 #include "generate_evidence.h"
 #include "get_endorsements.h"
 #include "get_fmspc.h"
+#include "get_stack_usage.h"
 #include "parse_args_helper.h"
 
 FILE* log_file = nullptr;
@@ -16,6 +17,7 @@ FILE* log_file = nullptr;
 #define COMMAND_GENERATE_EVIDENCE "generate-evidence"
 #define COMMAND_GET_ENDORSEMENTS "get-endorsements"
 #define COMMAND_GET_FMSPC "get-fmspc"
+#define COMMAND_STACK_USAGE "stack-usage"
 
 typedef enum _oeutil_command
 {
@@ -34,6 +36,11 @@ typedef enum _oeutil_command
      */
     OEUTIL_GET_FMSPC = 3,
 
+    /**
+     * Get the stack usage of each thread of an enclave.
+     */
+    OEUTIL_STACK_USAGE = 4,
+
 } oeutil_command_t;
 
 static void _display_help(const char* command)
@@ -47,6 +54,9 @@ static void _display_help(const char* command)
         "\t2. %s: get endorsements for input TDX evidence.\n",
         COMMAND_GET_ENDORSEMENTS);
     printf("\t3. %s: get FMSPC for input TDX evidence.\n", COMMAND_GET_FMSPC);
+    printf(
+        "\t4. %s: get the stack usage of each enclave thread.\n",
+        COMMAND_STACK_USAGE);
     printf("Options:\n\tType oeutil <command> --help for more information\n");
 }
 
@@ -73,6 +83,10 @@ static oeutil_command_t _get_oeutil_command(int argc, const char* argv[])
     {
         command_type = OEUTIL_GET_FMSPC;
     }
+    else if (strncasecmp(COMMAND_STACK_USAGE, argv[1], strlen(argv[1])) == 0)
+    {
+        command_type = OEUTIL_STACK_USAGE;
+    }
     else
     {
         printf("Invalid option: %s\n\n", argv[1]);
@@ -99,6 +113,9 @@ int main(int argc, const char* argv[])
         case OEUTIL_GET_FMSPC:
             ret = oeutil_get_fmspc(argc, argv);
             break;
+        case OEUTIL_STACK_USAGE:
+            ret = oeutil_get_stack_usage(argc, argv);
+            break;
         default:
             _display_help(argv[0]);
             ret = 1;